@@ -39,6 +39,8 @@
 
 #include "spandsp/private/async.h"
 
+#include "checkpoint_local.h"
+
 SPAN_DECLARE(const char *) signal_status_to_str(int status)
 {
     switch (status)
@@ -289,4 +291,197 @@ SPAN_DECLARE_NONSTD(int) async_tx_get_bit(void *user_data)
     return bit;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(chunk_tx_state_t *) chunk_tx_init(chunk_tx_state_t *s,
+                                               get_chunk_func_t get_chunk,
+                                               void *user_data,
+                                               int lsb_first)
+{
+    if (s == NULL)
+    {
+        if ((s = (chunk_tx_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    s->get_chunk = get_chunk;
+    s->user_data = user_data;
+    s->lsb_first = lsb_first;
+    chunk_tx_restart(s);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) chunk_tx_restart(chunk_tx_state_t *s)
+{
+    s->len = 0;
+    s->ptr = 0;
+    s->octet = 0;
+    s->bits = 0;
+    s->ended = FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) chunk_tx_release(chunk_tx_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) chunk_tx_free(chunk_tx_state_t *s)
+{
+    free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) chunk_tx_get_bit(void *user_data)
+{
+    chunk_tx_state_t *s;
+    int bit;
+
+    s = (chunk_tx_state_t *) user_data;
+    if (s->bits <= 0)
+    {
+        if (s->ptr >= s->len)
+        {
+            if (s->ended)
+                return SIG_STATUS_END_OF_DATA;
+            s->len = s->get_chunk(s->user_data, s->buf, CHUNK_TX_LEN);
+            s->ptr = 0;
+            if (s->len < CHUNK_TX_LEN)
+            {
+                /* A short chunk is the last one */
+                s->ended = TRUE;
+                if (s->len <= 0)
+                {
+                    s->len = 0;
+                    return SIG_STATUS_END_OF_DATA;
+                }
+            }
+        }
+        s->octet = s->buf[s->ptr++];
+        s->bits = 8;
+    }
+    s->bits--;
+    if (s->lsb_first)
+    {
+        bit = s->octet & 1;
+        s->octet >>= 1;
+    }
+    else
+    {
+        bit = (s->octet >> 7) & 1;
+        s->octet <<= 1;
+    }
+    return bit;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(chunk_rx_state_t *) chunk_rx_init(chunk_rx_state_t *s,
+                                               put_chunk_func_t put_chunk,
+                                               void *user_data,
+                                               int lsb_first)
+{
+    if (s == NULL)
+    {
+        if ((s = (chunk_rx_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    s->put_chunk = put_chunk;
+    s->user_data = user_data;
+    s->lsb_first = lsb_first;
+    s->octet = 0;
+    s->bits = 0;
+    s->len = 0;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) chunk_rx_release(chunk_rx_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) chunk_rx_free(chunk_rx_state_t *s)
+{
+    free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) chunk_rx_flush(chunk_rx_state_t *s)
+{
+    int len;
+
+    /* Clear the buffer before making the callback, in case the callback
+       leads back here. */
+    if ((len = s->len) > 0)
+    {
+        s->len = 0;
+        s->put_chunk(s->user_data, s->buf, len);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) chunk_rx_put_residue(chunk_rx_state_t *s, put_bit_func_t put_bit, void *user_data)
+{
+    int i;
+    int bit;
+
+    if (s->bits  &&  put_bit)
+    {
+        for (i = s->bits - 1;  i >= 0;  i--)
+        {
+            if (s->lsb_first)
+                bit = (s->octet >> (7 - i)) & 1;
+            else
+                bit = (s->octet >> i) & 1;
+            put_bit(user_data, bit);
+        }
+    }
+    s->octet = 0;
+    s->bits = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(void) chunk_rx_put_bit(void *user_data, int bit)
+{
+    chunk_rx_state_t *s;
+
+    s = (chunk_rx_state_t *) user_data;
+    if (s->lsb_first)
+        s->octet = (s->octet >> 1) | (bit << 7);
+    else
+        s->octet = (s->octet << 1) | bit;
+    if (++s->bits >= 8)
+    {
+        s->buf[s->len] = (uint8_t) s->octet;
+        s->bits = 0;
+        if (++s->len >= CHUNK_RX_LEN)
+            chunk_rx_flush(s);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+void chunk_tx_checkpoint(chunk_tx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->lsb_first);
+    checkpoint_field(c, s->buf);
+    checkpoint_field(c, s->len);
+    checkpoint_field(c, s->ptr);
+    checkpoint_field(c, s->octet);
+    checkpoint_field(c, s->bits);
+    checkpoint_field(c, s->ended);
+}
+/*- End of function --------------------------------------------------------*/
+
+void chunk_rx_checkpoint(chunk_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->lsb_first);
+    checkpoint_field(c, s->octet);
+    checkpoint_field(c, s->bits);
+    checkpoint_field(c, s->buf);
+    checkpoint_field(c, s->len);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -41,14 +41,15 @@
 
 SPAN_DECLARE(void) bitstream_put(bitstream_state_t *s, uint8_t **c, uint32_t value, int bits)
 {
-    value &= ((1 << bits) - 1);
+    uint64_t x;
+
+    /* There are never more than 7 bits waiting in the residue, so a 64 bit
+       accumulator can always take a full 32 bit value. */
+    x = value & (((uint64_t) 1 << bits) - 1);
     if (s->lsb_first)
     {
-        if (s->residue + bits <= 32)
-        {
-            s->bitstream |= (value << s->residue);
-            s->residue += bits;
-        }
+        s->bitstream |= (x << s->residue);
+        s->residue += bits;
         while (s->residue >= 8)
         {
             s->residue -= 8;
@@ -58,11 +59,8 @@ SPAN_DECLARE(void) bitstream_put(bitstream_state_t *s, uint8_t **c, uint32_t val
     }
     else
     {
-        if (s->residue + bits <= 32)
-        {
-            s->bitstream = (s->bitstream << bits) | value;
-            s->residue += bits;
-        }
+        s->bitstream = (s->bitstream << bits) | x;
+        s->residue += bits;
         while (s->residue >= 8)
         {
             s->residue -= 8;
@@ -72,13 +70,74 @@ SPAN_DECLARE(void) bitstream_put(bitstream_state_t *s, uint8_t **c, uint32_t val
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) bitstream_put_fields(bitstream_state_t *s, uint8_t **c, const uint32_t values[], const uint8_t bits[], int n)
+{
+    uint64_t bitstream;
+    uint8_t *t;
+    int residue;
+    int i;
+
+    /* Work in local variables, and only write out bytes when 32 bits have built up. */
+    t = *c;
+    bitstream = s->bitstream;
+    residue = s->residue;
+    if (s->lsb_first)
+    {
+        bitstream &= (((uint64_t) 1 << residue) - 1);
+        for (i = 0;  i < n;  i++)
+        {
+            bitstream |= ((values[i] & (((uint64_t) 1 << bits[i]) - 1)) << residue);
+            if ((residue += bits[i]) >= 32)
+            {
+                t[0] = (uint8_t) bitstream;
+                t[1] = (uint8_t) (bitstream >> 8);
+                t[2] = (uint8_t) (bitstream >> 16);
+                t[3] = (uint8_t) (bitstream >> 24);
+                t += 4;
+                bitstream >>= 32;
+                residue -= 32;
+            }
+        }
+        for (  ;  residue >= 8;  residue -= 8)
+        {
+            *t++ = (uint8_t) bitstream;
+            bitstream >>= 8;
+        }
+    }
+    else
+    {
+        for (i = 0;  i < n;  i++)
+        {
+            bitstream = (bitstream << bits[i]) | (values[i] & (((uint64_t) 1 << bits[i]) - 1));
+            if ((residue += bits[i]) >= 32)
+            {
+                residue -= 32;
+                t[0] = (uint8_t) (bitstream >> (residue + 24));
+                t[1] = (uint8_t) (bitstream >> (residue + 16));
+                t[2] = (uint8_t) (bitstream >> (residue + 8));
+                t[3] = (uint8_t) (bitstream >> residue);
+                t += 4;
+            }
+        }
+        while (residue >= 8)
+        {
+            residue -= 8;
+            *t++ = (uint8_t) (bitstream >> residue);
+        }
+    }
+    s->bitstream = bitstream;
+    s->residue = residue;
+    *c = t;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) bitstream_emit(bitstream_state_t *s, uint8_t **c)
 {
-    uint32_t bitstream;
+    uint64_t bitstream;
 
     if (s->residue > 0)
     {
-        bitstream = s->bitstream & ((1 << s->residue) - 1);
+        bitstream = s->bitstream & (((uint64_t) 1 << s->residue) - 1);
         if (s->lsb_first)
             *(*c) = (uint8_t) bitstream;
         else
@@ -107,27 +166,72 @@ SPAN_DECLARE(uint32_t) bitstream_get(bitstream_state_t *s, const uint8_t **c, in
     {
         while (s->residue < bits)
         {
-            s->bitstream |= (((uint32_t) *(*c)++) << s->residue);
+            s->bitstream |= (((uint64_t) *(*c)++) << s->residue);
             s->residue += 8;
         }
         s->residue -= bits;
-        x = s->bitstream & ((1 << bits) - 1);
+        x = (uint32_t) (s->bitstream & (((uint64_t) 1 << bits) - 1));
         s->bitstream >>= bits;
     }
     else
     {
         while (s->residue < bits)
         {
-            s->bitstream = (s->bitstream << 8) | ((uint32_t) *(*c)++);
+            s->bitstream = (s->bitstream << 8) | ((uint64_t) *(*c)++);
             s->residue += 8;
         }
         s->residue -= bits;
-        x = (s->bitstream >> s->residue) & ((1 << bits) - 1);
+        x = (uint32_t) ((s->bitstream >> s->residue) & (((uint64_t) 1 << bits) - 1));
     }
     return x;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) bitstream_get_fields(bitstream_state_t *s, const uint8_t **c, uint32_t values[], const uint8_t bits[], int n)
+{
+    uint64_t bitstream;
+    const uint8_t *t;
+    int residue;
+    int i;
+
+    /* Work in local variables. Bytes are only taken from the buffer as they are
+       needed, so we never read beyond the last field. */
+    t = *c;
+    bitstream = s->bitstream;
+    residue = s->residue;
+    if (s->lsb_first)
+    {
+        for (i = 0;  i < n;  i++)
+        {
+            while (residue < bits[i])
+            {
+                bitstream |= ((uint64_t) *t++ << residue);
+                residue += 8;
+            }
+            values[i] = (uint32_t) (bitstream & (((uint64_t) 1 << bits[i]) - 1));
+            bitstream >>= bits[i];
+            residue -= bits[i];
+        }
+    }
+    else
+    {
+        for (i = 0;  i < n;  i++)
+        {
+            while (residue < bits[i])
+            {
+                bitstream = (bitstream << 8) | *t++;
+                residue += 8;
+            }
+            residue -= bits[i];
+            values[i] = (uint32_t) ((bitstream >> residue) & (((uint64_t) 1 << bits[i]) - 1));
+        }
+    }
+    s->bitstream = bitstream;
+    s->residue = residue;
+    *c = t;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(bitstream_state_t *) bitstream_init(bitstream_state_t *s, int lsb_first)
 {
     if (s == NULL)
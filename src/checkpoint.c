@@ -0,0 +1,235 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * checkpoint.c - Support for checkpointing and restoring the state of
+ *                FAX sessions
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <limits.h>
+#include <string.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/logging.h"
+#include "spandsp/t4_page_buffer.h"
+
+#include "spandsp/private/logging.h"
+#include "spandsp/private/t4_page_buffer.h"
+
+
+#include "checkpoint_local.h"
+
+#define CHECKPOINT_MAGIC        0x53434B50
+#define CHECKPOINT_VERSION      2
+
+/*! The header at the start of every checkpoint. It is written in the machine's own byte
+    order, so a checkpoint from a machine of the other byte order fails on its magic
+    number. */
+typedef struct
+{
+    /*! \brief A magic number identifying a checkpoint. */
+    uint32_t magic;
+    /*! \brief The version of the checkpoint format. */
+    uint16_t version;
+    /*! \brief The kind of context in the checkpoint. */
+    uint16_t kind;
+    /*! \brief The total length of the checkpoint. */
+    uint32_t len;
+} checkpoint_header_t;
+
+void checkpoint_data(checkpoint_t *c, void *data, int len)
+{
+    if (c->failed  ||  len < 0  ||  c->len + len > c->max_len)
+    {
+        c->failed = TRUE;
+        return;
+    }
+    if (c->restoring)
+        memcpy(data, &c->rbuf[c->len], len);
+    else if (c->wbuf)
+        memcpy(&c->wbuf[c->len], data, len);
+    c->len += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+void checkpoint_buffer(checkpoint_t *c, void *field, int len)
+{
+    uint8_t *buf;
+    uint8_t present;
+
+    memcpy(&buf, field, sizeof(buf));
+    present = (buf != NULL);
+    checkpoint_field(c, present);
+    if (!present  ||  c->failed)
+        return;
+    if (c->restoring)
+    {
+        /* Always allocate something, so a zero length block is not mistaken for an absent one */
+        if ((buf = (uint8_t *) realloc(buf, (len > 0)  ?  len  :  1)) == NULL)
+        {
+            c->failed = TRUE;
+            return;
+        }
+        memcpy(field, &buf, sizeof(buf));
+    }
+    checkpoint_data(c, buf, len);
+}
+/*- End of function --------------------------------------------------------*/
+
+void checkpoint_string(checkpoint_t *c, void *field)
+{
+    char *s;
+    int32_t len;
+
+    memcpy(&s, field, sizeof(s));
+    len = (s)  ?  (int32_t) strlen(s) + 1  :  -1;
+    checkpoint_field(c, len);
+    if (len < 0  ||  c->failed)
+        return;
+    if (c->restoring)
+    {
+        if ((s = (char *) malloc(len)) == NULL)
+        {
+            c->failed = TRUE;
+            return;
+        }
+        memcpy(field, &s, sizeof(s));
+    }
+    checkpoint_data(c, s, len);
+    if (c->restoring)
+        s[len - 1] = '\0';
+}
+/*- End of function --------------------------------------------------------*/
+
+void checkpoint_page_buffer(checkpoint_t *c, t4_page_buffer_t *image)
+{
+    int32_t len;
+
+    /* Whole chunks are moved, as we cannot tell how much of the last one is in use */
+    len = image->chunks_held*T4_PAGE_BUFFER_CHUNK_SIZE;
+    checkpoint_field(c, len);
+    if (c->failed  ||  len < 0  ||  c->len + len > c->max_len)
+    {
+        c->failed = TRUE;
+        return;
+    }
+    if (c->restoring)
+    {
+        if (t4_page_buffer_put(image, 0, &c->rbuf[c->len], len) < 0)
+        {
+            c->failed = TRUE;
+            return;
+        }
+    }
+    else if (c->wbuf)
+    {
+        t4_page_buffer_get(image, 0, &c->wbuf[c->len], len);
+    }
+    c->len += len;
+}
+/*- End of function --------------------------------------------------------*/
+
+void checkpoint_logging(checkpoint_t *c, logging_state_t *s)
+{
+    checkpoint_field(c, s->elapsed_samples);
+}
+/*- End of function --------------------------------------------------------*/
+
+void checkpoint_start_write(checkpoint_t *c, uint8_t buf[], int max_len, int kind)
+{
+    checkpoint_header_t header;
+
+    c->wbuf = buf;
+    c->rbuf = NULL;
+    /* When we are only finding the length, there is no limit */
+    c->max_len = (buf)  ?  max_len  :  INT_MAX;
+    c->len = 0;
+    c->failed = FALSE;
+    c->restoring = FALSE;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.kind = (uint16_t) kind;
+    /* The length is filled in at the end */
+    checkpoint_field(c, header);
+}
+/*- End of function --------------------------------------------------------*/
+
+int checkpoint_end_write(checkpoint_t *c)
+{
+    uint32_t len;
+
+    if (c->failed)
+        return -1;
+    if (c->wbuf)
+    {
+        len = c->len;
+        memcpy(c->wbuf + offsetof(checkpoint_header_t, len), &len, sizeof(len));
+    }
+    return c->len;
+}
+/*- End of function --------------------------------------------------------*/
+
+int checkpoint_start_read(checkpoint_t *c, const uint8_t buf[], int len, int kind)
+{
+    checkpoint_header_t header;
+
+    c->wbuf = NULL;
+    c->rbuf = buf;
+    c->max_len = len;
+    c->len = 0;
+    c->failed = FALSE;
+    c->restoring = TRUE;
+    checkpoint_field(c, header);
+    if (c->failed
+        ||
+        header.magic != CHECKPOINT_MAGIC
+        ||
+        header.version != CHECKPOINT_VERSION
+        ||
+        header.kind != kind
+        ||
+        header.len != (uint32_t) len)
+    {
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int checkpoint_end_read(checkpoint_t *c)
+{
+    if (c->failed  ||  c->len != c->max_len)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,225 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * checkpoint_local.h - Support for checkpointing and restoring the state of
+ *                      FAX sessions
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_CHECKPOINT_LOCAL_H_)
+#define _CHECKPOINT_LOCAL_H_
+
+/* A checkpoint is a header, followed by the state of a context, written out field by
+   field. No pointers are written. Memory the context owns outside itself is written out
+   as its contents, and is allocated again when the checkpoint is restored. Handlers and
+   the pointers which tie the parts of a context together are never part of a checkpoint.
+   The context being restored into was set up by its own initialisation, and whatever
+   wiring depends on the progress of the call is built again on restore, by the same code
+   which built it for the call, from the settings which are in the checkpoint.
+
+   Each module has one function which both writes and reads its part of a checkpoint,
+   so the two can never get out of step. The fields are written in the form they have in
+   memory, so a checkpoint can only be restored by the same version of the library, on
+   the same kind of machine. */
+
+struct logging_state_s;
+struct t4_page_buffer_s;
+struct chunk_tx_state_s;
+struct chunk_rx_state_s;
+struct fsk_tx_state_s;
+struct fsk_rx_state_s;
+struct hdlc_tx_state_s;
+struct hdlc_rx_state_s;
+struct v17_tx_state_s;
+struct v17_rx_state_s;
+struct v29_tx_state_s;
+struct v29_rx_state_s;
+struct v27ter_tx_state_s;
+struct v27ter_rx_state_s;
+struct silence_gen_state_s;
+struct modem_connect_tones_tx_state_s;
+struct modem_connect_tones_rx_state_s;
+struct fax_modems_state_s;
+struct t38_core_state_s;
+struct tz_s;
+struct t4_state_s;
+struct t30_state_s;
+
+enum
+{
+    CHECKPOINT_KIND_FAX = 1,
+    CHECKPOINT_KIND_T38_TERMINAL = 2,
+    CHECKPOINT_KIND_T38_GATEWAY = 3
+};
+
+/* Which receive handler a set of FAX modems is using. A fast modem starts with V.21
+   running beside it, and one of the two is dropped once it is clear which is in use. */
+enum
+{
+    CHECKPOINT_RX_AS_STARTED = 0,
+    CHECKPOINT_RX_FAST_ONLY = 1,
+    CHECKPOINT_RX_V21_ONLY = 2
+};
+
+/*!
+    Checkpoint writing or reading descriptor.
+*/
+typedef struct
+{
+    /*! \brief The buffer being written, or NULL if only the length is being found. */
+    uint8_t *wbuf;
+    /*! \brief The buffer being read. */
+    const uint8_t *rbuf;
+    /*! \brief The length of the buffer. */
+    int max_len;
+    /*! \brief The length written or read so far. */
+    int len;
+    /*! \brief TRUE if the buffer overflowed, the checkpoint was too short, or something
+               in it could not be restored. */
+    int failed;
+    /*! \brief TRUE if a context is being restored from the checkpoint. FALSE if it is
+               being saved to it. */
+    int restoring;
+} checkpoint_t;
+
+/*! Move a field to or from a checkpoint. */
+#define checkpoint_field(c,f) checkpoint_data((c), &(f), sizeof(f))
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! Start writing a checkpoint.
+    \param c The checkpoint descriptor.
+    \param buf The buffer for the checkpoint, or NULL to just find its length.
+    \param max_len The length of the buffer.
+    \param kind The kind of context. */
+void checkpoint_start_write(checkpoint_t *c, uint8_t buf[], int max_len, int kind);
+
+/*! Finish writing a checkpoint.
+    \param c The checkpoint descriptor.
+    \return The length of the checkpoint, or -1 if it did not fit. */
+int checkpoint_end_write(checkpoint_t *c);
+
+/*! Start reading a checkpoint, and check it belongs to the kind of context it is to be
+    restored into.
+    \param c The checkpoint descriptor.
+    \param buf The checkpoint.
+    \param len The length of the checkpoint.
+    \param kind The kind of context.
+    \return 0 for OK, or -1 for a bad checkpoint. */
+int checkpoint_start_read(checkpoint_t *c, const uint8_t buf[], int len, int kind);
+
+/*! Finish reading a checkpoint.
+    \param c The checkpoint descriptor.
+    \return 0 for OK, or -1 if anything failed, or the checkpoint was not all used. */
+int checkpoint_end_read(checkpoint_t *c);
+
+/*! Move a block of data to or from a checkpoint.
+    \param c The checkpoint descriptor.
+    \param data The data.
+    \param len The length of the data. */
+void checkpoint_data(checkpoint_t *c, void *data, int len);
+
+/*! Move the contents of a block of memory a context owns, which may be absent, to or
+    from a checkpoint. When restoring, the block is allocated again, or resized if it
+    is already there.
+    \param c The checkpoint descriptor.
+    \param field The pointer to the block of memory.
+    \param len The length of the block. When restoring, this must be found from fields
+           which have already been restored. */
+void checkpoint_buffer(checkpoint_t *c, void *field, int len);
+
+/*! Move a string a context owns, which may be absent, to or from a checkpoint. When
+    restoring, the string is allocated again.
+    \param c The checkpoint descriptor.
+    \param field The pointer to the string. */
+void checkpoint_string(checkpoint_t *c, void *field);
+
+/*! Move the contents of a T.4 page buffer to or from a checkpoint. When restoring,
+    the buffer must be empty. */
+void checkpoint_page_buffer(checkpoint_t *c, struct t4_page_buffer_s *image);
+
+/*! Move a logging context's place in time to or from a checkpoint. Everything else
+    about logging is as the application set it up. */
+void checkpoint_logging(checkpoint_t *c, struct logging_state_s *s);
+
+/* The parts of the checkpoints which belong to individual modules */
+void chunk_tx_checkpoint(struct chunk_tx_state_s *s, checkpoint_t *c);
+
+void chunk_rx_checkpoint(struct chunk_rx_state_s *s, checkpoint_t *c);
+
+void fsk_tx_checkpoint(struct fsk_tx_state_s *s, checkpoint_t *c);
+
+void fsk_rx_checkpoint(struct fsk_rx_state_s *s, checkpoint_t *c);
+
+void hdlc_tx_checkpoint(struct hdlc_tx_state_s *s, checkpoint_t *c);
+
+void hdlc_rx_checkpoint(struct hdlc_rx_state_s *s, checkpoint_t *c);
+
+void v17_tx_checkpoint(struct v17_tx_state_s *s, checkpoint_t *c);
+
+void v17_rx_checkpoint(struct v17_rx_state_s *s, checkpoint_t *c);
+
+void v29_tx_checkpoint(struct v29_tx_state_s *s, checkpoint_t *c);
+
+void v29_rx_checkpoint(struct v29_rx_state_s *s, checkpoint_t *c);
+
+void v27ter_tx_checkpoint(struct v27ter_tx_state_s *s, checkpoint_t *c);
+
+void v27ter_rx_checkpoint(struct v27ter_rx_state_s *s, checkpoint_t *c);
+
+void silence_gen_checkpoint(struct silence_gen_state_s *s, checkpoint_t *c);
+
+void modem_connect_tones_tx_checkpoint(struct modem_connect_tones_tx_state_s *s, checkpoint_t *c);
+
+void modem_connect_tones_rx_checkpoint(struct modem_connect_tones_rx_state_s *s, checkpoint_t *c);
+
+void fax_modems_checkpoint(struct fax_modems_state_s *s, checkpoint_t *c);
+
+void t38_core_checkpoint(struct t38_core_state_s *s, checkpoint_t *c);
+
+void tz_checkpoint(struct tz_s *tz, checkpoint_t *c);
+
+void t4_tx_checkpoint(struct t4_state_s *s, checkpoint_t *c);
+
+void t4_rx_checkpoint(struct t4_state_s *s, checkpoint_t *c);
+
+/*! Give up the document being sent, once it belongs to a checkpoint. */
+void t4_tx_checkpoint_handover(struct t4_state_s *s);
+
+/*! Give up the document being received, once it belongs to a checkpoint. */
+void t4_rx_checkpoint_handover(struct t4_state_s *s);
+
+void t30_checkpoint(struct t30_state_s *s, checkpoint_t *c);
+
+/*! Give up any document being sent or received, once it belongs to a checkpoint. */
+void t30_checkpoint_handover(struct t30_state_s *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
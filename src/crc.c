@@ -37,6 +37,24 @@
 #include "spandsp/crc.h"
 #include "spandsp/bit_operations.h"
 
+#if defined(SPANDSP_USE_TARGET_PCLMUL)  &&  defined(SPANDSP_USE_SSE2)
+/* The carry-less multiply instruction is not covered by the configured instruction set,
+   so it is compiled for specially, and only used if the CPU turns out to have it. */
+#define CRC_USE_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+/* Buffers shorter than this are not worth the set up cost of the folding CRC engine */
+#define CRC_FOLD_MIN_LEN    128
+
+typedef struct
+{
+    /*! \brief The folding constants, for a fold across 64 bytes and across 16 bytes. */
+    uint64_t k[4];
+} crc_fold_constants_t;
+
+
 static const uint32_t crc_itu32_table[] =
 {
     0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3, 
@@ -73,47 +91,6 @@ static const uint32_t crc_itu32_table[] =
     0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
-SPAN_DECLARE(uint32_t) crc_itu32_calc(const uint8_t *buf, int len, uint32_t crc)
-{
-    int i;
-
-    for (i = 0;  i < len;  i++)
-        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
-    return crc;
-}
-/*- End of function --------------------------------------------------------*/
-
-SPAN_DECLARE(int) crc_itu32_append(uint8_t *buf, int len)
-{
-    uint32_t crc;
-    int new_len;
-    int i;
-
-    crc = 0xFFFFFFFF;
-    new_len = len + 4;
-    for (i = 0;  i < len;  i++)
-        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
-    crc ^= 0xFFFFFFFF;
-    buf[i++] = (uint8_t) crc;
-    buf[i++] = (uint8_t) (crc >> 8);
-    buf[i++] = (uint8_t) (crc >> 16);
-    buf[i++] = (uint8_t) (crc >> 24);
-    return new_len;
-}
-/*- End of function --------------------------------------------------------*/
-
-SPAN_DECLARE(int) crc_itu32_check(const uint8_t *buf, int len)
-{
-    uint32_t crc;
-    int i;
-
-    crc = 0xFFFFFFFF;
-    for (i = 0;  i < len;  i++)
-        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
-    return (crc == 0xDEBB20E3);
-}
-/*- End of function --------------------------------------------------------*/
-
 static const uint16_t crc_itu16_table[] =
 {
     0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
@@ -150,16 +127,162 @@ static const uint16_t crc_itu16_table[] =
     0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
 };
 
-SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
+#include "crc_slice_tables.h"
+
+#if defined(CRC_USE_PCLMUL)
+static __attribute__((target("sse2,pclmul"))) __inline__ __m128i fold_block(__m128i x, __m128i k, __m128i next)
 {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11)), next);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __attribute__((target("sse2,pclmul"))) int crc_fold(const uint8_t *buf, int len, uint32_t crc, const crc_fold_constants_t *c, uint8_t folded[16])
+{
+    __m128i x0;
+    __m128i x1;
+    __m128i x2;
+    __m128i x3;
+    __m128i k;
     int i;
 
-    for (i = 0;  i < len;  i++)
+    /* Fold the buffer down 64 bytes at a time, using four independent chains, and
+       then 16 bytes at a time, leaving a 16 byte block with the same CRC as the bytes
+       consumed. Folding works on the CRC's polynomial remainder, so the starting CRC
+       is absorbed by adding it into the first bytes. len must be at least 64. */
+    x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) buf), _mm_cvtsi32_si128((int) crc));
+    x1 = _mm_loadu_si128((const __m128i *) (buf + 16));
+    x2 = _mm_loadu_si128((const __m128i *) (buf + 32));
+    x3 = _mm_loadu_si128((const __m128i *) (buf + 48));
+    k = _mm_set_epi64x((int64_t) c->k[1], (int64_t) c->k[0]);
+    for (i = 64;  i + 64 <= len;  i += 64)
+    {
+        x0 = fold_block(x0, k, _mm_loadu_si128((const __m128i *) (buf + i)));
+        x1 = fold_block(x1, k, _mm_loadu_si128((const __m128i *) (buf + i + 16)));
+        x2 = fold_block(x2, k, _mm_loadu_si128((const __m128i *) (buf + i + 32)));
+        x3 = fold_block(x3, k, _mm_loadu_si128((const __m128i *) (buf + i + 48)));
+    }
+    k = _mm_set_epi64x((int64_t) c->k[3], (int64_t) c->k[2]);
+    x0 = fold_block(x0, k, x1);
+    x0 = fold_block(x0, k, x2);
+    x0 = fold_block(x0, k, x3);
+    for (  ;  i + 16 <= len;  i += 16)
+        x0 = fold_block(x0, k, _mm_loadu_si128((const __m128i *) (buf + i)));
+    _mm_storeu_si128((__m128i *) folded, x0);
+    return i;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static uint32_t crc_itu32_slice8(const uint8_t *buf, int len, uint32_t crc)
+{
+    int i;
+
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        crc ^= (uint32_t) buf[i] | ((uint32_t) buf[i + 1] << 8) | ((uint32_t) buf[i + 2] << 16) | ((uint32_t) buf[i + 3] << 24);
+        crc = crc_itu32_slice[7][crc & 0xFF]
+            ^ crc_itu32_slice[6][(crc >> 8) & 0xFF]
+            ^ crc_itu32_slice[5][(crc >> 16) & 0xFF]
+            ^ crc_itu32_slice[4][crc >> 24]
+            ^ crc_itu32_slice[3][buf[i + 4]]
+            ^ crc_itu32_slice[2][buf[i + 5]]
+            ^ crc_itu32_slice[1][buf[i + 6]]
+            ^ crc_itu32_slice[0][buf[i + 7]];
+    }
+    for (  ;  i < len;  i++)
+        crc = ((crc >> 8) & 0x00FFFFFF) ^ crc_itu32_table[(crc ^ buf[i]) & 0xFF];
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint32_t) crc_itu32_calc(const uint8_t *buf, int len, uint32_t crc)
+{
+#if defined(CRC_USE_PCLMUL)
+    uint8_t folded[16];
+    int i;
+#endif
+
+#if defined(CRC_USE_PCLMUL)
+    if (len >= CRC_FOLD_MIN_LEN  &&  __builtin_cpu_supports("pclmul"))
+    {
+        i = crc_fold(buf, len, crc, &crc_itu32_fold, folded);
+        crc = crc_itu32_slice8(folded, 16, 0);
+        return crc_itu32_slice8(buf + i, len - i, crc);
+    }
+#endif
+    return crc_itu32_slice8(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_itu32_append(uint8_t *buf, int len)
+{
+    uint32_t crc;
+    int new_len;
+    int i;
+
+    new_len = len + 4;
+    crc = crc_itu32_calc(buf, len, 0xFFFFFFFF);
+    crc ^= 0xFFFFFFFF;
+    i = len;
+    buf[i++] = (uint8_t) crc;
+    buf[i++] = (uint8_t) (crc >> 8);
+    buf[i++] = (uint8_t) (crc >> 16);
+    buf[i++] = (uint8_t) (crc >> 24);
+    return new_len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) crc_itu32_check(const uint8_t *buf, int len)
+{
+    uint32_t crc;
+
+    crc = crc_itu32_calc(buf, len, 0xFFFFFFFF);
+    return (crc == 0xDEBB20E3);
+}
+/*- End of function --------------------------------------------------------*/
+
+
+static uint16_t crc_itu16_slice8(const uint8_t *buf, int len, uint16_t crc)
+{
+    int i;
+
+    for (i = 0;  i + 8 <= len;  i += 8)
+    {
+        crc ^= (uint16_t) (buf[i] | (buf[i + 1] << 8));
+        crc = crc_itu16_slice[7][crc & 0xFF]
+            ^ crc_itu16_slice[6][crc >> 8]
+            ^ crc_itu16_slice[5][buf[i + 2]]
+            ^ crc_itu16_slice[4][buf[i + 3]]
+            ^ crc_itu16_slice[3][buf[i + 4]]
+            ^ crc_itu16_slice[2][buf[i + 5]]
+            ^ crc_itu16_slice[1][buf[i + 6]]
+            ^ crc_itu16_slice[0][buf[i + 7]];
+    }
+    for (  ;  i < len;  i++)
         crc = (crc >> 8) ^ crc_itu16_table[(crc ^ buf[i]) & 0xFF];
     return crc;
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(uint16_t) crc_itu16_calc(const uint8_t *buf, int len, uint16_t crc)
+{
+#if defined(CRC_USE_PCLMUL)
+    uint8_t folded[16];
+    int i;
+#endif
+
+#if defined(CRC_USE_PCLMUL)
+    if (len >= CRC_FOLD_MIN_LEN  &&  __builtin_cpu_supports("pclmul"))
+    {
+        i = crc_fold(buf, len, crc, &crc_itu16_fold, folded);
+        crc = crc_itu16_slice8(folded, 16, 0);
+        return crc_itu16_slice8(buf + i, len - i, crc);
+    }
+#endif
+    return crc_itu16_slice8(buf, len, crc);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(uint16_t) crc_itu16_bits(uint8_t buf, int len, uint16_t crc)
 {
     int i;
@@ -182,11 +305,10 @@ SPAN_DECLARE(int) crc_itu16_append(uint8_t *buf, int len)
     int new_len;
     int i;
 
-    crc = 0xFFFF;
     new_len = len + 2;
-    for (i = 0;  i < len;  i++)
-        crc = (crc >> 8) ^ crc_itu16_table[(crc ^ buf[i]) & 0xFF];
+    crc = crc_itu16_calc(buf, len, 0xFFFF);
     crc ^= 0xFFFF;
+    i = len;
     buf[i++] = (uint8_t) crc;
     buf[i++] = (uint8_t) (crc >> 8);
     return new_len;
@@ -196,11 +318,8 @@ SPAN_DECLARE(int) crc_itu16_append(uint8_t *buf, int len)
 SPAN_DECLARE(int) crc_itu16_check(const uint8_t *buf, int len)
 {
     uint16_t crc;
-    int i;
 
-    crc = 0xFFFF;
-    for (i = 0;  i < len;  i++)
-        crc = (crc >> 8) ^ crc_itu16_table[(crc ^ buf[i]) & 0xFF];
+    crc = crc_itu16_calc(buf, len, 0xFFFF);
     return (crc & 0xFFFF) == 0xF0B8;
 }
 /*- End of function --------------------------------------------------------*/
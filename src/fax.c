@@ -71,6 +71,7 @@
 #include "spandsp/v27ter_rx.h"
 #include "spandsp/v17tx.h"
 #include "spandsp/v17rx.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -91,6 +92,7 @@
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/silence_gen.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 #include "spandsp/private/modem_connect_tones.h"
 #include "spandsp/private/v8.h"
@@ -108,11 +110,14 @@
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 #include "spandsp/private/t30.h"
 #include "spandsp/private/fax.h"
 
+#include "checkpoint_local.h"
+
 #define HDLC_FRAMING_OK_THRESHOLD       8
 
 static void fax_send_hdlc(void *user_data, const uint8_t *msg, int len)
@@ -425,7 +430,9 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
 {
     fax_state_t *s;
     put_bit_func_t put_bit_func;
+    put_chunk_func_t put_chunk_func;
     void *put_bit_user_data;
+    int lsb_first;
     fax_modems_state_t *t;
 
     s = (fax_state_t *) user_data;
@@ -435,17 +442,25 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
         return;
     t->current_rx_type = type;
     t->rx_bit_rate = bit_rate;
+    t->rx_short_train = short_train;
+    t->rx_use_hdlc = use_hdlc;
     if (use_hdlc)
     {
         put_bit_func = (put_bit_func_t) hdlc_rx_put_bit;
+        put_chunk_func = (put_chunk_func_t) hdlc_rx_put;
+        lsb_first = FALSE;
         put_bit_user_data = (void *) &t->hdlc_rx;
         hdlc_rx_init(&t->hdlc_rx, FALSE, TRUE, HDLC_FRAMING_OK_THRESHOLD, t30_hdlc_accept, &s->t30);
     }
     else
     {
         put_bit_func = t30_non_ecm_put_bit;
+        put_chunk_func = t30_non_ecm_put_chunk;
+        lsb_first = TRUE;
         put_bit_user_data = (void *) &s->t30;
     }
+    /* The fast modems deliver their data in chunks of octets. The put_bit
+       functions are still needed, to handle status changes. */
     switch (type)
     {
     case T30_MODEM_V21:
@@ -456,16 +471,19 @@ static void fax_set_rx_type(void *user_data, int type, int bit_rate, int short_t
     case T30_MODEM_V27TER:
         v27ter_rx_restart(&t->v27ter_rx, bit_rate, FALSE);
         v27ter_rx_set_put_bit(&t->v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_set_put_chunk(&t->v27ter_rx, put_chunk_func, put_bit_user_data, lsb_first);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         break;
     case T30_MODEM_V29:
         v29_rx_restart(&t->v29_rx, bit_rate, FALSE);
         v29_rx_set_put_bit(&t->v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_set_put_chunk(&t->v29_rx, put_chunk_func, put_bit_user_data, lsb_first);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         break;
     case T30_MODEM_V17:
         v17_rx_restart(&t->v17_rx, bit_rate, short_train);
         v17_rx_set_put_bit(&t->v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_set_put_chunk(&t->v17_rx, put_chunk_func, put_bit_user_data, lsb_first);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         break;
     case T30_MODEM_DONE:
@@ -573,6 +591,8 @@ static void fax_set_tx_type(void *user_data, int type, int bit_rate, int short_t
         break;
     }
     t->tx_bit_rate = bit_rate;
+    t->tx_short_train = short_train;
+    t->tx_use_hdlc = use_hdlc;
     t->current_tx_type = type;
 }
 /*- End of function --------------------------------------------------------*/
@@ -589,6 +609,12 @@ SPAN_DECLARE(void) fax_set_tep_mode(fax_state_t *s, int use_tep)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) fax_set_training_cache(fax_state_t *s, int use_cache)
+{
+    return fax_modems_set_training_cache(&s->modems, use_cache);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(t30_state_t *) fax_get_t30_state(fax_state_t *s)
 {
     return &s->t30;
@@ -601,6 +627,134 @@ SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) fax_get_memory_footprint(fax_state_t *s)
+{
+    return sizeof(*s) + t30_get_allocated_memory(&s->t30);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void set_rx_stage(fax_state_t *s, int stage)
+{
+    fax_modems_state_t *t;
+
+    /* Drop the modem the call had dropped when the checkpoint was taken */
+    t = &s->modems;
+    if (stage == CHECKPOINT_RX_V21_ONLY)
+    {
+        set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &t->v21_rx);
+        return;
+    }
+    if (stage != CHECKPOINT_RX_FAST_ONLY)
+        return;
+    switch (t->current_rx_type)
+    {
+    case T30_MODEM_V27TER:
+        set_rx_handler(s, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_rx_fillin, &t->v27ter_rx);
+        break;
+    case T30_MODEM_V29:
+        set_rx_handler(s, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &t->v29_rx);
+        break;
+    case T30_MODEM_V17:
+        set_rx_handler(s, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &t->v17_rx);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void fax_checkpoint_state(fax_state_t *s, checkpoint_t *c)
+{
+    fax_modems_state_t *t;
+    int rx_type;
+    int rx_bit_rate;
+    int rx_short_train;
+    int rx_use_hdlc;
+    int rx_stage;
+    int tx_type;
+    int tx_bit_rate;
+    int tx_short_train;
+    int tx_use_hdlc;
+    int tx_next;
+    int transmit;
+
+    /* The handlers are rebuilt from how the modems were last set up, and how far the
+       call had moved on from there. The modems' own state is then put back over the top. */
+    t = &s->modems;
+    rx_type = t->current_rx_type;
+    rx_bit_rate = t->rx_bit_rate;
+    rx_short_train = t->rx_short_train;
+    rx_use_hdlc = t->rx_use_hdlc;
+    if (t->rx_user_data == &t->v17_rx  ||  t->rx_user_data == &t->v27ter_rx  ||  t->rx_user_data == &t->v29_rx)
+        rx_stage = CHECKPOINT_RX_FAST_ONLY;
+    else if (t->rx_user_data == &t->v21_rx  &&  rx_type != T30_MODEM_V21)
+        rx_stage = CHECKPOINT_RX_V21_ONLY;
+    else
+        rx_stage = CHECKPOINT_RX_AS_STARTED;
+    tx_type = t->current_tx_type;
+    tx_bit_rate = t->tx_bit_rate;
+    tx_short_train = t->tx_short_train;
+    tx_use_hdlc = t->tx_use_hdlc;
+    tx_next = (t->next_tx_handler != NULL);
+    transmit = t->transmit;
+
+    checkpoint_field(c, rx_type);
+    checkpoint_field(c, rx_bit_rate);
+    checkpoint_field(c, rx_short_train);
+    checkpoint_field(c, rx_use_hdlc);
+    checkpoint_field(c, rx_stage);
+    checkpoint_field(c, tx_type);
+    checkpoint_field(c, tx_bit_rate);
+    checkpoint_field(c, tx_short_train);
+    checkpoint_field(c, tx_use_hdlc);
+    checkpoint_field(c, tx_next);
+    checkpoint_field(c, transmit);
+    if (c->restoring  &&  !c->failed)
+    {
+        t->current_rx_type = -1;
+        fax_set_rx_type(s, rx_type, rx_bit_rate, rx_short_train, rx_use_hdlc);
+        set_rx_stage(s, rx_stage);
+        t->current_tx_type = -1;
+        fax_set_tx_type(s, tx_type, tx_bit_rate, tx_short_train, tx_use_hdlc);
+        while ((t->next_tx_handler  &&  !tx_next)  ||  (t->transmit  &&  !transmit))
+            set_next_tx_type(s);
+    }
+    fax_modems_checkpoint(t, c);
+    checkpoint_logging(c, &s->logging);
+    t30_checkpoint(&s->t30, c);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fax_checkpoint(fax_state_t *s, uint8_t buf[], int max_len)
+{
+    checkpoint_t c;
+    int len;
+
+    /* Find the length first, so nothing is handed over unless it all fits */
+    checkpoint_start_write(&c, NULL, 0, CHECKPOINT_KIND_FAX);
+    fax_checkpoint_state(s, &c);
+    if ((len = checkpoint_end_write(&c)) < 0  ||  buf == NULL)
+        return len;
+    if (len > max_len)
+        return -1;
+    checkpoint_start_write(&c, buf, max_len, CHECKPOINT_KIND_FAX);
+    fax_checkpoint_state(s, &c);
+    if ((len = checkpoint_end_write(&c)) < 0)
+        return -1;
+    t30_checkpoint_handover(&s->t30);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fax_restore(fax_state_t *s, const uint8_t buf[], int len)
+{
+    checkpoint_t c;
+
+    if (checkpoint_start_read(&c, buf, len, CHECKPOINT_KIND_FAX))
+        return -1;
+    fax_checkpoint_state(s, &c);
+    return checkpoint_end_read(&c);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) fax_restart(fax_state_t *s, int calling_party)
 {
 #if 0
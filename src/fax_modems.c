@@ -73,6 +73,7 @@
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/silence_gen.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 #include "spandsp/private/v17tx.h"
 #include "spandsp/private/v17rx.h"
@@ -84,6 +85,8 @@
 #include "spandsp/private/hdlc.h"
 #include "spandsp/private/fax_modems.h"
 
+#include "checkpoint_local.h"
+
 #define HDLC_FRAMING_OK_THRESHOLD               5
 
 SPAN_DECLARE_NONSTD(int) fax_modems_v17_v21_rx(void *user_data, const int16_t amp[], int len)
@@ -262,6 +265,54 @@ SPAN_DECLARE(void) fax_modems_set_tep_mode(fax_modems_state_t *s, int use_tep)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) fax_modems_set_training_cache(fax_modems_state_t *s, int use_cache)
+{
+    if (v17_tx_set_training_cache(&s->v17_tx, use_cache)
+        ||
+        v29_tx_set_training_cache(&s->v29_tx, use_cache)
+        ||
+        v27ter_tx_set_training_cache(&s->v27ter_tx, use_cache))
+    {
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+void fax_modems_checkpoint(fax_modems_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->use_tep);
+    checkpoint_field(c, s->transmit_on_idle);
+    hdlc_tx_checkpoint(&s->hdlc_tx, c);
+    hdlc_rx_checkpoint(&s->hdlc_rx, c);
+    fsk_tx_checkpoint(&s->v21_tx, c);
+    fsk_rx_checkpoint(&s->v21_rx, c);
+    v17_tx_checkpoint(&s->v17_tx, c);
+    v17_rx_checkpoint(&s->v17_rx, c);
+    v29_tx_checkpoint(&s->v29_tx, c);
+    v29_rx_checkpoint(&s->v29_rx, c);
+    v27ter_tx_checkpoint(&s->v27ter_tx, c);
+    v27ter_rx_checkpoint(&s->v27ter_rx, c);
+    silence_gen_checkpoint(&s->silence_gen, c);
+    modem_connect_tones_tx_checkpoint(&s->connect_tx, c);
+    modem_connect_tones_rx_checkpoint(&s->connect_rx, c);
+    checkpoint_field(c, s->dc_restore);
+    checkpoint_field(c, s->current_rx_type);
+    checkpoint_field(c, s->current_tx_type);
+    checkpoint_field(c, s->rx_short_train);
+    checkpoint_field(c, s->rx_use_hdlc);
+    checkpoint_field(c, s->tx_short_train);
+    checkpoint_field(c, s->tx_use_hdlc);
+    checkpoint_field(c, s->rx_signal_present);
+    checkpoint_field(c, s->rx_trained);
+    checkpoint_field(c, s->rx_frame_received);
+    checkpoint_field(c, s->tx_bit_rate);
+    checkpoint_field(c, s->rx_bit_rate);
+    checkpoint_field(c, s->transmit);
+    checkpoint_logging(c, &s->logging);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) fax_modems_restart(fax_modems_state_t *s)
 {
     return 0;
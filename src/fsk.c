@@ -40,6 +40,7 @@
 #endif
 #include "floating_fudge.h"
 #include <assert.h>
+#include "mmx_sse_decs.h"
 
 #include "spandsp/telephony.h"
 #include "spandsp/complex.h"
@@ -48,8 +49,11 @@
 #include "spandsp/async.h"
 #include "spandsp/fsk.h"
 
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 
+#include "checkpoint_local.h"
+
 const fsk_spec_t preset_fsk_specs[] =
 {
     {
@@ -248,6 +252,15 @@ SPAN_DECLARE(void) fsk_rx_set_put_bit(fsk_rx_state_t *s, put_bit_func_t put_bit,
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) fsk_rx_set_put_chunk(fsk_rx_state_t *s, put_chunk_func_t put_chunk, void *user_data, int lsb_first)
+{
+    /* Anything still waiting belongs to the old handler */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
+    chunk_rx_init(&s->chunk, put_chunk, user_data, lsb_first);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) fsk_rx_set_modem_status_handler(fsk_rx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -295,6 +308,10 @@ SPAN_DECLARE(int) fsk_rx_restart(fsk_rx_state_t *s, const fsk_spec_t *spec, int
     s->frame_state = 0;
     s->frame_bits = 0;
     s->last_bit = 0;
+    /* Anything received before the restart is still delivered, including any
+       partial octet. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
     
     /* Initialise a power detector, so sense when a signal is present. */
     power_meter_init(&(s->power), 4);
@@ -338,6 +355,10 @@ SPAN_DECLARE(int) fsk_rx_free(fsk_rx_state_t *s)
 
 static void report_status_change(fsk_rx_state_t *s, int status)
 {
+    /* Make sure everything received before the status change is delivered first,
+       including the odd bits at the end of the data. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -345,221 +366,237 @@ static void report_status_change(fsk_rx_state_t *s, int status)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(int) fsk_rx(fsk_rx_state_t *s, const int16_t *amp, int len)
+static __inline__ void fsk_rx_sample(fsk_rx_state_t *s, int16_t amp, int baudstate)
 {
-    int buf_ptr;
-    int baudstate;
-    int i;
-    int j;
     int16_t x;
-    int32_t dot;
-    int32_t sum[2];
     int32_t power;
-    complexi_t ph;
 
-    buf_ptr = s->buf_ptr;
-
-    for (i = 0;  i < len;  i++)
+    /* If there isn't much signal, don't demodulate - it will only produce
+       useless junk results. */
+    /* There should be no DC in the signal, but sometimes there is.
+       We need to measure the power with the DC blocked, but not using
+       a slow to respond DC blocker. Use the most elementary HPF. */
+    x = amp >> 1;
+    power = power_meter_update(&(s->power), x - s->last_sample);
+    s->last_sample = x;
+    if (s->signal_present)
     {
-        /* The *totally* asynchronous character to character behaviour of these
-           modems, when carrying async. data, seems to force a sample by sample
-           approach. */
-        for (j = 0;  j < 2;  j++)
-        {
-            s->dot[j].re -= s->window[j][buf_ptr].re;
-            s->dot[j].im -= s->window[j][buf_ptr].im;
-
-            ph = dds_complexi(&(s->phase_acc[j]), s->phase_rate[j]);
-            s->window[j][buf_ptr].re = (ph.re*amp[i]) >> s->scaling_shift;
-            s->window[j][buf_ptr].im = (ph.im*amp[i]) >> s->scaling_shift;
-
-            s->dot[j].re += s->window[j][buf_ptr].re;
-            s->dot[j].im += s->window[j][buf_ptr].im;
-
-            dot = s->dot[j].re >> 15;
-            sum[j] = dot*dot;
-            dot = s->dot[j].im >> 15;
-            sum[j] += dot*dot;
-        }
-        /* If there isn't much signal, don't demodulate - it will only produce
-           useless junk results. */
-        /* There should be no DC in the signal, but sometimes there is.
-           We need to measure the power with the DC blocked, but not using
-           a slow to respond DC blocker. Use the most elementary HPF. */
-        x = amp[i] >> 1;
-        power = power_meter_update(&(s->power), x - s->last_sample);
-        s->last_sample = x;
-        if (s->signal_present)
+        /* Look for power below turn-off threshold to turn the carrier off */
+        if (power < s->carrier_off_power)
         {
-            /* Look for power below turn-off threshold to turn the carrier off */
-            if (power < s->carrier_off_power)
+            if (--s->signal_present <= 0)
             {
-                if (--s->signal_present <= 0)
-                {
-                    /* Count down a short delay, to ensure we push the last
-                       few bits through the filters before stopping. */
-                    report_status_change(s, SIG_STATUS_CARRIER_DOWN);
-                    s->baud_phase = 0;
-                    continue;
-                }
+                /* Count down a short delay, to ensure we push the last
+                   few bits through the filters before stopping. */
+                report_status_change(s, SIG_STATUS_CARRIER_DOWN);
+                s->baud_phase = 0;
+                return;
             }
         }
-        else
+    }
+    else
+    {
+        /* Look for power exceeding turn-on threshold to turn the carrier on */
+        if (power < s->carrier_on_power)
         {
-            /* Look for power exceeding turn-on threshold to turn the carrier on */
-            if (power < s->carrier_on_power)
-            {
-                s->baud_phase = 0;
-                continue;
-            }
-            if (s->baud_phase < (s->correlation_span >> 1) - 30)
-            {
-                s->baud_phase++;
-                continue;
-            }
-            s->signal_present = 1;
-            /* Initialise the baud/bit rate tracking. */
             s->baud_phase = 0;
-            s->frame_state = 0;
-            s->frame_bits = 0;
-            s->last_bit = 0;
-            report_status_change(s, SIG_STATUS_CARRIER_UP);
+            return;
         }
-        /* Non-coherent FSK demodulation by correlation with the target tones
-           over a one baud interval. The slow V.xx specs. are too open ended
-           to allow anything fancier to be used. The dot products are calculated
-           using a sliding window approach, so the compute load is not that great. */
-
-        baudstate = (sum[0] < sum[1]);
-        switch (s->framing_mode)
+        if (s->baud_phase < (s->correlation_span >> 1) - 30)
         {
-        case FSK_FRAME_MODE_SYNC:
-            /* Synchronous serial operation - e.g. for HDLC */
-            if (s->last_bit != baudstate)
-            {
-                /* On a transition we check our timing */
-                s->last_bit = baudstate;
-                /* For synchronous use (e.g. HDLC channels in FAX modems), nudge
-                   the baud phase gently, trying to keep it centred on the bauds. */
-                if (s->baud_phase < (SAMPLE_RATE*50))
-                    s->baud_phase += (s->baud_rate >> 3);
-                else
-                    s->baud_phase -= (s->baud_rate >> 3);
-            }
-            if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
-            {
-                /* We should be in the middle of a baud now, so report the current
-                   state as the next bit */
-                s->baud_phase -= (SAMPLE_RATE*100);
+            s->baud_phase++;
+            return;
+        }
+        s->signal_present = 1;
+        /* Initialise the baud/bit rate tracking. */
+        s->baud_phase = 0;
+        s->frame_state = 0;
+        s->frame_bits = 0;
+        s->last_bit = 0;
+        report_status_change(s, SIG_STATUS_CARRIER_UP);
+    }
+    switch (s->framing_mode)
+    {
+    case FSK_FRAME_MODE_SYNC:
+        /* Synchronous serial operation - e.g. for HDLC */
+        if (s->last_bit != baudstate)
+        {
+            /* On a transition we check our timing */
+            s->last_bit = baudstate;
+            /* For synchronous use (e.g. HDLC channels in FAX modems), nudge
+               the baud phase gently, trying to keep it centred on the bauds. */
+            if (s->baud_phase < (SAMPLE_RATE*50))
+                s->baud_phase += (s->baud_rate >> 3);
+            else
+                s->baud_phase -= (s->baud_rate >> 3);
+        }
+        if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
+        {
+            /* We should be in the middle of a baud now, so report the current
+               state as the next bit */
+            s->baud_phase -= (SAMPLE_RATE*100);
+            if (s->chunk.put_chunk)
+                chunk_rx_put_bit(&s->chunk, baudstate);
+            else
                 s->put_bit(s->put_bit_user_data, baudstate);
-            }
-            break;
-        case FSK_FRAME_MODE_ASYNC:
-            /* Fully asynchronous mode */
-            if (s->last_bit != baudstate)
+        }
+        break;
+    case FSK_FRAME_MODE_ASYNC:
+        /* Fully asynchronous mode */
+        if (s->last_bit != baudstate)
+        {
+            /* On a transition we check our timing */
+            s->last_bit = baudstate;
+            /* For async. operation, believe transitions completely, and
+               sample appropriately. This allows instant start on the first
+               transition. */
+            /* We must now be about half way to a sampling point. We do not do
+               any fractional sample estimation of the transitions, so this is
+               the most accurate baud alignment we can do. */
+            s->baud_phase = SAMPLE_RATE*50;
+        }
+        if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
+        {
+            /* We should be in the middle of a baud now, so report the current
+               state as the next bit */
+            s->baud_phase -= (SAMPLE_RATE*100);
+            if (s->chunk.put_chunk)
+                chunk_rx_put_bit(&s->chunk, baudstate);
+            else
+                s->put_bit(s->put_bit_user_data, baudstate);
+        }
+        break;
+    default:
+        /* Gather the specified number of bits, with robust checking to ensure reasonable voice immunity.
+           The first bit should be a start bit (0), and the last bit should be a stop bit (1) */
+        if (s->frame_state == 0)
+        {
+            /* Looking for the start of a zero bit, which hopefully the start of a start bit */
+            if (baudstate == 0)
             {
-                /* On a transition we check our timing */
-                s->last_bit = baudstate;
-                /* For async. operation, believe transitions completely, and
-                   sample appropriately. This allows instant start on the first
-                   transition. */
-                /* We must now be about half way to a sampling point. We do not do
-                   any fractional sample estimation of the transitions, so this is
-                   the most accurate baud alignment we can do. */
-                s->baud_phase = SAMPLE_RATE*50;
+                s->baud_phase = SAMPLE_RATE*(100 - 40)/2;
+                s->frame_state = -1;
+                s->frame_bits = 0;
+                s->last_bit = -1;
             }
-            if ((s->baud_phase += s->baud_rate) >= (SAMPLE_RATE*100))
+        }
+        else if (s->frame_state == -1)
+        {
+            /* Look for a continuous zero from the start of the start bit until
+               beyond the middle */
+            if (baudstate != 0)
             {
-                /* We should be in the middle of a baud now, so report the current
-                   state as the next bit */
-                s->baud_phase -= (SAMPLE_RATE*100);
-                s->put_bit(s->put_bit_user_data, baudstate);
+                /* If we aren't looking at a stable start bit, restart */
+                s->frame_state = 0;
             }
-            break;
-        default:
-            /* Gather the specified number of bits, with robust checking to ensure reasonable voice immunity.
-               The first bit should be a start bit (0), and the last bit should be a stop bit (1) */
-            if (s->frame_state == 0)
+            else
             {
-                /* Looking for the start of a zero bit, which hopefully the start of a start bit */
-                if (baudstate == 0)
+                s->baud_phase += s->baud_rate;
+                if (s->baud_phase >= SAMPLE_RATE*100)
                 {
-                    s->baud_phase = SAMPLE_RATE*(100 - 40)/2;
-                    s->frame_state = -1;
-                    s->frame_bits = 0;
-                    s->last_bit = -1;
+                    s->frame_state = 1;
+                    s->last_bit = baudstate;
                 }
             }
-            else if (s->frame_state == -1)
+        }
+        else
+        {
+            s->baud_phase += s->baud_rate;
+            if (s->baud_phase >= SAMPLE_RATE*(100 - 40))
             {
-                /* Look for a continuous zero from the start of the start bit until
-                   beyond the middle */
-                if (baudstate != 0)
+                if (s->last_bit < 0)
+                    s->last_bit = baudstate;
+                /* Look for the bit being consistent over the central 20% of the bit time. */
+                if (s->last_bit != baudstate)
                 {
-                    /* If we aren't looking at a stable start bit, restart */
                     s->frame_state = 0;
                 }
-                else
+                else if (s->baud_phase >= SAMPLE_RATE*100)
                 {
-                    s->baud_phase += s->baud_rate;
-                    if (s->baud_phase >= SAMPLE_RATE*100)
+                    /* We should be in the middle of a baud now, so report the current
+                       state as the next bit */
+                    if (s->last_bit == baudstate)
                     {
-                        s->frame_state = 1;
-                        s->last_bit = baudstate;
-                    }
-                }
-            }
-            else
-            {
-                s->baud_phase += s->baud_rate;
-                if (s->baud_phase >= SAMPLE_RATE*(100 - 40))
-                {
-                    if (s->last_bit < 0)
-                        s->last_bit = baudstate;
-                    /* Look for the bit being consistent over the central 20% of the bit time. */
-                    if (s->last_bit != baudstate)
-                    {
-                        s->frame_state = 0;
-                    }
-                    else if (s->baud_phase >= SAMPLE_RATE*100)
-                    {
-                        /* We should be in the middle of a baud now, so report the current
-                           state as the next bit */
-                        if (s->last_bit == baudstate)
+                        s->frame_bits |= (baudstate << s->framing_mode);
+                        s->frame_bits >>= 1;
+                        s->baud_phase -= (SAMPLE_RATE*100);
+                        if (++s->frame_state > s->framing_mode)
                         {
-                            s->frame_bits |= (baudstate << s->framing_mode);
-                            s->frame_bits >>= 1;
-                            s->baud_phase -= (SAMPLE_RATE*100);
-                            if (++s->frame_state > s->framing_mode)
+                            /* Check we have a stop bit */
+                            if (baudstate == 1)
                             {
-                                /* Check we have a stop bit */
-                                if (baudstate == 1)
+                                /* Check we have a start bit */
+                                if ((s->frame_bits & 1) == 0)
                                 {
-                                    /* Check we have a start bit */
-                                    if ((s->frame_bits & 1) == 0)
-                                    {
-                                        /* Drop the start bit, and pass the rest back */
-                                        s->frame_bits >>= 1;
-                                        s->put_bit(s->put_bit_user_data, s->frame_bits);
-                                    }
+                                    /* Drop the start bit, and pass the rest back */
+                                    s->frame_bits >>= 1;
+                                    s->put_bit(s->put_bit_user_data, s->frame_bits);
                                 }
-                                s->frame_state = 0;
                             }
-                        }
-                        else
-                        {
                             s->frame_state = 0;
                         }
-                        s->last_bit = -1;
                     }
+                    else
+                    {
+                        s->frame_state = 0;
+                    }
+                    s->last_bit = -1;
                 }
             }
-            break;
         }
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) fsk_rx(fsk_rx_state_t *s, const int16_t *amp, int len)
+{
+    int buf_ptr;
+    int baudstate;
+    int i;
+    int j;
+    int32_t dot;
+    int32_t sum[2];
+    complexi_t ph;
+
+    buf_ptr = s->buf_ptr;
+
+    for (i = 0;  i < len;  i++)
+    {
+        /* The *totally* asynchronous character to character behaviour of these
+           modems, when carrying async. data, seems to force a sample by sample
+           approach. */
+        for (j = 0;  j < 2;  j++)
+        {
+            s->dot[j].re -= s->window[j][buf_ptr].re;
+            s->dot[j].im -= s->window[j][buf_ptr].im;
+
+            ph = dds_complexi(&(s->phase_acc[j]), s->phase_rate[j]);
+            s->window[j][buf_ptr].re = (ph.re*amp[i]) >> s->scaling_shift;
+            s->window[j][buf_ptr].im = (ph.im*amp[i]) >> s->scaling_shift;
+
+            s->dot[j].re += s->window[j][buf_ptr].re;
+            s->dot[j].im += s->window[j][buf_ptr].im;
+
+            dot = s->dot[j].re >> 15;
+            sum[j] = dot*dot;
+            dot = s->dot[j].im >> 15;
+            sum[j] += dot*dot;
+        }
+        /* Non-coherent FSK demodulation by correlation with the target tones
+           over a one baud interval. The slow V.xx specs. are too open ended
+           to allow anything fancier to be used. The dot products are calculated
+           using a sliding window approach, so the compute load is not that great. */
+        baudstate = (sum[0] < sum[1]);
+        /* The sample has gone into the correlation window, whether or not it is
+           demodulated, so always step the window on. The receiver bank works
+           the same way, so its channels match stand-alone receivers exactly. */
         if (++buf_ptr >= s->correlation_span)
             buf_ptr = 0;
+        fsk_rx_sample(s, amp[i], baudstate);
     }
     s->buf_ptr = buf_ptr;
+    chunk_rx_flush(&s->chunk);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -573,4 +610,320 @@ SPAN_DECLARE_NONSTD(int) fsk_rx_fillin(fsk_rx_state_t *s, int len)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+/* The correlator arrays of a receiver bank are laid out structure of arrays
+   style, with one element per channel in each row, so the channels can be
+   processed side by side. Each row is padded to a multiple of 4 channels. */
+#define BANK_LANES(channels)    (((channels) + 3) & ~3)
+
+static __inline__ int32_t *bank_window(fsk_rx_bank_state_t *s, int buf_ptr, int tone, int part)
+{
+    return &s->window[((buf_ptr*2 + tone)*2 + part)*s->lanes];
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int16_t bank_amp(fsk_rx_bank_state_t *s, const int16_t *amp[], int ch, int i)
+{
+    /* Padding and idle channels are fed silence. s->chan[] is NULL for the padding,
+       so amp[] is never looked at beyond the real channels. */
+    return (s->chan[ch]  &&  amp[ch])  ?  amp[ch][i]  :  0;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(__GNUC__)  &&  defined(SPANDSP_USE_SSE2)
+static __inline__ __m128i mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even;
+    __m128i odd;
+
+    /* SSE2 has no 32 bit x 32 bit -> low 32 bit multiply, so build one from
+       the 32 x 32 -> 64 bit multiply of the even and the odd lanes. */
+    even = _mm_mul_epu32(a, b);
+    odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+/*- End of function --------------------------------------------------------*/
+
+static void bank_correlate(fsk_rx_bank_state_t *s, const int16_t *amp[], int i)
+{
+    complexi_t ph;
+    __m128i tone[2][2];
+    __m128i x;
+    __m128i re;
+    __m128i im;
+    __m128i w;
+    __m128i sum[2];
+    int32_t *win;
+    int32_t *dot;
+    int j;
+    int k;
+    int ch;
+
+    for (j = 0;  j < 2;  j++)
+    {
+        ph = dds_complexi(&(s->phase_acc[j]), s->phase_rate[j]);
+        /* Each 32 bit lane holds one 16 bit audio sample, with a zero top half.
+           Multiplying with the same layout of a tone sample, using pmaddwd,
+           gives a full 32 bit product for each channel. */
+        tone[j][0] = _mm_set1_epi32((uint16_t) ph.re);
+        tone[j][1] = _mm_set1_epi32((uint16_t) ph.im);
+    }
+    for (ch = 0;  ch < s->lanes;  ch += 4)
+    {
+        x = _mm_set_epi32((uint16_t) bank_amp(s, amp, ch + 3, i),
+                          (uint16_t) bank_amp(s, amp, ch + 2, i),
+                          (uint16_t) bank_amp(s, amp, ch + 1, i),
+                          (uint16_t) bank_amp(s, amp, ch, i));
+        for (j = 0;  j < 2;  j++)
+        {
+            for (k = 0;  k < 2;  k++)
+            {
+                win = bank_window(s, s->buf_ptr, j, k) + ch;
+                dot = &s->dot[(j*2 + k)*s->lanes + ch];
+                w = _mm_srai_epi32(_mm_madd_epi16(x, tone[j][k]), s->scaling_shift);
+                _mm_storeu_si128((__m128i *) dot,
+                                 _mm_add_epi32(_mm_sub_epi32(_mm_loadu_si128((__m128i *) dot),
+                                                             _mm_loadu_si128((__m128i *) win)),
+                                               w));
+                _mm_storeu_si128((__m128i *) win, w);
+            }
+            /* The dot products, shifted down by 15 bits, do not always fit in 16
+               bits, so square them at full 32 bit width, as fsk_rx() does. */
+            re = _mm_srai_epi32(_mm_loadu_si128((__m128i *) &s->dot[(j*2)*s->lanes + ch]), 15);
+            im = _mm_srai_epi32(_mm_loadu_si128((__m128i *) &s->dot[(j*2 + 1)*s->lanes + ch]), 15);
+            sum[j] = _mm_add_epi32(mullo_epi32(re, re), mullo_epi32(im, im));
+        }
+        s->baudstate[ch >> 2] = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(sum[0], sum[1])));
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#else
+static void bank_correlate(fsk_rx_bank_state_t *s, const int16_t *amp[], int i)
+{
+    complexi_t ph;
+    int32_t *win[2][2];
+    int32_t *dot[2][2];
+    int32_t sum[2];
+    int32_t d;
+    int16_t x;
+    int j;
+    int k;
+    int ch;
+
+    for (j = 0;  j < 2;  j++)
+    {
+        for (k = 0;  k < 2;  k++)
+        {
+            win[j][k] = bank_window(s, s->buf_ptr, j, k);
+            dot[j][k] = &s->dot[(j*2 + k)*s->lanes];
+        }
+    }
+    for (j = 0;  j < 2;  j++)
+    {
+        ph = dds_complexi(&(s->phase_acc[j]), s->phase_rate[j]);
+        for (ch = 0;  ch < s->channels;  ch++)
+        {
+            x = bank_amp(s, amp, ch, i);
+            dot[j][0][ch] -= win[j][0][ch];
+            win[j][0][ch] = (ph.re*x) >> s->scaling_shift;
+            dot[j][0][ch] += win[j][0][ch];
+            dot[j][1][ch] -= win[j][1][ch];
+            win[j][1][ch] = (ph.im*x) >> s->scaling_shift;
+            dot[j][1][ch] += win[j][1][ch];
+        }
+    }
+    for (ch = 0;  ch < s->channels;  ch++)
+    {
+        if ((ch & 3) == 0)
+            s->baudstate[ch >> 2] = 0;
+        for (j = 0;  j < 2;  j++)
+        {
+            d = dot[j][0][ch] >> 15;
+            sum[j] = d*d;
+            d = dot[j][1][ch] >> 15;
+            sum[j] += d*d;
+        }
+        if (sum[0] < sum[1])
+            s->baudstate[ch >> 2] |= (1 << (ch & 3));
+    }
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+SPAN_DECLARE_NONSTD(int) fsk_rx_bank(fsk_rx_bank_state_t *s, const int16_t *amp[], int len)
+{
+    int i;
+    int ch;
+
+    for (i = 0;  i < len;  i++)
+    {
+        /* Run the tone correlators for all the channels side by side... */
+        bank_correlate(s, amp, i);
+        /* ...and then carrier detection and bit recovery channel by channel */
+        for (ch = 0;  ch < s->channels;  ch++)
+        {
+            if (s->chan[ch]  &&  amp[ch])
+                fsk_rx_sample(s->chan[ch], amp[ch][i], (s->baudstate[ch >> 2] >> (ch & 3)) & 1);
+        }
+        if (++s->buf_ptr >= s->correlation_span)
+            s->buf_ptr = 0;
+    }
+    for (ch = 0;  ch < s->channels;  ch++)
+    {
+        if (s->chan[ch])
+            chunk_rx_flush(&s->chan[ch]->chunk);
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fsk_rx_bank_set_channel(fsk_rx_bank_state_t *s, int channel, fsk_rx_state_t *rx)
+{
+    int i;
+    int j;
+    int k;
+
+    if (channel < 0  ||  channel >= s->channels)
+        return -1;
+    if (rx
+        &&
+        (rx->phase_rate[0] != s->phase_rate[0]  ||  rx->phase_rate[1] != s->phase_rate[1]  ||  rx->correlation_span != s->correlation_span))
+    {
+        /* The channel must have been set up with the same FSK spec. as the bank */
+        return -1;
+    }
+    s->chan[channel] = rx;
+    /* Start the new channel's correlators from scratch */
+    for (i = 0;  i < FSK_MAX_WINDOW_LEN;  i++)
+    {
+        for (j = 0;  j < 2;  j++)
+        {
+            for (k = 0;  k < 2;  k++)
+                bank_window(s, i, j, k)[channel] = 0;
+        }
+    }
+    for (j = 0;  j < 4;  j++)
+        s->dot[j*s->lanes + channel] = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(fsk_rx_bank_state_t *) fsk_rx_bank_init(fsk_rx_bank_state_t *s,
+                                                     const fsk_spec_t *spec,
+                                                     int channels)
+{
+    fsk_rx_state_t t;
+    int lanes;
+    int allocated;
+
+    if (channels <= 0)
+        return NULL;
+    allocated = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (fsk_rx_bank_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+        allocated = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    lanes = BANK_LANES(channels);
+    s->channels = channels;
+    s->lanes = lanes;
+    s->chan = (fsk_rx_state_t **) malloc(lanes*sizeof(s->chan[0]));
+    s->window = (int32_t *) malloc(FSK_MAX_WINDOW_LEN*2*2*lanes*sizeof(s->window[0]));
+    s->dot = (int32_t *) malloc(2*2*lanes*sizeof(s->dot[0]));
+    s->baudstate = (uint8_t *) malloc((lanes >> 2)*sizeof(s->baudstate[0]));
+    if (s->chan == NULL  ||  s->window == NULL  ||  s->dot == NULL  ||  s->baudstate == NULL)
+    {
+        fsk_rx_bank_release(s);
+        if (allocated)
+            free(s);
+        return NULL;
+    }
+    memset(s->chan, 0, lanes*sizeof(s->chan[0]));
+    memset(s->window, 0, FSK_MAX_WINDOW_LEN*2*2*lanes*sizeof(s->window[0]));
+    memset(s->dot, 0, 2*2*lanes*sizeof(s->dot[0]));
+    memset(s->baudstate, 0, (lanes >> 2)*sizeof(s->baudstate[0]));
+
+    /* Use a scratch receiver to derive the correlator parameters exactly as
+       a stand-alone receiver would. */
+    fsk_rx_init(&t, spec, FSK_FRAME_MODE_SYNC, NULL, NULL);
+    s->phase_rate[0] = t.phase_rate[0];
+    s->phase_rate[1] = t.phase_rate[1];
+    s->correlation_span = t.correlation_span;
+    s->scaling_shift = t.scaling_shift;
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fsk_rx_bank_release(fsk_rx_bank_state_t *s)
+{
+    if (s->chan)
+    {
+        free(s->chan);
+        s->chan = NULL;
+    }
+    if (s->window)
+    {
+        free(s->window);
+        s->window = NULL;
+    }
+    if (s->dot)
+    {
+        free(s->dot);
+        s->dot = NULL;
+    }
+    if (s->baudstate)
+    {
+        free(s->baudstate);
+        s->baudstate = NULL;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) fsk_rx_bank_free(fsk_rx_bank_state_t *s)
+{
+    fsk_rx_bank_release(s);
+    free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+void fsk_tx_checkpoint(fsk_tx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->baud_rate);
+    checkpoint_field(c, s->phase_rates);
+    checkpoint_field(c, s->scaling);
+    checkpoint_field(c, s->current_phase_rate);
+    checkpoint_field(c, s->phase_acc);
+    checkpoint_field(c, s->baud_frac);
+    checkpoint_field(c, s->shutdown);
+}
+/*- End of function --------------------------------------------------------*/
+
+void fsk_rx_checkpoint(fsk_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->baud_rate);
+    checkpoint_field(c, s->framing_mode);
+    chunk_rx_checkpoint(&s->chunk, c);
+    checkpoint_field(c, s->carrier_on_power);
+    checkpoint_field(c, s->carrier_off_power);
+    checkpoint_field(c, s->power);
+    checkpoint_field(c, s->last_sample);
+    checkpoint_field(c, s->signal_present);
+    checkpoint_field(c, s->phase_rate);
+    checkpoint_field(c, s->phase_acc);
+    checkpoint_field(c, s->correlation_span);
+    checkpoint_field(c, s->window);
+    checkpoint_field(c, s->dot);
+    checkpoint_field(c, s->buf_ptr);
+    checkpoint_field(c, s->frame_state);
+    checkpoint_field(c, s->frame_bits);
+    checkpoint_field(c, s->baud_phase);
+    checkpoint_field(c, s->last_bit);
+    checkpoint_field(c, s->scaling_shift);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
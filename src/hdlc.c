@@ -41,6 +41,44 @@
 #include "spandsp/hdlc.h"
 #include "spandsp/private/hdlc.h"
 
+#include "checkpoint_local.h"
+
+enum
+{
+    HDLC_RX_FLAG = 1,
+    HDLC_RX_ABORT = 2
+};
+
+/* The effect of one received octet on the receiver, for a given run of ones leading
+   into it. The stuffed zeros are removed, and the octet is split into up to three
+   runs of data bits, separated by up to two flags or aborts. */
+typedef struct
+{
+    /*! \brief The number of flags and aborts found in the octet. */
+    uint8_t events;
+    /*! \brief HDLC_RX_FLAG or HDLC_RX_ABORT, for each event. */
+    uint8_t event[2];
+    /*! \brief The number of data bits before, between and after the events. */
+    uint8_t bits[3];
+    /*! \brief The data bits, with the first received bit in the LSB. */
+    uint8_t data[3];
+} hdlc_rx_destuff_t;
+
+#include "hdlc_rx_destuff_table.h"
+
+/* The stuffed form of one octet to be transmitted, for a given run of ones leading into it. */
+typedef struct
+{
+    /*! \brief The stuffed bits, with the first bit to be sent in the MSB. */
+    uint16_t bits;
+    /*! \brief The number of stuffed bits - between 8 and 10. */
+    uint8_t len;
+    /*! \brief The run of ones at the end of the stuffed bits. */
+    uint8_t ones;
+} hdlc_tx_stuff_t;
+
+#include "hdlc_tx_stuff_table.h"
+
 static void report_status_change(hdlc_rx_state_t *s, int status)
 {
     if (s->status_handler)
@@ -118,99 +156,129 @@ static __inline__ void octet_count(hdlc_rx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static void rx_flag_or_abort(hdlc_rx_state_t *s)
+static void rx_abort(hdlc_rx_state_t *s)
 {
-    if ((s->raw_bit_stream & 0x8000))
-    {
-        /* Hit HDLC abort */
-        s->rx_aborts++;
-        report_status_change(s, SIG_STATUS_ABORT);
-        /* If we have not yet seen enough flags, restart the count. If we
-           are beyond that point, just back off one step, so we need to see
-           another flag before proceeding to collect frame octets. */
-        if (s->flags_seen < s->framing_ok_threshold - 1)
-            s->flags_seen = 0;
-        else
-            s->flags_seen = s->framing_ok_threshold - 1;
-        /* An abort starts octet counting */
-        octet_set_and_count(s);
-    }
+    /* Hit HDLC abort */
+    s->rx_aborts++;
+    report_status_change(s, SIG_STATUS_ABORT);
+    /* If we have not yet seen enough flags, restart the count. If we
+       are beyond that point, just back off one step, so we need to see
+       another flag before proceeding to collect frame octets. */
+    if (s->flags_seen < s->framing_ok_threshold - 1)
+        s->flags_seen = 0;
     else
+        s->flags_seen = s->framing_ok_threshold - 1;
+    /* An abort starts octet counting */
+    octet_set_and_count(s);
+    s->len = 0;
+    s->num_bits = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void rx_flag(hdlc_rx_state_t *s)
+{
+    /* Hit HDLC flag */
+    /* A flag clears octet counting */
+    s->octet_counting_mode = FALSE;
+    if (s->flags_seen >= s->framing_ok_threshold)
     {
-        /* Hit HDLC flag */
-        /* A flag clears octet counting */
-        s->octet_counting_mode = FALSE;
-        if (s->flags_seen >= s->framing_ok_threshold)
+        /* We may have a frame, or we may have back to back flags */
+        if (s->len)
         {
-            /* We may have a frame, or we may have back to back flags */
-            if (s->len)
+            if (s->num_bits == 7  &&  s->len >= (size_t) s->crc_bytes  &&  s->len <= s->max_frame_len)
             {
-                if (s->num_bits == 7  &&  s->len >= (size_t) s->crc_bytes  &&  s->len <= s->max_frame_len)
+                if ((s->crc_bytes == 2  &&  crc_itu16_check(s->buffer, s->len))
+                    ||
+                    (s->crc_bytes != 2  &&  crc_itu32_check(s->buffer, s->len)))
                 {
-                    if ((s->crc_bytes == 2  &&  crc_itu16_check(s->buffer, s->len))
-                        ||
-                        (s->crc_bytes != 2  &&  crc_itu32_check(s->buffer, s->len)))
-                    {
-                        s->rx_frames++;
-                        s->rx_bytes += s->len - s->crc_bytes;
-                        s->len -= s->crc_bytes;
-                        s->frame_handler(s->frame_user_data, s->buffer, s->len, TRUE);
-                    }
-                    else
-                    {
-                        s->rx_crc_errors++;
-                        if (s->report_bad_frames)
-                        {
-                            s->len -= s->crc_bytes;
-                            s->frame_handler(s->frame_user_data, s->buffer, s->len, FALSE);
-                        }
-                    }
+                    s->rx_frames++;
+                    s->rx_bytes += s->len - s->crc_bytes;
+                    s->len -= s->crc_bytes;
+                    s->frame_handler(s->frame_user_data, s->buffer, s->len, TRUE);
                 }
                 else
                 {
-                    /* Frame too short or too long, or the flag is misaligned with its octets. */
+                    s->rx_crc_errors++;
                     if (s->report_bad_frames)
                     {
-                        /* Don't let the length go below zero, or it will be confused
-                           with one of the special conditions. */
-                        if (s->len >= (size_t) s->crc_bytes)
-                            s->len -= s->crc_bytes;
-                        else
-                            s->len = 0;
+                        s->len -= s->crc_bytes;
                         s->frame_handler(s->frame_user_data, s->buffer, s->len, FALSE);
                     }
-                    s->rx_length_errors++;
                 }
             }
-        }
-        else
-        {
-            /* Check the flags are back-to-back when testing for valid preamble. This
-               greatly reduces the chances of false preamble detection, and anything
-               which doesn't send them back-to-back is badly broken. */
-            if (s->num_bits != 7)
+            else
             {
-                /* Don't set the flags seen indicator back to zero too aggressively.
-                   We want to pick up with the minimum of discarded data when there
-                   is a bit error in the stream, and a bit error could emulate a
-                   misaligned flag. */
-                if (s->flags_seen < s->framing_ok_threshold - 1)
-                    s->flags_seen = 0;
-                else
-                    s->flags_seen = s->framing_ok_threshold - 1;
-            }
-            if (++s->flags_seen >= s->framing_ok_threshold  &&  !s->framing_ok_announced)
-            {
-                report_status_change(s, SIG_STATUS_FRAMING_OK);
-                s->framing_ok_announced = TRUE;
+                /* Frame too short or too long, or the flag is misaligned with its octets. */
+                if (s->report_bad_frames)
+                {
+                    /* Don't let the length go below zero, or it will be confused
+                       with one of the special conditions. */
+                    if (s->len >= (size_t) s->crc_bytes)
+                        s->len -= s->crc_bytes;
+                    else
+                        s->len = 0;
+                    s->frame_handler(s->frame_user_data, s->buffer, s->len, FALSE);
+                }
+                s->rx_length_errors++;
             }
         }
     }
+    else
+    {
+        /* Check the flags are back-to-back when testing for valid preamble. This
+           greatly reduces the chances of false preamble detection, and anything
+           which doesn't send them back-to-back is badly broken. */
+        if (s->num_bits != 7)
+        {
+            /* Don't set the flags seen indicator back to zero too aggressively.
+               We want to pick up with the minimum of discarded data when there
+               is a bit error in the stream, and a bit error could emulate a
+               misaligned flag. */
+            if (s->flags_seen < s->framing_ok_threshold - 1)
+                s->flags_seen = 0;
+            else
+                s->flags_seen = s->framing_ok_threshold - 1;
+        }
+        if (++s->flags_seen >= s->framing_ok_threshold  &&  !s->framing_ok_announced)
+        {
+            report_status_change(s, SIG_STATUS_FRAMING_OK);
+            s->framing_ok_announced = TRUE;
+        }
+    }
     s->len = 0;
     s->num_bits = 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ void rx_flag_or_abort(hdlc_rx_state_t *s)
+{
+    if ((s->raw_bit_stream & 0x8000))
+        rx_abort(s);
+    else
+        rx_flag(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void rx_octet(hdlc_rx_state_t *s)
+{
+    /* Ensure we do not accept an overlength frame, and especially that
+       we do not overflow our buffer */
+    if (s->len < s->max_frame_len)
+    {
+        s->buffer[s->len++] = (uint8_t) s->byte_in_progress;
+    }
+    else
+    {
+        /* This is too long. Abandon the frame, and wait for the next
+           flag octet. */
+        s->len = sizeof(s->buffer) + 1;
+        s->flags_seen = s->framing_ok_threshold - 1;
+        octet_set_and_count(s);
+    }
+    s->num_bits = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ void hdlc_rx_put_bit_core(hdlc_rx_state_t *s)
 {
     if ((s->raw_bit_stream & 0x3F00) == 0x3E00)
@@ -230,23 +298,7 @@ static __inline__ void hdlc_rx_put_bit_core(hdlc_rx_state_t *s)
     }
     s->byte_in_progress = (s->byte_in_progress | (s->raw_bit_stream & 0x100)) >> 1;
     if (s->num_bits == 8)
-    {
-        /* Ensure we do not accept an overlength frame, and especially that
-           we do not overflow our buffer */
-        if (s->len < s->max_frame_len)
-        {
-            s->buffer[s->len++] = (uint8_t) s->byte_in_progress;
-        }
-        else
-        {
-            /* This is too long. Abandon the frame, and wait for the next
-               flag octet. */
-            s->len = sizeof(s->buffer) + 1;
-            s->flags_seen = s->framing_ok_threshold - 1;
-            octet_set_and_count(s);
-        }
-        s->num_bits = 0;
-    }
+        rx_octet(s);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -262,21 +314,74 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put_bit(hdlc_rx_state_t *s, int new_bit)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(void) hdlc_rx_put_byte(hdlc_rx_state_t *s, int new_byte)
+static __inline__ void rx_data_bits(hdlc_rx_state_t *s, unsigned int bits, int n)
 {
-    int i;
+    int m;
+
+    /* Absorb n destuffed data bits, with the first received bit in the LSB of bits.
+       This has exactly the same effect as n passes through hdlc_rx_put_bit_core(). */
+    while (n > 0)
+    {
+        if (s->flags_seen < s->framing_ok_threshold)
+        {
+            /* Report each octet boundary we cross, while hunting for flags. */
+            for (m = ((s->num_bits & 0x7) + n) >> 3;  m > 0;  m--)
+                octet_count(s);
+            s->num_bits += n;
+            return;
+        }
+        m = 8 - s->num_bits;
+        if (m > n)
+            m = n;
+        s->byte_in_progress = ((s->byte_in_progress >> m) | ((bits & ((1 << m) - 1)) << (8 - m))) & 0xFF;
+        s->num_bits += m;
+        bits >>= m;
+        n -= m;
+        if (s->num_bits == 8)
+            rx_octet(s);
+    }
+}
+/*- End of function --------------------------------------------------------*/
 
+static __inline__ void hdlc_rx_put_byte_core(hdlc_rx_state_t *s, int new_byte)
+{
+    const hdlc_rx_destuff_t *d;
+    int run;
+
+    /* The run of ones leading into this byte is at the bottom of the raw history. */
+    run = bottom_bit(~(s->raw_bit_stream >> 8) & 0xFF);
+    if (run < 0)
+        run = 7;
+    d = &destuff[run][new_byte];
+    rx_data_bits(s, d->data[0], d->bits[0]);
+    if (d->events)
+    {
+        if (d->event[0] == HDLC_RX_ABORT)
+            rx_abort(s);
+        else
+            rx_flag(s);
+        rx_data_bits(s, d->data[1], d->bits[1]);
+        if (d->events > 1)
+        {
+            if (d->event[1] == HDLC_RX_ABORT)
+                rx_abort(s);
+            else
+                rx_flag(s);
+            rx_data_bits(s, d->data[2], d->bits[2]);
+        }
+    }
+    s->raw_bit_stream = (s->raw_bit_stream | new_byte) << 8;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(void) hdlc_rx_put_byte(hdlc_rx_state_t *s, int new_byte)
+{
     if (new_byte < 0)
     {
         rx_special_condition(s, new_byte);
         return;
     }
-    s->raw_bit_stream |= new_byte;
-    for (i = 0;  i < 8;  i++)
-    {
-        s->raw_bit_stream <<= 1;
-        hdlc_rx_put_bit_core(s);
-    }
+    hdlc_rx_put_byte_core(s, new_byte & 0xFF);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -285,7 +390,7 @@ SPAN_DECLARE_NONSTD(void) hdlc_rx_put(hdlc_rx_state_t *s, const uint8_t buf[], i
     int i;
 
     for (i = 0;  i < len;  i++)
-        hdlc_rx_put_byte(s, buf[i]);
+        hdlc_rx_put_byte_core(s, buf[i]);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -438,10 +543,20 @@ SPAN_DECLARE(int) hdlc_tx_corrupt_frame(hdlc_tx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int tx_ones_run(uint64_t octets_in_progress)
+{
+    int run;
+
+    /* Stuffing means there can never be more than four ones at the end of the stream. */
+    if ((run = bottom_bit(~((unsigned int) octets_in_progress) & 0x1F)) < 0)
+        run = 4;
+    return run;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) hdlc_tx_get_byte(hdlc_tx_state_t *s)
 {
-    int i;
-    int byte_in_progress;
+    const hdlc_tx_stuff_t *d;
     int txbyte;
 
     if (s->flag_octets > 0)
@@ -515,21 +630,9 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_byte(hdlc_tx_state_t *s)
                 return txbyte;
             }
         }
-        byte_in_progress = s->buffer[s->pos++];
-        i = bottom_bit(byte_in_progress | 0x100);
-        s->octets_in_progress <<= i;
-        byte_in_progress >>= i;
-        for (  ;  i < 8;  i++)
-        {
-            s->octets_in_progress = (s->octets_in_progress << 1) | (byte_in_progress & 0x01);
-            byte_in_progress >>= 1;
-            if ((s->octets_in_progress & 0x1F) == 0x1F)
-            {
-                /* There are 5 ones - stuff */
-                s->octets_in_progress <<= 1;
-                s->num_bits++;
-            }
-        }
+        d = &stuff[tx_ones_run(s->octets_in_progress)][s->buffer[s->pos++]];
+        s->octets_in_progress = (s->octets_in_progress << d->len) | d->bits;
+        s->num_bits += d->len - 8;
         /* An input byte will generate between 8 and 10 output bits */
         return (s->octets_in_progress >> s->num_bits) & 0xFF;
     }
@@ -559,16 +662,64 @@ SPAN_DECLARE_NONSTD(int) hdlc_tx_get_bit(hdlc_tx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static size_t tx_get_frame_octets(hdlc_tx_state_t *s, uint8_t buf[], size_t max_len)
+{
+    const hdlc_tx_stuff_t *d;
+    uint64_t octets_in_progress;
+    size_t i;
+    int num_bits;
+    int ones;
+
+    /* Stuff the body of the current frame several octets at a time into a 64 bit
+       accumulator, and pull out whole octets. This produces exactly the same bits
+       as repeated calls to hdlc_tx_get_byte(). The CRC, and the closing flag, are
+       left to hdlc_tx_get_byte(). */
+    octets_in_progress = s->octets_in_progress;
+    num_bits = s->num_bits;
+    ones = tx_ones_run(octets_in_progress);
+    i = 0;
+    while (i < max_len)
+    {
+        /* Each octet stuffs to no more than 10 bits */
+        while (num_bits <= 64 - 10  &&  s->pos < s->len)
+        {
+            d = &stuff[ones][s->buffer[s->pos++]];
+            octets_in_progress = (octets_in_progress << d->len) | d->bits;
+            num_bits += d->len;
+            ones = d->ones;
+        }
+        if (num_bits < 8)
+            break;
+        do
+        {
+            num_bits -= 8;
+            buf[i++] = (uint8_t) (octets_in_progress >> num_bits);
+        }
+        while (num_bits >= 8  &&  i < max_len);
+    }
+    s->octets_in_progress = octets_in_progress;
+    s->num_bits = num_bits;
+    return i;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) hdlc_tx_get(hdlc_tx_state_t *s, uint8_t buf[], size_t max_len)
 {
     size_t i;
     int x;
 
-    for (i = 0;  i < max_len;  i++)
+    for (i = 0;  i < max_len;  )
     {
+        if (s->flag_octets <= 0  &&  s->pos < s->len)
+        {
+            /* We are in the body of a frame, so we can take the fast route */
+            i += tx_get_frame_octets(s, &buf[i], max_len - i);
+            if (i >= max_len)
+                break;
+        }
         if ((x = hdlc_tx_get_byte(s)) == SIG_STATUS_END_OF_DATA)
             return i;
-        buf[i] = (uint8_t) x;
+        buf[i++] = (uint8_t) x;
     }
     return (int) i;
 }
@@ -625,4 +776,50 @@ SPAN_DECLARE(int) hdlc_tx_free(hdlc_tx_state_t *s)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void hdlc_rx_checkpoint(hdlc_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->crc_bytes);
+    checkpoint_field(c, s->max_frame_len);
+    checkpoint_field(c, s->report_bad_frames);
+    checkpoint_field(c, s->framing_ok_threshold);
+    checkpoint_field(c, s->framing_ok_announced);
+    checkpoint_field(c, s->flags_seen);
+    checkpoint_field(c, s->raw_bit_stream);
+    checkpoint_field(c, s->byte_in_progress);
+    checkpoint_field(c, s->num_bits);
+    checkpoint_field(c, s->octet_counting_mode);
+    checkpoint_field(c, s->octet_count);
+    checkpoint_field(c, s->octet_count_report_interval);
+    checkpoint_field(c, s->buffer);
+    checkpoint_field(c, s->len);
+    checkpoint_field(c, s->rx_bytes);
+    checkpoint_field(c, s->rx_frames);
+    checkpoint_field(c, s->rx_crc_errors);
+    checkpoint_field(c, s->rx_length_errors);
+    checkpoint_field(c, s->rx_aborts);
+}
+/*- End of function --------------------------------------------------------*/
+
+void hdlc_tx_checkpoint(hdlc_tx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->crc_bytes);
+    checkpoint_field(c, s->inter_frame_flags);
+    checkpoint_field(c, s->progressive);
+    checkpoint_field(c, s->max_frame_len);
+    checkpoint_field(c, s->octets_in_progress);
+    checkpoint_field(c, s->num_bits);
+    checkpoint_field(c, s->idle_octet);
+    checkpoint_field(c, s->flag_octets);
+    checkpoint_field(c, s->abort_octets);
+    checkpoint_field(c, s->report_flag_underflow);
+    checkpoint_field(c, s->buffer);
+    checkpoint_field(c, s->len);
+    checkpoint_field(c, s->pos);
+    checkpoint_field(c, s->crc);
+    checkpoint_field(c, s->byte);
+    checkpoint_field(c, s->bits);
+    checkpoint_field(c, s->tx_end);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -125,6 +125,10 @@ SOURCE=.\bitstream.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\checkpoint.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\complex_filters.c
 # End Source File
 # Begin Source File
@@ -301,6 +305,10 @@ SOURCE=.\swept_tone.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\t4_page_buffer.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\t4_rx.c
 # End Source File
 # Begin Source File
@@ -345,6 +353,18 @@ SOURCE=.\t38_terminal.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\t81_t82_arith_coding.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\t85_decode.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\t85_encode.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\testcpuid.c
 # End Source File
 # Begin Source File
@@ -365,6 +385,10 @@ SOURCE=.\tone_generate.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\udptl.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\v17rx.c
 # End Source File
 # Begin Source File
@@ -663,6 +687,10 @@ SOURCE=.\spandsp/t38_terminal.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/t4_page_buffer.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/t4_rx.h
 # End Source File
 # Begin Source File
@@ -679,6 +707,14 @@ SOURCE=.\spandsp/t4_t6_encode.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/t81_t82_arith_coding.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\spandsp/t85.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/telephony.h
 # End Source File
 # Begin Source File
@@ -703,6 +739,10 @@ SOURCE=.\spandsp/tone_generate.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/udptl.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/v17rx.h
 # End Source File
 # Begin Source File
@@ -915,6 +955,10 @@ SOURCE=.\spandsp/private/t38_terminal.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/private/t4_page_buffer.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/private/t4_rx.h
 # End Source File
 # Begin Source File
@@ -931,6 +975,14 @@ SOURCE=.\spandsp/private/t4_t6_encode.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/private/t81_t82_arith_coding.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\spandsp/private/t85.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/private/time_scale.h
 # End Source File
 # Begin Source File
@@ -947,6 +999,10 @@ SOURCE=.\spandsp/private/tone_generate.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\spandsp/private/udptl.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp/private/v17rx.h
 # End Source File
 # Begin Source File
@@ -995,6 +1051,10 @@ SOURCE=.\spandsp/expose.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\checkpoint_local.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\spandsp.h
 # End Source File
 # End Group
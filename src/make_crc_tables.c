@@ -0,0 +1,160 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * make_crc_tables.c - Generate the slicing by 8 tables, and the folding
+ *                     constants, used by the ITU CRC code.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+/* The generator polynomials, in their usual form, with the x^n term implied and the
+   coefficient of x^0 in the LSB. The CRCs themselves work in the reflected bit order. */
+/* The ITU/HDLC 32 bit CRC - x^32 + x^26 + x^23 + x^22 + x^16 + x^12 + x^11 + x^10 + x^8 + x^7 + x^5 + x^4 + x^2 + x + 1 */
+#define CRC_ITU32_POLY  0x04C11DB7
+/* The ITU/HDLC 16 bit CRC - x^16 + x^12 + x^5 + 1 */
+#define CRC_ITU16_POLY  0x1021
+
+static uint64_t bit_reverse(uint64_t x, int bits)
+{
+    uint64_t y;
+    int i;
+
+    y = 0;
+    for (i = 0;  i < bits;  i++)
+    {
+        y = (y << 1) | (x & 1);
+        x >>= 1;
+    }
+    return y;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* x^n modulo the polynomial, in the usual bit order */
+static uint64_t x_pow_n_mod(int n, uint64_t poly, int bits)
+{
+    uint64_t r;
+    int i;
+
+    r = 1;
+    for (i = 0;  i < n;  i++)
+    {
+        r <<= 1;
+        if ((r >> bits) & 1)
+            r ^= poly | ((uint64_t) 1 << bits);
+    }
+    return r;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void make_slice_table(const char *name, const char *type, uint32_t poly, int bits)
+{
+    uint32_t table[8][256];
+    uint32_t reflected;
+    uint32_t crc;
+    int i;
+    int j;
+    int n;
+
+    /* Row 0 is the ordinary byte at a time table, for the reflected CRC */
+    reflected = (uint32_t) bit_reverse(poly, bits);
+    for (i = 0;  i < 256;  i++)
+    {
+        crc = i;
+        for (j = 0;  j < 8;  j++)
+            crc = (crc & 1)  ?  ((crc >> 1) ^ reflected)  :  (crc >> 1);
+        table[0][i] = crc;
+    }
+    for (n = 1;  n < 8;  n++)
+    {
+        for (i = 0;  i < 256;  i++)
+            table[n][i] = (table[n - 1][i] >> 8) ^ table[0][table[n - 1][i] & 0xFF];
+    }
+    printf("static const %s %s[8][256] =\n", type, name);
+    printf("{\n");
+    for (n = 0;  n < 8;  n++)
+    {
+        printf("    {\n");
+        for (i = 0;  i < 256;  i++)
+        {
+            if ((i & 7) == 0)
+                printf("        ");
+            printf("0x%0*" PRIX32, bits/4, table[n][i]);
+            if (i < 255)
+                printf("%s", ((i & 7) == 7)  ?  ",\n"  :  ", ");
+            else
+                printf("\n");
+        }
+        printf("%s", (n < 7)  ?  "    },\n"  :  "    }\n");
+    }
+    printf("};\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void make_fold_constants(const char *name, uint32_t poly, int bits)
+{
+    static const int powers[4] = {575, 511, 191, 127};
+    uint64_t k;
+    int i;
+
+    printf("static const crc_fold_constants_t %s =\n", name);
+    printf("{\n");
+    printf("    {");
+    for (i = 0;  i < 4;  i++)
+    {
+        k = bit_reverse(x_pow_n_mod(powers[i], poly, bits), bits) << (64 - bits);
+        printf("0x%016" PRIX64 "ULL%s", k, (i < 3)  ?  ", "  :  "");
+    }
+    printf("}\n");
+    printf("};\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    printf("/* Entry [n][i] is the CRC contribution of byte i followed by n zero bytes. Row 0 is the\n");
+    printf("   ordinary byte at a time table. Each later row is derived from the row before as\n");
+    printf("   row[n][i] = (row[n - 1][i] >> 8) ^ row[0][row[n - 1][i] & 0xFF]. */\n");
+    printf("\n");
+    make_slice_table("crc_itu32_slice", "uint32_t", CRC_ITU32_POLY, 32);
+    printf("\n");
+    make_slice_table("crc_itu16_slice", "uint16_t", CRC_ITU16_POLY, 16);
+    printf("\n");
+    printf("#if defined(CRC_USE_PCLMUL)\n");
+    printf("/* The folding constants are x^n modulo the polynomial, bit reversed into a 64 bit\n");
+    printf("   lane to suit the reflected bit order of these CRCs. A carry-less multiply of two\n");
+    printf("   reflected 64 bit values gives a product which is one bit short of filling 128 bits,\n");
+    printf("   so the powers are one less than the distance of each fold - 575 and 511 for a fold\n");
+    printf("   across 64 bytes, and 191 and 127 for a fold across 16 bytes. */\n");
+    make_fold_constants("crc_itu32_fold", CRC_ITU32_POLY, 32);
+    printf("\n");
+    make_fold_constants("crc_itu16_fold", CRC_ITU16_POLY, 16);
+    printf("#endif\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
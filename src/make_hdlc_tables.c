@@ -0,0 +1,248 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * make_hdlc_tables.c - Generate the octet at a time bit stuffing and
+ *                      destuffing tables used by the HDLC code.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#if defined(__sunos)  ||  defined(__solaris)  ||  defined(__sun)
+#include <getopt.h>
+#endif
+
+#if !defined(FALSE)
+#define FALSE 0
+#endif
+#if !defined(TRUE)
+#define TRUE (!FALSE)
+#endif
+
+/* These must match the names used in hdlc.c */
+static const char *rx_event_names[] =
+{
+    "0",
+    "HDLC_RX_FLAG",
+    "HDLC_RX_ABORT"
+};
+
+static void make_rx_destuff_table(void)
+{
+    int ones_in;
+    int octet;
+    int ones;
+    int bit;
+    int i;
+    int events;
+    int event[2];
+    int bits[3];
+    int data[3];
+
+    printf("/* Indexed by the number of ones leading into the octet (7 meaning 7 or more), and the\n");
+    printf("   octet. The octet arrives MSB first. Each run of ones is counted from the last zero\n");
+    printf("   bit. A zero following exactly five ones is a stuffed zero, and is dropped. A zero\n");
+    printf("   following six ones ends a flag, and a zero following seven or more ones ends an\n");
+    printf("   abort. Each entry gives the data bits before, between and after those events. */\n");
+    printf("static const hdlc_rx_destuff_t destuff[8][256] =\n");
+    printf("{\n");
+    for (ones_in = 0;  ones_in < 8;  ones_in++)
+    {
+        printf("    {\n");
+        if (ones_in < 7)
+            printf("        /* %d ones leading in */\n", ones_in);
+        else
+            printf("        /* %d or more ones leading in */\n", ones_in);
+        for (octet = 0;  octet < 256;  octet++)
+        {
+            ones = ones_in;
+            events = 0;
+            memset(event, 0, sizeof(event));
+            memset(bits, 0, sizeof(bits));
+            memset(data, 0, sizeof(data));
+            for (i = 7;  i >= 0;  i--)
+            {
+                bit = (octet >> i) & 1;
+                if (bit)
+                {
+                    /* The ones of a flag or abort are kept as data. The receiver strips
+                       them when it sees the event. */
+                    if (ones < 7)
+                        ones++;
+                    data[events] |= 1 << bits[events];
+                    bits[events]++;
+                    continue;
+                }
+                if (ones == 5)
+                {
+                    /* A stuffed zero */
+                }
+                else if (ones >= 6)
+                {
+                    /* Two events is the most which can fit in one octet */
+                    assert(events < 2);
+                    event[events++] = (ones == 6)  ?  1  :  2;
+                }
+                else
+                {
+                    bits[events]++;
+                }
+                ones = 0;
+            }
+            printf("        {%d, {%s, %s}, {%d, %d, %d}, {0x%02X, 0x%02X, 0x%02X}}%s    /* 0x%02X */\n",
+                   events,
+                   rx_event_names[event[0]],
+                   rx_event_names[event[1]],
+                   bits[0],
+                   bits[1],
+                   bits[2],
+                   data[0],
+                   data[1],
+                   data[2],
+                   (octet < 255)  ?  ","  :  "",
+                   octet);
+        }
+        if (ones_in < 7)
+            printf("    },\n");
+        else
+            printf("    }\n");
+    }
+    printf("};\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void make_tx_stuff_table(void)
+{
+    int ones_in;
+    int octet;
+    int ones;
+    int bit;
+    int i;
+    int bits;
+    int len;
+
+    printf("/* Indexed by the number of ones leading into the octet (never more than 4), and the\n");
+    printf("   octet. The octet is sent LSB first. A zero is stuffed after every run of five ones.\n");
+    printf("   Each entry gives the stuffed bits, with the first bit to be sent in the MSB, the\n");
+    printf("   number of stuffed bits, and the run of ones left at the end of them. */\n");
+    printf("static const hdlc_tx_stuff_t stuff[5][256] =\n");
+    printf("{\n");
+    for (ones_in = 0;  ones_in < 5;  ones_in++)
+    {
+        printf("    {\n");
+        printf("        /* %d ones leading in */\n", ones_in);
+        for (octet = 0;  octet < 256;  octet++)
+        {
+            ones = ones_in;
+            bits = 0;
+            len = 0;
+            for (i = 0;  i < 8;  i++)
+            {
+                bit = (octet >> i) & 1;
+                bits = (bits << 1) | bit;
+                len++;
+                if (bit)
+                {
+                    if (++ones == 5)
+                    {
+                        bits <<= 1;
+                        len++;
+                        ones = 0;
+                    }
+                }
+                else
+                {
+                    ones = 0;
+                }
+            }
+            printf("        {0x%03X, %2d, %d}%s    /* 0x%02X */\n",
+                   bits,
+                   len,
+                   ones,
+                   (octet < 255)  ?  ","  :  "",
+                   octet);
+        }
+        if (ones_in < 4)
+            printf("    },\n");
+        else
+            printf("    }\n");
+    }
+    printf("};\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: make_hdlc_tables -r | -t\n");
+    fprintf(stderr, "    -r  generate the receive destuffing table\n");
+    fprintf(stderr, "    -t  generate the transmit stuffing table\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+    int opt;
+    int rx_table;
+    int tx_table;
+
+    rx_table = FALSE;
+    tx_table = FALSE;
+    while ((opt = getopt(argc, argv, "rt")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rx_table = TRUE;
+            break;
+        case 't':
+            tx_table = TRUE;
+            break;
+        default:
+            usage();
+            exit(2);
+            break;
+        }
+    }
+    if (rx_table)
+    {
+        make_rx_destuff_table();
+    }
+    else if (tx_table)
+    {
+        make_tx_stuff_table();
+    }
+    else
+    {
+        usage();
+        exit(2);
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -67,9 +67,12 @@
 #include "spandsp/fsk.h"
 #include "spandsp/modem_connect_tones.h"
 
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 #include "spandsp/private/modem_connect_tones.h"
 
+#include "checkpoint_local.h"
+
 #define HDLC_FRAMING_OK_THRESHOLD       5
 
 SPAN_DECLARE(const char *) modem_connect_tone_to_str(int tone)
@@ -618,4 +621,42 @@ SPAN_DECLARE(int) modem_connect_tones_rx_free(modem_connect_tones_rx_state_t *s)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void modem_connect_tones_tx_checkpoint(modem_connect_tones_tx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->tone_type);
+    checkpoint_field(c, s->tone_phase_rate);
+    checkpoint_field(c, s->tone_phase);
+    checkpoint_field(c, s->level);
+    checkpoint_field(c, s->hop_timer);
+    checkpoint_field(c, s->duration_timer);
+    checkpoint_field(c, s->mod_phase);
+    checkpoint_field(c, s->mod_phase_rate);
+    checkpoint_field(c, s->mod_level);
+}
+/*- End of function --------------------------------------------------------*/
+
+void modem_connect_tones_rx_checkpoint(modem_connect_tones_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->tone_type);
+    checkpoint_field(c, s->znotch_1);
+    checkpoint_field(c, s->znotch_2);
+    checkpoint_field(c, s->z15hz_1);
+    checkpoint_field(c, s->z15hz_2);
+    checkpoint_field(c, s->notch_level);
+    checkpoint_field(c, s->channel_level);
+    checkpoint_field(c, s->am_level);
+    checkpoint_field(c, s->chunk_remainder);
+    checkpoint_field(c, s->tone_present);
+    checkpoint_field(c, s->tone_on);
+    checkpoint_field(c, s->tone_cycle_duration);
+    checkpoint_field(c, s->good_cycles);
+    checkpoint_field(c, s->hit);
+    fsk_rx_checkpoint(&s->v21rx, c);
+    checkpoint_field(c, s->raw_bit_stream);
+    checkpoint_field(c, s->num_bits);
+    checkpoint_field(c, s->flags_seen);
+    checkpoint_field(c, s->framing_ok_announced);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -36,6 +36,8 @@
 
 #define SPANDSP_USE_EXPORT_CAPABILITY 1
 
+#undef SPANDSP_SUPPORT_T85
+
 #include <stdlib.h>
 #include <msvc/inttypes.h>
 #include <string.h>
@@ -104,8 +106,8 @@
 #include <spandsp/image_translate.h>
 #include <spandsp/t4_t6_decode.h>
 #include <spandsp/t4_t6_encode.h>
-/*#include <spandsp/t81_t82_arith_coding.h>*/
-/*#include <spandsp/t85.h>*/
+#include <spandsp/t81_t82_arith_coding.h>
+#include <spandsp/t85.h>
 #include <spandsp/t30.h>
 #include <spandsp/t30_api.h>
 #include <spandsp/t30_fcf.h>
@@ -118,6 +120,7 @@
 #include <spandsp/t38_non_ecm_buffer.h>
 #include <spandsp/t38_gateway.h>
 #include <spandsp/t38_terminal.h>
+#include <spandsp/udptl.h>
 #include <spandsp/t31.h>
 #include <spandsp/adsi.h>
 #include <spandsp/oki_adpcm.h>
@@ -51,6 +51,8 @@
 
 #include "spandsp/private/silence_gen.h"
 
+#include "checkpoint_local.h"
+
 SPAN_DECLARE_NONSTD(int) silence_gen(silence_gen_state_t *s, int16_t *amp, int max_len)
 {
     if (s->remaining_samples != INT_MAX)
@@ -162,4 +164,11 @@ SPAN_DECLARE_NONSTD(int) span_dummy_rx_fillin(void *user_data, int len)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void silence_gen_checkpoint(silence_gen_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->remaining_samples);
+    checkpoint_field(c, s->total_samples);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
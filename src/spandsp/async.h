@@ -101,6 +101,15 @@ typedef void (*put_bit_func_t)(void *user_data, int bit);
 /*! Bit get function for data pumps */
 typedef int (*get_bit_func_t)(void *user_data);
 
+/*! Chunk put function for data pumps. This receives a block of octets of data
+    in one call, rather than bit by bit or byte by byte */
+typedef void (*put_chunk_func_t)(void *user_data, const uint8_t buf[], int len);
+
+/*! Chunk get function for data pumps. This supplies a block of octets of data
+    in one call, rather than bit by bit or byte by byte. A chunk shorter than
+    max_len marks the end of the data. */
+typedef int (*get_chunk_func_t)(void *user_data, uint8_t buf[], int max_len);
+
 /*! Completion callback function for tx data pumps */
 typedef void (*modem_tx_status_func_t)(void *user_data, int status);
 
@@ -131,6 +140,20 @@ typedef struct async_tx_state_s async_tx_state_t;
 */
 typedef struct async_rx_state_s async_rx_state_t;
 
+/*!
+    Chunk transmit descriptor. This defines the state of a single working instance
+    of a converter from chunks of octets to a synchronous serial bit stream, for use
+    in the fast FAX modems.
+*/
+typedef struct chunk_tx_state_s chunk_tx_state_t;
+
+/*!
+    Chunk receive descriptor. This defines the state of a single working instance
+    of a converter from a synchronous serial bit stream to chunks of octets, for use
+    in the modem receivers.
+*/
+typedef struct chunk_rx_state_s chunk_rx_state_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -170,6 +193,77 @@ SPAN_DECLARE(int) async_tx_free(async_tx_state_t *s);
     \return the next bit, or PUTBIT_END_OF_DATA to indicate the data stream has ended. */
 SPAN_DECLARE_NONSTD(int) async_tx_get_bit(void *user_data);
 
+/*! Initialise a chunk transmit context. The data is fetched from the get_chunk routine a
+    few octets at a time, and given out bit by bit. A chunk shorter than requested marks
+    the end of the data.
+    \brief Initialise a chunk transmit context.
+    \param s The transmitter context.
+    \param get_chunk The callback routine used to get the data to be transmitted.
+    \param user_data An opaque pointer.
+    \param lsb_first TRUE if the octets should be sent LSB first, else MSB first.
+    \return A pointer to the initialised context, or NULL if there was a problem. */
+SPAN_DECLARE(chunk_tx_state_t *) chunk_tx_init(chunk_tx_state_t *s,
+                                               get_chunk_func_t get_chunk,
+                                               void *user_data,
+                                               int lsb_first);
+
+/*! Discard anything left over from a previous transmission, so the next bit comes from
+    a fresh chunk.
+    \brief Restart a chunk transmit context.
+    \param s The transmitter context. */
+SPAN_DECLARE(void) chunk_tx_restart(chunk_tx_state_t *s);
+
+SPAN_DECLARE(int) chunk_tx_release(chunk_tx_state_t *s);
+
+SPAN_DECLARE(int) chunk_tx_free(chunk_tx_state_t *s);
+
+/*! Get the next bit of a transmitted synchronous bit stream, from chunks of octets.
+    \brief Get the next bit of a transmitted synchronous bit stream.
+    \param user_data An opaque point which must point to a chunk transmit context.
+    \return the next bit, or SIG_STATUS_END_OF_DATA to indicate the data stream has ended. */
+SPAN_DECLARE_NONSTD(int) chunk_tx_get_bit(void *user_data);
+
+/*! Initialise a chunk receive context. The received bits are packed into octets, and
+    delivered to the put_chunk routine in blocks of octets, rather than a bit at a time.
+    This greatly reduces the per-bit overhead at high bit rates. The octets may be passed
+    straight to hdlc_rx_put() (MSB first) or t30_non_ecm_put_chunk() (LSB first). The
+    owner delivers the pending octets with chunk_rx_flush(), and any odd bits short of a
+    whole octet with chunk_rx_put_residue().
+    \brief Initialise a chunk receive context.
+    \param s The receiver context.
+    \param put_chunk The callback routine used to handle blocks of received octets.
+    \param user_data An opaque pointer.
+    \param lsb_first TRUE if the bits should be packed LSB first, else MSB first.
+    \return A pointer to the initialised context, or NULL if there was a problem. */
+SPAN_DECLARE(chunk_rx_state_t *) chunk_rx_init(chunk_rx_state_t *s,
+                                               put_chunk_func_t put_chunk,
+                                               void *user_data,
+                                               int lsb_first);
+
+SPAN_DECLARE(int) chunk_rx_release(chunk_rx_state_t *s);
+
+SPAN_DECLARE(int) chunk_rx_free(chunk_rx_state_t *s);
+
+/*! Pass any complete octets waiting in a chunk receive context to its put_chunk routine.
+    \brief Flush the complete octets from a chunk receive context.
+    \param s The receiver context. */
+SPAN_DECLARE(void) chunk_rx_flush(chunk_rx_state_t *s);
+
+/*! Pass any bits short of a whole octet, oldest first, to a put_bit routine, and discard
+    them from a chunk receive context. This should follow chunk_rx_flush(), at the end of
+    the data.
+    \brief Deliver the odd bits left in a chunk receive context.
+    \param s The receiver context.
+    \param put_bit The callback routine used to handle the odd bits, or NULL to discard them.
+    \param user_data An opaque pointer passed to put_bit. */
+SPAN_DECLARE(void) chunk_rx_put_residue(chunk_rx_state_t *s, put_bit_func_t put_bit, void *user_data);
+
+/*! Put a bit of a received synchronous bit stream, to be packed into chunks of octets.
+    \brief Put a bit of a received synchronous bit stream.
+    \param user_data An opaque point which must point to a chunk receive context.
+    \param bit The new bit. */
+SPAN_DECLARE_NONSTD(void) chunk_rx_put_bit(void *user_data, int bit);
+
 /*! Initialise an asynchronous data receiver context.
     \brief Initialise an asynchronous data receiver context.
     \param s The receiver context.
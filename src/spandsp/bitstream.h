@@ -46,16 +46,34 @@ extern "C"
     \param s A pointer to the bitstream context.
     \param c A pointer to the bitstream output buffer.
     \param value The value to be pushed into the output buffer.
-    \param bits The number of bits of value to be pushed. 1 to 25 bits is valid. */
+    \param bits The number of bits of value to be pushed. 1 to 32 bits is valid. */
 SPAN_DECLARE(void) bitstream_put(bitstream_state_t *s, uint8_t **c, uint32_t value, int bits);
 
+/*! \brief Put a sequence of fields into the output buffer. This gives the same
+           result as calling bitstream_put() for each field in turn, but is faster.
+    \param s A pointer to the bitstream context.
+    \param c A pointer to the bitstream output buffer.
+    \param values The values to be pushed into the output buffer.
+    \param bits The number of bits in each value. 1 to 32 bits is valid.
+    \param n The number of fields. */
+SPAN_DECLARE(void) bitstream_put_fields(bitstream_state_t *s, uint8_t **c, const uint32_t values[], const uint8_t bits[], int n);
+
 /*! \brief Get a chunk of bits from the input buffer.
     \param s A pointer to the bitstream context.
     \param c A pointer to the bitstream input buffer.
-    \param bits The number of bits of value to be grabbed. 1 to 25 bits is valid.
+    \param bits The number of bits of value to be grabbed. 1 to 32 bits is valid.
     \return The value retrieved from the input buffer. */
 SPAN_DECLARE(uint32_t) bitstream_get(bitstream_state_t *s, const uint8_t **c, int bits);
 
+/*! \brief Get a sequence of fields from the input buffer. This gives the same
+           result as calling bitstream_get() for each field in turn, but is faster.
+    \param s A pointer to the bitstream context.
+    \param c A pointer to the bitstream input buffer.
+    \param values The values retrieved from the input buffer.
+    \param bits The number of bits in each value. 1 to 32 bits is valid.
+    \param n The number of fields. */
+SPAN_DECLARE(void) bitstream_get_fields(bitstream_state_t *s, const uint8_t **c, uint32_t values[], const uint8_t bits[], int n);
+
 /*! \brief Emit any residual bits to the output buffer, without actually flushing them.
            This is useful for getting the buffer fully up to date, ready for things
            like CRC calculations, while allowing bitstream_put() to be used to continue
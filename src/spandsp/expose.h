@@ -75,8 +75,9 @@
 #include <spandsp/private/image_translate.h>
 #include <spandsp/private/t4_t6_decode.h>
 #include <spandsp/private/t4_t6_encode.h>
-/*#include <spandsp/private/t81_t82_arith_coding.h>*/
-/*#include <spandsp/private/t85.h>*/
+#include <spandsp/private/t81_t82_arith_coding.h>
+#include <spandsp/private/t85.h>
+#include <spandsp/private/t4_page_buffer.h>
 #include <spandsp/private/t4_rx.h>
 #include <spandsp/private/t4_tx.h>
 #include <spandsp/private/t30.h>
@@ -85,6 +86,7 @@
 #include <spandsp/private/t38_non_ecm_buffer.h>
 #include <spandsp/private/t38_gateway.h>
 #include <spandsp/private/t38_terminal.h>
+#include <spandsp/private/udptl.h>
 #include <spandsp/private/t31.h>
 #include <spandsp/private/timezone.h>
 #include <spandsp/private/v18.h>
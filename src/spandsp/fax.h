@@ -88,6 +88,14 @@ SPAN_DECLARE(void) fax_set_transmit_on_idle(fax_state_t *s, int transmit_on_idle
 */
 SPAN_DECLARE(void) fax_set_tep_mode(fax_state_t *s, int use_tep);
 
+/*! Select whether the image modems replay their training sequences from shared,
+    precomputed waveforms, rather than synthesising them for every page.
+    \brief Select whether precomputed training waveforms are used for the image modems.
+    \param s The FAX context.
+    \param use_cache TRUE if the precomputed training waveforms should be used.
+    \return 0 for OK, -1 if the shared waveforms could not be built. */
+SPAN_DECLARE(int) fax_set_training_cache(fax_state_t *s, int use_cache);
+
 /*! Get a pointer to the T.30 engine associated with a FAX context.
     \brief Get a pointer to the T.30 engine associated with a FAX context.
     \param s The FAX context.
@@ -102,6 +110,41 @@ SPAN_DECLARE(t30_state_t *) fax_get_t30_state(fax_state_t *s);
 */
 SPAN_DECLARE(logging_state_t *) fax_get_logging_state(fax_state_t *s);
 
+/*! Get the amount of memory a FAX context is currently using. This is the context
+    itself, plus any page image and ECM buffers it currently holds. It changes as a
+    call progresses, and is smallest for an idle context.
+    \brief Get the amount of memory a FAX context is currently using.
+    \param s The FAX context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) fax_get_memory_footprint(fax_state_t *s);
+
+/*! Save the complete state of a FAX context, part way through a call, so the call can
+    be carried on by another context with fax_restore(). Once the checkpoint has been
+    written, any document being sent or received belongs to the checkpoint, and the
+    context must only be freed. The file is named in the checkpoint, and is opened again
+    where it is restored. No code or data addresses are held in the checkpoint, so any
+    process running the same version of the library, on the same kind of machine, can
+    restore it.
+    \brief Save the state of a FAX context.
+    \param s The FAX context.
+    \param buf The buffer for the checkpoint, or NULL to find the length needed.
+    \param max_len The length of the buffer.
+    \return The length of the checkpoint, or -1 if it will not fit in the buffer. */
+SPAN_DECLARE(int) fax_checkpoint(fax_state_t *s, uint8_t buf[], int max_len);
+
+/*! Carry on a call from a checkpoint written by fax_checkpoint(). The context must be
+    freshly initialised, and set up in the same way as the one the checkpoint was taken
+    from. Its handlers and settings are kept, and the state of the call comes from the
+    checkpoint. The handlers the call itself was using at the time are rebuilt from that
+    state.
+    \brief Restore the state of a FAX context.
+    \param s The FAX context.
+    \param buf The checkpoint.
+    \param len The length of the checkpoint.
+    \return 0 for OK, or -1 for a bad checkpoint, or one from a different version of
+            the library. After a failure the context can only be freed. */
+SPAN_DECLARE(int) fax_restore(fax_state_t *s, const uint8_t buf[], int len);
+
 /*! Restart a FAX context.
     \brief Restart a FAX context.
     \param s The FAX context.
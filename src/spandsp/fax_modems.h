@@ -68,6 +68,8 @@ SPAN_DECLARE(void) fax_modems_start_rx_modem(fax_modems_state_t *s, int which);
 
 SPAN_DECLARE(void) fax_modems_set_tep_mode(fax_modems_state_t *s, int use_tep);
 
+SPAN_DECLARE(int) fax_modems_set_training_cache(fax_modems_state_t *s, int use_cache);
+
 SPAN_DECLARE(int) fax_modems_restart(fax_modems_state_t *s);
 
 SPAN_DECLARE(fax_modems_state_t *) fax_modems_init(fax_modems_state_t *s,
@@ -139,6 +139,13 @@ typedef struct fsk_tx_state_s fsk_tx_state_t;
 */
 typedef struct fsk_rx_state_s fsk_rx_state_t;
 
+/*!
+    FSK modem receiver bank descriptor. This defines the state of a bank of FSK
+    modem receivers, all using the same FSK specification, whose tone correlators
+    are run side by side.
+*/
+typedef struct fsk_rx_bank_state_s fsk_rx_bank_state_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -238,6 +245,19 @@ SPAN_DECLARE_NONSTD(int) fsk_rx_fillin(fsk_rx_state_t *s, int len);
 
 SPAN_DECLARE(void) fsk_rx_set_put_bit(fsk_rx_state_t *s, put_bit_func_t put_bit, void *user_data);
 
+/*! Change the put_chunk function associated with a FSK modem receive context. The
+    received data is packed into octets, and delivered in blocks of octets, as
+    described for chunk_rx_init(). The pending octets are delivered at the end of each
+    block of audio processed, and before any status change is reported, with any odd
+    bits short of a whole octet going to the put_bit function.
+    \brief Change the put_chunk function associated with a FSK modem receive context.
+    \param s The modem context.
+    \param put_chunk The callback routine used to handle blocks of received octets, or
+           NULL to return to bit by bit operation.
+    \param user_data An opaque pointer.
+    \param lsb_first TRUE if the bits should be packed LSB first, else MSB first. */
+SPAN_DECLARE(void) fsk_rx_set_put_chunk(fsk_rx_state_t *s, put_chunk_func_t put_chunk, void *user_data, int lsb_first);
+
 /*! Change the modem status report function associated with an FSK modem receive context.
     \brief Change the modem status report function associated with an FSK modem receive context.
     \param s The modem context.
@@ -245,6 +265,48 @@ SPAN_DECLARE(void) fsk_rx_set_put_bit(fsk_rx_state_t *s, put_bit_func_t put_bit,
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) fsk_rx_set_modem_status_handler(fsk_rx_state_t *s, modem_rx_status_func_t handler, void *user_data);
 
+/*! Initialise a bank of FSK modem receivers. Many channels of the same type of FSK
+    signal (e.g. caller ID, or V.21 preamble monitoring) can be demodulated much more
+    cheaply in a bank than with one fsk_rx() call per channel. The bank runs the tone
+    correlators for all its channels side by side, using SIMD instructions where they
+    are available, and a single set of reference tone generators. Carrier detection,
+    framing and bit delivery remain those of the ordinary receiver attached to each
+    channel.
+    \brief Initialise a bank of FSK modem receivers.
+    \param s The bank context.
+    \param spec The specification of the modem tones and rate, common to all channels.
+    \param channels The number of channels in the bank.
+    \return A pointer to the bank context, or NULL if there was a problem. */
+SPAN_DECLARE(fsk_rx_bank_state_t *) fsk_rx_bank_init(fsk_rx_bank_state_t *s,
+                                                     const fsk_spec_t *spec,
+                                                     int channels);
+
+SPAN_DECLARE(int) fsk_rx_bank_release(fsk_rx_bank_state_t *s);
+
+SPAN_DECLARE(int) fsk_rx_bank_free(fsk_rx_bank_state_t *s);
+
+/*! Attach an FSK modem receiver to a channel of a receiver bank, or detach the channel.
+    The receiver must have been initialised with the same FSK specification as the bank.
+    Its signal cutoff, framing mode, put_bit and status handlers are used as normal.
+    Its own correlators are not used while it is attached to the bank.
+    \brief Attach an FSK modem receiver to a channel of a receiver bank.
+    \param s The bank context.
+    \param channel The channel number, from 0 to one less than the number of channels.
+    \param rx The receiver context, or NULL to make the channel idle.
+    \return 0 for OK, or -1 for a bad channel number or a mismatched receiver. */
+SPAN_DECLARE(int) fsk_rx_bank_set_channel(fsk_rx_bank_state_t *s, int channel, fsk_rx_state_t *rx);
+
+/*! Process a block of received FSK modem audio samples for all the channels of a
+    receiver bank.
+    \brief Process a block of received FSK modem audio samples for a bank of receivers.
+    \param s The bank context.
+    \param amp An array of pointers to the audio sample buffers, one per channel. The
+           pointer for an idle channel may be NULL.
+    \param len The number of samples in each buffer.
+    \return The number of samples unprocessed.
+*/
+SPAN_DECLARE_NONSTD(int) fsk_rx_bank(fsk_rx_bank_state_t *s, const int16_t *amp[], int len);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -85,5 +85,64 @@ struct async_rx_state_s
     int framing_errors;
 };
 
+/*! The number of octets requested in each call to a chunk transmitter's get_chunk routine */
+#define CHUNK_TX_LEN    8
+
+/*!
+    Chunk transmit descriptor. This defines the state of a single working instance
+    of a converter from chunks of octets to a synchronous serial bit stream, for use
+    in the fast FAX modems.
+*/
+struct chunk_tx_state_s
+{
+    /*! \brief A pointer to the callback routine used to get chunks of data to be transmitted. */
+    get_chunk_func_t get_chunk;
+    /*! \brief An opaque pointer passed when calling get_chunk. */
+    void *user_data;
+    /*! \brief TRUE if the octets are sent LSB first, else MSB first. */
+    int lsb_first;
+
+    /*! \brief The octets from the get_chunk routine waiting to be sent. */
+    uint8_t buf[CHUNK_TX_LEN];
+    /*! \brief The number of octets in buf. */
+    int len;
+    /*! \brief The position of the next octet to be taken from buf. */
+    int ptr;
+    /*! \brief The remaining bits of the octet being sent. */
+    unsigned int octet;
+    /*! \brief The number of bits left in octet. */
+    int bits;
+    /*! \brief TRUE if the get_chunk routine has reported the end of the data. */
+    int ended;
+};
+
+/*! The maximum number of octets passed in one call to a chunk receiver's put_chunk routine */
+#define CHUNK_RX_LEN    64
+
+/*!
+    Chunk receive descriptor. This defines the state of a single working instance
+    of a converter from a synchronous serial bit stream to chunks of octets, for use
+    in the modem receivers.
+*/
+struct chunk_rx_state_s
+{
+    /*! \brief The callback function used to put received data as chunks of octets,
+               or NULL for bit by bit operation. */
+    put_chunk_func_t put_chunk;
+    /*! \brief An opaque pointer passed when calling put_chunk. */
+    void *user_data;
+    /*! \brief TRUE if the received bits are packed into octets LSB first, else MSB first. */
+    int lsb_first;
+
+    /*! \brief The received bits being packed into the next octet. */
+    unsigned int octet;
+    /*! \brief The number of bits in octet. */
+    int bits;
+    /*! \brief The octets waiting to be passed to the put_chunk routine. */
+    uint8_t buf[CHUNK_RX_LEN];
+    /*! \brief The number of octets in buf. */
+    int len;
+};
+
 #endif
 /*- End of file ------------------------------------------------------------*/
@@ -29,8 +29,9 @@
 /*! Bitstream handler state */
 struct bitstream_state_s
 {
-    /*! The bit stream. */
-    uint32_t bitstream;
+    /*! The bit stream. 64 bits gives room for a full 32 bit field on top of
+        any residual bits. */
+    uint64_t bitstream;
     /*! The residual bits in bitstream. */
     int residue;
     /*! TRUE if the stream is LSB first, else MSB first */
@@ -83,6 +83,14 @@ struct fax_modems_state_s
     int current_rx_type;
     /*! \brief The currently select transmitter type */
     int current_tx_type;
+    /*! \brief TRUE if the receiver was last started for a short training sequence */
+    int rx_short_train;
+    /*! \brief TRUE if the receiver was last started for HDLC */
+    int rx_use_hdlc;
+    /*! \brief TRUE if the transmitter was last started for a short training sequence */
+    int tx_short_train;
+    /*! \brief TRUE if the transmitter was last started for HDLC */
+    int tx_use_hdlc;
 
     /*! \brief TRUE if a carrier is present. Otherwise FALSE. */
     int rx_signal_present;
@@ -64,6 +64,9 @@ struct fsk_rx_state_s
     put_bit_func_t put_bit;
     /*! \brief A user specified opaque pointer passed to the put_bit routine. */
     void *put_bit_user_data;
+    /*! \brief The receiver of the data as chunks of octets, rather than bit by bit.
+               Its put_chunk routine is NULL for bit by bit operation. */
+    chunk_rx_state_t chunk;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_tx_status_func_t status_handler;
@@ -94,5 +97,40 @@ struct fsk_rx_state_s
     int scaling_shift;
 };
 
+/*!
+    FSK modem receiver bank descriptor. This defines the state of a bank of FSK
+    receivers, sharing the same FSK specification, whose tone correlators are
+    run side by side.
+*/
+struct fsk_rx_bank_state_s
+{
+    /*! \brief The number of channels in the bank. */
+    int channels;
+    /*! \brief The number of channels, rounded up to a whole number of vectors. */
+    int lanes;
+    /*! \brief The receiver attached to each channel, or NULL for an idle channel. */
+    fsk_rx_state_t **chan;
+
+    /*! \brief The phase rates of the shared quadrature tone generators. */
+    int32_t phase_rate[2];
+    /*! \brief The phase accumulators of the shared quadrature tone generators. */
+    uint32_t phase_acc[2];
+    /*! \brief The correlation period, in samples. */
+    int correlation_span;
+    /*! \brief The down shift which avoids overflow in the correlation. */
+    int scaling_shift;
+    /*! \brief The current position in the sliding correlation windows. */
+    int buf_ptr;
+
+    /*! \brief The sliding correlation windows, indexed by window position, tone,
+               real/imaginary, and channel. */
+    int32_t *window;
+    /*! \brief The sliding dot products, indexed by tone, real/imaginary, and channel. */
+    int32_t *dot;
+    /*! \brief The demodulated bit for each channel, for the current sample. Each byte
+               holds the bits for a group of 4 channels. */
+    uint8_t *baudstate;
+};
+
 #endif
 /*- End of file ------------------------------------------------------------*/
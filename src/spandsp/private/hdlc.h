@@ -103,8 +103,9 @@ struct hdlc_tx_state_s
     /*! \brief Maximum permitted frame length. */
     size_t max_frame_len;
 
-    /*! \brief The stuffed bit stream being created. */
-    uint32_t octets_in_progress;
+    /*! \brief The stuffed bit stream being created. This is wide enough for several
+               stuffed octets to be accumulated before they are output. */
+    uint64_t octets_in_progress;
     /*! \brief The number of bits currently in octets_in_progress. */
     int num_bits;
     /*! \brief The currently rotated state of the flag octet. */
@@ -73,6 +73,11 @@ struct t30_state_s
                page image. FALSE for FAX page headers to add to the overall length of
                the page. */
     int header_overlays_image;
+    /*! \brief TRUE if each following page is to be encoded in the background, while
+               the current one is being sent. */
+    int tx_page_pre_encoding;
+    /*! \brief TRUE if received pages are to be written to the TIFF file in the background. */
+    int rx_page_background_writing;
     /*! \brief TRUE if remote T.30 procedural interrupts are allowed. */
     int remote_interrupts_allowed;
 
@@ -107,6 +112,11 @@ struct t30_state_s
     t30_real_time_frame_handler_t *real_time_frame_handler;
     /*! \brief An opaque pointer supplied in real time frame callbacks. */
     void *real_time_frame_user_data;
+    /*! \brief A pointer to a callback routine to be called when timing events
+        occur. */
+    t30_timing_handler_t *timing_handler;
+    /*! \brief An opaque pointer supplied in timing callbacks. */
+    void *timing_user_data;
 
     /*! \brief A pointer to a callback routine to be called when document events
         (e.g. end of transmitted document) occur. */
@@ -234,8 +244,9 @@ struct t30_state_s
     int receiver_not_ready_count;
     /*! \brief The number of octets to be used per ECM frame. */
     int octets_per_ecm_frame;
-    /*! \brief The ECM partial page buffer. */
-    uint8_t ecm_data[256][260];
+    /*! \brief The ECM partial page buffer. This is drawn from a pool shared by all T.30 contexts,
+               only while ECM image data is being sent or received, and is NULL at other times. */
+    uint8_t (*ecm_data)[260];
     /*! \brief The lengths of the frames in the ECM partial page buffer. */
     int16_t ecm_len[256];
     /*! \brief A bit map of the OK ECM frames, constructed as a PPR frame. */
@@ -279,6 +290,37 @@ struct t30_state_s
     /*! \brief The number of RTN events */
     int rtn_events;
 
+    /*! \brief The time since the start of the call, in samples. */
+    int64_t call_samples;
+    /*! \brief The time at which the current phase began, in samples. */
+    int64_t phase_start_samples;
+    /*! \brief The time at which the current TCF or stretch of page image began, in samples. */
+    int64_t step_start_samples;
+    /*! \brief The time spent in each of phases A to E, in samples. */
+    int64_t phase_samples[5];
+    /*! \brief The time spent on TCF, in samples. */
+    int64_t tcf_samples;
+    /*! \brief The time spent on page images, in samples. */
+    int64_t image_samples;
+    /*! \brief The page number of the page in progress, counting from 1, or zero if no page
+               is in progress. For ECM a page stays in progress across all its partial pages
+               and retransmissions. */
+    int timing_page;
+    /*! \brief The time at which the first page image began, in samples, or -1. */
+    int64_t first_page_samples;
+    /*! \brief The number of TCFs sent or received. */
+    int tcfs;
+    /*! \brief The number of retrains. */
+    int retrains;
+    /*! \brief The number of steps down to a lower speed. */
+    int fallbacks;
+    /*! \brief The number of PPS messages sent or received. */
+    int pps_rounds;
+    /*! \brief The number of PPR messages sent or received. */
+    int pprs;
+    /*! \brief The bit rate of the last DCS received, used to spot the far end falling back. */
+    int last_rx_dcs_bit_rate;
+
     /*! \brief the FCF2 field of the last PPS message we received. */
     uint8_t last_pps_fcf2;
     /*! \brief TRUE if all frames of the current received ECM block are now OK */
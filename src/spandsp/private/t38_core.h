@@ -26,6 +26,52 @@
 #if !defined(_SPANDSP_PRIVATE_T38_CORE_H_)
 #define _SPANDSP_PRIVATE_T38_CORE_H_
 
+/*! The number of IFP packets which may be awaiting repeat transmission at one time */
+#define T38_TX_SCHEDULE_SLOTS           8
+/*! The longest IFP packet which can be held for repeat transmission */
+#define T38_TX_SCHEDULE_MAX_LEN         400
+/*! The number of out of sequence IFP packets which may be held for reordering at one time */
+#define T38_RX_REORDER_SLOTS            8
+/*! The longest IFP packet which can be held for reordering */
+#define T38_RX_REORDER_MAX_LEN          400
+
+/*!
+    An IFP packet awaiting transmission, when batched transmission is in use.
+*/
+typedef struct
+{
+    /*! \brief The IFP packet. */
+    uint8_t buf[T38_TX_SCHEDULE_MAX_LEN];
+    /*! \brief The length of the IFP packet. */
+    int len;
+    /*! \brief The sequence number of the IFP packet. */
+    uint16_t seq_no;
+    /*! \brief The number of copies still to be sent. Zero if the slot is free. */
+    int remaining;
+    /*! \brief The time at which the next copy is due, on the transmit schedule's clock. */
+    uint32_t next_due;
+    /*! \brief The order in which the packets were queued, so packets due at the same time go
+               out in sequence. */
+    unsigned int serial;
+} t38_tx_scheduled_packet_t;
+
+/*!
+    A received IFP packet, held while the packets which should precede it have a chance to
+    arrive.
+*/
+typedef struct
+{
+    /*! \brief The IFP packet. */
+    uint8_t buf[T38_RX_REORDER_MAX_LEN];
+    /*! \brief The length of the IFP packet. Zero if the slot is free. */
+    int len;
+    /*! \brief The sequence number of the IFP packet. */
+    uint16_t seq_no;
+    /*! \brief The time at which we stop waiting for the earlier packets, on the receive
+               clock. */
+    uint32_t deadline;
+} t38_rx_held_packet_t;
+
 /*!
     Core T.38 state, common to all modes of T.38.
 */
@@ -36,6 +82,21 @@ struct t38_core_state_s
     /*! \brief An opaque pointer passed to tx_packet_handler */
     void *tx_packet_user_data;
 
+    /*! \brief Handler routine to transmit batches of datagrams, or NULL if each packet is
+               passed to tx_packet_handler as it is generated. */
+    t38_tx_packet_batch_handler_t *tx_packet_batch_handler;
+    /*! \brief An opaque pointer passed to tx_packet_batch_handler */
+    void *tx_packet_batch_user_data;
+    /*! \brief The interval between copies of a packet, in samples. */
+    int tx_repeat_spacing;
+    /*! \brief The clock for the transmit schedule, in samples. This wraps, so times on it
+               must only be compared through their difference. */
+    uint32_t tx_schedule_samples;
+    /*! \brief The serial number for the next packet queued. */
+    unsigned int tx_schedule_serial;
+    /*! \brief The packets awaiting transmission. */
+    t38_tx_scheduled_packet_t tx_schedule[T38_TX_SCHEDULE_SLOTS];
+
     /*! \brief Handler routine to process received indicator packets */
     t38_rx_indicator_handler_t *rx_indicator_handler;
     /*! \brief Handler routine to process received data packets */
@@ -121,6 +182,18 @@ struct t38_core_state_s
     /*! \brief The bit rate for V.34 operation */
     int v34_rate;
 
+    /*! \brief The longest time an out of sequence packet is held, waiting for the packets
+               which should precede it, in samples. Zero if reordering is disabled. */
+    int rx_reorder_hold;
+    /*! \brief The clock for the reorder buffer, in samples. This wraps, so times on it
+               must only be compared through their difference. */
+    uint32_t rx_reorder_samples;
+    /*! \brief The packets held for reordering. */
+    t38_rx_held_packet_t rx_held[T38_RX_REORDER_SLOTS];
+    /*! \brief A count of the packets which arrived out of sequence, and were put back in
+               order by the reorder buffer. */
+    int reordered_packets;
+
     /*! A count of missing receive packets. This count might not be accurate if the
         received packet numbers jump wildly. */
     int missing_packets;
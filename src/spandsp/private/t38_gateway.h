@@ -145,6 +145,29 @@ typedef struct
     int ecm_allowed;
     /*! \brief Required time between T.38 transmissions, in ms. */
     int ms_per_tx_chunk;
+    /*! \brief TRUE if the packet interval and data redundancy adapt to the network conditions. */
+    int adaptive_packetisation;
+    /*! \brief The number of times each data packet is sent, as chosen by adaptive
+               packetisation. */
+    int data_tx_count;
+    /*! \brief The application's redundancy setting for control data, saved while adaptive
+               packetisation is in use. Only its low byte is a copy count. */
+    int host_control_data_tx_count;
+    /*! \brief The application's redundancy setting for image data, saved while adaptive
+               packetisation is in use. Only its low byte is a copy count. */
+    int host_image_data_tx_count;
+    /*! \brief The packet loss reported by the application, in per cent. */
+    int reported_loss;
+    /*! \brief The one way network delay reported by the application, in ms, or -1 if unknown. */
+    int reported_delay;
+    /*! \brief The packet loss measured from the T.38 core's missing packet count, in per cent. */
+    int measured_loss;
+    /*! \brief The expected sequence number at the start of the current loss measurement, or
+               -1 if no measurement has started. */
+    int loss_sample_seq_no;
+    /*! \brief The T.38 core's missing packet count at the start of the current loss
+               measurement. */
+    int loss_sample_missing;
 
     /*! \brief TRUE if in image data modem is to use short training. This usually
                follows image_data_mode, but in ECM mode T.30 defines recovery
@@ -0,0 +1,59 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/t4_page_buffer.h - Chunked buffers for T.4 FAX page images
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_T4_PAGE_BUFFER_H_)
+#define _SPANDSP_PRIVATE_T4_PAGE_BUFFER_H_
+
+/*!
+    T.4 page image buffer descriptor.
+*/
+struct t4_page_buffer_s
+{
+    /*! \brief The chunks holding the page, in order. */
+    uint8_t **chunks;
+    /*! \brief The number of chunks currently held. */
+    int chunks_held;
+    /*! \brief The number of entries in the chunks array. */
+    int chunk_slots;
+};
+
+/*! \brief Get a pointer to a byte in a T.4 page buffer. The byte must already be
+           within the buffer. */
+static __inline__ uint8_t *t4_page_buffer_byte(t4_page_buffer_t *s, int offset)
+{
+    return &s->chunks[offset >> T4_PAGE_BUFFER_CHUNK_SHIFT][offset & (T4_PAGE_BUFFER_CHUNK_SIZE - 1)];
+}
+/*- End of function --------------------------------------------------------*/
+
+/*! \brief Get the amount of memory held by a T.4 page buffer, including the chunks it
+           has drawn from the pool. */
+static __inline__ int t4_page_buffer_allocated_memory(t4_page_buffer_t *s)
+{
+    return s->chunks_held*T4_PAGE_BUFFER_CHUNK_SIZE + s->chunk_slots*sizeof(s->chunks[0]);
+}
+/*- End of function --------------------------------------------------------*/
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -40,6 +40,11 @@ struct t4_t6_decode_state_s
     t4_row_write_handler_t row_write_handler;
     /*! \brief Opaque pointer passed to row_write_handler. */
     void *row_write_user_data;
+    /*! \brief Callback function to take each decoded row as a list of run lengths, instead
+               of a row of pixels. A NULL list means the row is a repeat of the previous one. */
+    int (*row_runs_handler)(void *user_data, const uint32_t runs[], int len);
+    /*! \brief Opaque pointer passed to row_runs_handler. */
+    void *row_runs_user_data;
 
     /*! \brief A pointer into the image buffer indicating where the last row begins */
     int last_row_starts_at;
@@ -55,10 +55,9 @@ struct t4_state_s
     int bytes_per_row;
     /*! \brief The size of the image in the image buffer, in bytes. */
     int image_size;
-    /*! \brief The current size of the image buffer. */
-    int image_buffer_size;
-    /*! \brief A point to the image buffer. */
-    uint8_t *image_buffer;
+    /*! \brief The image buffer. This holds the uncompressed rows of a page being received,
+               or the compressed image of a page being sent. */
+    t4_page_buffer_t image;
 
     /*! \brief The number of pages transferred to date. */
     int current_page;
@@ -105,6 +104,37 @@ struct t4_state_s
     t4_tiff_state_t tiff;
     t4_t6_decode_state_t t4_t6_rx;
     t4_t6_encode_state_t t4_t6_tx;
+#if defined(SPANDSP_SUPPORT_T85)
+    /*! \brief T.85 decoder state, used while a T.85 page is being received. */
+    t85_decode_state_t t85_rx;
+    /*! \brief T.85 encoder state, used while a T.85 page is being encoded. */
+    t85_encode_state_t t85_tx;
+#endif
+
+    /*! \brief The background encoder for the next page, or NULL if pages are being
+               encoded as they start. */
+    struct t4_tx_pre_encoder_s *pre_encoder;
+    /*! \brief The background writer for received pages, or NULL if pages are written
+               to the TIFF file as they end. */
+    struct t4_rx_tiff_writer_s *tiff_writer;
+};
+
+/*!
+    T.4 transcoder descriptor.
+*/
+struct t4_transcoder_state_s
+{
+    /*! \brief The decoder for the incoming data. Rows are taken from it as lists of
+               run lengths, so it never builds a bitmap of the page. */
+    t4_state_t rx;
+    /*! \brief The encoder for the outgoing data. Only the current and reference rows'
+               changing elements are held, and the output is passed on as each row is
+               encoded. */
+    t4_state_t tx;
+    /*! \brief The callback routine which takes the transcoded data. */
+    t4_transcoder_output_handler_t handler;
+    /*! \brief An opaque pointer passed to the handler. */
+    void *user_data;
 };
 
 #endif
@@ -0,0 +1,83 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/t81_t82_arith_coding.h - ITU T.81 and T.82 QM-coder arithmetic
+ *                                  encoding and decoding
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_T81_T82_ARITH_CODING_H_)
+#define _SPANDSP_PRIVATE_T81_T82_ARITH_CODING_H_
+
+/*!
+    T.81 and T.82 QM-coder arithmetic encoder state.
+*/
+struct t81_t82_arith_encode_state_s
+{
+    /*! \brief The probability estimation state, and the more probable symbol in the
+               top bit, for each context. */
+    uint8_t st[T81_T82_ARITH_CODING_CONTEXTS];
+    /*! \brief The C register. */
+    uint32_t c;
+    /*! \brief The A register. */
+    uint32_t a;
+    /*! \brief The number of 0xFF bytes held back, in case a carry turns them into 0x00. */
+    int32_t sc;
+    /*! \brief The bit shift counter, which determines when the next byte will be output. */
+    int ct;
+    /*! \brief The byte held back, in case a carry reaches it, or -1 for none. */
+    int buffer;
+
+    /*! \brief Callback function for the output bytes. */
+    t81_t82_arith_encode_output_handler_t output_byte_handler;
+    /*! \brief Opaque pointer passed to output_byte_handler. */
+    void *user_data;
+};
+
+/*!
+    T.81 and T.82 QM-coder arithmetic decoder state.
+*/
+struct t81_t82_arith_decode_state_s
+{
+    /*! \brief The probability estimation state, and the more probable symbol in the
+               top bit, for each context. */
+    uint8_t st[T81_T82_ARITH_CODING_CONTEXTS];
+    /*! \brief The C register. */
+    uint32_t c;
+    /*! \brief The A register. */
+    uint32_t a;
+    /*! \brief The bit shift counter, or -1 once a marker has been reached and zero
+               padding is being fed in. */
+    int ct;
+    /*! \brief TRUE while the registers are being filled at the start of decoding. */
+    int startup;
+    /*! \brief TRUE if a marker should be reported, rather than silently padded with
+               zeros. This is cleared when a marker is reported. */
+    int nopadding;
+
+    /*! \brief The next byte of coded data to be decoded. */
+    const uint8_t *pscd_ptr;
+    /*! \brief The end of the available coded data. */
+    const uint8_t *pscd_end;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
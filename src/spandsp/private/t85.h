@@ -0,0 +1,168 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/t85.h - ITU T.85 JBIG for FAX image processing
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_T85_H_)
+#define _SPANDSP_PRIVATE_T85_H_
+
+/*! The size of the staging buffer for incoming T.85 data. This must hold the longest
+    item which is parsed as a whole - the 20 byte image header. */
+#define T85_DECODE_BUFFER_SIZE      256
+
+/*! The maximum number of AT moves which may be queued for a stripe */
+#define T85_MAX_AT_MOVES            4
+
+/*!
+    T.85 encoder state.
+*/
+struct t85_encode_state_s
+{
+    /*! \brief The arithmetic encoder. */
+    t81_t82_arith_encode_state_t s;
+
+    /*! \brief Callback function for the output bytes. */
+    t81_t82_arith_encode_output_handler_t output_byte_handler;
+    /*! \brief Opaque pointer passed to output_byte_handler. */
+    void *user_data;
+
+    /*! \brief The width of the image, in pixels. */
+    uint32_t xd;
+    /*! \brief The length of the image, in rows, as declared in the image header. */
+    uint32_t yd;
+    /*! \brief The number of rows in each stripe. */
+    uint32_t l0;
+    /*! \brief The maximum horizontal offset of the AT pixel. */
+    int mx;
+    /*! \brief The T.82 options in use. */
+    int options;
+
+    /*! \brief The number of rows encoded so far. */
+    uint32_t y;
+    /*! \brief The number of rows encoded so far in the current stripe. */
+    uint32_t i;
+    /*! \brief TRUE if the previous row was typical (i.e. the same as the one above it). */
+    int ltp_old;
+    /*! \brief TRUE once the image header has been output. */
+    int header_sent;
+    /*! \brief TRUE once the image has been completed. */
+    int complete;
+
+    /*! \brief The number of bytes in each row. */
+    int bytes_per_row;
+    /*! \brief The buffer holding the three rows used for context formation. */
+    uint8_t *row_buf;
+    /*! \brief The row being encoded. */
+    uint8_t *cur_row;
+    /*! \brief The row above the one being encoded. */
+    uint8_t *prev_row;
+    /*! \brief The row two above the one being encoded. */
+    uint8_t *prev_row2;
+};
+
+/*!
+    T.85 decoder state.
+*/
+struct t85_decode_state_s
+{
+    /*! \brief The arithmetic decoder. */
+    t81_t82_arith_decode_state_t s;
+
+    /*! \brief Callback function to write a row of pixels to the image destination. */
+    t4_row_write_handler_t row_write_handler;
+    /*! \brief Opaque pointer passed to row_write_handler. */
+    void *row_write_user_data;
+
+    /*! \brief The current stage of parsing the incoming data. */
+    int state;
+    /*! \brief The staging buffer for incoming data. */
+    uint8_t buffer[T85_DECODE_BUFFER_SIZE];
+    /*! \brief The number of bytes in the staging buffer. */
+    int buf_len;
+    /*! \brief The next byte to be used from the staging buffer. */
+    int buf_ptr;
+    /*! \brief The number of bytes of comment still to be skipped. */
+    uint32_t comment_skip;
+
+    /*! \brief The maximum image width accepted, or 0 for no limit. */
+    uint32_t max_xd;
+    /*! \brief The maximum image length accepted, or 0 for no limit. */
+    uint32_t max_yd;
+
+    /*! \brief The width of the image, in pixels. */
+    uint32_t xd;
+    /*! \brief The length of the image, in rows. */
+    uint32_t yd;
+    /*! \brief The number of rows in each stripe. */
+    uint32_t l0;
+    /*! \brief The maximum horizontal offset of the AT pixel. */
+    int mx;
+    /*! \brief The T.82 options in use. */
+    int options;
+
+    /*! \brief The number of rows decoded so far. */
+    uint32_t y;
+    /*! \brief The number of rows decoded so far in the current stripe. */
+    uint32_t i;
+    /*! \brief The next pixel to be decoded in the current row. */
+    uint32_t x;
+    /*! \brief TRUE once the start of the current row has been processed. */
+    int row_started;
+    /*! \brief TRUE if the previous row was typical (i.e. the same as the one above it). */
+    int ltp_old;
+    /*! \brief Context bits from the row being decoded. */
+    uint32_t r1;
+    /*! \brief Context bits from the row above. */
+    uint32_t r2;
+    /*! \brief Context bits from the row two above. */
+    uint32_t r3;
+    /*! \brief The current horizontal offset of the AT pixel, or 0 for its default position. */
+    int tx;
+    /*! \brief The rows, counted from the start of the stripe, at which queued AT moves take effect. */
+    uint32_t at_row[T85_MAX_AT_MOVES];
+    /*! \brief The horizontal offsets of the queued AT moves. */
+    int at_tx[T85_MAX_AT_MOVES];
+    /*! \brief The number of queued AT moves. */
+    int at_moves;
+    /*! \brief TRUE if the next stripe follows an SDRST marker. */
+    int reset;
+    /*! \brief TRUE if we must check the marker which ended the coded data, before zero
+               padding the current stripe. */
+    int marker_peek;
+    /*! \brief TRUE if a NEWLEN marker is known to follow the current stripe. */
+    int newlen_pending;
+
+    /*! \brief The number of bytes in each row. */
+    int bytes_per_row;
+    /*! \brief The buffer holding the three rows used for context formation. */
+    uint8_t *row_buf;
+    /*! \brief The row being decoded. */
+    uint8_t *cur_row;
+    /*! \brief The row above the one being decoded. */
+    uint8_t *prev_row;
+    /*! \brief The row two above the one being decoded. */
+    uint8_t *prev_row2;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
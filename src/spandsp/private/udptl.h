@@ -0,0 +1,103 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * private/udptl.h - An implementation of the UDPTL protocol defined in T.38,
+ *                   less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#if !defined(_SPANDSP_PRIVATE_UDPTL_H_)
+#define _SPANDSP_PRIVATE_UDPTL_H_
+
+/*! The mask used to map sequence numbers to entries in the history buffers. The
+    history must be at least as long as the largest span of redundancy or FEC we
+    might need to work with. */
+#define UDPTL_BUF_MASK              15
+
+/*! The history buffer entry for a transmitted IFP packet. */
+typedef struct
+{
+    /*! \brief The length of the IFP packet, or -1 if the entry is empty. */
+    int buf_len;
+    /*! \brief The IFP packet. */
+    uint8_t buf[UDPTL_MAX_IFP_LEN];
+} udptl_fec_tx_buffer_t;
+
+/*! The history buffer entry for a received IFP packet, and any FEC data which arrived
+    with it. */
+typedef struct
+{
+    /*! \brief The length of the IFP packet, or -1 if it has not been received. */
+    int buf_len;
+    /*! \brief The IFP packet. */
+    uint8_t buf[UDPTL_MAX_IFP_LEN];
+    /*! \brief The lengths of the FEC entries which arrived with the packet. */
+    int fec_len[UDPTL_MAX_FEC_ENTRIES];
+    /*! \brief The FEC entries which arrived with the packet. */
+    uint8_t fec[UDPTL_MAX_FEC_ENTRIES][UDPTL_MAX_IFP_LEN];
+    /*! \brief The span of the FEC entries. */
+    int fec_span;
+    /*! \brief The number of FEC entries. */
+    int fec_entries;
+} udptl_fec_rx_buffer_t;
+
+/*!
+    UDPTL state.
+*/
+struct udptl_state_s
+{
+    /*! \brief Handler routine for the IFP packets received, or recovered, from UDPTL packets. */
+    udptl_rx_packet_handler_t *rx_packet_handler;
+    /*! \brief An opaque pointer passed to rx_packet_handler. */
+    void *user_data;
+
+    /*! \brief The error correction scheme used in transmitted UDPTL packets. */
+    int error_correction_scheme;
+    /*! \brief The number of error correction entries transmitted in UDPTL packets. */
+    int error_correction_entries;
+    /*! \brief The span of the error correction entries in transmitted UDPTL packets
+               (FEC only). */
+    int error_correction_span;
+
+    /*! \brief The maximum size of a datagram that can be accepted by the remote device. */
+    int far_max_datagram_size;
+    /*! \brief The maximum size of a datagram that we are prepared to accept. */
+    int local_max_datagram_size;
+
+    /*! \brief The sequence number of the next UDPTL packet to be transmitted. */
+    int tx_seq_no;
+    /*! \brief The sequence number of the next UDPTL packet expected, or -1 if no packets
+               have been received yet. */
+    int rx_seq_no;
+
+    /*! \brief The history of transmitted IFP packets, from which redundancy and FEC
+               entries are built. */
+    udptl_fec_tx_buffer_t tx[UDPTL_BUF_MASK + 1];
+    /*! \brief The history of received IFP packets, and FEC entries, from which lost
+               packets are recovered. */
+    udptl_fec_rx_buffer_t rx[UDPTL_BUF_MASK + 1];
+
+    /*! \brief Error and flow logging control */
+    logging_state_t logging;
+};
+
+#endif
+/*- End of file ------------------------------------------------------------*/
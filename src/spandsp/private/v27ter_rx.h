@@ -56,6 +56,9 @@ struct v27ter_rx_state_s
     put_bit_func_t put_bit;
     /*! \brief A user specified opaque pointer passed to the put_bit routine. */
     void *put_bit_user_data;
+    /*! \brief The receiver of the data as chunks of octets, rather than bit by bit.
+               Its put_chunk routine is NULL for bit by bit operation. */
+    chunk_rx_state_t chunk;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_rx_status_func_t status_handler;
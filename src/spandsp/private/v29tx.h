@@ -41,6 +41,9 @@ struct v29_tx_state_s
     get_bit_func_t get_bit;
     /*! \brief A user specified opaque pointer passed to the get_bit function. */
     void *get_bit_user_data;
+    /*! \brief The source of the data to be transmitted as chunks of octets, rather than
+               bit by bit. Its get_chunk routine is NULL for bit by bit operation. */
+    chunk_tx_state_t chunk;
 
     /*! \brief The callback function used to report modem status changes. */
     modem_tx_status_func_t status_handler;
@@ -90,6 +93,12 @@ struct v29_tx_state_s
     int constellation_state;
     /*! \brief The get_bit function in use at any instant. */
     get_bit_func_t current_get_bit;
+    /*! \brief TRUE if training should be replayed from the shared precomputed waveforms. */
+    int use_training_cache;
+    /*! \brief The precomputed training waveform currently being replayed, or NULL. */
+    const struct v29_tx_training_cache_s *training_cache;
+    /*! \brief The current position in the precomputed training waveform. */
+    int training_cache_pos;
     /*! \brief Error and flow logging control */
     logging_state_t logging;
 };
@@ -223,6 +223,47 @@ typedef void (t30_set_handler_t)(void *user_data, int type, int bit_rate, int sh
 */
 typedef void (t30_send_hdlc_handler_t)(void *user_data, const uint8_t msg[], int len);
 
+/*!
+    T.30 timing event codes, reported to a timing handler.
+*/
+enum
+{
+    /*! The T.30 phase has changed. The value is the new phase. */
+    T30_TIMING_PHASE = 0,
+    /*! A control frame has been sent. The value is its FCF. */
+    T30_TIMING_FRAME_TX,
+    /*! A control frame has been received. The value is its FCF. */
+    T30_TIMING_FRAME_RX,
+    /*! A TCF has started, being sent or received. The value is the bit rate. */
+    T30_TIMING_TCF_START,
+    /*! A TCF has ended. The value is the bit rate. */
+    T30_TIMING_TCF_END,
+    /*! Image data for a page has started, being sent or received. This happens once per
+        page, and not for each ECM partial page, or retransmission. The value is the page
+        number, counting from 1. */
+    T30_TIMING_PAGE_START,
+    /*! A page has been completed, or abandoned. The value is the page number, counting
+        from 1. */
+    T30_TIMING_PAGE_END,
+    /*! A retrain has been requested, by an FTT or RTN sent or received. The value is the
+        bit rate which failed. */
+    T30_TIMING_RETRAIN,
+    /*! The image modem has fallen back to a lower speed. The value is the new bit rate. */
+    T30_TIMING_FALLBACK
+};
+
+/*!
+    T.30 timing handler. This is called as each significant step in a call occurs, so the
+    time a call spends in each step can be measured.
+    \brief T.30 timing handler.
+    \param s The T.30 context.
+    \param user_data An opaque pointer.
+    \param event The timing event code.
+    \param when The time since the start of the call, in milliseconds.
+    \param value A value whose meaning depends on the event code.
+*/
+typedef void (t30_timing_handler_t)(t30_state_t *s, void *user_data, int event, int when, int value);
+
 /*!
     T.30 protocol completion codes, at phase E.
 */
@@ -555,6 +596,57 @@ typedef struct
 #endif
 } t30_stats_t;
 
+/*!
+    A summary of where the time went in a T.30 call. All times are in milliseconds.
+*/
+typedef struct
+{
+    /*! \brief The time since the start of the call. */
+    int call_time;
+    /*! \brief The time spent in phase A - call set up. */
+    int phase_a_time;
+    /*! \brief The time spent in phase B - pre-message procedure, including TCF. */
+    int phase_b_time;
+    /*! \brief The time spent in phase C - message transmission. */
+    int phase_c_time;
+    /*! \brief The time spent in phase D - post-message procedure. */
+    int phase_d_time;
+    /*! \brief The time spent in phase E - call release. */
+    int phase_e_time;
+    /*! \brief The time spent sending or receiving TCF. */
+    int tcf_time;
+    /*! \brief The time spent sending or receiving page image data. */
+    int image_time;
+    /*! \brief The time from the start of the call to the start of the first page image,
+               or -1 if no image has started. */
+    int first_page_time;
+    /*! \brief The number of TCFs sent or received. */
+    int tcfs;
+    /*! \brief The number of retrains - FTT or RTN sent or received. */
+    int retrains;
+    /*! \brief The number of steps down to a lower speed. */
+    int fallbacks;
+    /*! \brief The number of PPS messages sent or received, in ECM mode. */
+    int pps_rounds;
+    /*! \brief The number of PPR messages sent or received, in ECM mode. */
+    int pprs;
+} t30_timing_stats_t;
+
+/*!
+    Statistics for the pool of ECM partial page buffers shared by all T.30 contexts.
+*/
+typedef struct
+{
+    /*! \brief The size of each buffer, in bytes. */
+    int buffer_size;
+    /*! \brief The number of buffers allocated from the heap. */
+    int buffers_allocated;
+    /*! \brief The number of buffers currently held by T.30 contexts. */
+    int buffers_in_use;
+    /*! \brief The largest number of buffers which have been in use at one time. */
+    int peak_buffers_in_use;
+} t30_ecm_pool_stats_t;
+
 #if defined(__cplusplus)
 extern "C"
 {
@@ -670,12 +762,49 @@ SPAN_DECLARE_NONSTD(void) t30_hdlc_accept(void *user_data, const uint8_t msg[],
     \param samples The time change in 1/8000th second steps. */
 SPAN_DECLARE(void) t30_timer_update(t30_state_t *s, int samples);
 
+/*! Find how long it will be until the next T.30 timer expires, so a host need only report
+    the passage of time when something is due to happen.
+    \brief Find the time until the next T.30 timer expires.
+    \param s The T.30 context.
+    \return The time until the next timer expires, in 1/8000th second steps, or -1 if no
+            timer is running. */
+SPAN_DECLARE(int) t30_next_timer_expiry(t30_state_t *s);
+
 /*! Get the current transfer statistics for the file being sent or received.
     \brief Get the current transfer statistics.
     \param s The T.30 context.
     \param t A pointer to a buffer for the statistics. */
 SPAN_DECLARE(void) t30_get_transfer_statistics(t30_state_t *s, t30_stats_t *t);
 
+/*! Get a summary of where the time has gone in the current call, so far. This may be
+    called at any time, including from the phase E handler.
+    \brief Get a summary of the timing of the current call.
+    \param s The T.30 context.
+    \param t A pointer to a buffer for the timing summary. */
+SPAN_DECLARE(void) t30_get_timing_statistics(t30_state_t *s, t30_timing_stats_t *t);
+
+/*! Get the amount of memory a T.30 context is currently holding, beyond the context
+    itself. This is the ECM partial page buffer, while ECM image data is in transit,
+    and the page image of any document being sent or received.
+    \brief Get the amount of memory a T.30 context is holding.
+    \param s The T.30 context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) t30_get_allocated_memory(t30_state_t *s);
+
+/*! Get the statistics for the pool of ECM partial page buffers shared by all T.30 contexts.
+    The pool is only used where spandsp is built with thread support, so it can be locked.
+    Without thread support each context allocates and frees its own buffer, and the
+    statistics all read zero, apart from the buffer size.
+    \brief Get the ECM buffer pool statistics.
+    \param stats The statistics. */
+SPAN_DECLARE(void) t30_ecm_pool_get_stats(t30_ecm_pool_stats_t *stats);
+
+/*! Return the ECM partial page buffers which are not currently in use to the heap.
+    \brief Trim the ECM buffer pool.
+    \return The number of buffers freed. This is always zero without thread support, as
+            there is then no pool. */
+SPAN_DECLARE(int) t30_ecm_pool_trim(void);
+
 /*! Request a local interrupt of FAX exchange.
     \brief Request a local interrupt of FAX exchange.
     \param s The T.30 context.
@@ -380,6 +380,26 @@ SPAN_DECLARE(int) t30_set_tx_page_header_info(t30_state_t *s, const char *info);
     \return 0 for OK, else -1. */
 SPAN_DECLARE(int) t30_set_tx_page_header_tz(t30_state_t *s, const char *tzstring);
 
+/*! Set whether each following page of a document being sent is encoded in the background,
+    while the current one is being sent. This avoids stalling the caller of the T.30 context
+    while each new page is encoded. If a document is being sent the setting applies to its
+    remaining pages. Otherwise it takes effect from the next document sent.
+    \brief Set background encoding of the pages being sent.
+    \param s The T.30 context.
+    \param pre_encode TRUE to encode pages in the background.
+    \return 0 for OK, else -1. Background encoding is not available if the library was built
+            without thread support, or if it could not be started for the document being sent. */
+SPAN_DECLARE(int) t30_set_tx_page_pre_encoding(t30_state_t *s, int pre_encode);
+
+/*! Set whether the pages of a document being received are written to the TIFF file in the
+    background. This avoids stalling the caller of the T.30 context while each page is written.
+    The setting takes effect from the next document received.
+    \brief Set background writing of the pages being received.
+    \param s The T.30 context.
+    \param background TRUE to write pages in the background.
+    \return 0 for OK, else -1. */
+SPAN_DECLARE(int) t30_set_rx_page_background_writing(t30_state_t *s, int background);
+
 /*! Get the header information associated with a T.30 context.
     \brief Get the header information associated with a T.30 context.
     \param s The T.30 context.
@@ -538,6 +558,15 @@ SPAN_DECLARE(void) t30_set_document_handler(t30_state_t *s, t30_document_handler
     \param user_data An opaque pointer passed to the callback function. */
 SPAN_DECLARE(void) t30_set_real_time_frame_handler(t30_state_t *s, t30_real_time_frame_handler_t *handler, void *user_data);
 
+/*! Set a callback function for T.30 timing events, such as phase changes, control frames,
+    TCF, page images, retrains and fallbacks. This is called from the heart of the signal
+    processing, so don't take too long in the handler routine.
+    \brief Set a callback function for T.30 timing events.
+    \param s The T.30 context.
+    \param handler The callback function.
+    \param user_data An opaque pointer passed to the callback function. */
+SPAN_DECLARE(void) t30_set_timing_handler(t30_state_t *s, t30_timing_handler_t *handler, void *user_data);
+
 /*! Get a pointer to the logging context associated with a T.30 context.
     \brief Get a pointer to the logging context associated with a T.30 context.
     \param s The T.30 context.
@@ -202,6 +202,22 @@ typedef struct t38_core_state_s t38_core_state_t;
 
 typedef int (t38_tx_packet_handler_t)(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count);
 
+/*! A datagram passed to a batched transmit handler. */
+typedef struct
+{
+    /*! \brief The IFP packet. */
+    const uint8_t *buf;
+    /*! \brief The length of the IFP packet. */
+    int len;
+    /*! \brief The sequence number of the IFP packet. */
+    uint16_t seq_no;
+    /*! \brief The time, in samples from the start of the current tick, at which the
+               datagram should be sent. */
+    int offset;
+} t38_tx_datagram_t;
+
+typedef int (t38_tx_packet_batch_handler_t)(t38_core_state_t *s, void *user_data, const t38_tx_datagram_t datagrams[], int count);
+
 typedef int (t38_rx_indicator_handler_t)(t38_core_state_t *s, void *user_data, int indicator);
 typedef int (t38_rx_data_handler_t)(t38_core_state_t *s, void *user_data, int data_type, int field_type, const uint8_t *buf, int len);
 typedef int (t38_rx_missing_handler_t)(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no);
@@ -356,12 +372,59 @@ SPAN_DECLARE(void) t38_set_t38_version(t38_core_state_t *s, int t38_version);
 */
 SPAN_DECLARE(void) t38_set_sequence_number_handling(t38_core_state_t *s, int check);
 
+/*! Set the time for which an out of sequence received packet may be held, waiting for the
+    packets which should precede it. Packets which arrive late, but within this time, are
+    put back in order, instead of being treated as lost. The hold time is measured by the
+    calls to t38_core_timer_update(). Reordering only occurs when sequence numbers are being
+    checked.
+    \param s The T.38 context.
+    \param samples The hold time, in samples. Zero disables reordering, which is the default.
+*/
+SPAN_DECLARE(void) t38_set_rx_reorder_hold_time(t38_core_state_t *s, int samples);
+
 /*! Set the TEP handling option.
     \param s The T.38 context.
     \param allow_for_tep TRUE to allow for TEP playout, else FALSE.
 */
 SPAN_DECLARE(void) t38_set_tep_handling(t38_core_state_t *s, int allow_for_tep);
 
+/*! \brief Select batched transmission of IFP packets. Rather than passing each packet to
+           the transmit handler once, with a count of the number of times it should be sent,
+           the T.38 context holds the repeats itself. Each call to t38_core_send_scheduled()
+           then passes every datagram due in that tick to the batch handler, in a single call,
+           so the application can send them with a single vectored system call.
+    \param s The T.38 context.
+    \param handler The batched transmit handler, or NULL to return to calling the ordinary
+           transmit handler for each packet.
+    \param user_data An opaque pointer passed to the handler.
+    \param repeat_spacing The interval between copies of a packet, in samples. Zero sends all
+           the copies in the same tick. */
+SPAN_DECLARE(void) t38_core_set_tx_packet_batch_handler(t38_core_state_t *s,
+                                                        t38_tx_packet_batch_handler_t *handler,
+                                                        void *user_data,
+                                                        int repeat_spacing);
+
+/*! \brief Pass all the datagrams due in the next tick to the batched transmit handler.
+    \param s The T.38 context.
+    \param samples The length of the tick, in samples.
+    \return The number of datagrams sent. */
+SPAN_DECLARE(int) t38_core_send_scheduled(t38_core_state_t *s, int samples);
+
+/*! \brief Advance the timing of a T.38 context by one tick. Any held received packets whose
+           hold time has expired are processed, and any datagrams due are passed to the
+           batched transmit handler. The terminal and gateway modules call this once per tick,
+           from their timing routines, so an application using those modules need not call it.
+    \param s The T.38 context.
+    \param samples The length of the tick, in samples.
+    \return The number of datagrams sent. */
+SPAN_DECLARE(int) t38_core_timer_update(t38_core_state_t *s, int samples);
+
+/*! \brief Find how long it will be until t38_core_timer_update() next has something to do,
+           either releasing a held received packet, or sending a scheduled datagram.
+    \param s The T.38 context.
+    \return The time until the next action is due, in samples, or -1 if nothing is pending. */
+SPAN_DECLARE(int) t38_core_next_timer_expiry(t38_core_state_t *s);
+
 /*! Get a pointer to the logging context associated with a T.38 context.
     \brief Get a pointer to the logging context associated with a T.38 context.
     \param s The T.38 context.
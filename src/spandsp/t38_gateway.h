@@ -183,6 +183,31 @@ SPAN_DECLARE(void) t38_gateway_set_tep_mode(t38_gateway_state_t *s, int use_tep)
 */
 SPAN_DECLARE(void) t38_gateway_set_fill_bit_removal(t38_gateway_state_t *s, int remove);
 
+/*! Select whether the packetisation of data sent to the T.38 channel adapts to the network
+    conditions. When it does, the packet interval for image data is lengthened, to reduce
+    the packet rate, as far as the network delay allows, and data packets are sent more than
+    once when the packet loss becomes significant. The conditions are taken from
+    t38_gateway_report_network_conditions(), and the loss is also measured from the gaps in
+    the received packet sequence. Changes take effect at the start of each modem burst.
+    The redundancy set for control and image data with t38_set_redundancy_control() when
+    adaptation is turned on is the least adaptation will use, and is put back when
+    adaptation is turned off. Changes made to those settings while adaptation is on may be
+    overwritten.
+    \brief Select adaptive packetisation.
+    \param s The T.38 context.
+    \param adaptive TRUE to adapt the packetisation, FALSE to use fixed packetisation.
+*/
+SPAN_DECLARE(void) t38_gateway_set_adaptive_packetisation(t38_gateway_state_t *s, int adaptive);
+
+/*! Report the current network conditions, as seen by the application, for use by adaptive
+    packetisation.
+    \brief Report the current network conditions.
+    \param s The T.38 context.
+    \param loss The packet loss, in per cent.
+    \param delay The one way delay, in ms, or -1 if unknown.
+*/
+SPAN_DECLARE(void) t38_gateway_report_network_conditions(t38_gateway_state_t *s, int loss, int delay);
+
 /*! Get the current transfer statistics for the current T.38 session.
     \brief Get the current transfer statistics.
     \param s The T.38 context.
@@ -205,6 +230,36 @@ SPAN_DECLARE(t38_core_state_t *) t38_gateway_get_t38_core_state(t38_gateway_stat
 */
 SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_t *s);
 
+/*! Get the amount of memory a T.38 gateway context is using.
+    \brief Get the amount of memory a T.38 gateway context is using.
+    \param s The T.38 context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) t38_gateway_get_memory_footprint(t38_gateway_state_t *s);
+
+/*! Save the complete state of a T.38 gateway context, part way through a call, so the
+    call can be carried on by another context with t38_gateway_restore(). No code or data
+    addresses are held in the checkpoint, so any process running the same version of the
+    library, on the same kind of machine, can restore it.
+    \brief Save the state of a T.38 gateway context.
+    \param s The T.38 context.
+    \param buf The buffer for the checkpoint, or NULL to find the length needed.
+    \param max_len The length of the buffer.
+    \return The length of the checkpoint, or -1 if it will not fit in the buffer. */
+SPAN_DECLARE(int) t38_gateway_checkpoint(t38_gateway_state_t *s, uint8_t buf[], int max_len);
+
+/*! Carry on a call from a checkpoint written by t38_gateway_checkpoint(). The context
+    must be freshly initialised, and set up in the same way as the one the checkpoint was
+    taken from. Its handlers and settings are kept, and the state of the call comes from
+    the checkpoint. The handlers the call itself was using at the time are rebuilt from
+    that state.
+    \brief Restore the state of a T.38 gateway context.
+    \param s The T.38 context.
+    \param buf The checkpoint.
+    \param len The length of the checkpoint.
+    \return 0 for OK, or -1 for a bad checkpoint, or one from a different version of
+            the library. After a failure the context can only be freed. */
+SPAN_DECLARE(int) t38_gateway_restore(t38_gateway_state_t *s, const uint8_t buf[], int len);
+
 /*! Set a callback function for T.30 frame exchange monitoring. This is called from the heart
     of the signal processing, so don't take too long in the handler routine.
     \brief Set a callback function for T.30 frame exchange monitoring.
@@ -126,6 +126,23 @@ SPAN_DECLARE(void) t38_non_ecm_buffer_report_output_status(t38_non_ecm_buffer_st
     \return The next bit, or one of the values indicating a change of modem status. */
 SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data);
 
+/*! \brief Get the next octet of data from a T.38 rate adapting non-ECM buffer context.
+           The octet is sent MSB first, as the bits from t38_non_ecm_buffer_get_bit() are.
+           Bit and octet operation should not be mixed within a transmission.
+    \param user_data The buffer context, cast to a void pointer.
+    \return The next octet, or SIG_STATUS_END_OF_DATA when the data is complete. */
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_byte(void *user_data);
+
+/*! \brief Get a chunk of data from a T.38 rate adapting non-ECM buffer context. Any
+           shortfall in the buffered data is made up with flow control fill octets, exactly as
+           t38_non_ecm_buffer_get_bit() would insert them, so a full chunk is always returned
+           until the data is complete.
+    \param user_data The buffer context, cast to a void pointer.
+    \param buf The buffer for the chunk.
+    \param max_len The maximum length of the chunk.
+    \return The length of the chunk. This is less than max_len only at the end of the data. */
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_chunk(void *user_data, uint8_t buf[], int max_len);
+
 #if defined(__cplusplus)
 }
 #endif
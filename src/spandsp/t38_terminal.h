@@ -57,8 +57,28 @@ extern "C"
 {
 #endif
 
+/*! Report the passage of time to a T.38 terminal, and send anything which is due.
+    \brief Report the passage of time to a T.38 terminal.
+    \param s The T.38 context.
+    \param samples The time change in 1/8000th second steps.
+    \return TRUE if the call has finished, else FALSE. */
 SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples);
 
+/*! Find how long it will be until a T.38 terminal next needs t38_terminal_send_timeout() to
+    be called. A host running many sessions can sleep until then, instead of calling
+    t38_terminal_send_timeout() on a regular tick, and pass the whole of the elapsed time in
+    one call. The answer changes whenever the terminal is acted upon, so it should be asked
+    again after each call to t38_terminal_send_timeout(), and after each received packet is
+    processed. Received packets should be processed only after the elapsed time has been
+    reported, so the terminal's view of time is up to date.
+    \brief Find the time until a T.38 terminal next needs attention.
+    \param s The T.38 context.
+    \return The time until the next action, in 1/8000th second steps, or -1 if nothing is
+            pending. Zero means an action is due now, which includes reporting that the
+            call has finished. In the "no delays" mode, used with IAF terminals, an action
+            is due at once whenever something is being sent. */
+SPAN_DECLARE(int) t38_terminal_time_to_next_action(t38_terminal_state_t *s);
+
 /*! Set configuration options.
     \brief Set configuration options.
     \param s The T.38 context.
@@ -103,6 +123,41 @@ SPAN_DECLARE(t38_core_state_t *) t38_terminal_get_t38_core_state(t38_terminal_st
 */
 SPAN_DECLARE(logging_state_t *) t38_terminal_get_logging_state(t38_terminal_state_t *s);
 
+/*! Get the amount of memory a termination mode T.38 context is currently using. This is
+    the context itself, plus any page image and ECM buffers it currently holds. It changes
+    as a call progresses, and is smallest for an idle context.
+    \brief Get the amount of memory a T.38 context is currently using.
+    \param s The T.38 context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) t38_terminal_get_memory_footprint(t38_terminal_state_t *s);
+
+/*! Save the complete state of a termination mode T.38 context, part way through a call,
+    so the call can be carried on by another context with t38_terminal_restore(). Once
+    the checkpoint has been written, any document being sent or received belongs to the
+    checkpoint, and the context must only be freed. The file is named in the checkpoint,
+    and is opened again where it is restored. No code or data addresses are held in the
+    checkpoint, so any process running the same version of the library, on the same kind
+    of machine, can restore it.
+    \brief Save the state of a T.38 context.
+    \param s The T.38 context.
+    \param buf The buffer for the checkpoint, or NULL to find the length needed.
+    \param max_len The length of the buffer.
+    \return The length of the checkpoint, or -1 if it will not fit in the buffer. */
+SPAN_DECLARE(int) t38_terminal_checkpoint(t38_terminal_state_t *s, uint8_t buf[], int max_len);
+
+/*! Carry on a call from a checkpoint written by t38_terminal_checkpoint(). The context
+    must be freshly initialised, and set up in the same way as the one the checkpoint was
+    taken from. Its handlers and settings are kept, and the state of the call comes from
+    the checkpoint. The handlers the call itself was using at the time are rebuilt from
+    that state.
+    \brief Restore the state of a T.38 context.
+    \param s The T.38 context.
+    \param buf The checkpoint.
+    \param len The length of the checkpoint.
+    \return 0 for OK, or -1 for a bad checkpoint, or one from a different version of
+            the library. After a failure the context can only be freed. */
+SPAN_DECLARE(int) t38_terminal_restore(t38_terminal_state_t *s, const uint8_t buf[], int len);
+
 /*! \brief Reinitialise a termination mode T.38 context.
     \param s The T.38 context.
     \param calling_party TRUE if the context is for a calling party. FALSE if the
@@ -0,0 +1,153 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t4_page_buffer.h - Chunked buffers for T.4 FAX page images
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_T4_PAGE_BUFFER_H_)
+#define _SPANDSP_T4_PAGE_BUFFER_H_
+
+/*! \page t4_page_buffer_page T.4 page image buffers
+\section t4_page_buffer_page_sec_1 What does it do?
+
+The T.4 page buffers hold the image of a FAX page while it is being received or sent.
+This may be the uncompressed bit image of a page being received, or the compressed
+image of a page being sent.
+
+\section t4_page_buffer_page_sec_2 How does it work?
+
+A page buffer is built from fixed size chunks, so it grows without copying the part
+of the page already stored. The chunks are drawn from a single pool, shared by every
+FAX channel, and are returned to the pool as soon as the page is finished with. A
+busy system therefore recycles the same chunks, rather than fragmenting its heap with
+page sized allocations. The pool is only used where spandsp is built with thread
+support, so it can be locked. Without thread support each page buffer allocates and
+frees its own chunks, as the contexts may still be used from different threads. The
+pool statistics show how much memory is tied up in page images, and a limit may be
+set on the number of chunks, to cap that memory for a given number of channels.
+
+When a page buffer holds rows of image, no row is allowed to straddle two chunks.
+This means each row can always be accessed in place.
+*/
+
+/*! The size of the chunks from which page buffers are built is 2 to this power. */
+#define T4_PAGE_BUFFER_CHUNK_SHIFT      14
+/*! The size of the chunks from which page buffers are built. */
+#define T4_PAGE_BUFFER_CHUNK_SIZE       (1 << T4_PAGE_BUFFER_CHUNK_SHIFT)
+
+/*! \brief A chunked T.4 page image buffer. */
+typedef struct t4_page_buffer_s t4_page_buffer_t;
+
+/*!
+    T.4 page buffer pool statistics.
+*/
+typedef struct
+{
+    /*! \brief The size of each chunk, in bytes. */
+    int chunk_size;
+    /*! \brief The number of chunks allocated from the heap. */
+    int chunks_allocated;
+    /*! \brief The number of chunks currently holding page images. */
+    int chunks_in_use;
+    /*! \brief The largest number of chunks which have been in use at one time. */
+    int peak_chunks_in_use;
+    /*! \brief The maximum number of chunks which may be allocated, or zero for no limit. */
+    int chunk_limit;
+    /*! \brief The number of requests for a chunk which could not be met. */
+    int failed_requests;
+} t4_page_buffer_pool_stats_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Initialise a T.4 page buffer, which will initially be empty.
+    \param s The page buffer.
+    \return A pointer to the page buffer, or NULL if there was a problem. */
+SPAN_DECLARE(t4_page_buffer_t *) t4_page_buffer_init(t4_page_buffer_t *s);
+
+/*! \brief Return all the chunks held by a T.4 page buffer to the pool, leaving it empty.
+    \param s The page buffer.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_page_buffer_release(t4_page_buffer_t *s);
+
+/*! \brief Release a T.4 page buffer, and free the buffer itself.
+    \param s The page buffer.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_page_buffer_free(t4_page_buffer_t *s);
+
+/*! \brief Make sure a T.4 page buffer has room for a specified number of bytes.
+    \param s The page buffer.
+    \param len The number of bytes, counted from the start of the buffer.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_page_buffer_grow(t4_page_buffer_t *s, int len);
+
+/*! \brief Get a row of image in a T.4 page buffer which is holding rows. The buffer
+           grows as needed to hold the row.
+    \param s The page buffer.
+    \param row The row number, starting from zero.
+    \param bytes_per_row The number of bytes in each row.
+    \return A pointer to the row, or NULL if there was a problem. */
+SPAN_DECLARE(uint8_t *) t4_page_buffer_row(t4_page_buffer_t *s, int row, int bytes_per_row);
+
+/*! \brief Copy bytes out of a T.4 page buffer.
+    \param s The page buffer.
+    \param offset The offset of the first byte to copy, from the start of the buffer.
+    \param buf The buffer for the bytes.
+    \param len The number of bytes to copy. These must already be in the page buffer.
+    \return The number of bytes copied. */
+SPAN_DECLARE(int) t4_page_buffer_get(t4_page_buffer_t *s, int offset, uint8_t buf[], int len);
+
+/*! \brief Copy bytes into a T.4 page buffer. The buffer grows as needed to hold them.
+    \param s The page buffer.
+    \param offset The offset at which the first byte is to be placed, from the start of the buffer.
+    \param buf The bytes.
+    \param len The number of bytes to copy.
+    \return The number of bytes copied, or -1 if there was a problem. */
+SPAN_DECLARE(int) t4_page_buffer_put(t4_page_buffer_t *s, int offset, const uint8_t buf[], int len);
+
+/*! \brief Get the statistics for the pool of chunks shared by all T.4 page buffers.
+    \param stats The statistics. */
+SPAN_DECLARE(void) t4_page_buffer_pool_get_stats(t4_page_buffer_pool_stats_t *stats);
+
+/*! \brief Set the maximum number of chunks which may be allocated for T.4 page buffers.
+           This caps the memory used for FAX page images. Page operations which need
+           more memory will fail.
+    \param chunks The maximum number of chunks, or zero for no limit.
+    \return 0 for success, otherwise -1. A limit can't be set if spandsp was built
+            without thread support, as there is then no pool. */
+SPAN_DECLARE(int) t4_page_buffer_pool_set_limit(int chunks);
+
+/*! \brief Return the chunks of the T.4 page buffer pool which are not currently in
+           use to the heap.
+    \return The number of chunks freed. */
+SPAN_DECLARE(int) t4_page_buffer_pool_trim(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -279,6 +279,16 @@ SPAN_DECLARE(int) t4_rx_free(t4_state_t *s);
     \return 0 for success, otherwise -1. */
 SPAN_DECLARE(int) t4_rx_set_row_write_handler(t4_state_t *s, t4_row_write_handler_t handler, void *user_data);
 
+/*! \brief Select whether received pages are written to the TIFF file by a background
+           thread. When enabled, t4_rx_end_page() just queues the completed page, and
+           the thread writes it. All queued pages are written before the file is closed.
+           Disabling background writing waits for any queued pages to be written.
+    \param s The T.4 receive context.
+    \param background TRUE to write pages in the background, FALSE to write them as they end.
+    \return 0 for success, otherwise -1. Background writing is not available if spandsp
+            was built without thread support. */
+SPAN_DECLARE(int) t4_rx_set_background_writing(t4_state_t *s, int background);
+
 /*! \brief Set the encoding for the received data.
     \param s The T.4 context.
     \param encoding The encoding. */
@@ -330,6 +340,13 @@ SPAN_DECLARE(void) t4_rx_set_model(t4_state_t *s, const char *model);
     \param t A pointer to a statistics structure. */
 SPAN_DECLARE(void) t4_rx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t);
 
+/*! \brief Get the amount of memory a T.4 context is currently holding, beyond the context
+           itself. This includes the page image, and any received pages still waiting to be
+           written to the TIFF file.
+    \param s The T.4 context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) t4_rx_get_allocated_memory(t4_state_t *s);
+
 /*! Get the short text name of an encoding format. 
     \brief Get the short text name of an encoding format.
     \param encoding The encoding type.
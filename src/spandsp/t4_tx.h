@@ -30,6 +30,40 @@
 
 typedef int (*t4_row_read_handler_t)(void *user_data, uint8_t buf[], size_t len);
 
+/*! \brief Callback function to take the output of a T.4 transcoder.
+    \param user_data An opaque pointer.
+    \param buf The encoded data.
+    \param len The length of the encoded data.
+    \return 0 for success, otherwise -1. */
+typedef int (*t4_transcoder_output_handler_t)(void *user_data, const uint8_t buf[], int len);
+
+/*!
+    T.4 encoded page cache statistics.
+*/
+typedef struct
+{
+    /*! \brief The number of pages in the cache. */
+    int entries;
+    /*! \brief The total size of the pages in the cache, in bytes. */
+    int bytes;
+    /*! \brief The maximum total size of the pages in the cache, in bytes. Zero means
+               the cache is disabled. */
+    int byte_limit;
+    /*! \brief The number of times a page was found in the cache. */
+    int hits;
+    /*! \brief The number of times a page had to be encoded, because it was not in the cache. */
+    int misses;
+    /*! \brief The number of pages dropped from the cache to stay within its size limit. */
+    int evictions;
+} t4_tx_page_cache_stats_t;
+
+/*!
+    T.4 transcoder descriptor. This converts an image between T.4 1D, T.4 2D and
+    T.6 coding, working row by row on the lists of black and white runs. The page
+    is never expanded into a bitmap.
+*/
+typedef struct t4_transcoder_state_s t4_transcoder_state_t;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -151,6 +185,21 @@ SPAN_DECLARE(void) t4_tx_set_header_tz(t4_state_t *s, const char *tzstring);
     \return 0 for success, otherwise -1. */
 SPAN_DECLARE(int) t4_tx_set_row_read_handler(t4_state_t *s, t4_row_read_handler_t handler, void *user_data);
 
+/*! Set whether each following page of the document is read and encoded by a background
+    thread, while the current page is being sent. t4_tx_start_page() then only needs to
+    pick up the encoded page, instead of stalling its caller while the whole page is
+    encoded. t4_tx_start_page() never waits for the background thread. If the page is not
+    ready yet, the page settings have changed since the background encoding started, or
+    it failed, the page is encoded by t4_tx_start_page() in the usual way. Background
+    encoding is not used for images supplied through a row read handler.
+    \brief Set background encoding of the following pages.
+    \param s The T.4 context.
+    \param pre_encode TRUE to encode pages in the background, or FALSE to encode them
+           as they start.
+    \return 0 for success, otherwise -1. Background encoding is not available if the
+            library was built without thread support. */
+SPAN_DECLARE(int) t4_tx_set_pre_encoding(t4_state_t *s, int pre_encode);
+
 /*! \brief Get the row-to-row (y) resolution of the current page.
     \param s The T.4 context.
     \return The resolution, in pixels per metre. */
@@ -182,6 +231,98 @@ SPAN_DECLARE(int) t4_tx_get_current_page_in_file(t4_state_t *s);
     \param t A pointer to a statistics structure. */
 SPAN_DECLARE(void) t4_tx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t);
 
+/*! \brief Get the amount of memory a T.4 context is currently holding, beyond the context
+           itself. This includes the page image, and any page being encoded in the background.
+    \param s The T.4 context.
+    \return The number of bytes. */
+SPAN_DECLARE(int) t4_tx_get_allocated_memory(t4_state_t *s);
+
+/*! \brief Set the maximum total size of the encoded page cache. This cache is shared by
+           every T.4 context sending from a TIFF file, so a document sent many times, such
+           as in a broadcast, is only read and encoded once for each way it is sent. A page
+           is only reused when it comes from the same, unchanged, file, with the same
+           encoding, minimum row length and header line. Note that the header line includes
+           the time, to the minute. When the limit is reached the least recently used pages
+           are dropped.
+    \param bytes The maximum size, in bytes. Zero, the default, disables the cache.
+    \return 0 for success, otherwise -1. The cache can't be enabled if spandsp was built
+            without thread support, as it could not be locked. */
+SPAN_DECLARE(int) t4_tx_page_cache_set_limit(int bytes);
+
+/*! \brief Drop every page from the encoded page cache. */
+SPAN_DECLARE(void) t4_tx_page_cache_flush(void);
+
+/*! \brief Get the statistics for the encoded page cache.
+    \param stats The statistics. */
+SPAN_DECLARE(void) t4_tx_page_cache_get_stats(t4_tx_page_cache_stats_t *stats);
+
+/*! \brief Initialise a T.4 transcoder context.
+    \param s The transcoder context.
+    \param input_encoding The encoding of the data to be put into the transcoder. This
+           may be T.4 1D, T.4 2D or T.6.
+    \param output_encoding The encoding of the data the transcoder produces. This may be
+           T.4 1D, T.4 2D or T.6.
+    \param handler The callback routine which takes the transcoded data.
+    \param user_data An opaque pointer passed to the handler routine.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(t4_transcoder_state_t *) t4_transcoder_init(t4_transcoder_state_t *s,
+                                                         int input_encoding,
+                                                         int output_encoding,
+                                                         t4_transcoder_output_handler_t handler,
+                                                         void *user_data);
+
+/*! \brief Set the width of the image, in pixel columns.
+    \param s The transcoder context.
+    \param width The number of pixels across the image.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_transcoder_set_image_width(t4_transcoder_state_t *s, int width);
+
+/*! \brief Set the vertical resolution of the image. For T.4 2D output this selects
+           how often a 1D coded row is inserted.
+    \param s The transcoder context.
+    \param resolution The resolution, in pixels per metre. */
+SPAN_DECLARE(void) t4_transcoder_set_y_resolution(t4_transcoder_state_t *s, int resolution);
+
+/*! \brief Set the minimum number of encoded bits per row of the output.
+    \param s The transcoder context.
+    \param bits The minimum number of bits per row. */
+SPAN_DECLARE(void) t4_transcoder_set_min_bits_per_row(t4_transcoder_state_t *s, int bits);
+
+/*! \brief Prepare to transcode a page.
+    \param s The transcoder context.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_transcoder_start_page(t4_transcoder_state_t *s);
+
+/*! \brief Put a chunk of the page to be transcoded. The transcoded data is passed
+           to the output handler as each row is completed.
+    \param s The transcoder context.
+    \param buf The buffer containing the chunk.
+    \param len The length of the chunk.
+    \return TRUE when the chunk ends the page, otherwise FALSE. */
+SPAN_DECLARE(int) t4_transcoder_put_chunk(t4_transcoder_state_t *s, const uint8_t buf[], int len);
+
+/*! \brief Complete the transcoding of a page. The end of page code, and any
+           remaining data, are passed to the output handler.
+    \param s The transcoder context.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_transcoder_end_page(t4_transcoder_state_t *s);
+
+/*! \brief Get the transfer statistics for the current page.
+    \param s The transcoder context.
+    \param t A pointer to a statistics structure. The line image size is the
+           size of the transcoded output. */
+SPAN_DECLARE(void) t4_transcoder_get_transfer_statistics(t4_transcoder_state_t *s, t4_stats_t *t);
+
+/*! \brief Release a T.4 transcoder context.
+    \param s The transcoder context.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_transcoder_release(t4_transcoder_state_t *s);
+
+/*! \brief Release and free a T.4 transcoder context.
+    \param s The transcoder context.
+    \return 0 for success, otherwise -1. */
+SPAN_DECLARE(int) t4_transcoder_free(t4_transcoder_state_t *s);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,132 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t81_t82_arith_coding.h - ITU T.81 and T.82 QM-coder arithmetic encoding
+ *                          and decoding
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_T81_T82_ARITH_CODING_H_)
+#define _SPANDSP_T81_T82_ARITH_CODING_H_
+
+/*! \page t81_t82_arith_coding_page T.81 and T.82 QM-coder arithmetic encoding and decoding
+\section t81_t82_arith_coding_page_sec_1 What does it do?
+The QM-coder is the adaptive binary arithmetic coder used by JPEG (T.81) and JBIG (T.82).
+It codes one binary decision at a time, in a context chosen by the caller. Each context
+has its own adaptive estimate of how probable the less likely value is.
+
+\section t81_t82_arith_coding_page_sec_2 How does it work?
+The coder follows the flow charts in T.82, with the probability estimation table shared
+by T.81 and T.82. The encoder passes each completed output byte to a callback, with any
+0xFF bytes already followed by the stuffing byte (0x00) which stops them looking like
+the start of a marker. The decoder works on a caller supplied buffer, and may be
+interrupted at any point when it runs out of data. When it reaches a marker it feeds zero
+bits into the decoding process, as the encoder's flush will have dropped any trailing zero
+bytes.
+*/
+
+/*! Callback for each byte of output from the arithmetic encoder. */
+typedef void (*t81_t82_arith_encode_output_handler_t)(void *user_data, int byte);
+
+/*! The number of contexts supported by the arithmetic coders. */
+#define T81_T82_ARITH_CODING_CONTEXTS   4096
+
+/*! Return value from the arithmetic decoder, when more data is needed. */
+#define T81_T82_ARITH_DECODE_MORE_DATA  -1
+/*! Return value from the arithmetic decoder, when it has reached a marker and
+    the caller asked to be told of this, rather than have zero padding applied. */
+#define T81_T82_ARITH_DECODE_MARKER     -2
+
+typedef struct t81_t82_arith_encode_state_s t81_t82_arith_encode_state_t;
+
+typedef struct t81_t82_arith_decode_state_s t81_t82_arith_decode_state_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Arithmetically encode one binary decision.
+    \param s The arithmetic encoder context.
+    \param cx The context, in the range 0 to T81_T82_ARITH_CODING_CONTEXTS - 1.
+    \param bit The decision, 0 or 1. */
+SPAN_DECLARE(void) t81_t82_arith_encode(t81_t82_arith_encode_state_t *s, int cx, int bit);
+
+/*! \brief Flush any pending output from an arithmetic encoder, at the end of a
+           sequence of decisions.
+    \param s The arithmetic encoder context. */
+SPAN_DECLARE(void) t81_t82_arith_encode_flush(t81_t82_arith_encode_state_t *s);
+
+/*! \brief Prepare an arithmetic encoder for a new sequence of decisions.
+    \param s The arithmetic encoder context.
+    \param reuse_st TRUE to keep the probability estimates learned so far, FALSE to
+           return them to their initial state.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t81_t82_arith_encode_restart(t81_t82_arith_encode_state_t *s, int reuse_st);
+
+/*! \brief Initialise an arithmetic encoder.
+    \param s The arithmetic encoder context.
+    \param output_byte_handler The callback which takes each output byte.
+    \param user_data An opaque pointer passed to the output handler.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(t81_t82_arith_encode_state_t *) t81_t82_arith_encode_init(t81_t82_arith_encode_state_t *s,
+                                                                       t81_t82_arith_encode_output_handler_t output_byte_handler,
+                                                                       void *user_data);
+
+SPAN_DECLARE(int) t81_t82_arith_encode_release(t81_t82_arith_encode_state_t *s);
+
+SPAN_DECLARE(int) t81_t82_arith_encode_free(t81_t82_arith_encode_state_t *s);
+
+/*! \brief Arithmetically decode one binary decision. The data to be decoded is taken from
+           the buffer described by pscd_ptr and pscd_end in the context, and pscd_ptr is
+           advanced past the data used.
+    \param s The arithmetic decoder context.
+    \param cx The context, in the range 0 to T81_T82_ARITH_CODING_CONTEXTS - 1.
+    \return The decision, 0 or 1, T81_T82_ARITH_DECODE_MORE_DATA if the buffer was exhausted
+            before the decision could be made, or T81_T82_ARITH_DECODE_MARKER if a marker
+            was reached and nopadding was set. In either of the last two cases, the same
+            context should be decoded again when the caller is ready. */
+SPAN_DECLARE(int) t81_t82_arith_decode(t81_t82_arith_decode_state_t *s, int cx);
+
+/*! \brief Prepare an arithmetic decoder for a new sequence of decisions.
+    \param s The arithmetic decoder context.
+    \param reuse_st TRUE to keep the probability estimates learned so far, FALSE to
+           return them to their initial state.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t81_t82_arith_decode_restart(t81_t82_arith_decode_state_t *s, int reuse_st);
+
+/*! \brief Initialise an arithmetic decoder.
+    \param s The arithmetic decoder context.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(t81_t82_arith_decode_state_t *) t81_t82_arith_decode_init(t81_t82_arith_decode_state_t *s);
+
+SPAN_DECLARE(int) t81_t82_arith_decode_release(t81_t82_arith_decode_state_t *s);
+
+SPAN_DECLARE(int) t81_t82_arith_decode_free(t81_t82_arith_decode_state_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,186 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t85.h - ITU T.85 JBIG for FAX image processing
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_T85_H_)
+#define _SPANDSP_T85_H_
+
+/*! \page t85_page T.85 (JBIG for FAX) image compression and decompression
+
+\section t85_page_sec_1 What does it do?
+The T.85 image compression and decompression routines implement the application profile
+of JBIG (T.82) defined for FAX. This is a single layer, single bit plane, form of JBIG,
+which typically compresses document pages considerably more than T.6 (MMR) does. It is
+only used with error correction.
+
+\section t85_page_sec_2 How does it work?
+Each pixel is coded by the QM arithmetic coder, in a context formed from the pixels
+above it and to its left. The image is coded in stripes of L0 rows. Typical prediction
+allows a row identical to the one above it to be coded with a single decision.
+
+The encoder takes the image a row at a time, and passes its output a byte at a time to a
+callback. The decoder accepts the coded data in arbitrary chunks, and passes each row to
+a callback as soon as it is decoded. It supports both the two and three row templates,
+typical prediction, adaptive template moves, and the NEWLEN marker used when the sender
+does not know the length of the image until it has finished scanning it.
+*/
+
+/*! Bits in the options byte of the T.82 bi-level image header */
+enum
+{
+    /*! Use the two row template, rather than the three row one */
+    T85_LRLTWO = 0x40,
+    /*! The image length in the header may be reduced by a later NEWLEN marker */
+    T85_VLENGTH = 0x20,
+    /*! Typical prediction for differential layers. Not used by T.85 */
+    T85_TPDON = 0x10,
+    /*! Typical prediction for the lowest resolution layer */
+    T85_TPBON = 0x08,
+    /*! Deterministic prediction. Not used by T.85 */
+    T85_DPON = 0x04,
+    /*! Private deterministic prediction table. Not used by T.85 */
+    T85_DPPRIV = 0x02,
+    /*! Deterministic prediction table follows. Not used by T.85 */
+    T85_DPLAST = 0x01
+};
+
+/*! The stripe length used when L0 has not been negotiated to some other value */
+#define T85_DEFAULT_L0          128
+
+typedef struct t85_encode_state_s t85_encode_state_t;
+
+typedef struct t85_decode_state_s t85_decode_state_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Set the T.85 coding options for an image. This must be done before the first row
+           is encoded.
+    \param s The T.85 context.
+    \param l0 The number of rows in each stripe.
+    \param mx The maximum horizontal offset allowed for the AT pixel.
+    \param options The T.82 options, from T85_LRLTWO and T85_TPBON. T85_VLENGTH is set
+           automatically when the image length is not known in advance.
+    \return 0 for OK, or -1 for a bad parameter, or encoding having already started. */
+SPAN_DECLARE(int) t85_encode_set_options(t85_encode_state_t *s, uint32_t l0, int mx, int options);
+
+/*! \brief Set the length of the image to be encoded. This must be done before the first
+           row is encoded.
+    \param s The T.85 context.
+    \param length The length of the image, in rows, or 0 if it is not known.
+    \return 0 for OK, or -1 if encoding has already started. */
+SPAN_DECLARE(int) t85_encode_set_image_length(t85_encode_state_t *s, uint32_t length);
+
+/*! \brief Encode a row of an image.
+    \param s The T.85 context.
+    \param row The row, with the first pixel in the most significant bit of the first byte,
+           and 1 being black.
+    \return 0 for OK, or -1 if the image is already complete. */
+SPAN_DECLARE(int) t85_encode_put_row(t85_encode_state_t *s, const uint8_t row[]);
+
+/*! \brief Complete the encoding of an image. If fewer rows have been encoded than the length
+           declared in the image header, a NEWLEN marker corrects the length, if T85_VLENGTH
+           was in use. Otherwise the image is padded with white rows.
+    \param s The T.85 context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t85_encode_image_complete(t85_encode_state_t *s);
+
+/*! \brief Get the number of rows encoded so far.
+    \param s The T.85 context.
+    \return The number of rows. */
+SPAN_DECLARE(uint32_t) t85_encode_get_image_length(t85_encode_state_t *s);
+
+/*! \brief Initialise a T.85 encoder for an image.
+    \param s The T.85 context.
+    \param image_width The width of the image, in pixels.
+    \param image_length The length of the image, in rows, or 0 if it is not known.
+    \param output_byte_handler The callback which takes each byte of the encoded image.
+    \param user_data An opaque pointer passed to the output handler.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(t85_encode_state_t *) t85_encode_init(t85_encode_state_t *s,
+                                                   uint32_t image_width,
+                                                   uint32_t image_length,
+                                                   t81_t82_arith_encode_output_handler_t output_byte_handler,
+                                                   void *user_data);
+
+SPAN_DECLARE(int) t85_encode_release(t85_encode_state_t *s);
+
+SPAN_DECLARE(int) t85_encode_free(t85_encode_state_t *s);
+
+/*! \brief Set limits on the size of image a T.85 decoder will accept. An image whose header
+           exceeds the limits is rejected, rather than allowing a bad header to cause
+           excessive memory to be used. An image with T85_VLENGTH set may declare a length
+           beyond the limit, as a NEWLEN marker may correct it later, but decoding stops
+           at the limit.
+    \param s The T.85 context.
+    \param max_xd The maximum width, in pixels, or 0 for no limit.
+    \param max_yd The maximum length, in rows, or 0 for no limit. */
+SPAN_DECLARE(void) t85_decode_set_image_size_constraints(t85_decode_state_t *s, uint32_t max_xd, uint32_t max_yd);
+
+/*! \brief Decode a chunk of T.85 data.
+    \param s The T.85 context.
+    \param data The data.
+    \param len The length of the data.
+    \return 0 if more data is needed, TRUE if the image is complete, or -1 if the data is
+            bad, or the sender aborted the image. */
+SPAN_DECLARE(int) t85_decode_put_chunk(t85_decode_state_t *s, const uint8_t data[], size_t len);
+
+/*! \brief Get the width of the image being decoded.
+    \param s The T.85 context.
+    \return The width, in pixels, or 0 if the image header has not been received. */
+SPAN_DECLARE(uint32_t) t85_decode_get_image_width(t85_decode_state_t *s);
+
+/*! \brief Get the number of rows decoded so far.
+    \param s The T.85 context.
+    \return The number of rows. */
+SPAN_DECLARE(uint32_t) t85_decode_get_image_length(t85_decode_state_t *s);
+
+/*! \brief Prepare a T.85 decoder for a new image.
+    \param s The T.85 context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) t85_decode_restart(t85_decode_state_t *s);
+
+/*! \brief Initialise a T.85 decoder.
+    \param s The T.85 context.
+    \param handler The callback which takes each decoded row.
+    \param user_data An opaque pointer passed to the row handler.
+    \return A pointer to the context, or NULL if there was a problem. */
+SPAN_DECLARE(t85_decode_state_t *) t85_decode_init(t85_decode_state_t *s,
+                                                   t4_row_write_handler_t handler,
+                                                   void *user_data);
+
+SPAN_DECLARE(int) t85_decode_release(t85_decode_state_t *s);
+
+SPAN_DECLARE(int) t85_decode_free(t85_decode_state_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
+/*- End of file ------------------------------------------------------------*/
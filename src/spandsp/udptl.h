@@ -0,0 +1,159 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl.h - An implementation of the UDPTL protocol defined in T.38,
+ *           less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if !defined(_SPANDSP_UDPTL_H_)
+#define _SPANDSP_UDPTL_H_
+
+/*! \page udptl_page UDPTL framing of T.38 IFP packets
+\section udptl_page_sec_1 What does it do?
+The UDPTL module wraps the IFP packets produced by the T.38 core in the UDPTL
+framing defined in T.38 annex D, for transport over UDP, and unwraps received
+UDPTL packets into the IFP packets they carry. Lost packets may be recovered
+from either of the optional error recovery schemes - redundancy, where each
+packet carries copies of some earlier packets, or parity FEC, where each packet
+carries XOR sums of groups of earlier packets.
+
+\section udptl_page_sec_2 How does it work?
+The module does not perform any network I/O. The application passes each IFP
+packet from the T.38 core's transmit handler to udptl_build_packet(), which
+builds the UDPTL packet directly in the application's datagram buffer, ready to
+be sent. Each arriving datagram is passed to udptl_rx_packet(), which delivers
+the IFP packet it carries, and any earlier ones it was able to recover, to a
+callback, typically feeding t38_core_rx_ifp_packet().
+
+The history of recent packets needed for error recovery is held in fixed
+buffers within the UDPTL context, so no memory is allocated while packets are
+being processed.
+*/
+
+/*! The maximum length of an IFP packet which UDPTL can carry */
+#define UDPTL_MAX_IFP_LEN           400
+/*! The maximum number of FEC entries which can be handled in a UDPTL packet */
+#define UDPTL_MAX_FEC_ENTRIES       5
+
+enum
+{
+    UDPTL_ERROR_CORRECTION_NONE,
+    UDPTL_ERROR_CORRECTION_FEC,
+    UDPTL_ERROR_CORRECTION_REDUNDANCY
+};
+
+typedef int (udptl_rx_packet_handler_t) (void *user_data, const uint8_t msg[], int len, int seq_no);
+
+typedef struct udptl_state_s udptl_state_t;
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+/*! \brief Process an arriving UDPTL packet.
+    \param s The UDPTL context.
+    \param buf The UDPTL packet buffer.
+    \param len The length of the packet.
+    \return 0 for OK, or -1 if the packet is malformed. */
+SPAN_DECLARE(int) udptl_rx_packet(udptl_state_t *s, const uint8_t buf[], int len);
+
+/*! \brief Construct a UDPTL packet, ready for transmission. The packet is built
+           directly in the supplied buffer. If redundancy is in use, and the full set of
+           redundant entries would make the packet longer than the buffer, or than the far
+           end will accept, the oldest entries are omitted.
+    \param s The UDPTL context.
+    \param buf The buffer for the UDPTL packet.
+    \param max_len The length of the buffer.
+    \param msg The primary IFP packet.
+    \param msg_len The length of the primary IFP packet.
+    \return The length of the constructed UDPTL packet, or -1 if the packet could not
+            be built. */
+SPAN_DECLARE(int) udptl_build_packet(udptl_state_t *s, uint8_t buf[], int max_len, const uint8_t msg[], int msg_len);
+
+/*! \brief Change the error correction settings of a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes, or -1 to leave the scheme unchanged.
+    \param span The packet span over which error correction should be applied, or -1 to leave it unchanged.
+    \param entries The number of error correction entries to include in packets, or -1 to leave it unchanged.
+    \return 0 for OK, or -1 for a bad parameter. */
+SPAN_DECLARE(int) udptl_set_error_correction(udptl_state_t *s, int ec_scheme, int span, int entries);
+
+/*! \brief Check the error correction settings of a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes.
+    \param span The packet span over which error correction is being applied.
+    \param entries The number of error correction being included in packets.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_get_error_correction(udptl_state_t *s, int *ec_scheme, int *span, int *entries);
+
+SPAN_DECLARE(int) udptl_set_local_max_datagram(udptl_state_t *s, int max_datagram);
+
+SPAN_DECLARE(int) udptl_get_local_max_datagram(udptl_state_t *s);
+
+SPAN_DECLARE(int) udptl_set_far_max_datagram(udptl_state_t *s, int max_datagram);
+
+SPAN_DECLARE(int) udptl_get_far_max_datagram(udptl_state_t *s);
+
+/*! Get a pointer to the logging context associated with a UDPTL context.
+    \brief Get a pointer to the logging context associated with a UDPTL context.
+    \param s The UDPTL context.
+    \return A pointer to the logging context, or NULL. */
+SPAN_DECLARE(logging_state_t *) udptl_get_logging_state(udptl_state_t *s);
+
+/*! \brief Restart a UDPTL context, for a new session.
+    \param s The UDPTL context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_restart(udptl_state_t *s);
+
+/*! \brief Initialise a UDPTL context.
+    \param s The UDPTL context.
+    \param ec_scheme One of the optional error correction schemes.
+    \param span The packet span over which error correction should be applied.
+    \param entries The number of error correction entries to include in packets.
+    \param rx_packet_handler The callback function, used to report arriving IFP packets.
+    \param user_data An opaque pointer supplied to rx_packet_handler.
+    \return A pointer to the UDPTL context, or NULL if there was a problem. */
+SPAN_DECLARE(udptl_state_t *) udptl_init(udptl_state_t *s,
+                                         int ec_scheme,
+                                         int span,
+                                         int entries,
+                                         udptl_rx_packet_handler_t *rx_packet_handler,
+                                         void *user_data);
+
+/*! \brief Release a UDPTL context.
+    \param s The UDPTL context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_release(udptl_state_t *s);
+
+/*! \brief Free a UDPTL context.
+    \param s The UDPTL context.
+    \return 0 for OK. */
+SPAN_DECLARE(int) udptl_free(udptl_state_t *s);
+
+#if defined(__cplusplus)
+}
+#endif
+#endif
+/*- End of file ------------------------------------------------------------*/
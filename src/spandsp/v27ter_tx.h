@@ -122,6 +122,32 @@ SPAN_DECLARE(logging_state_t *) v27ter_tx_get_logging_state(v27ter_tx_state_t *s
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v27ter_tx_set_get_bit(v27ter_tx_state_t *s, get_bit_func_t get_bit, void *user_data);
 
+/*! Change the get_chunk function associated with a V.27ter modem transmit context. When a
+    get_chunk function is set, the data to be transmitted is fetched a chunk of octets at a
+    time, rather than calling the get_bit function for every bit. This greatly reduces the
+    per-bit overhead at high bit rates. The octets may come straight from
+    t38_non_ecm_buffer_get_chunk() (MSB first) or t30_non_ecm_get_chunk() (LSB first). A
+    chunk shorter than requested marks the end of the data.
+    \brief Change the get_chunk function associated with a V.27ter modem transmit context.
+    \param s The modem context.
+    \param get_chunk The callback routine used to get chunks of data to be transmitted, or
+           NULL to return to bit by bit operation.
+    \param user_data An opaque pointer.
+    \param lsb_first TRUE if the octets should be sent LSB first, else MSB first. */
+SPAN_DECLARE(void) v27ter_tx_set_get_chunk(v27ter_tx_state_t *s, get_chunk_func_t get_chunk, void *user_data, int lsb_first);
+
+/*! Select whether the training sequence is replayed from a precomputed waveform,
+    rather than synthesised symbol by symbol. The waveforms are built once, the first
+    time any V.27ter transmitter asks for them, and are then shared read-only by all
+    instances. In a multi-threaded application this first call should be made before
+    other threads start using V.27ter transmitters. The setting takes effect from the
+    next restart of the modem.
+    \brief Select whether the training sequence is replayed from a precomputed waveform.
+    \param s The modem context.
+    \param use_cache TRUE to replay the precomputed training waveform.
+    \return 0 for OK, -1 if the shared waveforms could not be built. */
+SPAN_DECLARE(int) v27ter_tx_set_training_cache(v27ter_tx_state_t *s, int use_cache);
+
 /*! Change the modem status report function associated with a V.27ter modem transmit context.
     \brief Change the modem status report function associated with a V.27ter modem transmit context.
     \param s The modem context.
@@ -173,6 +173,19 @@ SPAN_DECLARE(logging_state_t *) v29_rx_get_logging_state(v29_rx_state_t *s);
     \param user_data An opaque pointer. */
 SPAN_DECLARE(void) v29_rx_set_put_bit(v29_rx_state_t *s, put_bit_func_t put_bit, void *user_data);
 
+/*! Change the put_chunk function associated with a V.29 modem receive context. The
+    received data is packed into octets, and delivered in blocks of octets, as
+    described for chunk_rx_init(). The pending octets are delivered at the end of each
+    block of audio processed, and before any status change is reported, with any odd
+    bits short of a whole octet going to the put_bit function.
+    \brief Change the put_chunk function associated with a V.29 modem receive context.
+    \param s The modem context.
+    \param put_chunk The callback routine used to handle blocks of received octets, or
+           NULL to return to bit by bit operation.
+    \param user_data An opaque pointer.
+    \param lsb_first TRUE if the bits should be packed LSB first, else MSB first. */
+SPAN_DECLARE(void) v29_rx_set_put_chunk(v29_rx_state_t *s, put_chunk_func_t put_chunk, void *user_data, int lsb_first);
+
 /*! Change the modem status report function associated with a V.29 modem receive context.
     \brief Change the modem status report function associated with a V.29 modem receive context.
     \param s The modem context.
@@ -43,6 +43,10 @@
 #endif
 #include "floating_fudge.h"
 #include <tiffio.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define T30_USE_ECM_POOL
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/logging.h"
@@ -58,6 +62,7 @@
 #include "spandsp/v29tx.h"
 #include "spandsp/v27ter_rx.h"
 #include "spandsp/v27ter_tx.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -79,12 +84,14 @@
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 #include "spandsp/private/t30.h"
 #include "spandsp/private/t30_dis_dtc_dcs_bits.h"
 
 #include "t30_local.h"
+#include "checkpoint_local.h"
 
 /*! The maximum permitted number of retries of a single command allowed. */
 #define MAX_COMMAND_TRIES   3
@@ -396,6 +403,7 @@ static void timer_t4_start(t30_state_t *s);
 static void timer_t4a_start(t30_state_t *s);
 static void timer_t4b_start(t30_state_t *s);
 static void timer_t2_t4_stop(t30_state_t *s);
+static void timing_page_end(t30_state_t *s);
 
 /*! Test a specified bit within a DIS, DTC or DCS frame */
 #define test_ctrl_bit(s,bit) ((s)[3 + ((bit - 1)/8)] & (1 << ((bit - 1)%8)))
@@ -406,6 +414,88 @@ static void timer_t2_t4_stop(t30_state_t *s);
 /*! Clear a specified bit within a DIS, DTC or DCS frame */
 #define clr_ctrl_bit(s,bit) (s)[3 + ((bit - 1)/8)] &= ~(1 << ((bit - 1)%8))
 
+/*! An ECM partial page buffer. While it is in the pool, the start of the buffer links it
+    to the next free one. */
+typedef union ecm_buffer_u
+{
+    union ecm_buffer_u *next;
+    uint8_t data[256][260];
+} ecm_buffer_t;
+
+#if defined(T30_USE_ECM_POOL)
+/*! The pool of ECM partial page buffers shared by all T.30 contexts. A context only
+    holds a buffer while it is sending or receiving an ECM page, so a large number of
+    mostly idle, or non-ECM, channels need only a few buffers between them. The pool
+    only exists when it can be locked, as the contexts may be used in different
+    threads. Without locking each context allocates and frees its own buffer. */
+static struct
+{
+    pthread_mutex_t mutex;
+    ecm_buffer_t *free_buffers;
+    int buffers_allocated;
+    int buffers_in_use;
+    int peak_buffers_in_use;
+} ecm_pool =
+{
+    PTHREAD_MUTEX_INITIALIZER,
+    NULL,
+    0,
+    0,
+    0
+};
+#endif
+
+static int get_ecm_buffer(t30_state_t *s)
+{
+    ecm_buffer_t *ecm;
+
+    if (s->ecm_data)
+        return 0;
+#if defined(T30_USE_ECM_POOL)
+    pthread_mutex_lock(&ecm_pool.mutex);
+    if ((ecm = ecm_pool.free_buffers))
+        ecm_pool.free_buffers = ecm->next;
+    else if ((ecm = (ecm_buffer_t *) malloc(sizeof(*ecm))))
+        ecm_pool.buffers_allocated++;
+    if (ecm)
+    {
+        if (++ecm_pool.buffers_in_use > ecm_pool.peak_buffers_in_use)
+            ecm_pool.peak_buffers_in_use = ecm_pool.buffers_in_use;
+    }
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#else
+    ecm = (ecm_buffer_t *) malloc(sizeof(*ecm));
+#endif
+    if (ecm == NULL)
+    {
+        span_log(&s->logging, SPAN_LOG_WARNING, "No memory for the ECM partial page buffer\n");
+        return -1;
+    }
+    s->ecm_data = ecm->data;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void release_ecm_buffer(t30_state_t *s)
+{
+    ecm_buffer_t *ecm;
+
+    if (s->ecm_data == NULL)
+        return;
+    ecm = (ecm_buffer_t *) s->ecm_data;
+    s->ecm_data = NULL;
+#if defined(T30_USE_ECM_POOL)
+    pthread_mutex_lock(&ecm_pool.mutex);
+    ecm->next = ecm_pool.free_buffers;
+    ecm_pool.free_buffers = ecm;
+    ecm_pool.buffers_in_use--;
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#else
+    free(ecm);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
 static int terminate_operation_in_progress(t30_state_t *s)
 {
     /* Make sure any FAX in progress is tidied up. If the tidying up has
@@ -421,12 +511,14 @@ static int terminate_operation_in_progress(t30_state_t *s)
         s->operation_in_progress = OPERATION_IN_PROGRESS_POST_T4_RX;
         break;
     }
+    release_ecm_buffer(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
 static int tx_start_page(t30_state_t *s)
 {
+    timing_page_end(s);
     if (t4_tx_start_page(&s->t4.tx))
     {
         terminate_operation_in_progress(s);
@@ -442,6 +534,8 @@ static int tx_start_page(t30_state_t *s)
 static int tx_end_page(t30_state_t *s)
 {
     s->retries = 0;
+    release_ecm_buffer(s);
+    timing_page_end(s);
     if (t4_tx_end_page(&s->t4.tx) == 0)
     {
         s->tx_page_number++;
@@ -466,6 +560,7 @@ static int rx_start_page(t30_state_t *s)
     t4_rx_set_x_resolution(&s->t4.rx, s->x_resolution);
     t4_rx_set_y_resolution(&s->t4.rx, s->y_resolution);
 
+    timing_page_end(s);
     if (t4_rx_start_page(&s->t4.rx))
         return -1;
     /* Clear the ECM buffer */
@@ -481,6 +576,8 @@ static int rx_start_page(t30_state_t *s)
 
 static int rx_end_page(t30_state_t *s)
 {
+    release_ecm_buffer(s);
+    timing_page_end(s);
     if (t4_rx_end_page(&s->t4.rx) == 0)
     {
         s->rx_page_number++;
@@ -659,6 +756,7 @@ static void release_resources(t30_state_t *s)
         free(s->rx_info.csa);
         s->rx_info.csa = NULL;
     }
+    release_ecm_buffer(s);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -703,6 +801,8 @@ static int get_partial_ecm_page(t30_state_t *s)
 
     s->ppr_count = 0;
     s->ecm_progress = 0;
+    if (get_ecm_buffer(s))
+        return -1;
     /* Fill our partial page buffer with a partial page. Use the negotiated preferred frame size
        as the basis for the size of the frames produced. */
     /* We fill the buffer with complete HDLC frames, ready to send out. */
@@ -743,6 +843,14 @@ static int get_partial_ecm_page(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void ecm_page_failed(t30_state_t *s)
+{
+    /* Without a partial page buffer there is no way to carry on sending */
+    s->current_status = T30_ERR_NOMEM;
+    send_dcn(s);
+}
+/*- End of function --------------------------------------------------------*/
+
 static int send_next_ecm_frame(t30_state_t *s)
 {
     int i;
@@ -802,6 +910,64 @@ static int send_first_ecm_frame(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void timing_event(t30_state_t *s, int event, int value)
+{
+    if (s->timing_handler)
+        s->timing_handler(s, s->timing_user_data, event, (int) (s->call_samples/(SAMPLE_RATE/1000)), value);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void timing_page_end(t30_state_t *s)
+{
+    /* A page ends when it is finished with, or abandoned, and not each time one of its ECM
+       blocks, or a retransmission, ends. */
+    if (s->timing_page > 0)
+    {
+        timing_event(s, T30_TIMING_PAGE_END, s->timing_page);
+        s->timing_page = 0;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void timing_frame(t30_state_t *s, int event, const uint8_t *msg, int len)
+{
+    int fcf;
+
+    if (len < 3)
+        return;
+    fcf = msg[2] & 0xFE;
+    /* Image data frames are timed as part of the page, rather than one by one */
+    if ((s->phase == T30_PHASE_C_ECM_TX  ||  s->phase == T30_PHASE_C_ECM_RX)
+        &&
+        (fcf == T4_FCD  ||  fcf == T4_RCP))
+    {
+        return;
+    }
+    timing_event(s, event, msg[2]);
+    switch (fcf)
+    {
+    case T30_PPS:
+        s->pps_rounds++;
+        break;
+    case T30_PPR:
+        s->pprs++;
+        break;
+    case T30_FTT:
+    case T30_RTN:
+        s->retrains++;
+        timing_event(s, T30_TIMING_RETRAIN, fallback_sequence[s->current_fallback].bit_rate);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void timing_fallback(t30_state_t *s)
+{
+    s->fallbacks++;
+    timing_event(s, T30_TIMING_FALLBACK, fallback_sequence[s->current_fallback].bit_rate);
+}
+/*- End of function --------------------------------------------------------*/
+
 static void print_frame(t30_state_t *s, const char *io, const uint8_t *msg, int len)
 {
     span_log(&s->logging,
@@ -820,6 +986,7 @@ static void send_frame(t30_state_t *s, const uint8_t *msg, int len)
 
     if (s->real_time_frame_handler)
         s->real_time_frame_handler(s, s->real_time_frame_user_data, FALSE, msg, len);
+    timing_frame(s, T30_TIMING_FRAME_TX, msg, len);
     if (s->send_hdlc_handler)
         s->send_hdlc_handler(s->send_hdlc_user_data, msg, len);
 }
@@ -1629,6 +1796,7 @@ static int step_fallback_entry(t30_state_t *s)
     t4_tx_set_min_bits_per_row(&s->t4.tx, min_row_bits);
     /* We need to rebuild the DCS message we will send. */
     build_dcs(s);
+    timing_fallback(s);
     return s->current_fallback;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1958,16 +2126,49 @@ static int start_sending_document(t30_state_t *s)
 
     if (tx_start_page(s))
         return -1;
+    /* Any following pages can be encoded while this one is being sent. If that can't be
+       set up, they are just encoded as each one starts. */
+    if (s->tx_page_pre_encoding  &&  t4_tx_set_pre_encoding(&s->t4.tx, TRUE))
+        span_log(&s->logging, SPAN_LOG_WARNING, "Background page encoding could not be started\n");
     s->image_width = t4_tx_get_image_width(&s->t4.tx);
     if (s->error_correcting_mode)
     {
-        if (get_partial_ecm_page(s) == 0)
+        switch (get_partial_ecm_page(s))
+        {
+        case -1:
+            s->current_status = T30_ERR_NOMEM;
+            terminate_operation_in_progress(s);
+            return -1;
+        case 0:
             span_log(&s->logging, SPAN_LOG_WARNING, "No image data to send\n");
+            break;
+        }
     }
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
 
+int t30_set_tx_pre_encoding(t30_state_t *s, int pre_encode)
+{
+    /* If a document is being sent the change applies to its remaining pages, and is
+       refused if background encoding can't be started for them. */
+    if (s->operation_in_progress == OPERATION_IN_PROGRESS_T4_TX)
+    {
+        if (t4_tx_set_pre_encoding(&s->t4.tx, pre_encode))
+            return -1;
+    }
+#if !defined(HAVE_PTHREAD_H)  ||  !defined(HAVE_LIBPTHREAD)
+    else if (pre_encode)
+    {
+        /* There is no thread to encode the pages with */
+        return -1;
+    }
+#endif
+    s->tx_page_pre_encoding = pre_encode;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int restart_sending_document(t30_state_t *s)
 {
     t4_tx_restart_page(&s->t4.tx);
@@ -2306,6 +2507,10 @@ static int process_rx_dcs(t30_state_t *s, const uint8_t *msg, int len)
         span_log(&s->logging, SPAN_LOG_FLOW, "Remote asked for a modem standard we do not support\n");
         return -1;
     }
+    /* A slower DCS than last time means the far end has fallen back */
+    if (s->last_rx_dcs_bit_rate > fallback_sequence[s->current_fallback].bit_rate)
+        timing_fallback(s);
+    s->last_rx_dcs_bit_rate = fallback_sequence[s->current_fallback].bit_rate;
     s->error_correcting_mode = (test_ctrl_bit(dcs_frame, T30_DCS_BIT_ECM) != 0);
 
     if (s->phase_b_handler)
@@ -2342,6 +2547,8 @@ static int process_rx_dcs(t30_state_t *s, const uint8_t *msg, int len)
             send_dcn(s);
             return -1;
         }
+        if (s->rx_page_background_writing)
+            t4_rx_set_background_writing(&s->t4.rx, TRUE);
         s->operation_in_progress = OPERATION_IN_PROGRESS_T4_RX;
     }
     if (!(s->iaf & T30_IAF_MODE_NO_TCF))
@@ -2528,9 +2735,10 @@ static int process_rx_pps(t30_state_t *s, const uint8_t *msg, int len)
                 break;
             }
         }
-        /* Clear the ECM buffer */
+        /* Clear the ECM buffer. Its memory can go back to the pool until the next block arrives. */
         for (i = 0;  i < 256;  i++)
             s->ecm_len[i] = -1;
+        release_ecm_buffer(s);
         s->ecm_block++;
         s->ecm_frames = -1;
 
@@ -2674,6 +2882,13 @@ static void process_rx_fcd(t30_state_t *s, const uint8_t *msg, int len)
                the frame, and let retries sort things out. */
             span_log(&s->logging, SPAN_LOG_FLOW, "Unexpected %s frame length - %d\n", t30_frametype(msg[0]), len);
         }
+        else if (get_ecm_buffer(s))
+        {
+            /* Without a partial page buffer there is no way to receive the page */
+            s->current_status = T30_ERR_NOMEM;
+            send_dcn(s);
+            return;
+        }
         else
         {
             frame_no = msg[3];
@@ -3913,6 +4128,7 @@ static void process_state_iv(t30_state_t *s, const uint8_t *msg, int len)
 static void process_state_iv_pps_null(t30_state_t *s, const uint8_t *msg, int len)
 {
     uint8_t fcf;
+    int frames;
 
     fcf = msg[2] & 0xFE;
     switch (fcf)
@@ -3922,7 +4138,12 @@ static void process_state_iv_pps_null(t30_state_t *s, const uint8_t *msg, int le
         s->timer_t5 = 0;
         /* Is there more of the current page to get, or do we move on? */
         span_log(&s->logging, SPAN_LOG_FLOW, "Is there more to send? - %d %d\n", s->ecm_frames, s->ecm_len[255]);
-        if (!s->ecm_at_page_end  &&  get_partial_ecm_page(s) > 0)
+        frames = (s->ecm_at_page_end)  ?  0  :  get_partial_ecm_page(s);
+        if (frames < 0)
+        {
+            ecm_page_failed(s);
+        }
+        else if (frames > 0)
         {
             span_log(&s->logging, SPAN_LOG_FLOW, "Additional image data to send\n");
             s->ecm_block++;
@@ -3945,12 +4166,16 @@ static void process_state_iv_pps_null(t30_state_t *s, const uint8_t *msg, int le
                     /* TODO: recover */
                     break;
                 }
-                if (get_partial_ecm_page(s) > 0)
+                if ((frames = get_partial_ecm_page(s)) > 0)
                 {
                     set_state(s, T30_STATE_IV);
                     queue_phase(s, T30_PHASE_C_ECM_TX);
                     send_first_ecm_frame(s);
                 }
+                else if (frames < 0)
+                {
+                    ecm_page_failed(s);
+                }
                 break;
             case T30_PRI_EOM:
             case T30_EOM:
@@ -4006,6 +4231,7 @@ static void process_state_iv_pps_null(t30_state_t *s, const uint8_t *msg, int le
 static void process_state_iv_pps_q(t30_state_t *s, const uint8_t *msg, int len)
 {
     uint8_t fcf;
+    int frames;
 
     fcf = msg[2] & 0xFE;
     switch (fcf)
@@ -4026,7 +4252,12 @@ static void process_state_iv_pps_q(t30_state_t *s, const uint8_t *msg, int len)
         s->timer_t5 = 0;
         /* Is there more of the current page to get, or do we move on? */
         span_log(&s->logging, SPAN_LOG_FLOW, "Is there more to send? - %d %d\n", s->ecm_frames, s->ecm_len[255]);
-        if (!s->ecm_at_page_end  &&  get_partial_ecm_page(s) > 0)
+        frames = (s->ecm_at_page_end)  ?  0  :  get_partial_ecm_page(s);
+        if (frames < 0)
+        {
+            ecm_page_failed(s);
+        }
+        else if (frames > 0)
         {
             span_log(&s->logging, SPAN_LOG_FLOW, "Additional image data to send\n");
             s->ecm_block++;
@@ -4049,12 +4280,16 @@ static void process_state_iv_pps_q(t30_state_t *s, const uint8_t *msg, int len)
                     /* TODO: recover */
                     break;
                 }
-                if (get_partial_ecm_page(s) > 0)
+                if ((frames = get_partial_ecm_page(s)) > 0)
                 {
                     set_state(s, T30_STATE_IV);
                     queue_phase(s, T30_PHASE_C_ECM_TX);
                     send_first_ecm_frame(s);
                 }
+                else if (frames < 0)
+                {
+                    ecm_page_failed(s);
+                }
                 break;
             case T30_PRI_EOM:
             case T30_EOM:
@@ -4121,6 +4356,7 @@ static void process_state_iv_pps_q(t30_state_t *s, const uint8_t *msg, int len)
 static void process_state_iv_pps_rnr(t30_state_t *s, const uint8_t *msg, int len)
 {
     uint8_t fcf;
+    int frames;
 
     fcf = msg[2] & 0xFE;
     switch (fcf)
@@ -4141,7 +4377,12 @@ static void process_state_iv_pps_rnr(t30_state_t *s, const uint8_t *msg, int len
         s->timer_t5 = 0;
         /* Is there more of the current page to get, or do we move on? */
         span_log(&s->logging, SPAN_LOG_FLOW, "Is there more to send? - %d %d\n", s->ecm_frames, s->ecm_len[255]);
-        if (!s->ecm_at_page_end  &&  get_partial_ecm_page(s) > 0)
+        frames = (s->ecm_at_page_end)  ?  0  :  get_partial_ecm_page(s);
+        if (frames < 0)
+        {
+            ecm_page_failed(s);
+        }
+        else if (frames > 0)
         {
             span_log(&s->logging, SPAN_LOG_FLOW, "Additional image data to send\n");
             s->ecm_block++;
@@ -4164,12 +4405,16 @@ static void process_state_iv_pps_rnr(t30_state_t *s, const uint8_t *msg, int len
                     /* TODO: recover */
                     break;
                 }
-                if (get_partial_ecm_page(s) > 0)
+                if ((frames = get_partial_ecm_page(s)) > 0)
                 {
                     set_state(s, T30_STATE_IV);
                     queue_phase(s, T30_PHASE_C_ECM_TX);
                     send_first_ecm_frame(s);
                 }
+                else if (frames < 0)
+                {
+                    ecm_page_failed(s);
+                }
                 break;
             case T30_PRI_EOM:
             case T30_EOM:
@@ -4366,6 +4611,7 @@ static void process_rx_control_msg(t30_state_t *s, const uint8_t *msg, int len)
     print_frame(s, "Rx: ", msg, len);
     if (s->real_time_frame_handler)
         s->real_time_frame_handler(s, s->real_time_frame_user_data, TRUE, msg, len);
+    timing_frame(s, T30_TIMING_FRAME_RX, msg, len);
 
     if ((msg[1] & 0x10) == 0)
     {
@@ -4408,6 +4654,17 @@ static void process_rx_control_msg(t30_state_t *s, const uint8_t *msg, int len)
             {
                 /* Non-standard facilities */
                 /* OK in (NSF) (CSI) DIS */
+                if (s->rx_info.nsf)
+                {
+                    free(s->rx_info.nsf);
+                    s->rx_info.nsf = NULL;
+                }
+                s->rx_info.nsf_len = 0;
+                if (len > 3  &&  (s->rx_info.nsf = (uint8_t *) malloc(len - 3)))
+                {
+                    memcpy(s->rx_info.nsf, &msg[3], len - 3);
+                    s->rx_info.nsf_len = len - 3;
+                }
                 t35_decode(&msg[3], len - 3, &s->country, &s->vendor, &s->model);
                 if (s->country)
                     span_log(&s->logging, SPAN_LOG_FLOW, "The remote was made in '%s'\n", s->country);
@@ -4654,11 +4911,46 @@ static void queue_phase(t30_state_t *s, int phase)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int timing_phase_group(int phase)
+{
+    switch (phase)
+    {
+    case T30_PHASE_A_CED:
+    case T30_PHASE_A_CNG:
+        return 0;
+    case T30_PHASE_B_RX:
+    case T30_PHASE_B_TX:
+        return 1;
+    case T30_PHASE_C_NON_ECM_RX:
+    case T30_PHASE_C_NON_ECM_TX:
+    case T30_PHASE_C_ECM_RX:
+    case T30_PHASE_C_ECM_TX:
+        return 2;
+    case T30_PHASE_D_RX:
+    case T30_PHASE_D_TX:
+        return 3;
+    case T30_PHASE_E:
+        return 4;
+    }
+    return -1;
+}
+/*- End of function --------------------------------------------------------*/
+
 static void set_phase(t30_state_t *s, int phase)
 {
+    int group;
+
     //if (phase = s->phase)
     //    return;
     span_log(&s->logging, SPAN_LOG_FLOW, "Changing from phase %s to %s\n", phase_names[s->phase], phase_names[phase]);
+    if ((group = timing_phase_group(s->phase)) >= 0)
+        s->phase_samples[group] += s->call_samples - s->phase_start_samples;
+    s->phase_start_samples = s->call_samples;
+    /* A page still in progress at the end of the call has been abandoned */
+    if (phase == T30_PHASE_E  ||  phase == T30_PHASE_CALL_FINISHED)
+        timing_page_end(s);
+    if (phase != s->phase)
+        timing_event(s, T30_TIMING_PHASE, phase);
     /* We may be killing a receiver before it has declared the end of the
        signal. Force the signal present indicator to off, because the
        receiver will never be able to. */
@@ -4768,7 +5060,48 @@ static void set_state(t30_state_t *s, int state)
     if (s->state != state)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Changing from state %d to %d\n", s->state, state);
+        /* Time the TCF and page image steps, which are the bulk of most calls */
+        switch (s->state)
+        {
+        case T30_STATE_D_TCF:
+        case T30_STATE_F_TCF:
+            s->tcf_samples += s->call_samples - s->step_start_samples;
+            timing_event(s, T30_TIMING_TCF_END, fallback_sequence[s->current_fallback].bit_rate);
+            break;
+        case T30_STATE_I:
+        case T30_STATE_IV:
+        case T30_STATE_F_DOC_NON_ECM:
+        case T30_STATE_F_DOC_ECM:
+            s->image_samples += s->call_samples - s->step_start_samples;
+            break;
+        }
         s->state = state;
+        switch (state)
+        {
+        case T30_STATE_D_TCF:
+        case T30_STATE_F_TCF:
+            s->step_start_samples = s->call_samples;
+            s->tcfs++;
+            timing_event(s, T30_TIMING_TCF_START, fallback_sequence[s->current_fallback].bit_rate);
+            break;
+        case T30_STATE_I:
+        case T30_STATE_IV:
+        case T30_STATE_F_DOC_NON_ECM:
+        case T30_STATE_F_DOC_ECM:
+            s->step_start_samples = s->call_samples;
+            if (s->first_page_samples < 0)
+                s->first_page_samples = s->call_samples;
+            if (s->timing_page == 0)
+            {
+                /* This is the first image data for the page */
+                if (state == T30_STATE_I  ||  state == T30_STATE_IV)
+                    s->timing_page = s->tx_page_number + 1;
+                else
+                    s->timing_page = s->rx_page_number + 1;
+                timing_event(s, T30_TIMING_PAGE_START, s->timing_page);
+            }
+            break;
+        }
     }
     s->step = 0;
 }
@@ -6047,6 +6380,7 @@ SPAN_DECLARE(void) t30_timer_update(t30_state_t *s, int samples)
 {
     int previous;
 
+    s->call_samples += samples;
     if (s->timer_t0_t1 > 0)
     {
         if ((s->timer_t0_t1 -= samples) <= 0)
@@ -6112,6 +6446,23 @@ SPAN_DECLARE(void) t30_timer_update(t30_state_t *s, int samples)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t30_next_timer_expiry(t30_state_t *s)
+{
+    int next;
+
+    next = -1;
+    if (s->timer_t0_t1 > 0  &&  (next < 0  ||  s->timer_t0_t1 < next))
+        next = s->timer_t0_t1;
+    if (s->timer_t3 > 0  &&  (next < 0  ||  s->timer_t3 < next))
+        next = s->timer_t3;
+    if (s->timer_t2_t4 > 0  &&  (next < 0  ||  s->timer_t2_t4 < next))
+        next = s->timer_t2_t4;
+    if (s->timer_t5 > 0  &&  (next < 0  ||  s->timer_t5 < next))
+        next = s->timer_t5;
+    return next;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t30_terminate(t30_state_t *s)
 {
     if (s->phase != T30_PHASE_CALL_FINISHED)
@@ -6182,6 +6533,107 @@ SPAN_DECLARE(void) t30_get_transfer_statistics(t30_state_t *s, t30_stats_t *t)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t30_get_timing_statistics(t30_state_t *s, t30_timing_stats_t *t)
+{
+    int64_t phase_samples[5];
+    int64_t tcf_samples;
+    int64_t image_samples;
+    int group;
+
+    /* Include the part of the current phase, and any TCF or page in progress, so far */
+    memcpy(phase_samples, s->phase_samples, sizeof(phase_samples));
+    if ((group = timing_phase_group(s->phase)) >= 0)
+        phase_samples[group] += s->call_samples - s->phase_start_samples;
+    tcf_samples = s->tcf_samples;
+    image_samples = s->image_samples;
+    switch (s->state)
+    {
+    case T30_STATE_D_TCF:
+    case T30_STATE_F_TCF:
+        tcf_samples += s->call_samples - s->step_start_samples;
+        break;
+    case T30_STATE_I:
+    case T30_STATE_IV:
+    case T30_STATE_F_DOC_NON_ECM:
+    case T30_STATE_F_DOC_ECM:
+        image_samples += s->call_samples - s->step_start_samples;
+        break;
+    }
+    t->call_time = (int) (s->call_samples/(SAMPLE_RATE/1000));
+    t->phase_a_time = (int) (phase_samples[0]/(SAMPLE_RATE/1000));
+    t->phase_b_time = (int) (phase_samples[1]/(SAMPLE_RATE/1000));
+    t->phase_c_time = (int) (phase_samples[2]/(SAMPLE_RATE/1000));
+    t->phase_d_time = (int) (phase_samples[3]/(SAMPLE_RATE/1000));
+    t->phase_e_time = (int) (phase_samples[4]/(SAMPLE_RATE/1000));
+    t->tcf_time = (int) (tcf_samples/(SAMPLE_RATE/1000));
+    t->image_time = (int) (image_samples/(SAMPLE_RATE/1000));
+    t->first_page_time = (s->first_page_samples >= 0)  ?  (int) (s->first_page_samples/(SAMPLE_RATE/1000))  :  -1;
+    t->tcfs = s->tcfs;
+    t->retrains = s->retrains;
+    t->fallbacks = s->fallbacks;
+    t->pps_rounds = s->pps_rounds;
+    t->pprs = s->pprs;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t30_get_allocated_memory(t30_state_t *s)
+{
+    int mem;
+
+    mem = (s->ecm_data)  ?  sizeof(ecm_buffer_t)  :  0;
+    switch (s->operation_in_progress)
+    {
+    case OPERATION_IN_PROGRESS_T4_TX:
+        mem += t4_tx_get_allocated_memory(&s->t4.tx);
+        break;
+    case OPERATION_IN_PROGRESS_T4_RX:
+        mem += t4_rx_get_allocated_memory(&s->t4.rx);
+        break;
+    }
+    return mem;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t30_ecm_pool_get_stats(t30_ecm_pool_stats_t *stats)
+{
+    stats->buffer_size = sizeof(ecm_buffer_t);
+#if defined(T30_USE_ECM_POOL)
+    pthread_mutex_lock(&ecm_pool.mutex);
+    stats->buffers_allocated = ecm_pool.buffers_allocated;
+    stats->buffers_in_use = ecm_pool.buffers_in_use;
+    stats->peak_buffers_in_use = ecm_pool.peak_buffers_in_use;
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#else
+    stats->buffers_allocated = 0;
+    stats->buffers_in_use = 0;
+    stats->peak_buffers_in_use = 0;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t30_ecm_pool_trim(void)
+{
+    int freed;
+#if defined(T30_USE_ECM_POOL)
+    ecm_buffer_t *ecm;
+#endif
+
+    freed = 0;
+#if defined(T30_USE_ECM_POOL)
+    pthread_mutex_lock(&ecm_pool.mutex);
+    while ((ecm = ecm_pool.free_buffers))
+    {
+        ecm_pool.free_buffers = ecm->next;
+        free(ecm);
+        freed++;
+    }
+    ecm_pool.buffers_allocated -= freed;
+    pthread_mutex_unlock(&ecm_pool.mutex);
+#endif
+    return freed;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t30_local_interrupt_request(t30_state_t *s, int state)
 {
     if (s->timer_t3 > 0)
@@ -6222,6 +6674,20 @@ SPAN_DECLARE(int) t30_restart(t30_state_t *s)
     s->tx_page_number = 0;
     s->rtn_events = 0;
     s->rtp_events = 0;
+    s->call_samples = 0;
+    s->phase_start_samples = 0;
+    s->step_start_samples = 0;
+    memset(s->phase_samples, 0, sizeof(s->phase_samples));
+    s->tcf_samples = 0;
+    s->image_samples = 0;
+    s->first_page_samples = -1;
+    s->timing_page = 0;
+    s->tcfs = 0;
+    s->retrains = 0;
+    s->fallbacks = 0;
+    s->pps_rounds = 0;
+    s->pprs = 0;
+    s->last_rx_dcs_bit_rate = 0;
     s->local_interrupt_pending = FALSE;
     s->far_end_detected = FALSE;
     s->timer_t0_t1 = ms_to_samples(DEFAULT_TIMER_T0);
@@ -6239,6 +6705,214 @@ SPAN_DECLARE(int) t30_restart(t30_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void checkpoint_exchanged_info(t30_exchanged_info_t *info, checkpoint_t *c)
+{
+    checkpoint_field(c, info->ident);
+    checkpoint_field(c, info->sub_address);
+    checkpoint_field(c, info->selective_polling_address);
+    checkpoint_field(c, info->polled_sub_address);
+    checkpoint_field(c, info->sender_ident);
+    checkpoint_field(c, info->password);
+    checkpoint_field(c, info->nsf_len);
+    checkpoint_buffer(c, &info->nsf, info->nsf_len);
+    checkpoint_field(c, info->nsc_len);
+    checkpoint_buffer(c, &info->nsc, info->nsc_len);
+    checkpoint_field(c, info->nss_len);
+    checkpoint_buffer(c, &info->nss, info->nss_len);
+    checkpoint_field(c, info->tsa_type);
+    checkpoint_field(c, info->tsa_len);
+    checkpoint_buffer(c, &info->tsa, info->tsa_len);
+    checkpoint_field(c, info->ira_type);
+    checkpoint_field(c, info->ira_len);
+    checkpoint_buffer(c, &info->ira, info->ira_len);
+    checkpoint_field(c, info->cia_type);
+    checkpoint_field(c, info->cia_len);
+    checkpoint_buffer(c, &info->cia, info->cia_len);
+    checkpoint_field(c, info->isp_type);
+    checkpoint_field(c, info->isp_len);
+    checkpoint_buffer(c, &info->isp, info->isp_len);
+    checkpoint_field(c, info->csa_type);
+    checkpoint_field(c, info->csa_len);
+    checkpoint_buffer(c, &info->csa, info->csa_len);
+}
+/*- End of function --------------------------------------------------------*/
+
+void t30_checkpoint(t30_state_t *s, checkpoint_t *c)
+{
+    uint8_t have_ecm_data;
+
+    /* The handlers, and what we send about ourselves, are whatever the restoring
+       context was set up with. */
+    checkpoint_field(c, s->operation_in_progress);
+    checkpoint_field(c, s->calling_party);
+    checkpoint_field(c, s->iaf);
+    checkpoint_field(c, s->supported_modems);
+    checkpoint_field(c, s->supported_compressions);
+    checkpoint_field(c, s->supported_resolutions);
+    checkpoint_field(c, s->supported_image_sizes);
+    checkpoint_field(c, s->supported_t30_features);
+    checkpoint_field(c, s->ecm_allowed);
+    checkpoint_field(c, s->retransmit_capable);
+    checkpoint_field(c, s->rx_dcs_string);
+    checkpoint_field(c, s->header_info);
+    checkpoint_field(c, s->header_overlays_image);
+    checkpoint_field(c, s->tx_page_pre_encoding);
+    checkpoint_field(c, s->rx_page_background_writing);
+    checkpoint_field(c, s->remote_interrupts_allowed);
+    checkpoint_exchanged_info(&s->rx_info, c);
+    checkpoint_field(c, s->local_min_scan_time_code);
+    checkpoint_field(c, s->phase);
+    checkpoint_field(c, s->next_phase);
+    checkpoint_field(c, s->state);
+    checkpoint_field(c, s->step);
+    checkpoint_field(c, s->dcs_frame);
+    checkpoint_field(c, s->dcs_len);
+    checkpoint_field(c, s->local_dis_dtc_frame);
+    checkpoint_field(c, s->local_dis_dtc_len);
+    checkpoint_field(c, s->far_dis_dtc_frame);
+    checkpoint_field(c, s->far_dis_dtc_len);
+    checkpoint_field(c, s->dis_received);
+    checkpoint_field(c, s->short_train);
+    checkpoint_field(c, s->tcf_test_bits);
+    checkpoint_field(c, s->tcf_current_zeros);
+    checkpoint_field(c, s->tcf_most_zeros);
+    checkpoint_field(c, s->current_fallback);
+    checkpoint_field(c, s->current_permitted_modems);
+    checkpoint_field(c, s->rx_signal_present);
+    checkpoint_field(c, s->rx_trained);
+    checkpoint_field(c, s->rx_frame_received);
+    checkpoint_field(c, s->current_rx_type);
+    checkpoint_field(c, s->current_tx_type);
+    checkpoint_field(c, s->timer_t0_t1);
+    checkpoint_field(c, s->timer_t2_t4);
+    checkpoint_field(c, s->timer_t2_t4_is);
+    checkpoint_field(c, s->timer_t3);
+    checkpoint_field(c, s->timer_t5);
+    checkpoint_field(c, s->timer_t6);
+    checkpoint_field(c, s->timer_t7);
+    checkpoint_field(c, s->timer_t8);
+    checkpoint_field(c, s->far_end_detected);
+    checkpoint_field(c, s->local_interrupt_pending);
+    checkpoint_field(c, s->line_encoding);
+    checkpoint_field(c, s->output_encoding);
+    checkpoint_field(c, s->min_scan_time_code);
+    checkpoint_field(c, s->x_resolution);
+    checkpoint_field(c, s->y_resolution);
+    checkpoint_field(c, s->image_width);
+    checkpoint_field(c, s->retries);
+    checkpoint_field(c, s->error_correcting_mode);
+    checkpoint_field(c, s->error_correcting_mode_retries);
+    checkpoint_field(c, s->ppr_count);
+    checkpoint_field(c, s->receiver_not_ready_count);
+    checkpoint_field(c, s->octets_per_ecm_frame);
+    checkpoint_field(c, s->ecm_len);
+    checkpoint_field(c, s->ecm_frame_map);
+    checkpoint_field(c, s->rx_page_number);
+    checkpoint_field(c, s->tx_page_number);
+    checkpoint_field(c, s->ecm_block);
+    checkpoint_field(c, s->ecm_frames);
+    checkpoint_field(c, s->ecm_frames_this_tx_burst);
+    checkpoint_field(c, s->ecm_current_tx_frame);
+    checkpoint_field(c, s->ecm_at_page_end);
+    checkpoint_field(c, s->next_tx_step);
+    checkpoint_field(c, s->next_rx_step);
+    checkpoint_field(c, s->rx_file);
+    checkpoint_field(c, s->rx_stop_page);
+    checkpoint_field(c, s->tx_file);
+    checkpoint_field(c, s->tx_start_page);
+    checkpoint_field(c, s->tx_stop_page);
+    checkpoint_field(c, s->current_status);
+    checkpoint_field(c, s->rtp_events);
+    checkpoint_field(c, s->rtn_events);
+    checkpoint_field(c, s->call_samples);
+    checkpoint_field(c, s->phase_start_samples);
+    checkpoint_field(c, s->step_start_samples);
+    checkpoint_field(c, s->phase_samples);
+    checkpoint_field(c, s->tcf_samples);
+    checkpoint_field(c, s->image_samples);
+    checkpoint_field(c, s->timing_page);
+    checkpoint_field(c, s->first_page_samples);
+    checkpoint_field(c, s->tcfs);
+    checkpoint_field(c, s->retrains);
+    checkpoint_field(c, s->fallbacks);
+    checkpoint_field(c, s->pps_rounds);
+    checkpoint_field(c, s->pprs);
+    checkpoint_field(c, s->last_rx_dcs_bit_rate);
+    checkpoint_field(c, s->last_pps_fcf2);
+    checkpoint_field(c, s->rx_ecm_block_ok);
+    checkpoint_field(c, s->ecm_progress);
+    checkpoint_logging(c, &s->logging);
+
+    have_ecm_data = (s->ecm_data != NULL);
+    checkpoint_field(c, have_ecm_data);
+    if (have_ecm_data  &&  !c->failed)
+    {
+        /* ECM buffers come from the pool */
+        if (c->restoring  &&  get_ecm_buffer(s))
+        {
+            c->failed = TRUE;
+            return;
+        }
+        checkpoint_data(c, s->ecm_data, 256*sizeof(s->ecm_data[0]));
+    }
+    if (c->restoring)
+    {
+        /* The remote's make and model point into the tables of known machines */
+        if (s->rx_info.nsf)
+            t35_decode(s->rx_info.nsf, (int) s->rx_info.nsf_len, &s->country, &s->vendor, &s->model);
+        else
+            s->country = s->vendor = s->model = NULL;
+    }
+
+    switch (s->operation_in_progress)
+    {
+    case OPERATION_IN_PROGRESS_T4_TX:
+        t4_tx_checkpoint(&s->t4.tx, c);
+        if (c->restoring  &&  !c->failed)
+        {
+            t4_tx_set_local_ident(&s->t4.tx, s->tx_info.ident);
+            t4_tx_set_header_info(&s->t4.tx, s->header_info);
+            if (s->tx_page_pre_encoding  &&  t4_tx_set_pre_encoding(&s->t4.tx, TRUE))
+                span_log(&s->logging, SPAN_LOG_WARNING, "Background page encoding could not be started\n");
+        }
+        break;
+    case OPERATION_IN_PROGRESS_T4_RX:
+        t4_rx_checkpoint(&s->t4.rx, c);
+        if (c->restoring  &&  !c->failed)
+        {
+            /* The T.4 context's results are still looked at once a page is over, so
+               it is always pointed at our strings. */
+            t4_rx_set_sub_address(&s->t4.rx, s->rx_info.sub_address);
+            t4_rx_set_dcs(&s->t4.rx, s->rx_dcs_string);
+            t4_rx_set_far_ident(&s->t4.rx, s->rx_info.ident);
+            t4_rx_set_vendor(&s->t4.rx, s->vendor);
+            t4_rx_set_model(&s->t4.rx, s->model);
+            if (s->rx_page_background_writing)
+                t4_rx_set_background_writing(&s->t4.rx, TRUE);
+        }
+        break;
+    }
+    /* If the T.4 context could not be restored, it holds nothing which should be
+       tidied up with this context. */
+    if (c->restoring  &&  c->failed)
+        s->operation_in_progress = OPERATION_IN_PROGRESS_NONE;
+}
+/*- End of function --------------------------------------------------------*/
+
+void t30_checkpoint_handover(t30_state_t *s)
+{
+    switch (s->operation_in_progress)
+    {
+    case OPERATION_IN_PROGRESS_T4_TX:
+        t4_tx_checkpoint_handover(&s->t4.tx);
+        break;
+    case OPERATION_IN_PROGRESS_T4_RX:
+        t4_rx_checkpoint_handover(&s->t4.rx);
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(t30_state_t *) t30_init(t30_state_t *s,
                                      int calling_party,
                                      t30_set_handler_t *set_rx_type_handler,
@@ -6285,6 +6959,9 @@ SPAN_DECLARE(int) t30_release(t30_state_t *s)
     /* Make sure any FAX in progress is tidied up. If the tidying up has
        already happened, repeating it here is harmless. */
     terminate_operation_in_progress(s);
+    /* A context can be released part way through a call, such as once it has been
+       checkpointed, so the copies of the frames exchanged must go too. */
+    release_resources(s);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -35,6 +35,8 @@ extern "C"
 
 int t30_build_dis_or_dtc(t30_state_t *s);
 
+int t30_set_tx_pre_encoding(t30_state_t *s, int pre_encode);
+
 #if defined(__cplusplus)
 }
 #endif
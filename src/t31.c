@@ -92,6 +92,7 @@
 #include "spandsp/private/bitstream.h"
 #include "spandsp/private/t38_core.h"
 #include "spandsp/private/silence_gen.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 #include "spandsp/private/modem_connect_tones.h"
 #include "spandsp/private/v8.h"
@@ -1017,7 +1018,7 @@ static int stream_cng(t31_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
+static int send_timed_steps(t31_state_t *s, int samples)
 {
     t31_t38_front_end_state_t *fe;
     int delay;
@@ -1069,6 +1070,18 @@ SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t31_t38_send_timeout(t31_state_t *s, int samples)
+{
+    int ret;
+
+    ret = send_timed_steps(s, samples);
+    /* Release any held received packets whose time is up, and send anything due from
+       the batched transmit schedule */
+    t38_core_timer_update(&s->t38_fe.t38, samples);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int t31_modem_control_handler(at_state_t *s, void *user_data, int op, const char *num)
 {
     t31_state_t *t;
@@ -1303,7 +1316,6 @@ static int non_ecm_get_chunk(void *user_data, uint8_t buf[], int len)
                 s->tx.final = FALSE;
                 /* This will put the modem into its shutdown sequence. When
                    it has finally shut down, an OK response will be sent. */
-                //return SIG_STATUS_END_OF_DATA;
                 return i;
             }
             /* Fill with 0xFF bytes at the start of transmission, or 0x00 if we are in
@@ -1678,6 +1690,7 @@ static int restart_modem(t31_state_t *s, int new_modem)
         else
         {
             v17_tx_restart(&t->v17_tx, s->bit_rate, FALSE, s->short_train);
+            v17_tx_set_get_chunk(&t->v17_tx, non_ecm_get_chunk, (void *) s, TRUE);
             set_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->v17_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
@@ -1715,6 +1728,7 @@ static int restart_modem(t31_state_t *s, int new_modem)
         else
         {
             v27ter_tx_restart(&t->v27ter_tx, s->bit_rate, FALSE);
+            v27ter_tx_set_get_chunk(&t->v27ter_tx, non_ecm_get_chunk, (void *) s, TRUE);
             set_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->v27ter_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
@@ -1752,6 +1766,7 @@ static int restart_modem(t31_state_t *s, int new_modem)
         else
         {
             v29_tx_restart(&t->v29_tx, s->bit_rate, FALSE);
+            v29_tx_set_get_chunk(&t->v29_tx, non_ecm_get_chunk, (void *) s, TRUE);
             set_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->v29_tx);
             set_next_tx_handler(s, (span_tx_handler_t *) NULL, NULL);
         }
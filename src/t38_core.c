@@ -54,8 +54,13 @@
 #include "spandsp/private/logging.h"
 #include "spandsp/private/t38_core.h"
 
+#include "checkpoint_local.h"
+
 #define ACCEPTABLE_SEQ_NO_OFFSET    2000
 
+/* The largest number of datagrams passed to a batched transmit handler in one call */
+#define T38_TX_BATCH_MAX            32
+
 /* The times for training, the optional TEP, and the HDLC preamble, for all the modem options, in ms.
    Note that the preamble for V.21 is 1s+-15%, and for the other modems is 200ms+100ms. */
 static const struct
@@ -325,7 +330,7 @@ static __inline__ int classify_seq_no_offset(int expected, int actual)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no)
+static int rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no)
 {
     int i;
     int t30_indicator;
@@ -614,6 +619,152 @@ SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf
 }
 /*- End of function --------------------------------------------------------*/
 
+static t38_rx_held_packet_t *earliest_held_packet(t38_core_state_t *s)
+{
+    t38_rx_held_packet_t *earliest;
+    int earliest_offset;
+    int offset;
+    int i;
+
+    earliest = NULL;
+    earliest_offset = 0x10000;
+    for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+    {
+        if (s->rx_held[i].len > 0)
+        {
+            offset = (s->rx_held[i].seq_no - s->rx_expected_seq_no) & 0xFFFF;
+            if (offset < earliest_offset)
+            {
+                earliest = &s->rx_held[i];
+                earliest_offset = offset;
+            }
+        }
+    }
+    return earliest;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void release_held_packet(t38_core_state_t *s, t38_rx_held_packet_t *slot)
+{
+    int len;
+
+    /* The slot is only reused by a later packet, so its contents remain valid while the
+       packet is processed. */
+    len = slot->len;
+    slot->len = 0;
+    rx_ifp_packet(s, slot->buf, len, slot->seq_no);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void release_held_in_sequence(t38_core_state_t *s)
+{
+    int i;
+
+    /* Pass on any held packets which have become the next in sequence */
+    i = 0;
+    while (i < T38_RX_REORDER_SLOTS)
+    {
+        if (s->rx_held[i].len > 0  &&  s->rx_held[i].seq_no == s->rx_expected_seq_no)
+        {
+            release_held_packet(s, &s->rx_held[i]);
+            s->reordered_packets++;
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void release_all_held(t38_core_state_t *s)
+{
+    t38_rx_held_packet_t *slot;
+
+    /* Give up waiting for the gaps to fill, and pass on everything held, in sequence order.
+       The packets still missing are reported in the usual way. */
+    while ((slot = earliest_held_packet(s)))
+    {
+        release_held_packet(s, slot);
+        release_held_in_sequence(s);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_rx_ifp_packet(t38_core_state_t *s, const uint8_t *buf, int len, uint16_t seq_no)
+{
+    t38_rx_held_packet_t *slot;
+    int free_slot;
+    int offset;
+    int res;
+    int i;
+
+    if (s->rx_reorder_hold <= 0
+        ||
+        !s->check_sequence_numbers
+        ||
+        s->rx_expected_seq_no == -1
+        ||
+        len < 1)
+    {
+        return rx_ifp_packet(s, buf, len, seq_no);
+    }
+    if (seq_no != s->rx_expected_seq_no)
+    {
+        switch (classify_seq_no_offset(s->rx_expected_seq_no, seq_no))
+        {
+        case 1:
+            /* This packet is in the near future. The packets which should precede it may
+               just be running late, so hold this one for a while, to give them a chance to
+               slot in ahead of it. */
+            free_slot = -1;
+            for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+            {
+                if (s->rx_held[i].len == 0)
+                {
+                    if (free_slot < 0)
+                        free_slot = i;
+                }
+                else if (s->rx_held[i].seq_no == seq_no)
+                {
+                    span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Repeat of held packet\n", seq_no);
+                    return 0;
+                }
+            }
+            if (free_slot >= 0  &&  len <= T38_RX_REORDER_MAX_LEN)
+            {
+                span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Held - expected %d\n", seq_no, s->rx_expected_seq_no);
+                slot = &s->rx_held[free_slot];
+                memcpy(slot->buf, buf, len);
+                slot->len = len;
+                slot->seq_no = seq_no;
+                slot->deadline = s->rx_reorder_samples + s->rx_reorder_hold;
+                return 0;
+            }
+            /* There is nowhere to hold this packet, so stop waiting for the packets which
+               should precede it. */
+            offset = (seq_no - s->rx_expected_seq_no) & 0xFFFF;
+            while ((slot = earliest_held_packet(s))
+                   &&
+                   ((slot->seq_no - s->rx_expected_seq_no) & 0xFFFF) < offset)
+            {
+                release_held_packet(s, slot);
+                release_held_in_sequence(s);
+                offset = (seq_no - s->rx_expected_seq_no) & 0xFFFF;
+            }
+            break;
+        case 0:
+            /* The sequence has jumped wildly, so nothing being held will ever fit in */
+            for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+                s->rx_held[i].len = 0;
+            break;
+        }
+    }
+    res = rx_ifp_packet(s, buf, len, seq_no);
+    release_held_in_sequence(s);
+    return res;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int t38_encode_indicator(t38_core_state_t *s, uint8_t buf[], int indicator)
 {
     int len;
@@ -775,6 +926,201 @@ static int t38_encode_data(t38_core_state_t *s, uint8_t buf[], int data_type, co
 }
 /*- End of function --------------------------------------------------------*/
 
+static int send_batch(t38_core_state_t *s, t38_tx_datagram_t datagrams[], unsigned int serials[], int n)
+{
+    t38_tx_datagram_t datagram;
+    unsigned int serial;
+    int i;
+    int j;
+
+    /* Put the batch in the order the datagrams should go out. Insertion sort is fine for
+       such short lists. */
+    for (i = 1;  i < n;  i++)
+    {
+        datagram = datagrams[i];
+        serial = serials[i];
+        for (j = i;  j > 0;  j--)
+        {
+            if (datagrams[j - 1].offset < datagram.offset
+                ||
+                (datagrams[j - 1].offset == datagram.offset  &&  (int) (serials[j - 1] - serial) < 0))
+            {
+                break;
+            }
+            datagrams[j] = datagrams[j - 1];
+            serials[j] = serials[j - 1];
+        }
+        datagrams[j] = datagram;
+        serials[j] = serial;
+    }
+    return s->tx_packet_batch_handler(s, s->tx_packet_batch_user_data, datagrams, n);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tx_packet(t38_core_state_t *s, const uint8_t buf[], int len, int count)
+{
+    t38_tx_scheduled_packet_t *slot;
+    t38_tx_datagram_t datagrams[T38_TX_BATCH_MAX];
+    unsigned int serials[T38_TX_BATCH_MAX];
+    int i;
+    int n;
+
+    if (s->tx_packet_batch_handler == NULL)
+        return s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, count);
+    /* Only the low byte of the setting is a count of copies. Anything else is information
+       for a transport which handles its own repeats. */
+    if ((count &= 0xFF) == 0)
+        return 0;
+    if (len <= T38_TX_SCHEDULE_MAX_LEN)
+    {
+        for (i = 0;  i < T38_TX_SCHEDULE_SLOTS;  i++)
+        {
+            slot = &s->tx_schedule[i];
+            if (slot->remaining == 0)
+            {
+                memcpy(slot->buf, buf, len);
+                slot->len = len;
+                slot->seq_no = s->tx_seq_no;
+                slot->remaining = count;
+                slot->next_due = s->tx_schedule_samples;
+                slot->serial = s->tx_schedule_serial++;
+                return 0;
+            }
+        }
+    }
+    /* There is nowhere to hold the packet, so pass all its copies to the application now,
+       with their proper offsets. */
+    span_log(&s->logging, SPAN_LOG_FLOW, "Tx %5d: cannot be scheduled - sending %d copies now\n", s->tx_seq_no, count);
+    for (i = 0, n = 0;  i < count;  i++)
+    {
+        datagrams[n].buf = buf;
+        datagrams[n].len = len;
+        datagrams[n].seq_no = s->tx_seq_no;
+        datagrams[n].offset = i*s->tx_repeat_spacing;
+        serials[n] = i;
+        if (++n >= T38_TX_BATCH_MAX)
+        {
+            send_batch(s, datagrams, serials, n);
+            n = 0;
+        }
+    }
+    if (n > 0)
+        send_batch(s, datagrams, serials, n);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_send_scheduled(t38_core_state_t *s, int samples)
+{
+    t38_tx_scheduled_packet_t *slot;
+    t38_tx_datagram_t datagrams[T38_TX_BATCH_MAX];
+    unsigned int serials[T38_TX_BATCH_MAX];
+    uint32_t end;
+    int32_t offset;
+    int sent;
+    int n;
+    int i;
+
+    if (s->tx_packet_batch_handler == NULL)
+        return 0;
+    end = s->tx_schedule_samples + samples;
+    sent = 0;
+    n = 0;
+    for (i = 0;  i < T38_TX_SCHEDULE_SLOTS;  i++)
+    {
+        slot = &s->tx_schedule[i];
+        while (slot->remaining > 0  &&  (int32_t) (slot->next_due - end) < 0)
+        {
+            datagrams[n].buf = slot->buf;
+            datagrams[n].len = slot->len;
+            datagrams[n].seq_no = slot->seq_no;
+            offset = (int32_t) (slot->next_due - s->tx_schedule_samples);
+            datagrams[n].offset = (offset > 0)  ?  offset  :  0;
+            serials[n] = slot->serial;
+            /* The slot is only reused by a later packet, so its contents remain valid until
+               the batch has been sent. */
+            slot->remaining--;
+            slot->next_due += s->tx_repeat_spacing;
+            if (++n >= T38_TX_BATCH_MAX)
+            {
+                send_batch(s, datagrams, serials, n);
+                sent += n;
+                n = 0;
+            }
+        }
+    }
+    if (n > 0)
+    {
+        send_batch(s, datagrams, serials, n);
+        sent += n;
+    }
+    s->tx_schedule_samples = end;
+    return sent;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_next_timer_expiry(t38_core_state_t *s)
+{
+    int next;
+    int due;
+    int i;
+
+    next = -1;
+    for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+    {
+        if (s->rx_held[i].len > 0)
+        {
+            due = (int32_t) (s->rx_held[i].deadline - s->rx_reorder_samples);
+            if (due < 0)
+                due = 0;
+            if (next < 0  ||  due < next)
+                next = due;
+        }
+    }
+    if (s->tx_packet_batch_handler)
+    {
+        for (i = 0;  i < T38_TX_SCHEDULE_SLOTS;  i++)
+        {
+            if (s->tx_schedule[i].remaining > 0)
+            {
+                /* A datagram is sent by the tick which takes the clock past its due time */
+                due = (int32_t) (s->tx_schedule[i].next_due - s->tx_schedule_samples) + 1;
+                if (due < 0)
+                    due = 0;
+                if (next < 0  ||  due < next)
+                    next = due;
+            }
+        }
+    }
+    return next;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_core_timer_update(t38_core_state_t *s, int samples)
+{
+    t38_rx_held_packet_t *slot;
+    int i;
+
+    s->rx_reorder_samples += samples;
+    for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+    {
+        if (s->rx_held[i].len > 0  &&  (int32_t) (s->rx_held[i].deadline - s->rx_reorder_samples) <= 0)
+        {
+            /* We have waited long enough for the packets which should precede this one.
+               Pass on everything up to, and including, this one, in sequence order. The
+               packets still missing are reported in the usual way. */
+            span_log(&s->logging, SPAN_LOG_FLOW, "Rx %5d: Hold time expired - expected %d\n", s->rx_held[i].seq_no, s->rx_expected_seq_no);
+            while (s->rx_held[i].len > 0  &&  (slot = earliest_held_packet(s)))
+            {
+                release_held_packet(s, slot);
+                release_held_in_sequence(s);
+            }
+        }
+    }
+    return t38_core_send_scheduled(s, samples);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t38_core_send_indicator(t38_core_state_t *s, int indicator)
 {
     uint8_t buf[100];
@@ -799,7 +1145,7 @@ SPAN_DECLARE(int) t38_core_send_indicator(t38_core_state_t *s, int indicator)
                 return len;
             }
             span_log(&s->logging, SPAN_LOG_FLOW, "Tx %5d: indicator %s\n", s->tx_seq_no, t38_indicator_to_str(indicator));
-            s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, transmissions);
+            tx_packet(s, buf, len, transmissions);
             s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
             delay = modem_startup_time[indicator].training;
             if (s->allow_for_tep)
@@ -837,7 +1183,7 @@ SPAN_DECLARE(int) t38_core_send_data(t38_core_state_t *s, int data_type, int fie
         span_log(&s->logging, SPAN_LOG_FLOW, "T.38 data len is %d\n", len);
         return len;
     }
-    s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, s->category_control[category]);
+    tx_packet(s, buf, len, s->category_control[category]);
     s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
     return 0;
 }
@@ -853,7 +1199,7 @@ SPAN_DECLARE(int) t38_core_send_data_multi_field(t38_core_state_t *s, int data_t
         span_log(&s->logging, SPAN_LOG_FLOW, "T.38 data len is %d\n", len);
         return len;
     }
-    s->tx_packet_handler(s, s->tx_packet_user_data, buf, len, s->category_control[category]);
+    tx_packet(s, buf, len, s->category_control[category]);
     s->tx_seq_no = (s->tx_seq_no + 1) & 0xFFFF;
     return 0;
 }
@@ -913,6 +1259,17 @@ SPAN_DECLARE(void) t38_set_sequence_number_handling(t38_core_state_t *s, int che
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t38_set_rx_reorder_hold_time(t38_core_state_t *s, int samples)
+{
+    if (samples <= 0)
+    {
+        release_all_held(s);
+        samples = 0;
+    }
+    s->rx_reorder_hold = samples;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_set_tep_handling(t38_core_state_t *s, int allow_for_tep)
 {
     s->allow_for_tep = allow_for_tep;
@@ -937,6 +1294,22 @@ SPAN_DECLARE(int) t38_get_fastest_image_data_rate(t38_core_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t38_core_set_tx_packet_batch_handler(t38_core_state_t *s,
+                                                        t38_tx_packet_batch_handler_t *handler,
+                                                        void *user_data,
+                                                        int repeat_spacing)
+{
+    int i;
+
+    /* Anything still waiting for the old handler is dropped */
+    for (i = 0;  i < T38_TX_SCHEDULE_SLOTS;  i++)
+        s->tx_schedule[i].remaining = 0;
+    s->tx_packet_batch_handler = handler;
+    s->tx_packet_batch_user_data = user_data;
+    s->tx_repeat_spacing = (repeat_spacing > 0)  ?  repeat_spacing  :  0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(logging_state_t *) t38_core_get_logging_state(t38_core_state_t *s)
 {
     return &s->logging;
@@ -945,6 +1318,8 @@ SPAN_DECLARE(logging_state_t *) t38_core_get_logging_state(t38_core_state_t *s)
 
 SPAN_DECLARE(int) t38_core_restart(t38_core_state_t *s)
 {
+    int i;
+
     /* Set the initial current receive states to something invalid, so the
        first data received is seen as a change of state. */
     s->current_rx_indicator = -1;
@@ -959,6 +1334,8 @@ SPAN_DECLARE(int) t38_core_restart(t38_core_state_t *s)
        They most often start at 0 or 1 for a UDPTL transport, but random
        starting numbers are possible. */
     s->rx_expected_seq_no = -1;
+    for (i = 0;  i < T38_RX_REORDER_SLOTS;  i++)
+        s->rx_held[i].len = 0;
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1024,4 +1401,38 @@ SPAN_DECLARE(int) t38_core_free(t38_core_state_t *s)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void t38_core_checkpoint(t38_core_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->tx_repeat_spacing);
+    checkpoint_field(c, s->tx_schedule_samples);
+    checkpoint_field(c, s->tx_schedule_serial);
+    checkpoint_field(c, s->tx_schedule);
+    checkpoint_field(c, s->data_rate_management_method);
+    checkpoint_field(c, s->data_transport_protocol);
+    checkpoint_field(c, s->fill_bit_removal);
+    checkpoint_field(c, s->mmr_transcoding);
+    checkpoint_field(c, s->jbig_transcoding);
+    checkpoint_field(c, s->max_buffer_size);
+    checkpoint_field(c, s->max_datagram_size);
+    checkpoint_field(c, s->t38_version);
+    checkpoint_field(c, s->allow_for_tep);
+    checkpoint_field(c, s->fastest_image_data_rate);
+    checkpoint_field(c, s->category_control);
+    checkpoint_field(c, s->check_sequence_numbers);
+    checkpoint_field(c, s->tx_seq_no);
+    checkpoint_field(c, s->rx_expected_seq_no);
+    checkpoint_field(c, s->current_rx_indicator);
+    checkpoint_field(c, s->current_rx_data_type);
+    checkpoint_field(c, s->current_rx_field_type);
+    checkpoint_field(c, s->current_tx_indicator);
+    checkpoint_field(c, s->v34_rate);
+    checkpoint_field(c, s->rx_reorder_hold);
+    checkpoint_field(c, s->rx_reorder_samples);
+    checkpoint_field(c, s->rx_held);
+    checkpoint_field(c, s->reordered_packets);
+    checkpoint_field(c, s->missing_packets);
+    checkpoint_logging(c, &s->logging);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
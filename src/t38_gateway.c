@@ -71,6 +71,7 @@
 #include "spandsp/v17rx.h"
 #include "spandsp/super_tone_rx.h"
 #include "spandsp/modem_connect_tones.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -90,6 +91,7 @@
 
 #include "spandsp/private/logging.h"
 #include "spandsp/private/silence_gen.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/fsk.h"
 #include "spandsp/private/v17tx.h"
 #include "spandsp/private/v17rx.h"
@@ -106,6 +108,7 @@
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 #include "spandsp/private/t30.h"
@@ -113,6 +116,8 @@
 #include "spandsp/private/t38_non_ecm_buffer.h"
 #include "spandsp/private/t38_gateway.h"
 
+#include "checkpoint_local.h"
+
 /* This is the target time per transmission chunk. The actual
    packet timing will sync to the data octets. */
 /*! The default number of milliseconds per transmitted IFP when sending bulk T.38 data */
@@ -129,6 +134,26 @@
 /*! The number of transmissions of terminating data IFP packets */
 #define DATA_END_TX_COUNT                       3
 
+/*! The shortest packet interval used by adaptive packetisation, in ms */
+#define ADAPTIVE_MIN_MS_PER_TX_CHUNK            20
+/*! The longest packet interval used by adaptive packetisation, in ms */
+#define ADAPTIVE_MAX_MS_PER_TX_CHUNK            60
+/*! The one way delay, in ms, which adaptive packetisation tries not to exceed, by trading the
+    packet interval against the delay in the network */
+#define ADAPTIVE_DELAY_BUDGET_MS                150
+/*! The minimum number of packets over which the T.38 core's missing packet count is used to
+    estimate the packet loss rate */
+#define ADAPTIVE_MIN_LOSS_SAMPLE                50
+/*! The packet loss, in per cent, at which adaptive packetisation starts sending data packets
+    more than once */
+#define ADAPTIVE_LOW_LOSS_PERCENT               1
+/*! The number of transmissions of data IFP packets at low packet loss */
+#define ADAPTIVE_LOW_LOSS_DATA_TX_COUNT         2
+/*! The packet loss, in per cent, at which adaptive packetisation sends data packets still more times */
+#define ADAPTIVE_HIGH_LOSS_PERCENT              5
+/*! The number of transmissions of data IFP packets at high packet loss */
+#define ADAPTIVE_HIGH_LOSS_DATA_TX_COUNT        3
+
 enum
 {
     DISBIT1 = 0x01,
@@ -192,6 +217,7 @@ static void hdlc_underflow_handler(void *user_data);
 static void to_t38_buffer_init(t38_gateway_to_t38_state_t *s);
 static void t38_hdlc_rx_put_bit(hdlc_rx_state_t *t, int new_bit);
 static void non_ecm_put_bit(void *user_data, int bit);
+static void non_ecm_put_chunk(void *user_data, const uint8_t buf[], int len);
 static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit);
 static void non_ecm_push_residue(t38_gateway_state_t *s);
 static void tone_detected(void *user_data, int tone, int level, int delay);
@@ -416,62 +442,32 @@ static void hdlc_underflow_handler(void *user_data)
 }
 /*- End of function --------------------------------------------------------*/
 
-static int set_next_tx_type(t38_gateway_state_t *s)
+static void set_tx_type(t38_gateway_state_t *s, int indicator)
 {
     get_bit_func_t get_bit_func;
+    get_chunk_func_t get_chunk_func;
     void *get_bit_user_data;
-    int indicator;
     int short_train;
     fax_modems_state_t *t;
     t38_gateway_hdlc_state_t *u;
 
     t = &s->audio.modems;
-    t38_non_ecm_buffer_report_output_status(&s->core.non_ecm_to_modem, &s->logging);
-    if (t->next_tx_handler)
-    {
-        /* There is a handler queued, so that is the next one. */
-        set_tx_handler(s, t->next_tx_handler, t->next_tx_user_data);
-        set_next_tx_handler(s, NULL, NULL);
-        if (t->tx_handler == (span_tx_handler_t *) &(silence_gen)
-            ||
-            t->tx_handler == (span_tx_handler_t *) &(tone_gen))
-        {
-            set_rx_active(s, TRUE);
-        }
-        else
-        {
-            set_rx_active(s, FALSE);
-        }
-        /*endif*/
-        return TRUE;
-    }
-    /*endif*/
     u = &s->core.hdlc_to_modem;
-    if (u->in == u->out)
-        return FALSE;
-    /*endif*/
-    if ((u->buf[u->out].contents & FLAG_INDICATOR) == 0)
-        return FALSE;
-    /*endif*/
-    indicator = (u->buf[u->out].contents & 0xFF);
-    u->buf[u->out].len = 0;
-    u->buf[u->out].flags = 0;
-    u->buf[u->out].contents = 0;
-    if (++u->out >= T38_TX_HDLC_BUFS)
-        u->out = 0;
-    /*endif*/
     span_log(&s->logging, SPAN_LOG_FLOW, "Changing to %s\n", t38_indicator_to_str(indicator));
     if (s->core.image_data_mode  &&  s->core.ecm_mode)
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "HDLC mode\n");
         hdlc_tx_init(&t->hdlc_tx, FALSE, 2, TRUE, hdlc_underflow_handler, s);
         get_bit_func = (get_bit_func_t) hdlc_tx_get_bit;
+        get_chunk_func = NULL;
         get_bit_user_data = (void *) &t->hdlc_tx;
     }
     else
     {
         span_log(&s->logging, SPAN_LOG_FLOW, "Non-ECM mode\n");
+        /* The fast modems take non-ECM data from the buffer a chunk of octets at a time */
         get_bit_func = t38_non_ecm_buffer_get_bit;
+        get_chunk_func = t38_non_ecm_buffer_get_chunk;
         get_bit_user_data = (void *) &s->core.non_ecm_to_modem;
     }
     /*endif*/
@@ -526,6 +522,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v27ter_tx_restart(&t->v27ter_tx, t->tx_bit_rate, t->use_tep);
         v27ter_tx_set_get_bit(&t->v27ter_tx, get_bit_func, get_bit_user_data);
+        v27ter_tx_set_get_chunk(&t->v27ter_tx, get_chunk_func, get_bit_user_data, FALSE);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v27ter_tx, &t->v27ter_tx);
         set_rx_active(s, TRUE);
@@ -545,6 +542,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v29_tx_restart(&t->v29_tx, t->tx_bit_rate, t->use_tep);
         v29_tx_set_get_bit(&t->v29_tx, get_bit_func, get_bit_user_data);
+        v29_tx_set_get_chunk(&t->v29_tx, get_chunk_func, get_bit_user_data, FALSE);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v29_tx, &t->v29_tx);
         set_rx_active(s, TRUE);
@@ -593,6 +591,7 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         silence_gen_alter(&t->silence_gen, ms_to_samples(75));
         v17_tx_restart(&t->v17_tx, t->tx_bit_rate, t->use_tep, short_train);
         v17_tx_set_get_bit(&t->v17_tx, get_bit_func, get_bit_user_data);
+        v17_tx_set_get_chunk(&t->v17_tx, get_chunk_func, get_bit_user_data, FALSE);
         set_tx_handler(s, (span_tx_handler_t *) &silence_gen, &t->silence_gen);
         set_next_tx_handler(s, (span_tx_handler_t *) &v17_tx, &t->v17_tx);
         set_rx_active(s, TRUE);
@@ -627,6 +626,51 @@ static int set_next_tx_type(t38_gateway_state_t *s)
         hdlc_tx_flags(&t->hdlc_tx, t->tx_bit_rate/(8*5));
     /*endif*/
     s->t38x.in_progress_rx_indicator = indicator;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int set_next_tx_type(t38_gateway_state_t *s)
+{
+    int indicator;
+    fax_modems_state_t *t;
+    t38_gateway_hdlc_state_t *u;
+
+    t = &s->audio.modems;
+    t38_non_ecm_buffer_report_output_status(&s->core.non_ecm_to_modem, &s->logging);
+    if (t->next_tx_handler)
+    {
+        /* There is a handler queued, so that is the next one. */
+        set_tx_handler(s, t->next_tx_handler, t->next_tx_user_data);
+        set_next_tx_handler(s, NULL, NULL);
+        if (t->tx_handler == (span_tx_handler_t *) &(silence_gen)
+            ||
+            t->tx_handler == (span_tx_handler_t *) &(tone_gen))
+        {
+            set_rx_active(s, TRUE);
+        }
+        else
+        {
+            set_rx_active(s, FALSE);
+        }
+        /*endif*/
+        return TRUE;
+    }
+    /*endif*/
+    u = &s->core.hdlc_to_modem;
+    if (u->in == u->out)
+        return FALSE;
+    /*endif*/
+    if ((u->buf[u->out].contents & FLAG_INDICATOR) == 0)
+        return FALSE;
+    /*endif*/
+    indicator = (u->buf[u->out].contents & 0xFF);
+    u->buf[u->out].len = 0;
+    u->buf[u->out].flags = 0;
+    u->buf[u->out].contents = 0;
+    if (++u->out >= T38_TX_HDLC_BUFS)
+        u->out = 0;
+    /*endif*/
+    set_tx_type(s, indicator);
     return TRUE;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1563,12 +1607,130 @@ static int process_rx_data(t38_core_state_t *t, void *user_data, int data_type,
 }
 /*- End of function --------------------------------------------------------*/
 
-static void set_octets_per_data_packet(t38_gateway_state_t *s, int bit_rate)
+static int measured_loss(t38_gateway_state_t *s)
+{
+    t38_core_state_t *t;
+    int packets;
+    int missing;
+
+    /* Estimate the loss rate, in per cent, from the packets the T.38 core has found missing
+       since the last estimate. */
+    t = &s->t38x.t38;
+    if (t->rx_expected_seq_no < 0)
+        return s->core.measured_loss;
+    /*endif*/
+    if (s->core.loss_sample_seq_no < 0)
+    {
+        s->core.loss_sample_seq_no = t->rx_expected_seq_no;
+        s->core.loss_sample_missing = t->missing_packets;
+        return s->core.measured_loss;
+    }
+    /*endif*/
+    packets = (t->rx_expected_seq_no - s->core.loss_sample_seq_no) & 0xFFFF;
+    if (packets >= ADAPTIVE_MIN_LOSS_SAMPLE)
+    {
+        missing = t->missing_packets - s->core.loss_sample_missing;
+        if (missing < 0)
+            missing = 0;
+        else if (missing > packets)
+            missing = packets;
+        /*endif*/
+        s->core.measured_loss = 100*missing/packets;
+        s->core.loss_sample_seq_no = t->rx_expected_seq_no;
+        s->core.loss_sample_missing = t->missing_packets;
+    }
+    /*endif*/
+    return s->core.measured_loss;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int adapted_redundancy_control(int host_setting, int count)
+{
+    /* Only the low byte of a redundancy setting is a copy count. Anything above it is for the
+       transport, and is kept as the application set it. */
+    if (count > (host_setting & 0xFF))
+        return (host_setting & ~0xFF) | count;
+    /*endif*/
+    return host_setting;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void adapt_packetisation(t38_gateway_state_t *s)
+{
+    int loss;
+    int ms;
+    int count;
+
+    if (!s->core.adaptive_packetisation)
+        return;
+    /*endif*/
+    loss = measured_loss(s);
+    if (s->core.reported_loss > loss)
+        loss = s->core.reported_loss;
+    /*endif*/
+    /* Longer packets mean fewer packets per second, but they add to the delay. Use whatever
+       part of the delay budget the network leaves unused. */
+    if (s->core.reported_delay < 0)
+    {
+        ms = DEFAULT_MS_PER_TX_CHUNK;
+    }
+    else
+    {
+        ms = ADAPTIVE_DELAY_BUDGET_MS - s->core.reported_delay;
+        if (ms < ADAPTIVE_MIN_MS_PER_TX_CHUNK)
+            ms = ADAPTIVE_MIN_MS_PER_TX_CHUNK;
+        else if (ms > ADAPTIVE_MAX_MS_PER_TX_CHUNK)
+            ms = ADAPTIVE_MAX_MS_PER_TX_CHUNK;
+        /*endif*/
+    }
+    /*endif*/
+    /* Send the data packets more than once when the loss becomes significant. */
+    if (loss >= ADAPTIVE_HIGH_LOSS_PERCENT)
+        count = ADAPTIVE_HIGH_LOSS_DATA_TX_COUNT;
+    else if (loss >= ADAPTIVE_LOW_LOSS_PERCENT)
+        count = ADAPTIVE_LOW_LOSS_DATA_TX_COUNT;
+    else
+        count = DATA_TX_COUNT;
+    /*endif*/
+    if (ms != s->core.ms_per_tx_chunk  ||  count != s->core.data_tx_count)
+    {
+        span_log(&s->logging,
+                 SPAN_LOG_FLOW,
+                 "Packetisation now %dms, data sent %d times (loss %d%%, delay %dms)\n",
+                 ms,
+                 count,
+                 loss,
+                 s->core.reported_delay);
+        s->core.ms_per_tx_chunk = ms;
+        s->core.data_tx_count = count;
+        /* Never send data fewer times than the application asked for */
+        t38_set_redundancy_control(&s->t38x.t38,
+                                   T38_PACKET_CATEGORY_CONTROL_DATA,
+                                   adapted_redundancy_control(s->core.host_control_data_tx_count, count));
+        t38_set_redundancy_control(&s->t38x.t38,
+                                   T38_PACKET_CATEGORY_IMAGE_DATA,
+                                   adapted_redundancy_control(s->core.host_image_data_tx_count, count));
+    }
+    /*endif*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void set_octets_per_data_packet(t38_gateway_state_t *s, int bit_rate, int ms_per_tx_chunk)
 {
     int octets;
+    int max_octets;
     
-    //octets = s->core.ms_per_tx_chunk*bit_rate/(8*1000);
-    octets = DEFAULT_MS_PER_TX_CHUNK*bit_rate/(8*1000);
+    octets = ms_per_tx_chunk*bit_rate/(8*1000);
+    if (s->core.adaptive_packetisation)
+    {
+        /* Don't let longer packets outgrow what the far end will accept. Allow a little
+           for the IFP header. */
+        max_octets = s->t38x.t38.max_datagram_size - 10;
+        if (max_octets > 0  &&  octets > max_octets)
+            octets = max_octets;
+        /*endif*/
+    }
+    /*endif*/
     if (octets < 1)
         octets = 1;
     /*endif*/
@@ -1578,7 +1740,10 @@ static void set_octets_per_data_packet(t38_gateway_state_t *s, int bit_rate)
 
 static int set_slow_packetisation(t38_gateway_state_t *s)
 {
-    set_octets_per_data_packet(s, 300);
+    adapt_packetisation(s);
+    /* V.21 control messages are always timed at the default interval, as they are the
+       most sensitive to delay. */
+    set_octets_per_data_packet(s, 300, DEFAULT_MS_PER_TX_CHUNK);
     s->t38x.current_tx_data_type = T38_DATA_V21;
     return T38_IND_V21_PREAMBLE;
 }
@@ -1589,10 +1754,11 @@ static int set_fast_packetisation(t38_gateway_state_t *s)
     int ind;
 
     ind = T38_IND_NO_SIGNAL;
+    adapt_packetisation(s);
     switch (s->core.fast_rx_active)
     {
     case T38_V17_RX:
-        set_octets_per_data_packet(s, s->core.fast_bit_rate);
+        set_octets_per_data_packet(s, s->core.fast_bit_rate, s->core.ms_per_tx_chunk);
         switch (s->core.fast_bit_rate)
         {
         case 7200:
@@ -1616,7 +1782,7 @@ static int set_fast_packetisation(t38_gateway_state_t *s)
         /*endswitch*/
         break;
     case T38_V27TER_RX:
-        set_octets_per_data_packet(s, s->core.fast_bit_rate);
+        set_octets_per_data_packet(s, s->core.fast_bit_rate, s->core.ms_per_tx_chunk);
         switch (s->core.fast_bit_rate)
         {
         case 2400:
@@ -1632,7 +1798,7 @@ static int set_fast_packetisation(t38_gateway_state_t *s)
         /*endswitch*/
         break;
     case T38_V29_RX:
-        set_octets_per_data_packet(s, s->core.fast_bit_rate);
+        set_octets_per_data_packet(s, s->core.fast_bit_rate, s->core.ms_per_tx_chunk);
         switch (s->core.fast_bit_rate)
         {
         case 7200:
@@ -1803,6 +1969,45 @@ static void non_ecm_put_bit(void *user_data, int bit)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void non_ecm_put_chunk(void *user_data, const uint8_t buf[], int len)
+{
+    t38_gateway_state_t *t;
+    t38_gateway_to_t38_state_t *s;
+    int i;
+    int j;
+
+    t = (t38_gateway_state_t *) user_data;
+    s = &t->core.to_t38;
+
+    /* The modem packs the bits MSB first, just as non_ecm_put_bit() does. */
+    if (s->bit_no)
+    {
+        /* Some odd bits have come through non_ecm_put_bit(), so we are not octet
+           aligned. This should not happen, but if it does we must not lose or
+           reorder anything. */
+        for (i = 0;  i < len;  i++)
+        {
+            for (j = 7;  j >= 0;  j--)
+                non_ecm_put_bit(user_data, (buf[i] >> j) & 1);
+            /*endfor*/
+        }
+        /*endfor*/
+        return;
+    }
+    /*endif*/
+    s->in_bits += 8*len;
+    for (i = 0;  i < len;  i++)
+    {
+        s->bit_stream = (s->bit_stream << 8) | buf[i];
+        s->data[s->data_ptr++] = buf[i];
+        if (s->data_ptr >= s->octets_per_data_packet)
+            non_ecm_push(t);
+        /*endif*/
+    }
+    /*endfor*/
+}
+/*- End of function --------------------------------------------------------*/
+
 static void non_ecm_remove_fill_and_put_bit(void *user_data, int bit)
 {
     t38_gateway_state_t *t;
@@ -2108,6 +2313,7 @@ static void t38_hdlc_rx_put_bit(hdlc_rx_state_t *t, int new_bit)
 static int restart_rx_modem(t38_gateway_state_t *s)
 {
     put_bit_func_t put_bit_func;
+    put_chunk_func_t put_chunk_func;
     void *put_bit_user_data;
 
     if (s->core.to_t38.in_bits  ||  s->core.to_t38.out_octets)
@@ -2137,6 +2343,9 @@ static int restart_rx_modem(t38_gateway_state_t *s)
 #if 0
     fsk_rx_signal_cutoff(&(s->audio.modems.v21_rx), -45.5f);
 #endif
+    /* HDLC, and non-ECM data with fill bit removal, must be examined bit by bit.
+       Plain non-ECM data can be passed on a chunk of octets at a time. */
+    put_chunk_func = NULL;
     if (s->core.image_data_mode  &&  s->core.ecm_mode)
     {
         put_bit_func = (put_bit_func_t) t38_hdlc_rx_put_bit;
@@ -2145,9 +2354,14 @@ static int restart_rx_modem(t38_gateway_state_t *s)
     else
     {
         if (s->core.image_data_mode  &&  s->core.to_t38.fill_bit_removal)
+        {
             put_bit_func = non_ecm_remove_fill_and_put_bit;
+        }
         else
+        {
             put_bit_func = non_ecm_put_bit;
+            put_chunk_func = non_ecm_put_chunk;
+        }
         /*endif*/
         put_bit_user_data = (void *) s;
     }
@@ -2159,18 +2373,21 @@ static int restart_rx_modem(t38_gateway_state_t *s)
     case T38_V17_RX:
         v17_rx_restart(&s->audio.modems.v17_rx, s->core.fast_bit_rate, s->core.short_train);
         v17_rx_set_put_bit(&s->audio.modems.v17_rx, put_bit_func, put_bit_user_data);
+        v17_rx_set_put_chunk(&s->audio.modems.v17_rx, put_chunk_func, put_bit_user_data, FALSE);
         set_rx_handler(s, &v17_v21_rx, &v17_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V17_RX;
         break;
     case T38_V27TER_RX:
         v27ter_rx_restart(&s->audio.modems.v27ter_rx, s->core.fast_bit_rate, FALSE);
         v27ter_rx_set_put_bit(&s->audio.modems.v27ter_rx, put_bit_func, put_bit_user_data);
+        v27ter_rx_set_put_chunk(&s->audio.modems.v27ter_rx, put_chunk_func, put_bit_user_data, FALSE);
         set_rx_handler(s, &v27ter_v21_rx, &v27ter_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V27TER_RX;
         break;
     case T38_V29_RX:
         v29_rx_restart(&s->audio.modems.v29_rx, s->core.fast_bit_rate, FALSE);
         v29_rx_set_put_bit(&s->audio.modems.v29_rx, put_bit_func, put_bit_user_data);
+        v29_rx_set_put_chunk(&s->audio.modems.v29_rx, put_chunk_func, put_bit_user_data, FALSE);
         set_rx_handler(s, &v29_v21_rx, &v29_v21_rx_fillin, s);
         s->core.fast_rx_active = T38_V29_RX;
         break;
@@ -2236,6 +2453,9 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx(t38_gateway_state_t *s, int16_t amp[], i
         amp[i] = dc_restore(&(s->audio.modems.dc_restore), amp[i]);
     /*endfor*/
     s->audio.modems.rx_handler(s->audio.modems.rx_user_data, amp, len);
+    /* Release any held received packets whose time is up, and send anything due from
+       the batched transmit schedule */
+    t38_core_timer_update(&s->t38x.t38, len);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2264,6 +2484,7 @@ SPAN_DECLARE_NONSTD(int) t38_gateway_rx_fillin(t38_gateway_state_t *s, int len)
     update_rx_timing(s, len);
     /* TODO: handle the modems properly */
     s->audio.modems.rx_fillin_handler(s->audio.modems.rx_user_data, len);
+    t38_core_timer_update(&s->t38x.t38, len);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -2334,6 +2555,152 @@ SPAN_DECLARE(logging_state_t *) t38_gateway_get_logging_state(t38_gateway_state_
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_gateway_get_memory_footprint(t38_gateway_state_t *s)
+{
+    /* The gateway relays image data through fixed buffers within its context. It holds
+       no memory outside the context. */
+    return sizeof(*s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void set_rx_stage(t38_gateway_state_t *s, int stage)
+{
+    fax_modems_state_t *t;
+
+    /* Drop the modem the call had dropped when the checkpoint was taken */
+    t = &s->audio.modems;
+    if (stage == CHECKPOINT_RX_V21_ONLY)
+    {
+        set_rx_handler(s, (span_rx_handler_t *) &fsk_rx, (span_rx_fillin_handler_t *) &fsk_rx_fillin, &t->v21_rx);
+        return;
+    }
+    /*endif*/
+    if (stage != CHECKPOINT_RX_FAST_ONLY)
+        return;
+    /*endif*/
+    switch (s->core.fast_rx_active)
+    {
+    case T38_V17_RX:
+        set_rx_handler(s, (span_rx_handler_t *) &v17_rx, (span_rx_fillin_handler_t *) &v17_rx_fillin, &t->v17_rx);
+        break;
+    case T38_V27TER_RX:
+        set_rx_handler(s, (span_rx_handler_t *) &v27ter_rx, (span_rx_fillin_handler_t *) &v27ter_v21_rx_fillin, &t->v27ter_rx);
+        break;
+    case T38_V29_RX:
+        set_rx_handler(s, (span_rx_handler_t *) &v29_rx, (span_rx_fillin_handler_t *) &v29_rx_fillin, &t->v29_rx);
+        break;
+    }
+    /*endswitch*/
+}
+/*- End of function --------------------------------------------------------*/
+
+static void t38_gateway_checkpoint_state(t38_gateway_state_t *s, checkpoint_t *c)
+{
+    fax_modems_state_t *t;
+    int rx_stage;
+    int rx_active;
+    int tx_next;
+
+    /* The handlers are rebuilt from the settings the modems were last started with, and
+       how far the call had moved on from there. The state is then put back over the top. */
+    t = &s->audio.modems;
+    if (t->rx_user_data == &t->v17_rx  ||  t->rx_user_data == &t->v27ter_rx  ||  t->rx_user_data == &t->v29_rx)
+        rx_stage = CHECKPOINT_RX_FAST_ONLY;
+    else if (t->rx_user_data == &t->v21_rx  &&  s->core.fast_rx_active != T38_NONE)
+        rx_stage = CHECKPOINT_RX_V21_ONLY;
+    else
+        rx_stage = CHECKPOINT_RX_AS_STARTED;
+    /*endif*/
+    rx_active = (t->rx_handler != span_dummy_rx);
+    tx_next = (t->next_tx_handler != NULL);
+    checkpoint_field(c, s->t38x.in_progress_rx_indicator);
+    checkpoint_field(c, s->core.image_data_mode);
+    checkpoint_field(c, s->core.ecm_mode);
+    checkpoint_field(c, s->core.to_t38.fill_bit_removal);
+    checkpoint_field(c, s->core.fast_rx_modem);
+    checkpoint_field(c, s->core.fast_bit_rate);
+    checkpoint_field(c, s->core.short_train);
+    checkpoint_field(c, rx_stage);
+    checkpoint_field(c, rx_active);
+    checkpoint_field(c, tx_next);
+    if (c->restoring  &&  !c->failed)
+    {
+        restart_rx_modem(s);
+        set_rx_stage(s, rx_stage);
+        set_tx_type(s, s->t38x.in_progress_rx_indicator);
+        if (t->next_tx_handler  &&  !tx_next)
+            set_next_tx_type(s);
+        /*endif*/
+        set_rx_active(s, rx_active);
+    }
+    /*endif*/
+
+    t38_core_checkpoint(&s->t38x.t38, c);
+    checkpoint_field(c, s->t38x.suppress_nsx_len);
+    checkpoint_field(c, s->t38x.corrupt_current_frame);
+    checkpoint_field(c, s->t38x.current_rx_field_class);
+    checkpoint_field(c, s->t38x.current_tx_data_type);
+
+    checkpoint_field(c, s->core.supported_modems);
+    checkpoint_field(c, s->core.ecm_allowed);
+    checkpoint_field(c, s->core.ms_per_tx_chunk);
+    checkpoint_field(c, s->core.adaptive_packetisation);
+    checkpoint_field(c, s->core.data_tx_count);
+    checkpoint_field(c, s->core.host_control_data_tx_count);
+    checkpoint_field(c, s->core.host_image_data_tx_count);
+    checkpoint_field(c, s->core.reported_loss);
+    checkpoint_field(c, s->core.reported_delay);
+    checkpoint_field(c, s->core.measured_loss);
+    checkpoint_field(c, s->core.loss_sample_seq_no);
+    checkpoint_field(c, s->core.loss_sample_missing);
+    checkpoint_field(c, s->core.min_row_bits);
+    checkpoint_field(c, s->core.count_page_on_mcf);
+    checkpoint_field(c, s->core.pages_confirmed);
+    checkpoint_field(c, s->core.fast_rx_active);
+    checkpoint_field(c, s->core.timed_mode);
+    checkpoint_field(c, s->core.samples_to_timeout);
+    /* The buffers between the two sides hold no pointers, so they can be moved whole */
+    checkpoint_field(c, s->core.to_t38);
+    checkpoint_field(c, s->core.hdlc_to_modem);
+    checkpoint_field(c, s->core.non_ecm_to_modem);
+
+    fax_modems_checkpoint(t, c);
+    checkpoint_logging(c, &s->logging);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_checkpoint(t38_gateway_state_t *s, uint8_t buf[], int max_len)
+{
+    checkpoint_t c;
+    int len;
+
+    /* The gateway holds nothing outside its context, so nothing needs to be handed over */
+    checkpoint_start_write(&c, NULL, 0, CHECKPOINT_KIND_T38_GATEWAY);
+    t38_gateway_checkpoint_state(s, &c);
+    if ((len = checkpoint_end_write(&c)) < 0  ||  buf == NULL)
+        return len;
+    /*endif*/
+    if (len > max_len)
+        return -1;
+    /*endif*/
+    checkpoint_start_write(&c, buf, max_len, CHECKPOINT_KIND_T38_GATEWAY);
+    t38_gateway_checkpoint_state(s, &c);
+    return checkpoint_end_write(&c);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_gateway_restore(t38_gateway_state_t *s, const uint8_t buf[], int len)
+{
+    checkpoint_t c;
+
+    if (checkpoint_start_read(&c, buf, len, CHECKPOINT_KIND_T38_GATEWAY))
+        return -1;
+    /*endif*/
+    t38_gateway_checkpoint_state(s, &c);
+    return checkpoint_end_read(&c);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_gateway_set_ecm_capability(t38_gateway_state_t *s, int ecm_allowed)
 {
     s->core.ecm_allowed = ecm_allowed;
@@ -2382,6 +2749,36 @@ SPAN_DECLARE(void) t38_gateway_set_fill_bit_removal(t38_gateway_state_t *s, int
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) t38_gateway_set_adaptive_packetisation(t38_gateway_state_t *s, int adaptive)
+{
+    if (adaptive  &&  !s->core.adaptive_packetisation)
+    {
+        /* Keep the application's redundancy settings, as the least adaptation may use, and
+           to put back when adaptation stops. */
+        s->core.host_control_data_tx_count = s->t38x.t38.category_control[T38_PACKET_CATEGORY_CONTROL_DATA];
+        s->core.host_image_data_tx_count = s->t38x.t38.category_control[T38_PACKET_CATEGORY_IMAGE_DATA];
+        s->core.data_tx_count = DATA_TX_COUNT;
+    }
+    else if (!adaptive  &&  s->core.adaptive_packetisation)
+    {
+        /* Return to the fixed packetisation, and the application's redundancy settings */
+        s->core.ms_per_tx_chunk = DEFAULT_MS_PER_TX_CHUNK;
+        s->core.data_tx_count = DATA_TX_COUNT;
+        t38_set_redundancy_control(&s->t38x.t38, T38_PACKET_CATEGORY_CONTROL_DATA, s->core.host_control_data_tx_count);
+        t38_set_redundancy_control(&s->t38x.t38, T38_PACKET_CATEGORY_IMAGE_DATA, s->core.host_image_data_tx_count);
+    }
+    /*endif*/
+    s->core.adaptive_packetisation = adaptive;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t38_gateway_report_network_conditions(t38_gateway_state_t *s, int loss, int delay)
+{
+    s->core.reported_loss = (loss > 0)  ?  loss  :  0;
+    s->core.reported_delay = delay;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t38_gateway_set_real_time_frame_handler(t38_gateway_state_t *s,
                                                            t38_gateway_real_time_frame_handler_t *handler,
                                                            void *user_data)
@@ -2463,7 +2860,11 @@ SPAN_DECLARE(t38_gateway_state_t *) t38_gateway_init(t38_gateway_state_t *s,
 
     s->core.to_t38.octets_per_data_packet = 1;
     s->core.ecm_allowed = TRUE;
-    //s->core.ms_per_tx_chunk = DEFAULT_MS_PER_TX_CHUNK;
+    s->core.ms_per_tx_chunk = DEFAULT_MS_PER_TX_CHUNK;
+    s->core.data_tx_count = DATA_TX_COUNT;
+    s->core.reported_loss = 0;
+    s->core.reported_delay = -1;
+    s->core.loss_sample_seq_no = -1;
     t38_non_ecm_buffer_init(&s->core.non_ecm_to_modem, FALSE, 0);
     restart_rx_modem(s);
     s->core.timed_mode = TIMED_MODE_STARTUP;
@@ -79,6 +79,34 @@ static void restart_buffer(t38_non_ecm_buffer_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_octet(t38_non_ecm_buffer_state_t *s)
+{
+    int octet;
+
+    if (s->out_ptr != s->latest_eol_ptr)
+    {
+        octet = s->data[s->out_ptr];
+        s->out_ptr = (s->out_ptr + 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
+    }
+    else
+    {
+        if (s->data_finished)
+        {
+            /* The queue is empty, and we have received the end of data signal. This must
+               really be the end to transmission. */
+            restart_buffer(s);
+            return SIG_STATUS_END_OF_DATA;
+        }
+        /* The queue is blocked, but this does not appear to be the end of the data. Idle with
+           fill octets, which should be safe at this point. */
+        octet = s->flow_control_fill_octet;
+        s->flow_control_fill_octets++;
+    }
+    s->out_octets++;
+    return octet;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data)
 {
     t38_non_ecm_buffer_state_t *s;
@@ -89,32 +117,61 @@ SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_bit(void *user_data)
     if (s->bit_no <= 0)
     {
         /* We need another byte */
-        if (s->out_ptr != s->latest_eol_ptr)
-        {
-            s->octet = s->data[s->out_ptr];
-            s->out_ptr = (s->out_ptr + 1) & (T38_NON_ECM_TX_BUF_LEN - 1);
-        }
-        else
+        if ((bit = get_octet(s)) < 0)
+            return bit;
+        s->octet = bit;
+        s->bit_no = 8;
+    }
+    s->bit_no--;
+    bit = (s->octet >> 7) & 1;
+    s->octet <<= 1;
+    return bit;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_byte(void *user_data)
+{
+    return get_octet((t38_non_ecm_buffer_state_t *) user_data);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) t38_non_ecm_buffer_get_chunk(void *user_data, uint8_t buf[], int max_len)
+{
+    t38_non_ecm_buffer_state_t *s;
+    int len;
+    int n;
+
+    s = (t38_non_ecm_buffer_state_t *) user_data;
+    len = 0;
+    while (len < max_len)
+    {
+        if (s->out_ptr == s->latest_eol_ptr)
         {
             if (s->data_finished)
             {
-                /* The queue is empty, and we have received the end of data signal. This must
-                   really be the end to transmission. */
+                /* This is the end of the data. The short chunk tells the caller so. */
                 restart_buffer(s);
-                return SIG_STATUS_END_OF_DATA;
+                break;
             }
-            /* The queue is blocked, but this does not appear to be the end of the data. Idle with
-               fill octets, which should be safe at this point. */
-            s->octet = s->flow_control_fill_octet;
-            s->flow_control_fill_octets++;
+            /* Nothing more can arrive while we are in here, so the rest of the chunk can
+               only be fill. */
+            n = max_len - len;
+            memset(&buf[len], s->flow_control_fill_octet, n);
+            s->flow_control_fill_octets += n;
+            s->out_octets += n;
+            len += n;
+            break;
         }
-        s->out_octets++;
-        s->bit_no = 8;
+        /* Copy a run of real data, up to the last EOL or the end of the circular buffer */
+        n = (s->latest_eol_ptr > s->out_ptr)  ?  (s->latest_eol_ptr - s->out_ptr)  :  (T38_NON_ECM_TX_BUF_LEN - s->out_ptr);
+        if (n > max_len - len)
+            n = max_len - len;
+        memcpy(&buf[len], &s->data[s->out_ptr], n);
+        s->out_ptr = (s->out_ptr + n) & (T38_NON_ECM_TX_BUF_LEN - 1);
+        s->out_octets += n;
+        len += n;
     }
-    s->bit_no--;
-    bit = (s->octet >> 7) & 1;
-    s->octet <<= 1;
-    return bit;
+    return len;
 }
 /*- End of function --------------------------------------------------------*/
 
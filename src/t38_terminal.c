@@ -61,6 +61,7 @@
 #include "spandsp/v27ter_rx.h"
 #include "spandsp/v17tx.h"
 #include "spandsp/v17rx.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -84,12 +85,15 @@
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 #include "spandsp/private/t30.h"
 #include "spandsp/private/t38_core.h"
 #include "spandsp/private/t38_terminal.h"
 
+#include "checkpoint_local.h"
+
 /* Settings suitable for paced transmission over a UDP transport */
 #define DEFAULT_MS_PER_TX_CHUNK                 30
 
@@ -1023,7 +1027,7 @@ static int stream_cng(t38_terminal_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples)
+static int send_timed_steps(t38_terminal_state_t *s, int samples)
 {
     t38_terminal_front_end_state_t *fe;
     int delay;
@@ -1081,6 +1085,60 @@ SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_terminal_send_timeout(t38_terminal_state_t *s, int samples)
+{
+    int ret;
+
+    ret = send_timed_steps(s, samples);
+    /* Release any held received packets whose time is up, and send anything due from
+       the batched transmit schedule */
+    t38_core_timer_update(&s->t38_fe.t38, samples);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_terminal_time_to_next_action(t38_terminal_state_t *s)
+{
+    t38_terminal_front_end_state_t *fe;
+    int next;
+    int due;
+
+    fe = &s->t38_fe;
+    /* When the call has finished, the next call to t38_terminal_send_timeout() reports it */
+    if (fe->current_rx_type == T30_MODEM_DONE  ||  fe->current_tx_type == T30_MODEM_DONE)
+        return 0;
+    /*endif*/
+    next = t30_next_timer_expiry(&s->t30);
+    if ((due = t38_core_next_timer_expiry(&fe->t38)) >= 0  &&  (next < 0  ||  due < next))
+        next = due;
+    /*endif*/
+    if (fe->timeout_rx_samples)
+    {
+        due = fe->timeout_rx_samples - fe->samples + 1;
+        if (due < 0)
+            due = 0;
+        /*endif*/
+        if (next < 0  ||  due < next)
+            next = due;
+        /*endif*/
+    }
+    /*endif*/
+    if (fe->timed_step != T38_TIMED_STEP_NONE)
+    {
+        /* In "no delays" mode the next step is always due at once */
+        due = (fe->ms_per_tx_chunk)  ?  (fe->next_tx_samples - fe->samples)  :  0;
+        if (due < 0)
+            due = 0;
+        /*endif*/
+        if (next < 0  ||  due < next)
+            next = due;
+        /*endif*/
+    }
+    /*endif*/
+    return next;
+}
+/*- End of function --------------------------------------------------------*/
+
 static void set_rx_type(void *user_data, int type, int bit_rate, int short_train, int use_hdlc)
 {
     t38_terminal_state_t *s;
@@ -1349,6 +1407,75 @@ SPAN_DECLARE(logging_state_t *) t38_terminal_get_logging_state(t38_terminal_stat
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t38_terminal_get_memory_footprint(t38_terminal_state_t *s)
+{
+    return sizeof(*s) + t30_get_allocated_memory(&s->t30);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void t38_terminal_checkpoint_state(t38_terminal_state_t *s, checkpoint_t *c)
+{
+    t38_terminal_front_end_state_t *fe;
+
+    /* The front end does all its work through the T.30 and T.38 contexts, so the only
+       handlers it has are the ones set up when it was initialised. */
+    fe = &s->t38_fe;
+    checkpoint_field(c, fe->iaf);
+    checkpoint_field(c, fe->ms_per_tx_chunk);
+    checkpoint_field(c, fe->chunking_modes);
+    t38_core_checkpoint(&fe->t38, c);
+    checkpoint_field(c, fe->timed_step);
+    checkpoint_field(c, fe->rx_data_missing);
+    checkpoint_field(c, fe->octets_per_data_packet);
+    checkpoint_field(c, fe->hdlc_rx);
+    checkpoint_field(c, fe->hdlc_tx);
+    checkpoint_field(c, fe->non_ecm_trailer_bytes);
+    checkpoint_field(c, fe->next_tx_indicator);
+    checkpoint_field(c, fe->current_tx_data_type);
+    checkpoint_field(c, fe->rx_signal_present);
+    checkpoint_field(c, fe->current_rx_type);
+    checkpoint_field(c, fe->current_tx_type);
+    checkpoint_field(c, fe->tx_bit_rate);
+    checkpoint_field(c, fe->samples);
+    checkpoint_field(c, fe->next_tx_samples);
+    checkpoint_field(c, fe->timeout_rx_samples);
+    checkpoint_logging(c, &s->logging);
+    t30_checkpoint(&s->t30, c);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_terminal_checkpoint(t38_terminal_state_t *s, uint8_t buf[], int max_len)
+{
+    checkpoint_t c;
+    int len;
+
+    /* Find the length first, so nothing is handed over unless it all fits */
+    checkpoint_start_write(&c, NULL, 0, CHECKPOINT_KIND_T38_TERMINAL);
+    t38_terminal_checkpoint_state(s, &c);
+    if ((len = checkpoint_end_write(&c)) < 0  ||  buf == NULL)
+        return len;
+    if (len > max_len)
+        return -1;
+    checkpoint_start_write(&c, buf, max_len, CHECKPOINT_KIND_T38_TERMINAL);
+    t38_terminal_checkpoint_state(s, &c);
+    if ((len = checkpoint_end_write(&c)) < 0)
+        return -1;
+    t30_checkpoint_handover(&s->t30);
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t38_terminal_restore(t38_terminal_state_t *s, const uint8_t buf[], int len)
+{
+    checkpoint_t c;
+
+    if (checkpoint_start_read(&c, buf, len, CHECKPOINT_KIND_T38_TERMINAL))
+        return -1;
+    t38_terminal_checkpoint_state(s, &c);
+    return checkpoint_end_read(&c);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t38_terminal_restart(t38_terminal_state_t *s,
                                        int calling_party)
 {
@@ -0,0 +1,316 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t4_page_buffer.c - Chunked buffers for T.4 FAX page images
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define T4_PAGE_BUFFER_USE_POOL
+#endif
+
+#include "spandsp/telephony.h"
+#include "spandsp/t4_page_buffer.h"
+
+#include "spandsp/private/t4_page_buffer.h"
+
+/*! A chunk in the pool. While it is free, the start of the chunk links it to the next free chunk. */
+typedef union pool_chunk_u
+{
+    union pool_chunk_u *next;
+    uint8_t data[T4_PAGE_BUFFER_CHUNK_SIZE];
+} pool_chunk_t;
+
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+/*! The pool of chunks shared by all the page buffers. It only exists when it can be
+    locked. The buffers may belong to contexts being used in different threads, even
+    where spandsp starts no threads of its own. Without locking each buffer allocates
+    and frees its own chunks, and nothing is shared. */
+static struct
+{
+    pthread_mutex_t mutex;
+    pool_chunk_t *free_chunks;
+    int chunks_allocated;
+    int chunks_in_use;
+    int peak_chunks_in_use;
+    int chunk_limit;
+    int failed_requests;
+} pool =
+{
+    PTHREAD_MUTEX_INITIALIZER,
+    NULL,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+#endif
+
+static uint8_t *get_chunk(void)
+{
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pool_chunk_t *chunk;
+
+    pthread_mutex_lock(&pool.mutex);
+    if ((chunk = pool.free_chunks))
+    {
+        pool.free_chunks = chunk->next;
+    }
+    else if (pool.chunk_limit == 0  ||  pool.chunks_allocated < pool.chunk_limit)
+    {
+        if ((chunk = (pool_chunk_t *) malloc(sizeof(*chunk))))
+            pool.chunks_allocated++;
+    }
+    if (chunk)
+    {
+        if (++pool.chunks_in_use > pool.peak_chunks_in_use)
+            pool.peak_chunks_in_use = pool.chunks_in_use;
+    }
+    else
+    {
+        pool.failed_requests++;
+    }
+    pthread_mutex_unlock(&pool.mutex);
+    return (uint8_t *) chunk;
+#else
+    return (uint8_t *) malloc(sizeof(pool_chunk_t));
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static int add_chunk(t4_page_buffer_t *s)
+{
+    uint8_t **chunks;
+    uint8_t *chunk;
+    int slots;
+
+    if (s->chunks_held >= s->chunk_slots)
+    {
+        slots = (s->chunk_slots)  ?  2*s->chunk_slots  :  16;
+        if ((chunks = (uint8_t **) realloc(s->chunks, slots*sizeof(s->chunks[0]))) == NULL)
+            return -1;
+        s->chunks = chunks;
+        s->chunk_slots = slots;
+    }
+    if ((chunk = get_chunk()) == NULL)
+        return -1;
+    s->chunks[s->chunks_held++] = chunk;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_grow(t4_page_buffer_t *s, int len)
+{
+    while (len > s->chunks_held*T4_PAGE_BUFFER_CHUNK_SIZE)
+    {
+        if (add_chunk(s))
+            return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint8_t *) t4_page_buffer_row(t4_page_buffer_t *s, int row, int bytes_per_row)
+{
+    int rows_per_chunk;
+    int chunk;
+
+    if (bytes_per_row <= 0  ||  bytes_per_row > T4_PAGE_BUFFER_CHUNK_SIZE)
+        return NULL;
+    /* Rows never straddle chunks, so any space left at the end of a chunk is unused. */
+    rows_per_chunk = T4_PAGE_BUFFER_CHUNK_SIZE/bytes_per_row;
+    chunk = row/rows_per_chunk;
+    while (chunk >= s->chunks_held)
+    {
+        if (add_chunk(s))
+            return NULL;
+    }
+    return s->chunks[chunk] + (row - chunk*rows_per_chunk)*bytes_per_row;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_get(t4_page_buffer_t *s, int offset, uint8_t buf[], int len)
+{
+    int chunk_offset;
+    int i;
+    int n;
+
+    for (i = 0;  i < len;  i += n)
+    {
+        chunk_offset = offset & (T4_PAGE_BUFFER_CHUNK_SIZE - 1);
+        n = T4_PAGE_BUFFER_CHUNK_SIZE - chunk_offset;
+        if (n > len - i)
+            n = len - i;
+        memcpy(&buf[i], &s->chunks[offset >> T4_PAGE_BUFFER_CHUNK_SHIFT][chunk_offset], n);
+        offset += n;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_put(t4_page_buffer_t *s, int offset, const uint8_t buf[], int len)
+{
+    int chunk_offset;
+    int i;
+    int n;
+
+    if (t4_page_buffer_grow(s, offset + len))
+        return -1;
+    for (i = 0;  i < len;  i += n)
+    {
+        chunk_offset = offset & (T4_PAGE_BUFFER_CHUNK_SIZE - 1);
+        n = T4_PAGE_BUFFER_CHUNK_SIZE - chunk_offset;
+        if (n > len - i)
+            n = len - i;
+        memcpy(&s->chunks[offset >> T4_PAGE_BUFFER_CHUNK_SHIFT][chunk_offset], &buf[i], n);
+        offset += n;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t4_page_buffer_t *) t4_page_buffer_init(t4_page_buffer_t *s)
+{
+    if (s == NULL)
+    {
+        if ((s = (t4_page_buffer_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_release(t4_page_buffer_t *s)
+{
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pool_chunk_t *chunk;
+#endif
+    int i;
+
+    if (s->chunks_held)
+    {
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+        pthread_mutex_lock(&pool.mutex);
+        for (i = 0;  i < s->chunks_held;  i++)
+        {
+            chunk = (pool_chunk_t *) s->chunks[i];
+            chunk->next = pool.free_chunks;
+            pool.free_chunks = chunk;
+        }
+        pool.chunks_in_use -= s->chunks_held;
+        pthread_mutex_unlock(&pool.mutex);
+#else
+        for (i = 0;  i < s->chunks_held;  i++)
+            free(s->chunks[i]);
+#endif
+    }
+    if (s->chunks)
+        free(s->chunks);
+    s->chunks = NULL;
+    s->chunks_held = 0;
+    s->chunk_slots = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_free(t4_page_buffer_t *s)
+{
+    int ret;
+
+    ret = t4_page_buffer_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_page_buffer_pool_get_stats(t4_page_buffer_pool_stats_t *stats)
+{
+    stats->chunk_size = T4_PAGE_BUFFER_CHUNK_SIZE;
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pthread_mutex_lock(&pool.mutex);
+    stats->chunks_allocated = pool.chunks_allocated;
+    stats->chunks_in_use = pool.chunks_in_use;
+    stats->peak_chunks_in_use = pool.peak_chunks_in_use;
+    stats->chunk_limit = pool.chunk_limit;
+    stats->failed_requests = pool.failed_requests;
+    pthread_mutex_unlock(&pool.mutex);
+#else
+    stats->chunks_allocated = 0;
+    stats->chunks_in_use = 0;
+    stats->peak_chunks_in_use = 0;
+    stats->chunk_limit = 0;
+    stats->failed_requests = 0;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_pool_set_limit(int chunks)
+{
+    if (chunks < 0)
+        return -1;
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pthread_mutex_lock(&pool.mutex);
+    pool.chunk_limit = chunks;
+    pthread_mutex_unlock(&pool.mutex);
+    return 0;
+#else
+    /* There is no pool to limit */
+    return (chunks == 0)  ?  0  :  -1;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_page_buffer_pool_trim(void)
+{
+    int freed;
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pool_chunk_t *chunk;
+#endif
+
+    freed = 0;
+#if defined(T4_PAGE_BUFFER_USE_POOL)
+    pthread_mutex_lock(&pool.mutex);
+    while ((chunk = pool.free_chunks))
+    {
+        pool.free_chunks = chunk->next;
+        free(chunk);
+        freed++;
+    }
+    pool.chunks_allocated -= freed;
+    pthread_mutex_unlock(&pool.mutex);
+#endif
+    return freed;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -77,12 +77,17 @@
 #endif
 #include "floating_fudge.h"
 #include <tiffio.h>
+#if defined(HAVE_LIBTIFF)  &&  defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define T4_RX_USE_TIFF_WRITER
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
 #include "spandsp/timezone.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -100,9 +105,12 @@
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 
+#include "checkpoint_local.h"
+
 /*! The number of centimetres in one inch */
 #define CM_PER_INCH                 2.54f
 
@@ -113,6 +121,11 @@
 /*! The number of EOLs to check at the end of a T.6 page */
 #define EOLS_TO_END_T6_RX_PAGE      2
 
+/*! The longest page we will accept, in millimetres. T.30 allows pages of unlimited length,
+    but a T.85 image header can claim billions of rows, and a few bytes of coded data can
+    legitimately describe a very long white page. */
+#define T4_MAX_PAGE_LENGTH_MM       2000
+
 #include "t4_t6_decode_states.h"
 
 #if defined(T4_STATE_DEBUGGING)
@@ -130,10 +143,77 @@ static void STATE_TRACE(const char *format, ...)
 #endif
 
 #if defined(HAVE_LIBTIFF)
-static int set_tiff_directory_info(t4_state_t *s)
+/*!
+    A description of a received page, with everything needed to write it to the TIFF file.
+*/
+typedef struct t4_rx_tiff_page_s
 {
-    time_t now;
-    struct tm *tm;
+    /*! \brief The next page waiting to be written. */
+    struct t4_rx_tiff_page_s *next;
+    /*! \brief The image, as rows. */
+    t4_page_buffer_t image;
+    /*! \brief The width of the image, in pixels. */
+    int image_width;
+    /*! \brief The length of the image, in pixels. */
+    int image_length;
+    /*! \brief The number of bytes per row of the image. */
+    int bytes_per_row;
+    /*! \brief Column-to-column (X) resolution in pixels per metre. */
+    int x_resolution;
+    /*! \brief Row-to-row (Y) resolution in pixels per metre. */
+    int y_resolution;
+    /*! \brief The page number, starting from zero. */
+    int page_no;
+    /*! \brief The number of bad rows in the page. */
+    int bad_rows;
+    /*! \brief The longest run of consecutive bad rows in the page. */
+    int longest_bad_row_run;
+    /*! \brief The time at which reception of the page began. */
+    time_t page_start_time;
+    /*! \brief The time at which reception of the page ended. */
+    time_t page_end_time;
+    /*! \brief The FAX DCS information, as an ASCII string. */
+    const char *dcs;
+    /*! \brief The FAX sub-address. */
+    const char *sub_address;
+    /*! \brief The remote end's ident string. */
+    const char *far_ident;
+    /*! \brief The vendor of the machine which produced the page. */
+    const char *vendor;
+    /*! \brief The model of machine which produced the page. */
+    const char *model;
+} t4_rx_tiff_page_t;
+
+#if defined(T4_RX_USE_TIFF_WRITER)
+/*!
+    Background TIFF writer. Received pages are queued for a thread, which writes them
+    to the TIFF file in order. Only this thread touches the TIFF file until it is closed.
+*/
+typedef struct t4_rx_tiff_writer_s
+{
+    /*! \brief The thread writing the pages. */
+    pthread_t thread;
+    /*! \brief The mutex protecting the page queue. */
+    pthread_mutex_t mutex;
+    /*! \brief Signalled when a page is queued, or the writer should stop. */
+    pthread_cond_t cond;
+    /*! \brief The oldest page waiting to be written. */
+    t4_rx_tiff_page_t *head;
+    /*! \brief The newest page waiting to be written. */
+    t4_rx_tiff_page_t *tail;
+    /*! \brief TRUE when the thread should finish once the queue is empty. */
+    int stop;
+    /*! \brief The number of pages the thread failed to write, and which have not yet
+               been reported. */
+    int failed_pages;
+    /*! \brief The T.4 context whose TIFF file is being written. */
+    t4_state_t *t4;
+} t4_rx_tiff_writer_t;
+#endif
+
+static int set_tiff_directory_info(t4_state_t *s, const t4_rx_tiff_page_t *page)
+{
+    struct tm tm;
     char buf[256 + 1];
     uint16_t resunit;
     float x_resolution;
@@ -148,7 +228,7 @@ static int set_tiff_directory_info(t4_state_t *s)
         TIFFSetField(t->tiff_file, TIFFTAG_T4OPTIONS, t->output_t4_options);
         TIFFSetField(t->tiff_file, TIFFTAG_FAXMODE, FAXMODE_CLASSF);
     }
-    TIFFSetField(t->tiff_file, TIFFTAG_IMAGEWIDTH, s->image_width);
+    TIFFSetField(t->tiff_file, TIFFTAG_IMAGEWIDTH, page->image_width);
     TIFFSetField(t->tiff_file, TIFFTAG_BITSPERSAMPLE, 1);
     TIFFSetField(t->tiff_file, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
     TIFFSetField(t->tiff_file, TIFFTAG_SAMPLESPERPIXEL, 1);
@@ -168,8 +248,8 @@ static int set_tiff_directory_info(t4_state_t *s)
     TIFFSetField(t->tiff_file, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
     TIFFSetField(t->tiff_file, TIFFTAG_FILLORDER, FILLORDER_LSB2MSB);
 
-    x_resolution = s->x_resolution/100.0f;
-    y_resolution = s->y_resolution/100.0f;
+    x_resolution = page->x_resolution/100.0f;
+    y_resolution = page->y_resolution/100.0f;
     /* Metric seems the sane thing to use in the 21st century, but a lot of lousy software
        gets FAX resolutions wrong, and more get it wrong using metric than using inches. */
 #if 0
@@ -189,51 +269,50 @@ static int set_tiff_directory_info(t4_state_t *s)
         TIFFSetField(t->tiff_file, TIFFTAG_HOSTCOMPUTER, buf);
 
 #if defined(TIFFTAG_FAXDCS)
-    if (t->dcs)
-        TIFFSetField(t->tiff_file, TIFFTAG_FAXDCS, t->dcs);
+    if (page->dcs)
+        TIFFSetField(t->tiff_file, TIFFTAG_FAXDCS, page->dcs);
 #endif
-    if (t->sub_address)
-        TIFFSetField(t->tiff_file, TIFFTAG_FAXSUBADDRESS, t->sub_address);
-    if (t->far_ident)
-        TIFFSetField(t->tiff_file, TIFFTAG_IMAGEDESCRIPTION, t->far_ident);
-    if (t->vendor)
-        TIFFSetField(t->tiff_file, TIFFTAG_MAKE, t->vendor);
-    if (t->model)
-        TIFFSetField(t->tiff_file, TIFFTAG_MODEL, t->model);
-
-    time(&now);
-    tm = localtime(&now);
+    if (page->sub_address)
+        TIFFSetField(t->tiff_file, TIFFTAG_FAXSUBADDRESS, page->sub_address);
+    if (page->far_ident)
+        TIFFSetField(t->tiff_file, TIFFTAG_IMAGEDESCRIPTION, page->far_ident);
+    if (page->vendor)
+        TIFFSetField(t->tiff_file, TIFFTAG_MAKE, page->vendor);
+    if (page->model)
+        TIFFSetField(t->tiff_file, TIFFTAG_MODEL, page->model);
+
+    /* This may run on the background writer thread, so don't use localtime()'s static result */
+    localtime_r(&page->page_end_time, &tm);
     sprintf(buf,
             "%4d/%02d/%02d %02d:%02d:%02d",
-            tm->tm_year + 1900,
-            tm->tm_mon + 1,
-            tm->tm_mday,
-            tm->tm_hour,
-            tm->tm_min,
-            tm->tm_sec);
+            tm.tm_year + 1900,
+            tm.tm_mon + 1,
+            tm.tm_mday,
+            tm.tm_hour,
+            tm.tm_min,
+            tm.tm_sec);
     TIFFSetField(t->tiff_file, TIFFTAG_DATETIME, buf);
-    TIFFSetField(t->tiff_file, TIFFTAG_FAXRECVTIME, now - s->page_start_time);
+    TIFFSetField(t->tiff_file, TIFFTAG_FAXRECVTIME, page->page_end_time - page->page_start_time);
 
-    TIFFSetField(t->tiff_file, TIFFTAG_IMAGELENGTH, s->image_length);
+    TIFFSetField(t->tiff_file, TIFFTAG_IMAGELENGTH, page->image_length);
     /* Set the total pages to 1. For any one page document we will get this
        right. For multi-page documents we will need to come back and fill in
        the right answer when we know it. */
-    TIFFSetField(t->tiff_file, TIFFTAG_PAGENUMBER, s->current_page++, 1);
-    s->tiff.pages_in_file = s->current_page;
+    TIFFSetField(t->tiff_file, TIFFTAG_PAGENUMBER, page->page_no, 1);
     if (t->output_compression == COMPRESSION_CCITT_T4)
     {
-        if (s->t4_t6_rx.bad_rows)
+        if (page->bad_rows)
         {
-            TIFFSetField(t->tiff_file, TIFFTAG_BADFAXLINES, s->t4_t6_rx.bad_rows);
+            TIFFSetField(t->tiff_file, TIFFTAG_BADFAXLINES, page->bad_rows);
             TIFFSetField(t->tiff_file, TIFFTAG_CLEANFAXDATA, CLEANFAXDATA_REGENERATED);
-            TIFFSetField(t->tiff_file, TIFFTAG_CONSECUTIVEBADFAXLINES, s->t4_t6_rx.longest_bad_row_run);
+            TIFFSetField(t->tiff_file, TIFFTAG_CONSECUTIVEBADFAXLINES, page->longest_bad_row_run);
         }
         else
         {
             TIFFSetField(t->tiff_file, TIFFTAG_CLEANFAXDATA, CLEANFAXDATA_CLEAN);
         }
     }
-    TIFFSetField(t->tiff_file, TIFFTAG_IMAGEWIDTH, s->image_width);
+    TIFFSetField(t->tiff_file, TIFFTAG_IMAGEWIDTH, page->image_width);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -246,15 +325,192 @@ static int open_tiff_output_file(t4_state_t *s, const char *file)
 }
 /*- End of function --------------------------------------------------------*/
 
-static void write_tiff_image(t4_state_t *s)
+static int write_tiff_page(t4_state_t *s, t4_rx_tiff_page_t *page)
 {
+    int row;
+    int result;
+
+    /* This may run on the background writer thread, so it must not log. The caller
+       reports any failure. */
+    result = 0;
     /* Set up the TIFF directory info... */
-    set_tiff_directory_info(s);
-    /* ..and then write the image... */
-    if (TIFFWriteEncodedStrip(s->tiff.tiff_file, 0, s->image_buffer, s->image_length*s->bytes_per_row) < 0)
-        span_log(&s->logging, SPAN_LOG_WARNING, "%s: Error writing TIFF strip.\n", s->tiff.file);
+    set_tiff_directory_info(s, page);
+    /* ..and then write the image, a row at a time, as the rows are not contiguous... */
+    for (row = 0;  row < page->image_length;  row++)
+    {
+        if (TIFFWriteScanline(s->tiff.tiff_file, t4_page_buffer_row(&page->image, row, page->bytes_per_row), row, 0) < 0)
+        {
+            result = -1;
+            break;
+        }
+    }
     /* ...then the directory entry, and libtiff is happy. */
-    TIFFWriteDirectory(s->tiff.tiff_file);
+    if (!TIFFWriteDirectory(s->tiff.tiff_file))
+        result = -1;
+    return result;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void describe_page(t4_state_t *s, t4_rx_tiff_page_t *page)
+{
+    page->next = NULL;
+    page->image = s->image;
+    page->image_width = s->image_width;
+    page->image_length = s->image_length;
+    page->bytes_per_row = s->bytes_per_row;
+    page->x_resolution = s->x_resolution;
+    page->y_resolution = s->y_resolution;
+    page->page_no = s->current_page;
+    page->bad_rows = s->t4_t6_rx.bad_rows;
+    page->longest_bad_row_run = s->t4_t6_rx.longest_bad_row_run;
+    page->page_start_time = s->page_start_time;
+    time(&page->page_end_time);
+    page->dcs = s->tiff.dcs;
+    page->sub_address = s->tiff.sub_address;
+    page->far_ident = s->tiff.far_ident;
+    page->vendor = s->tiff.vendor;
+    page->model = s->tiff.model;
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(T4_RX_USE_TIFF_WRITER)
+static char *copy_string(const char *s)
+{
+    return (s)  ?  strdup(s)  :  NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void free_page(t4_rx_tiff_page_t *page)
+{
+    t4_page_buffer_release(&page->image);
+    if (page->dcs)
+        free((char *) page->dcs);
+    if (page->sub_address)
+        free((char *) page->sub_address);
+    if (page->far_ident)
+        free((char *) page->far_ident);
+    if (page->vendor)
+        free((char *) page->vendor);
+    if (page->model)
+        free((char *) page->model);
+    free(page);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *tiff_writer_thread(void *user_data)
+{
+    t4_rx_tiff_writer_t *w;
+    t4_rx_tiff_page_t *page;
+    int result;
+
+    w = (t4_rx_tiff_writer_t *) user_data;
+    pthread_mutex_lock(&w->mutex);
+    for (;;)
+    {
+        while (w->head == NULL  &&  !w->stop)
+            pthread_cond_wait(&w->cond, &w->mutex);
+        if ((page = w->head) == NULL)
+            break;
+        if ((w->head = page->next) == NULL)
+            w->tail = NULL;
+        pthread_mutex_unlock(&w->mutex);
+        result = write_tiff_page(w->t4, page);
+        free_page(page);
+        pthread_mutex_lock(&w->mutex);
+        if (result)
+            w->failed_pages++;
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void report_tiff_writer_failures(t4_state_t *s, int failed_pages)
+{
+    /* The writer thread can't use our logging, so its failures are reported from here */
+    if (failed_pages)
+        span_log(&s->logging, SPAN_LOG_WARNING, "%s: Error writing %d TIFF page(s).\n", s->tiff.file, failed_pages);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int queue_tiff_page(t4_state_t *s)
+{
+    t4_rx_tiff_writer_t *w;
+    t4_rx_tiff_page_t *page;
+    int failed_pages;
+
+    w = s->tiff_writer;
+    if ((page = (t4_rx_tiff_page_t *) malloc(sizeof(*page))) == NULL)
+        return -1;
+    describe_page(s, page);
+    /* The strings belong to our caller, and may change before the page is written */
+    page->dcs = copy_string(page->dcs);
+    page->sub_address = copy_string(page->sub_address);
+    page->far_ident = copy_string(page->far_ident);
+    page->vendor = copy_string(page->vendor);
+    page->model = copy_string(page->model);
+    /* The image buffer now belongs to the page. The next page will get a fresh one. */
+    t4_page_buffer_init(&s->image);
+    pthread_mutex_lock(&w->mutex);
+    if (w->tail)
+        w->tail->next = page;
+    else
+        w->head = page;
+    w->tail = page;
+    pthread_cond_signal(&w->cond);
+    failed_pages = w->failed_pages;
+    w->failed_pages = 0;
+    pthread_mutex_unlock(&w->mutex);
+    report_tiff_writer_failures(s, failed_pages);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void stop_tiff_writer(t4_state_t *s)
+{
+    t4_rx_tiff_writer_t *w;
+
+    if ((w = s->tiff_writer) == NULL)
+        return;
+    /* Let the writer finish any queued pages, and wait for it */
+    pthread_mutex_lock(&w->mutex);
+    w->stop = TRUE;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
+    pthread_join(w->thread, NULL);
+    report_tiff_writer_failures(s, w->failed_pages);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->mutex);
+    free(w);
+    s->tiff_writer = NULL;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void write_tiff_image(t4_state_t *s)
+{
+    t4_rx_tiff_page_t page;
+
+#if defined(T4_RX_USE_TIFF_WRITER)
+    if (s->tiff_writer)
+    {
+        if (queue_tiff_page(s) == 0)
+        {
+            s->current_page++;
+            s->tiff.pages_in_file = s->current_page;
+            return;
+        }
+        /* We could not queue the page, so get the writer out of the way, and
+           write the page directly. */
+        span_log(&s->logging, SPAN_LOG_WARNING, "%s: Cannot queue page for writing.\n", s->tiff.file);
+        stop_tiff_writer(s);
+    }
+#endif
+    describe_page(s, &page);
+    if (write_tiff_page(s, &page))
+        span_log(&s->logging, SPAN_LOG_WARNING, "%s: Error writing TIFF page %d.\n", s->tiff.file, s->current_page);
+    s->current_page++;
+    s->tiff.pages_in_file = s->current_page;
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -264,6 +520,11 @@ static int close_tiff_output_file(t4_state_t *s)
     t4_tiff_state_t *t;
 
     t = &s->tiff;
+#if defined(T4_RX_USE_TIFF_WRITER)
+    /* Make sure every page has been written, and the writer thread is finished with
+       the file, before touching it here. */
+    stop_tiff_writer(s);
+#endif
     /* Perform any operations needed to tidy up a written TIFF file before
        closure. */
     if (s->current_page > 1)
@@ -273,9 +534,14 @@ static int close_tiff_output_file(t4_state_t *s)
            need to set the correct total page count associated with each page. */
         for (i = 0;  i < s->current_page;  i++)
         {
-            TIFFSetDirectory(t->tiff_file, (tdir_t) i);
+            if (!TIFFSetDirectory(t->tiff_file, (tdir_t) i))
+            {
+                span_log(&s->logging, SPAN_LOG_WARNING, "%s: Failed to set directory to page %d.\n", t->file, i);
+                continue;
+            }
             TIFFSetField(t->tiff_file, TIFFTAG_PAGENUMBER, i, s->current_page);
-            TIFFWriteDirectory(t->tiff_file);
+            if (!TIFFWriteDirectory(t->tiff_file))
+                span_log(&s->logging, SPAN_LOG_WARNING, "%s: Failed to write directory for page %d.\n", t->file, i);
         }
     }
     TIFFClose(t->tiff_file);
@@ -396,12 +662,10 @@ static __inline__ int run_length(unsigned int bits)
 
 static int free_buffers(t4_state_t *s)
 {
-    if (s->image_buffer)
-    {
-        free(s->image_buffer);
-        s->image_buffer = NULL;
-        s->image_buffer_size = 0;
-    }
+    t4_page_buffer_release(&s->image);
+#if defined(SPANDSP_SUPPORT_T85)
+    t85_decode_release(&s->t85_rx);
+#endif
     if (s->cur_runs)
     {
         free(s->cur_runs);
@@ -472,13 +736,17 @@ static int put_decoded_row(t4_state_t *s)
     }
 #endif
     row_starts_at = s->image_size;
-    /* Make sure there is enough room for another row */
-    if (s->image_size + s->bytes_per_row >= s->image_buffer_size)
+    if (s->t4_t6_rx.row_runs_handler)
+    {
+        /* The row goes straight to the handler as run lengths, without ever being
+           expanded into a bitmap. */
+        t = NULL;
+    }
+    else
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        /* Make sure there is room for another row */
+        if ((t = t4_page_buffer_row(&s->image, s->image_length, s->bytes_per_row)) == NULL)
             return -1;
-        s->image_buffer_size += 100*s->bytes_per_row;
-        s->image_buffer = t;
     }
     if (s->row_len == s->image_width)
     {
@@ -489,24 +757,34 @@ static int put_decoded_row(t4_state_t *s)
                 s->t4_t6_rx.longest_bad_row_run = s->t4_t6_rx.curr_bad_row_run;
             s->t4_t6_rx.curr_bad_row_run = 0;
         }
-        /* Convert the runs to a bit image of the row */
-        /* White/black/white... runs, always starting with white. That means the first run could be
-           zero length. */
-        for (x = 0, fudge = 0;  x < s->t4_t6_rx.a_cursor;  x++, fudge ^= 0xFF)
+        if (s->t4_t6_rx.row_runs_handler)
+        {
+            if (s->t4_t6_rx.row_runs_handler(s->t4_t6_rx.row_runs_user_data, s->cur_runs, s->t4_t6_rx.a_cursor) < 0)
+                return -1;
+            s->image_size += s->bytes_per_row;
+        }
+        else
         {
-            i = s->cur_runs[x];
-            if ((int) i >= s->tx_bits)
+            /* Convert the runs to a bit image of the row */
+            /* White/black/white... runs, always starting with white. That means the first run could be
+               zero length. */
+            for (x = 0, fudge = 0;  x < s->t4_t6_rx.a_cursor;  x++, fudge ^= 0xFF)
             {
-                s->tx_bitstream = (s->tx_bitstream << s->tx_bits) | (msbmask[s->tx_bits] & fudge);
-                for (i += (8 - s->tx_bits);  i >= 8;  i -= 8)
+                i = s->cur_runs[x];
+                if ((int) i >= s->tx_bits)
                 {
-                    s->tx_bits = 8;
-                    s->image_buffer[s->image_size++] = (uint8_t) s->tx_bitstream;
-                    s->tx_bitstream = fudge;
+                    s->tx_bitstream = (s->tx_bitstream << s->tx_bits) | (msbmask[s->tx_bits] & fudge);
+                    for (i += (8 - s->tx_bits);  i >= 8;  i -= 8)
+                    {
+                        s->tx_bits = 8;
+                        *t++ = (uint8_t) s->tx_bitstream;
+                        s->image_size++;
+                        s->tx_bitstream = fudge;
+                    }
                 }
+                s->tx_bitstream = (s->tx_bitstream << i) | (msbmask[i] & fudge);
+                s->tx_bits -= i;
             }
-            s->tx_bitstream = (s->tx_bitstream << i) | (msbmask[i] & fudge);
-            s->tx_bits -= i;
         }
         s->image_length++;
     }
@@ -547,7 +825,15 @@ static int put_decoded_row(t4_state_t *s)
         if (s->image_size != s->t4_t6_rx.last_row_starts_at)
         {
             /* Copy the previous row over this one */
-            memcpy(s->image_buffer + s->image_size, s->image_buffer + s->t4_t6_rx.last_row_starts_at, s->bytes_per_row);
+            if (s->t4_t6_rx.row_runs_handler)
+            {
+                if (s->t4_t6_rx.row_runs_handler(s->t4_t6_rx.row_runs_user_data, NULL, 0) < 0)
+                    return -1;
+            }
+            else
+            {
+                memcpy(t, t4_page_buffer_row(&s->image, s->image_length - 1, s->bytes_per_row), s->bytes_per_row);
+            }
             s->image_size += s->bytes_per_row;
             s->image_length++;
         }
@@ -583,6 +869,15 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_state_t *s)
     int row;
     int i;
 
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        /* Any rows the decoder completed are already in the image. A truncated
+           image simply ends early. */
+        t85_decode_release(&s->t85_rx);
+    }
+    else
+#endif
     if (s->line_encoding == T4_COMPRESSION_ITU_T6)
     {
         /* Push enough zeros through the decoder to flush out any remaining codes */
@@ -603,7 +898,7 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_state_t *s)
     {
         for (row = 0;  row < s->image_length;  row++)
         {
-            if (s->t4_t6_rx.row_write_handler(s->t4_t6_rx.row_write_user_data, s->image_buffer + row*s->bytes_per_row, s->bytes_per_row) < 0)
+            if (s->t4_t6_rx.row_write_handler(s->t4_t6_rx.row_write_user_data, t4_page_buffer_row(&s->image, row, s->bytes_per_row), s->bytes_per_row) < 0)
             {
                 span_log(&s->logging, SPAN_LOG_WARNING, "Write error at row %d.\n", row);
                 break;
@@ -613,10 +908,12 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_state_t *s)
         if (s->t4_t6_rx.row_write_handler(s->t4_t6_rx.row_write_user_data, NULL, 0) < 0)
             span_log(&s->logging, SPAN_LOG_WARNING, "Write error at row %d.\n", row);
     }
-    else
+    else if (s->t4_t6_rx.row_runs_handler == NULL)
     {
         write_tiff_image(s);
     }
+    /* Give the image's memory back to the pool until the next page */
+    t4_page_buffer_release(&s->image);
     s->t4_t6_rx.rx_bits = 0;
     s->t4_t6_rx.rx_skip_bits = 0;
     s->t4_t6_rx.rx_bitstream = 0;
@@ -627,15 +924,52 @@ SPAN_DECLARE(int) t4_rx_end_page(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ uint32_t eol_positions(uint32_t bitstream)
+{
+    uint32_t zeros;
+
+    /* Find every bit position at which an EOL (11 zeros followed by a one)
+       starts, so a run of bits can be searched in one go, rather than by
+       shifting through them one at a time. */
+    zeros = ~bitstream;
+    zeros &= (zeros >> 1);
+    zeros &= (zeros >> 2);
+    zeros &= (zeros >> 4);
+    zeros &= (zeros >> 3);
+    return zeros & (bitstream >> 11);
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void skip_rx_bits(t4_state_t *s)
+{
+    int skip;
+    uint32_t eols;
+
+    /* Clear out as much of the remaining bits of the last code word as we
+       can, while still leaving the 13 bits needed to spot an EOL. We must stop
+       short at any misaligned EOL which starts within them, or a single bit
+       error can severely damage an image. An EOL starting right at the end of
+       the skip will be picked up next time around the decode loop, so only the
+       bits in between need to be checked. */
+    skip = s->t4_t6_rx.rx_bits - 12;
+    if (skip > s->t4_t6_rx.rx_skip_bits)
+        skip = s->t4_t6_rx.rx_skip_bits;
+    if (skip > 1)
+    {
+        if ((eols = eol_positions(s->t4_t6_rx.rx_bitstream) & ((1U << skip) - 2)))
+            skip = bottom_bit(eols);
+    }
+    s->t4_t6_rx.rx_skip_bits -= skip;
+    s->t4_t6_rx.rx_bits -= skip;
+    s->t4_t6_rx.rx_bitstream >>= skip;
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ void drop_rx_bits(t4_state_t *s, int bits)
 {
-    /* Only remove one bit right now. The rest need to be removed step by step,
-       checking for a misaligned EOL along the way. This is time consuming, but
-       if we don't do it a single bit error can severely damage an image. */
     s->row_bits += bits;
-    s->t4_t6_rx.rx_skip_bits += (bits - 1);
-    s->t4_t6_rx.rx_bits--;
-    s->t4_t6_rx.rx_bitstream >>= 1;
+    s->t4_t6_rx.rx_skip_bits = bits;
+    skip_rx_bits(s);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -654,9 +988,13 @@ static int rx_put_bits(t4_state_t *s, uint32_t bit_string, int quantity)
 {
     int bits;
     int old_a0;
+    int skip;
+    uint32_t eols;
 
-    /* We decompress bit by bit, as the data stream is received. We need to
-       scan continuously for EOLs, so we might as well work this way. */
+    /* We decompress as the data stream is received. Each code word is resolved
+       by a single table lookup, but we need to scan continuously for EOLs, so
+       the bits of each code are only dropped once we know no EOL starts among
+       them. */
     s->line_image_size += quantity;
     s->t4_t6_rx.rx_bitstream |= (bit_string << s->t4_t6_rx.rx_bits);
     /* The longest item we need to scan for is 13 bits long (a 2D EOL), so we
@@ -673,14 +1011,18 @@ static int rx_put_bits(t4_state_t *s, uint32_t bit_string, int quantity)
         if (s->t4_t6_rx.consecutive_eols < 0)
         {
             /* We are waiting for the very first EOL (1D or 2D only). */
-            /* We need to take this bit by bit, as the EOL could be anywhere,
-               and any junk could preceed it. */
-            while ((s->t4_t6_rx.rx_bitstream & 0xFFF) != 0x800)
+            /* The EOL could be anywhere, and any junk could preceed it, so
+               search every bit position where a complete EOL could start. */
+            eols = eol_positions(s->t4_t6_rx.rx_bitstream) & ((2U << (s->t4_t6_rx.rx_bits - 13)) - 1);
+            if (eols == 0)
             {
-                s->t4_t6_rx.rx_bitstream >>= 1;
-                if (--s->t4_t6_rx.rx_bits < 13)
-                    return FALSE;
+                s->t4_t6_rx.rx_bitstream >>= (s->t4_t6_rx.rx_bits - 12);
+                s->t4_t6_rx.rx_bits = 12;
+                return FALSE;
             }
+            skip = bottom_bit(eols);
+            s->t4_t6_rx.rx_bitstream >>= skip;
+            s->t4_t6_rx.rx_bits -= skip;
             /* We have an EOL, so now the page begins and we can proceed to
                process the bit stream as image data. */
             s->t4_t6_rx.consecutive_eols = 0;
@@ -769,9 +1111,7 @@ static int rx_put_bits(t4_state_t *s, uint32_t bit_string, int quantity)
         {
             /* We are clearing out the remaining bits of the last code word we
                absorbed. */
-            s->t4_t6_rx.rx_skip_bits--;
-            s->t4_t6_rx.rx_bits--;
-            s->t4_t6_rx.rx_bitstream >>= 1;
+            skip_rx_bits(s);
             continue;
         }
         if (s->row_is_2d  &&  s->t4_t6_rx.black_white == 0)
@@ -972,14 +1312,79 @@ static int rx_put_bits(t4_state_t *s, uint32_t bit_string, int quantity)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(SPANDSP_SUPPORT_T85)
+static int t85_row_write_handler(void *user_data, const uint8_t buf[], size_t len)
+{
+    t4_state_t *s;
+    uint8_t *t;
+
+    s = (t4_state_t *) user_data;
+    if ((t = t4_page_buffer_row(&s->image, s->image_length, s->bytes_per_row)) == NULL)
+        return -1;
+    /* The image header has already been checked against the page width, so the row
+       can only be short, never long. */
+    if (len > (size_t) s->bytes_per_row)
+        len = s->bytes_per_row;
+    memcpy(t, buf, len);
+    if (len < (size_t) s->bytes_per_row)
+        memset(t + len, 0, s->bytes_per_row - len);
+    s->image_size += s->bytes_per_row;
+    s->image_length++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t85_put_chunk(t4_state_t *s, const uint8_t buf[], int len)
+{
+    uint8_t reversed[256];
+    int chunk;
+    int i;
+
+    s->line_image_size += 8*len;
+    /* The T.4 layer passes bytes with the first bit received in the least significant
+       bit, but JBIG data is defined most significant bit first. */
+    while (len > 0)
+    {
+        chunk = (len > (int) sizeof(reversed))  ?  (int) sizeof(reversed)  :  len;
+        for (i = 0;  i < chunk;  i++)
+            reversed[i] = bit_reverse8(buf[i]);
+        if (t85_decode_put_chunk(&s->t85_rx, reversed, chunk))
+            return TRUE;
+        buf += chunk;
+        len -= chunk;
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
 SPAN_DECLARE(int) t4_rx_put_bit(t4_state_t *s, int bit)
 {
+#if defined(SPANDSP_SUPPORT_T85)
+    uint8_t byte;
+
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        /* Gather whole bytes for the T.85 decoder */
+        s->t4_t6_rx.rx_bitstream |= ((bit & 1) << s->t4_t6_rx.rx_bits);
+        if (++s->t4_t6_rx.rx_bits < 8)
+            return FALSE;
+        byte = (uint8_t) s->t4_t6_rx.rx_bitstream;
+        s->t4_t6_rx.rx_bitstream = 0;
+        s->t4_t6_rx.rx_bits = 0;
+        return t85_put_chunk(s, &byte, 1);
+    }
+#endif
     return rx_put_bits(s, bit & 1, 1);
 }
 /*- End of function --------------------------------------------------------*/
 
 SPAN_DECLARE(int) t4_rx_put_byte(t4_state_t *s, uint8_t byte)
 {
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+        return t85_put_chunk(s, &byte, 1);
+#endif
     return rx_put_bits(s, byte & 0xFF, 8);
 }
 /*- End of function --------------------------------------------------------*/
@@ -989,6 +1394,10 @@ SPAN_DECLARE(int) t4_rx_put_chunk(t4_state_t *s, const uint8_t buf[], int len)
     int i;
     uint8_t byte;
 
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+        return t85_put_chunk(s, buf, len);
+#endif
     for (i = 0;  i < len;  i++)
     {
         byte = buf[i];
@@ -1007,6 +1416,42 @@ SPAN_DECLARE(int) t4_rx_set_row_write_handler(t4_state_t *s, t4_row_write_handle
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t4_rx_set_background_writing(t4_state_t *s, int background)
+{
+#if defined(T4_RX_USE_TIFF_WRITER)
+    t4_rx_tiff_writer_t *w;
+
+    if (!background)
+    {
+        /* Any pages already queued will be written before we return */
+        stop_tiff_writer(s);
+        return 0;
+    }
+    if (s->tiff_writer)
+        return 0;
+    if (s->tiff.tiff_file == NULL)
+        return -1;
+    if ((w = (t4_rx_tiff_writer_t *) malloc(sizeof(*w))) == NULL)
+        return -1;
+    memset(w, 0, sizeof(*w));
+    w->t4 = s;
+    pthread_mutex_init(&w->mutex, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, tiff_writer_thread, w))
+    {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->mutex);
+        free(w);
+        return -1;
+    }
+    s->tiff_writer = w;
+    return 0;
+#else
+    return (background)  ?  -1  :  0;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(t4_state_t *) t4_rx_init(t4_state_t *s, const char *file, int output_encoding)
 {
     if (s == NULL)
@@ -1021,11 +1466,14 @@ SPAN_DECLARE(t4_state_t *) t4_rx_init(t4_state_t *s, const char *file, int outpu
     
     span_log(&s->logging, SPAN_LOG_FLOW, "Start rx document\n");
 
-    if (open_tiff_output_file(s, file) < 0)
-        return NULL;
-
-    /* Save the file name for logging reports. */
-    s->tiff.file = strdup(file);
+    /* A NULL file name means the decoded rows are only delivered through a handler. */
+    if (file)
+    {
+        if (open_tiff_output_file(s, file) < 0)
+            return NULL;
+        /* Save the file name for logging reports. */
+        s->tiff.file = strdup(file);
+    }
     /* Only provide for one form of coding throughout the file, even though the
        coding on the wire could change between pages. */
     switch (output_encoding)
@@ -1053,8 +1501,7 @@ SPAN_DECLARE(t4_state_t *) t4_rx_init(t4_state_t *s, const char *file, int outpu
     s->tiff.start_page = 0;
     s->tiff.stop_page = INT_MAX;
 
-    s->image_buffer = NULL;
-    s->image_buffer_size = 0;
+    t4_page_buffer_init(&s->image);
 
     /* Set some default values */
     s->x_resolution = T4_X_RESOLUTION_R8;
@@ -1072,8 +1519,14 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_state_t *s)
     uint32_t *bufptr;
 
     span_log(&s->logging, SPAN_LOG_FLOW, "Start rx page - compression %d\n", s->line_encoding);
-    if (s->tiff.tiff_file == NULL)
+    if (s->tiff.tiff_file == NULL
+        &&
+        s->t4_t6_rx.row_write_handler == NULL
+        &&
+        s->t4_t6_rx.row_runs_handler == NULL)
+    {
         return -1;
+    }
 
     /* Calculate the scanline/tile width. */
     bytes_per_row = (s->image_width + 7)/8;
@@ -1131,6 +1584,19 @@ SPAN_DECLARE(int) t4_rx_start_page(t4_state_t *s)
 
     s->t4_t6_rx.run_length = 0;
 
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        if (t85_decode_init(&s->t85_rx, t85_row_write_handler, s) == NULL)
+            return -1;
+        /* Don't let a bad image header make us accept rows wider than the page, or an
+           absurd number of rows */
+        t85_decode_set_image_size_constraints(&s->t85_rx,
+                                              s->image_width,
+                                              (uint32_t) (((int64_t) s->y_resolution*T4_MAX_PAGE_LENGTH_MM)/1000));
+    }
+#endif
+
     time (&s->page_start_time);
 
     return 0;
@@ -1158,6 +1624,172 @@ SPAN_DECLARE(int) t4_rx_free(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+void t4_rx_checkpoint(t4_state_t *s, checkpoint_t *c)
+{
+    t4_t6_decode_state_t *t;
+#if defined(SPANDSP_SUPPORT_T85)
+    t85_decode_state_t *u;
+    int cur_row;
+    int prev_row;
+    int prev_row2;
+#endif
+
+    if (c->restoring)
+    {
+        /* A freshly initialised T.30 context has not started a document, so there is
+           nothing here to lose. */
+        memset(s, 0, sizeof(*s));
+        span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
+        span_log_set_protocol(&s->logging, "T.4");
+        t4_page_buffer_init(&s->image);
+    }
+#if defined(T4_RX_USE_TIFF_WRITER)
+    else
+    {
+        /* Pages already received must be in the file before anyone else opens it */
+        stop_tiff_writer(s);
+    }
+#endif
+    checkpoint_field(c, s->rx);
+    checkpoint_field(c, s->line_encoding);
+    checkpoint_field(c, s->page_start_time);
+    checkpoint_field(c, s->line_image_size);
+    checkpoint_field(c, s->bytes_per_row);
+    checkpoint_field(c, s->image_size);
+    checkpoint_field(c, s->current_page);
+    checkpoint_field(c, s->x_resolution);
+    checkpoint_field(c, s->y_resolution);
+    checkpoint_field(c, s->image_width);
+    checkpoint_field(c, s->image_length);
+    checkpoint_field(c, s->row);
+    checkpoint_field(c, s->row_is_2d);
+    checkpoint_field(c, s->row_len);
+    checkpoint_field(c, s->tx_bitstream);
+    checkpoint_field(c, s->tx_bits);
+    checkpoint_field(c, s->row_bits);
+    checkpoint_field(c, s->min_row_bits);
+    checkpoint_field(c, s->max_row_bits);
+    checkpoint_logging(c, &s->logging);
+
+    /* The strings describing the call belong to the T.30 context, which points us at
+       them again once it has been restored. */
+    checkpoint_string(c, &s->tiff.file);
+    checkpoint_field(c, s->tiff.output_compression);
+    checkpoint_field(c, s->tiff.photo_metric);
+    checkpoint_field(c, s->tiff.fill_order);
+    checkpoint_field(c, s->tiff.output_t4_options);
+    checkpoint_field(c, s->tiff.pages_in_file);
+    checkpoint_field(c, s->tiff.start_page);
+    checkpoint_field(c, s->tiff.stop_page);
+
+    t = &s->t4_t6_rx;
+    checkpoint_field(c, t->last_row_starts_at);
+    checkpoint_field(c, t->consecutive_eols);
+    checkpoint_field(c, t->a0);
+    checkpoint_field(c, t->b1);
+    checkpoint_field(c, t->run_length);
+    checkpoint_field(c, t->black_white);
+    checkpoint_field(c, t->its_black);
+    checkpoint_field(c, t->a_cursor);
+    checkpoint_field(c, t->b_cursor);
+    checkpoint_field(c, t->rx_bitstream);
+    checkpoint_field(c, t->rx_bits);
+    checkpoint_field(c, t->rx_skip_bits);
+    checkpoint_field(c, t->curr_bad_row_run);
+    checkpoint_field(c, t->longest_bad_row_run);
+    checkpoint_field(c, t->bad_rows);
+
+    checkpoint_page_buffer(c, &s->image);
+    checkpoint_buffer(c, &s->cur_runs, (s->image_width + 4)*sizeof(uint32_t));
+    checkpoint_buffer(c, &s->ref_runs, (s->image_width + 4)*sizeof(uint32_t));
+    checkpoint_buffer(c, &s->row_buf, s->bytes_per_row);
+
+#if defined(SPANDSP_SUPPORT_T85)
+    u = &s->t85_rx;
+    checkpoint_field(c, u->s.st);
+    checkpoint_field(c, u->s.c);
+    checkpoint_field(c, u->s.a);
+    checkpoint_field(c, u->s.ct);
+    checkpoint_field(c, u->s.startup);
+    checkpoint_field(c, u->s.nopadding);
+    checkpoint_field(c, u->state);
+    checkpoint_field(c, u->buffer);
+    checkpoint_field(c, u->buf_len);
+    checkpoint_field(c, u->buf_ptr);
+    checkpoint_field(c, u->comment_skip);
+    checkpoint_field(c, u->max_xd);
+    checkpoint_field(c, u->max_yd);
+    checkpoint_field(c, u->xd);
+    checkpoint_field(c, u->yd);
+    checkpoint_field(c, u->l0);
+    checkpoint_field(c, u->mx);
+    checkpoint_field(c, u->options);
+    checkpoint_field(c, u->y);
+    checkpoint_field(c, u->i);
+    checkpoint_field(c, u->x);
+    checkpoint_field(c, u->row_started);
+    checkpoint_field(c, u->ltp_old);
+    checkpoint_field(c, u->r1);
+    checkpoint_field(c, u->r2);
+    checkpoint_field(c, u->r3);
+    checkpoint_field(c, u->tx);
+    checkpoint_field(c, u->at_row);
+    checkpoint_field(c, u->at_tx);
+    checkpoint_field(c, u->at_moves);
+    checkpoint_field(c, u->reset);
+    checkpoint_field(c, u->marker_peek);
+    checkpoint_field(c, u->newlen_pending);
+    checkpoint_field(c, u->bytes_per_row);
+    /* The row pointers lead into the row buffer */
+    cur_row = (u->row_buf)  ?  u->cur_row - u->row_buf  :  0;
+    prev_row = (u->row_buf)  ?  u->prev_row - u->row_buf  :  0;
+    prev_row2 = (u->row_buf)  ?  u->prev_row2 - u->row_buf  :  0;
+    checkpoint_field(c, cur_row);
+    checkpoint_field(c, prev_row);
+    checkpoint_field(c, prev_row2);
+    checkpoint_buffer(c, &u->row_buf, 3*(u->bytes_per_row + 1));
+    if (c->restoring)
+    {
+        u->row_write_handler = t85_row_write_handler;
+        u->row_write_user_data = s;
+        u->s.pscd_ptr = NULL;
+        u->s.pscd_end = NULL;
+        if (u->row_buf)
+        {
+            u->cur_row = u->row_buf + cur_row;
+            u->prev_row = u->row_buf + prev_row;
+            u->prev_row2 = u->row_buf + prev_row2;
+        }
+    }
+#endif
+#if defined(HAVE_LIBTIFF)
+    /* Pages received so far are already in the file, so add to it */
+    if (c->restoring  &&  !c->failed  &&  s->tiff.file)
+    {
+        if ((s->tiff.tiff_file = TIFFOpen(s->tiff.file, "a")) == NULL)
+            c->failed = TRUE;
+    }
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+void t4_rx_checkpoint_handover(t4_state_t *s)
+{
+    /* Once the checkpoint has been written the file belongs to whoever restores it. It
+       is closed as it stands, without the tidying up at the end of a call. */
+#if defined(HAVE_LIBTIFF)
+    if (s->tiff.tiff_file)
+    {
+        TIFFClose(s->tiff.tiff_file);
+        s->tiff.tiff_file = NULL;
+    }
+#endif
+    if (s->tiff.file)
+        free((char *) s->tiff.file);
+    s->tiff.file = NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t4_rx_set_rx_encoding(t4_state_t *s, int encoding)
 {
     s->line_encoding = encoding;
@@ -1227,6 +1859,37 @@ SPAN_DECLARE(void) t4_rx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t)
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) t4_rx_get_allocated_memory(t4_state_t *s)
+{
+    int mem;
+#if defined(T4_RX_USE_TIFF_WRITER)
+    t4_rx_tiff_page_t *page;
+#endif
+
+    mem = t4_page_buffer_allocated_memory(&s->image);
+    if (s->cur_runs)
+        mem += 2*(s->image_width + 4)*sizeof(uint32_t);
+    if (s->row_buf)
+        mem += s->bytes_per_row;
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->t85_rx.row_buf)
+        mem += 3*(s->t85_rx.bytes_per_row + 1);
+#endif
+#if defined(T4_RX_USE_TIFF_WRITER)
+    /* Pages waiting to be written hold their images until the writer has finished with them */
+    if (s->tiff_writer)
+    {
+        mem += sizeof(*s->tiff_writer);
+        pthread_mutex_lock(&s->tiff_writer->mutex);
+        for (page = s->tiff_writer->head;  page;  page = page->next)
+            mem += sizeof(*page) + t4_page_buffer_allocated_memory(&page->image);
+        pthread_mutex_unlock(&s->tiff_writer->mutex);
+    }
+#endif
+    return mem;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(const char *) t4_encoding_to_str(int encoding)
 {
     switch (encoding)
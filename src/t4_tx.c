@@ -66,6 +66,8 @@
 #include <time.h>
 #include <memory.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #if defined(HAVE_TGMATH_H)
 #include <tgmath.h>
 #endif
@@ -74,12 +76,18 @@
 #endif
 #include "floating_fudge.h"
 #include <tiffio.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define T4_TX_USE_PRE_ENCODER
+#define T4_TX_PAGE_CACHE_LOCKING
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/logging.h"
 #include "spandsp/bit_operations.h"
 #include "spandsp/async.h"
 #include "spandsp/timezone.h"
+#include "spandsp/t4_page_buffer.h"
 #include "spandsp/t4_rx.h"
 #include "spandsp/t4_tx.h"
 #if defined(SPANDSP_SUPPORT_T85)
@@ -90,15 +98,19 @@
 #include "spandsp/t4_t6_encode.h"
 
 #include "spandsp/private/logging.h"
+#include "spandsp/private/timezone.h"
 #if defined(SPANDSP_SUPPORT_T85)
 #include "spandsp/private/t81_t82_arith_coding.h"
 #include "spandsp/private/t85.h"
 #endif
 #include "spandsp/private/t4_t6_decode.h"
 #include "spandsp/private/t4_t6_encode.h"
+#include "spandsp/private/t4_page_buffer.h"
 #include "spandsp/private/t4_rx.h"
 #include "spandsp/private/t4_tx.h"
 
+#include "checkpoint_local.h"
+
 /*! The number of centimetres in one inch */
 #define CM_PER_INCH                 2.54f
 
@@ -107,6 +119,152 @@
 /*! The number of EOLs to be sent at the end of a T.6 page */
 #define EOLS_TO_END_T6_TX_PAGE      2
 
+/* The vertical resolutions, and the K factor (the maximum number of rows from
+   one 1D row to the next) for T.4 2D coding at each of them. */
+static const struct
+{
+    float resolution;
+    int code;
+    int max_rows_to_next_1d_row;
+} y_res_table[] =
+{
+    {             38.50f, T4_Y_RESOLUTION_STANDARD, 2},
+    {             77.00f, T4_Y_RESOLUTION_FINE, 4},
+    { 300.0f/CM_PER_INCH, T4_Y_RESOLUTION_300, 6},
+    {            154.00f, T4_Y_RESOLUTION_SUPERFINE, 8},
+    { 600.0f/CM_PER_INCH, T4_Y_RESOLUTION_600, 12},
+    { 800.0f/CM_PER_INCH, T4_Y_RESOLUTION_800, 16},
+    {1200.0f/CM_PER_INCH, T4_Y_RESOLUTION_1200, 24},
+    {             -1.00f, -1, -1}
+};
+
+/*!
+    The identity of an encoded page. Pages match when they come from the same version of
+    the same file, and are encoded in exactly the same way. A file rewritten within the
+    same second, and to the same size, is still seen as changed, through its status
+    change time, and through the nanoseconds of its modification time where the system
+    provides them.
+*/
+typedef struct
+{
+    /*! \brief The device holding the TIFF file. */
+    uint64_t file_dev;
+    /*! \brief The TIFF file's inode. */
+    uint64_t file_ino;
+    /*! \brief The size of the TIFF file. */
+    int64_t file_size;
+    /*! \brief The modification time of the TIFF file, in seconds. */
+    int64_t file_mtime;
+    /*! \brief The nanoseconds part of the modification time of the TIFF file, if known. */
+    int64_t file_mtime_nsec;
+    /*! \brief The status change time of the TIFF file. */
+    int64_t file_ctime;
+    /*! \brief The page number in the file. */
+    int page;
+    /*! \brief The encoding. */
+    int encoding;
+    /*! \brief The minimum bits per row. */
+    int min_bits_per_row;
+    /*! \brief The text of the header line, which is empty for no header. */
+    const char *header;
+    /*! \brief A hash of all the above, for quick comparisons. */
+    uint32_t hash;
+} t4_tx_page_cache_key_t;
+
+/*! An encoded page in the page cache. */
+typedef struct t4_tx_page_cache_entry_s
+{
+    /*! \brief The next entry, in most to least recently used order. */
+    struct t4_tx_page_cache_entry_s *next;
+    /*! \brief The identity of the page. The header text is owned by the entry. */
+    t4_tx_page_cache_key_t key;
+    /*! \brief The number of rows in the page. */
+    int image_length;
+    /*! \brief The minimum bits in any row of the page. */
+    int min_row_bits;
+    /*! \brief The maximum bits in any row of the page. */
+    int max_row_bits;
+    /*! \brief The length of the encoded page, in bytes. */
+    int len;
+    /*! \brief The encoded page. */
+    uint8_t *data;
+} t4_tx_page_cache_entry_t;
+
+/*! The cache of encoded pages, shared by every T.4 context sending from a TIFF file. */
+static struct
+{
+#if defined(T4_TX_PAGE_CACHE_LOCKING)
+    pthread_mutex_t mutex;
+#endif
+    t4_tx_page_cache_entry_t *entries;
+    int entry_count;
+    int bytes;
+    int byte_limit;
+    int hits;
+    int misses;
+    int evictions;
+} page_cache =
+{
+#if defined(T4_TX_PAGE_CACHE_LOCKING)
+    PTHREAD_MUTEX_INITIALIZER,
+#endif
+    NULL,
+    0,
+    0,
+    0,
+    0,
+    0,
+    0
+};
+
+#if defined(T4_TX_USE_PRE_ENCODER)
+/*!
+    Background page encoder. This works on its own T.4 context, with its own handle
+    on the TIFF file, so nothing is shared with the context sending the current page.
+    One worker thread lives for as long as background encoding is enabled. It is
+    handed one page at a time, and is polled for the result, so the sending context
+    never has to wait for it.
+*/
+typedef struct t4_tx_pre_encoder_s
+{
+    /*! \brief The context in which the next page is encoded. */
+    t4_state_t t4;
+    /*! \brief The worker thread. */
+    pthread_t thread;
+    /*! \brief Guards everything below, and the context above while no encoding is in progress. */
+    pthread_mutex_t mutex;
+    /*! \brief Signalled when a new request is posted, or the worker is told to stop. */
+    pthread_cond_t cond;
+    /*! \brief TRUE when the worker should exit. */
+    int stop;
+    /*! \brief TRUE when a request has been posted, but the worker has not yet picked it up. */
+    int pending;
+    /*! \brief TRUE while the worker is encoding a page. */
+    int busy;
+    /*! \brief TRUE when the context above holds a finished page, not yet claimed. */
+    int done;
+    /*! \brief The settings of the posted request. */
+    struct
+    {
+        int page;
+        int line_encoding;
+        int min_bits_per_row;
+        const char *local_ident;
+        const char *header_info;
+        tz_t *tz;
+    } req;
+    /*! \brief The result of starting the page in the background. */
+    int result;
+} t4_tx_pre_encoder_t;
+#endif
+
+#if defined(SPANDSP_USE_TARGET_LZCNT)
+/* The count leading zeros instruction is not part of the base instruction set,
+   so the run length scan is compiled for it specially, and only used if the
+   CPU turns out to have it. */
+#define T4_USE_LZCNT
+#endif
+
 #if defined(T4_STATE_DEBUGGING)
 static void STATE_TRACE(const char *format, ...)
 {
@@ -399,42 +557,39 @@ static void make_header(t4_state_t *s, char *header)
 }
 /*- End of function --------------------------------------------------------*/
 
-static int t4_tx_put_fax_header(t4_state_t *s)
+static int header_row_repeats(int y_resolution)
 {
-    int row;
-    int i;
-    int repeats;
-    int pattern;
-    int row_bufptr;
-    char *t;
-    char header[132 + 1];
-
-    /* Modify the resulting image to include a header line, typical of hardware FAX machines */
-    make_header(s, header);
-    switch (s->y_resolution)
+    /* Each row of the header font is repeated, to give the same height at any resolution */
+    switch (y_resolution)
     {
     case T4_Y_RESOLUTION_1200:
-        repeats = 12;
-        break;
+        return 12;
     case T4_Y_RESOLUTION_800:
-        repeats = 8;
-        break;
+        return 8;
     case T4_Y_RESOLUTION_600:
-        repeats = 6;
-        break;
+        return 6;
     case T4_Y_RESOLUTION_SUPERFINE:
-        repeats = 4;
-        break;
+        return 4;
     case T4_Y_RESOLUTION_300:
-        repeats = 3;
-        break;
+        return 3;
     case T4_Y_RESOLUTION_FINE:
-        repeats = 2;
-        break;
-    default:
-        repeats = 1;
-        break;
+        return 2;
     }
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int t4_tx_put_fax_header(t4_state_t *s, const char *header)
+{
+    int row;
+    int i;
+    int repeats;
+    int pattern;
+    int row_bufptr;
+    const char *t;
+
+    /* Modify the resulting image to include a header line, typical of hardware FAX machines */
+    repeats = header_row_repeats(s->y_resolution);
     for (row = 0;  row < 16;  row++)
     {
         t = header;
@@ -482,22 +637,6 @@ static int get_tiff_directory_info(t4_state_t *s)
         {1200.0f/CM_PER_INCH, T4_X_RESOLUTION_1200},
         {             -1.00f, -1}
     };
-    static const struct
-    {
-        float resolution;
-        int code;
-        int max_rows_to_next_1d_row;
-    } y_res_table[] =
-    {
-        {             38.50f, T4_Y_RESOLUTION_STANDARD, 2},
-        {             77.00f, T4_Y_RESOLUTION_FINE, 4},
-        { 300.0f/CM_PER_INCH, T4_Y_RESOLUTION_300, 6},
-        {            154.00f, T4_Y_RESOLUTION_SUPERFINE, 8},
-        { 600.0f/CM_PER_INCH, T4_Y_RESOLUTION_600, 12},
-        { 800.0f/CM_PER_INCH, T4_Y_RESOLUTION_800, 16},
-        {1200.0f/CM_PER_INCH, T4_Y_RESOLUTION_1200, 24},
-        {             -1.00f, -1, -1}
-    };
     uint16_t res_unit;
     uint16_t parm16;
     uint32_t parm32;
@@ -584,22 +723,6 @@ static int test_tiff_directory_info(t4_state_t *s)
         {1200.0f/CM_PER_INCH, T4_X_RESOLUTION_1200},
         {             -1.00f, -1}
     };
-    static const struct
-    {
-        float resolution;
-        int code;
-        int max_rows_to_next_1d_row;
-    } y_res_table[] =
-    {
-        {             38.50f, T4_Y_RESOLUTION_STANDARD, 2},
-        {             77.00f, T4_Y_RESOLUTION_FINE, 4},
-        { 300.0f/CM_PER_INCH, T4_Y_RESOLUTION_300, 6},
-        {            154.00f, T4_Y_RESOLUTION_SUPERFINE, 8},
-        { 600.0f/CM_PER_INCH, T4_Y_RESOLUTION_600, 12},
-        { 800.0f/CM_PER_INCH, T4_Y_RESOLUTION_800, 16},
-        {1200.0f/CM_PER_INCH, T4_Y_RESOLUTION_1200, 24},
-        {             -1.00f, -1, -1}
-    };
     uint16_t res_unit;
     uint16_t parm16;
     uint32_t parm32;
@@ -722,12 +845,10 @@ static void update_row_bit_info(t4_state_t *s)
 
 static int free_buffers(t4_state_t *s)
 {
-    if (s->image_buffer)
-    {
-        free(s->image_buffer);
-        s->image_buffer = NULL;
-        s->image_buffer_size = 0;
-    }
+    t4_page_buffer_release(&s->image);
+#if defined(SPANDSP_SUPPORT_T85)
+    t85_encode_release(&s->t85_tx);
+#endif
     if (s->cur_runs)
     {
         free(s->cur_runs);
@@ -747,10 +868,50 @@ static int free_buffers(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
+static __inline__ uint64_t get_row_word(const uint8_t row[])
+{
+    uint64_t x;
+
+    /* Get 64 pixels, with the first one in the most significant bit */
+#if defined(__GNUC__)  &&  defined(__BYTE_ORDER__)  &&  (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(&x, row, sizeof(x));
+    x = __builtin_bswap64(x);
+#else
+    x = ((uint64_t) row[0] << 56)
+      | ((uint64_t) row[1] << 48)
+      | ((uint64_t) row[2] << 40)
+      | ((uint64_t) row[3] << 32)
+      | ((uint64_t) row[4] << 24)
+      | ((uint64_t) row[5] << 16)
+      | ((uint64_t) row[6] << 8)
+      | ((uint64_t) row[7]);
+#endif
+    return x;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ int leading_zeros64(uint64_t x)
+{
+#if defined(__GNUC__)
+    /* With a count leading zeros instruction available, the compiler makes the
+       zero test disappear. */
+    return (x)  ?  __builtin_clzll(x)  :  64;
+#else
+    if ((x >> 32))
+        return 31 - top_bit((uint32_t) (x >> 32));
+    return 63 - top_bit((uint32_t) x);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(__GNUC__)
+static __inline__ __attribute__((always_inline)) int row_to_run_lengths_core(uint32_t list[], const uint8_t row[], int width)
+#else
+static __inline__ int row_to_run_lengths_core(uint32_t list[], const uint8_t row[], int width)
+#endif
 {
-    uint32_t flip;
-    uint32_t x;
+    uint64_t flip;
+    uint64_t x;
     int span;
     int entry;
     int frag;
@@ -759,62 +920,84 @@ static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
     int i;
     int pos;
 
+    /* Most rows of a typical fax page are entirely white, so look for that case
+       quickly. Any white words we pass over here are simply skipped by the full
+       scan below. */
+    limit = (width >> 3) & ~7;
+    for (i = 0;  i < limit;  i += sizeof(uint64_t))
+    {
+        if (get_row_word(&row[i]))
+            break;
+    }
+    if (i >= limit)
+    {
+        for (  ;  i < (width >> 3);  i++)
+        {
+            if (row[i])
+                break;
+        }
+        if (i >= (width >> 3)  &&  ((width & 7) == 0  ||  (row[i] & (0xFF00 >> (width & 7))) == 0))
+        {
+            list[0] = width;
+            return 1;
+        }
+        i = limit;
+    }
+
     /* Deal with whole words first. We know we are starting on a word boundary. */
     entry = 0;
     flip = 0;
-    limit = (width >> 3) & ~3;
     span = 0;
     pos = 0;
-    for (i = 0;  i < limit;  i += sizeof(uint32_t))
+    for (  ;  i < limit;  i += sizeof(uint64_t))
     {
-        x = *((uint32_t *) &row[i]);
+        x = get_row_word(&row[i]);
         if (x != flip)
         {
-            x = ((uint32_t) row[i] << 24) | ((uint32_t) row[i + 1] << 16) | ((uint32_t) row[i + 2] << 8) | ((uint32_t) row[i + 3]);
             /* We know we are going to find at least one transition. */
-            frag = 31 - top_bit(x ^ flip);
+            frag = leading_zeros64(x ^ flip);
             pos += ((i << 3) - span + frag);
             list[entry++] = pos;
             x <<= frag;
-            flip ^= 0xFFFFFFFF;
-            rem = 32 - frag;
+            flip = ~flip;
+            rem = 64 - frag;
             /* Now see if there are any more */
-            while ((frag = 31 - top_bit(x ^ flip)) < rem)
+            while ((frag = leading_zeros64(x ^ flip)) < rem)
             {
                 pos += frag;
                 list[entry++] = pos;
                 x <<= frag;
-                flip ^= 0xFFFFFFFF;
+                flip = ~flip;
                 rem -= frag;
             }
             /* Save the remainder of the word */
-            span = (i << 3) + 32 - rem;
+            span = (i << 3) + 64 - rem;
         }
     }
     /* Now deal with some whole bytes, if there are any left. */
     limit = width >> 3;
-    flip &= 0xFF000000;
+    flip &= 0xFF00000000000000ULL;
     if (i < limit)
     {
         for (  ;  i < limit;  i++)
         {
-            x = (uint32_t) row[i] << 24;
+            x = (uint64_t) row[i] << 56;
             if (x != flip)
             {
                 /* We know we are going to find at least one transition. */
-                frag = 31 - top_bit(x ^ flip);
+                frag = leading_zeros64(x ^ flip);
                 pos += ((i << 3) - span + frag);
                 list[entry++] = pos;
                 x <<= frag;
-                flip ^= 0xFF000000;
+                flip ^= 0xFF00000000000000ULL;
                 rem = 8 - frag;
                 /* Now see if there are any more */
-                while ((frag = 31 - top_bit(x ^ flip)) < rem)
+                while ((frag = leading_zeros64(x ^ flip)) < rem)
                 {
                     pos += frag;
                     list[entry++] = pos;
                     x <<= frag;
-                    flip ^= 0xFF000000;
+                    flip ^= 0xFF00000000000000ULL;
                     rem -= frag;
                 }   
                 /* Save the remainder of the word */
@@ -826,18 +1009,17 @@ static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
     span = (i << 3) - span;
     if ((rem = width & 7))
     {
-        x = row[i];
-        x <<= 24;
+        x = (uint64_t) row[i] << 56;
         do
         {
-            frag = 31 - top_bit(x ^ flip);
+            frag = leading_zeros64(x ^ flip);
             if (frag > rem)
                 frag = rem;
             pos += (span + frag);
             list[entry++] = pos;
             x <<= frag;
             span = 0;
-            flip ^= 0xFF000000;
+            flip ^= 0xFF00000000000000ULL;
             rem -= frag;
         }
         while (rem > 0);
@@ -854,25 +1036,42 @@ static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
 }
 /*- End of function --------------------------------------------------------*/
 
+#if defined(T4_USE_LZCNT)
+static __attribute__((target("lzcnt"))) int row_to_run_lengths_lzcnt(uint32_t list[], const uint8_t row[], int width)
+{
+    return row_to_run_lengths_core(list, row, width);
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static int row_to_run_lengths(uint32_t list[], const uint8_t row[], int width)
+{
+#if defined(T4_USE_LZCNT)
+    if (__builtin_cpu_supports("lzcnt"))
+        return row_to_run_lengths_lzcnt(list, row, width);
+#endif
+    return row_to_run_lengths_core(list, row, width);
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int put_encoded_bits(t4_state_t *s, uint32_t bits, int length)
 {
-    uint8_t *t;
+    int len;
 
     /* We might be called with a large length value, to spew out a mass of zero bits for
        minimum row length padding. */
     s->tx_bitstream |= (bits << s->tx_bits);
     s->tx_bits += length;
     s->row_bits += length;
-    if ((s->image_size + (s->tx_bits + 7)/8) >= s->image_buffer_size)
+    len = s->image_size + (s->tx_bits + 7)/8;
+    if (len > s->image.chunks_held*T4_PAGE_BUFFER_CHUNK_SIZE)
     {
-        if ((t = realloc(s->image_buffer, s->image_buffer_size + 100*s->bytes_per_row)) == NULL)
+        if (t4_page_buffer_grow(&s->image, len))
             return -1;
-        s->image_buffer = t;
-        s->image_buffer_size += 100*s->bytes_per_row;
     }
     while (s->tx_bits >= 8)
     {
-        s->image_buffer[s->image_size++] = (uint8_t) (s->tx_bitstream & 0xFF);
+        *t4_page_buffer_byte(&s->image, s->image_size++) = (uint8_t) (s->tx_bitstream & 0xFF);
         s->tx_bitstream >>= 8;
         s->tx_bits -= 8;
     }
@@ -910,8 +1109,6 @@ static __inline__ int put_1d_span(t4_state_t *s, int32_t span, const t4_run_tabl
 }
 /*- End of function --------------------------------------------------------*/
 
-#define pixel_is_black(x,bit) (((x)[(bit) >> 3] << ((bit) & 7)) & 0x80)
-
 /*
  * Write an EOL code to the output stream.  We also handle writing the tag
  * bit for the next scanline when doing 2D encoding.
@@ -958,9 +1155,10 @@ static void encode_eol(t4_state_t *s)
 /*- End of function --------------------------------------------------------*/
 
 /*
- * 2D-encode a row of pixels.  Consult ITU specification T.4 for the algorithm.
+ * 2D-encode a row of pixels, from the list of its changing elements in s->cur_runs.
+ * Consult ITU specification T.4 for the algorithm.
  */
-static void encode_2d_row(t4_state_t *s)
+static void encode_2d_row(t4_state_t *s, int cur_steps)
 {
     static const t4_run_table_entry_t codes[] =
     {
@@ -991,7 +1189,6 @@ static void encode_2d_row(t4_state_t *s)
     int diff;
     int a_cursor;
     int b_cursor;
-    int cur_steps;
     uint32_t *p;
 
     /*
@@ -1050,7 +1247,6 @@ static void encode_2d_row(t4_state_t *s)
                           Vertical and horizontal modes
      */
     /* The following implements the 2-D encoding section of the flow chart in Figure7/T.4 */
-    cur_steps = row_to_run_lengths(s->cur_runs, s->row_buf, s->image_width);
     /* Stretch the row a little, so when we step by 2 we are guaranteed to
        hit an entry showing the row length */
     s->cur_runs[cur_steps] =
@@ -1080,7 +1276,9 @@ static void encode_2d_row(t4_state_t *s)
                 /* Horizontal mode coding */
                 a2 = s->cur_runs[a_cursor + 1];
                 put_encoded_bits(s, codes[7].code, codes[7].length);
-                if (a0 + a1 == 0  ||  pixel_is_black(s->row_buf, a0) == 0)
+                /* a0 is always in the run which ends at changing element a_cursor, so
+                   even values of a_cursor mean a0 is white. */
+                if ((a_cursor & 1) == 0)
                 {
                     put_1d_span(s, a1 - a0, t4_white_codes);
                     put_1d_span(s, a2 - a1, t4_black_codes);
@@ -1112,7 +1310,7 @@ static void encode_2d_row(t4_state_t *s)
         /* We need to hunt for the correct position in the reference row, as the
            runs there have no particular alignment with the runs in the current
            row. */
-        if (pixel_is_black(s->row_buf, a0))
+        if ((a_cursor & 1))
             b_cursor |= 1;
         else
             b_cursor &= ~1;
@@ -1146,16 +1344,21 @@ static void encode_2d_row(t4_state_t *s)
 /*- End of function --------------------------------------------------------*/
 
 /*
- * 1D-encode a row of pixels. The encoding is a sequence of all-white or
- * all-black spans of pixels encoded with Huffman codes.
+ * 1D-encode a row of pixels, from the list of its changing elements in s->cur_runs.
+ * The encoding is a sequence of all-white or all-black spans of pixels encoded with
+ * Huffman codes.
  */
-static void encode_1d_row(t4_state_t *s)
+static void encode_1d_row(t4_state_t *s, int cur_steps)
 {
+    uint32_t *p;
     int i;
 
-    /* Do our work in the reference row buffer, and it is already in place if
-       we need a reference row for a following 2D encoded row. */
-    s->t4_t6_tx.ref_steps = row_to_run_lengths(s->ref_runs, s->row_buf, s->image_width);
+    /* Swap the buffers, so the row is already in place if we need a reference row for
+       a following 2D encoded row. */
+    s->t4_t6_tx.ref_steps = cur_steps;
+    p = s->cur_runs;
+    s->cur_runs = s->ref_runs;
+    s->ref_runs = p;
     put_1d_span(s, s->ref_runs[0], t4_white_codes);
     for (i = 1;  i < s->t4_t6_tx.ref_steps;  i++)
         put_1d_span(s, s->ref_runs[i] - s->ref_runs[i - 1], (i & 1)  ?  t4_black_codes  :  t4_white_codes);
@@ -1167,7 +1370,8 @@ static void encode_1d_row(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-static int encode_row(t4_state_t *s)
+/* Encode a row, from the list of its changing elements in s->cur_runs. */
+static int encode_row_runs(t4_state_t *s, int steps)
 {
     switch (s->line_encoding)
     {
@@ -1178,18 +1382,18 @@ static int encode_row(t4_state_t *s)
            to recover from data errors. It doesn't need EOLs, either. */
         if (s->row_bits)
             update_row_bit_info(s);
-        encode_2d_row(s);
+        encode_2d_row(s, steps);
         break;
     case T4_COMPRESSION_ITU_T4_2D:
         encode_eol(s);
         if (s->row_is_2d)
         {
-            encode_2d_row(s);
+            encode_2d_row(s, steps);
             s->t4_t6_tx.rows_to_next_1d_row--;
         }
         else
         {
-            encode_1d_row(s);
+            encode_1d_row(s, steps);
             s->row_is_2d = TRUE;
         }
         if (s->t4_t6_tx.rows_to_next_1d_row <= 0)
@@ -1202,7 +1406,7 @@ static int encode_row(t4_state_t *s)
     default:
     case T4_COMPRESSION_ITU_T4_1D:
         encode_eol(s);
-        encode_1d_row(s);
+        encode_1d_row(s, steps);
         break;
     }
     s->row++;
@@ -1210,6 +1414,101 @@ static int encode_row(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int encode_row(t4_state_t *s)
+{
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        s->row++;
+        return t85_encode_put_row(&s->t85_tx, s->row_buf);
+    }
+#endif
+    return encode_row_runs(s, row_to_run_lengths(s->cur_runs, s->row_buf, s->image_width));
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(SPANDSP_SUPPORT_T85)
+static void t85_output_byte(void *user_data, int byte)
+{
+    /* JBIG data is sent most significant bit first, but the bytes of a page image are
+       sent least significant bit first. */
+    put_encoded_bits((t4_state_t *) user_data, bit_reverse8((uint8_t) byte), 8);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int start_t85_page_encoding(t4_state_t *s, const char *header)
+{
+    uint32_t image_length;
+
+    /* When the rows come from a TIFF file we know the length of the page up front. When
+       they come from a row handler, the length is corrected with a NEWLEN at the end. */
+    image_length = 0;
+    if (s->t4_t6_tx.row_read_handler == NULL)
+    {
+        TIFFGetField(s->tiff.tiff_file, TIFFTAG_IMAGELENGTH, &image_length);
+        if (header[0])
+            image_length += 16*header_row_repeats(s->y_resolution);
+    }
+    if (t85_encode_init(&s->t85_tx, s->image_width, image_length, t85_output_byte, s) == NULL)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static void start_page_encoding(t4_state_t *s)
+{
+    s->image_size = 0;
+    s->tx_bitstream = 0;
+    s->tx_bits = 0;
+    s->row_is_2d = (s->line_encoding == T4_COMPRESSION_ITU_T6);
+    s->t4_t6_tx.rows_to_next_1d_row = s->t4_t6_tx.max_rows_to_next_1d_row - 1;
+
+    s->ref_runs[0] =
+    s->ref_runs[1] =
+    s->ref_runs[2] =
+    s->ref_runs[3] = s->image_width;
+    s->t4_t6_tx.ref_steps = 1;
+
+    s->row_bits = 0;
+    s->min_row_bits = INT_MAX;
+    s->max_row_bits = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_page_encoding(t4_state_t *s)
+{
+    int i;
+
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        /* T.85 needs no end of page marking, beyond that which ends the last stripe */
+        t85_encode_image_complete(&s->t85_tx);
+        t85_encode_release(&s->t85_tx);
+        return;
+    }
+#endif
+    if (s->line_encoding == T4_COMPRESSION_ITU_T6)
+    {
+        /* Attach an EOFB (end of facsimile block == 2 x EOLs) to the end of the page */
+        for (i = 0;  i < EOLS_TO_END_T6_TX_PAGE;  i++)
+            encode_eol(s);
+    }
+    else
+    {
+        /* Attach an RTC (return to control == 6 x EOLs) to the end of the page */
+        s->row_is_2d = FALSE;
+        for (i = 0;  i < EOLS_TO_END_T4_TX_PAGE;  i++)
+            encode_eol(s);
+    }
+
+    /* Force any partial byte in progress to flush using ones. Any post EOL padding when
+       sending is normally ones, so this is consistent. */
+    put_encoded_bits(s, 0xFF, 7);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(int) t4_tx_set_row_read_handler(t4_state_t *s, t4_row_read_handler_t handler, void *user_data)
 {
     s->t4_t6_tx.row_read_handler = handler;
@@ -1273,114 +1572,595 @@ SPAN_DECLARE(t4_state_t *) t4_tx_init(t4_state_t *s, const char *file, int start
     s->ref_runs[2] =
     s->ref_runs[3] = s->image_width;
     s->t4_t6_tx.ref_steps = 1;
-    s->image_buffer_size = 0;
+    t4_page_buffer_init(&s->image);
     return s;
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE(int) t4_tx_start_page(t4_state_t *s)
+static int resize_row_buffers(t4_state_t *s)
 {
-    int row;
-    int i;
     int run_space;
-    int len;
-    int old_image_width;
     uint8_t *bufptr8;
     uint32_t *bufptr;
 
-    span_log(&s->logging, SPAN_LOG_FLOW, "Start tx page %d\n", s->current_page);
-    if (s->current_page > s->tiff.stop_page)
+    s->bytes_per_row = (s->image_width + 7)/8;
+    run_space = (s->image_width + 4)*sizeof(uint32_t);
+    if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
         return -1;
-    if (s->tiff.tiff_file == NULL)
+    s->cur_runs = bufptr;
+    if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
         return -1;
-    old_image_width = s->image_width;
-    if (s->t4_t6_tx.row_read_handler == NULL)
-    {
-#if defined(HAVE_LIBTIFF)
-        if (!TIFFSetDirectory(s->tiff.tiff_file, (tdir_t) s->current_page))
-            return -1;
-        get_tiff_directory_info(s);
-#endif
-    }
-    s->image_size = 0;
-    s->tx_bitstream = 0;
-    s->tx_bits = 0;
-    s->row_is_2d = (s->line_encoding == T4_COMPRESSION_ITU_T6);
-    s->t4_t6_tx.rows_to_next_1d_row = s->t4_t6_tx.max_rows_to_next_1d_row - 1;
+    s->ref_runs = bufptr;
+    if ((bufptr8 = realloc(s->row_buf, s->bytes_per_row)) == NULL)
+        return -1;
+    s->row_buf = bufptr8;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
 
-    /* Allow for pages being of different width. */
-    run_space = (s->image_width + 4)*sizeof(uint32_t);
-    if (old_image_width != s->image_width)
-    {
-        s->bytes_per_row = (s->image_width + 7)/8;
+#if defined(T4_TX_USE_PRE_ENCODER)
+static void *pre_encoder_thread(void *user_data)
+{
+    t4_tx_pre_encoder_t *p;
+    t4_state_t *t;
+    int result;
 
-        if ((bufptr = (uint32_t *) realloc(s->cur_runs, run_space)) == NULL)
-            return -1;
-        s->cur_runs = bufptr;
-        if ((bufptr = (uint32_t *) realloc(s->ref_runs, run_space)) == NULL)
-            return -1;
-        s->ref_runs = bufptr;
-        if ((bufptr8 = realloc(s->row_buf, s->bytes_per_row)) == NULL)
-            return -1;
-        s->row_buf = bufptr8;
+    p = (t4_tx_pre_encoder_t *) user_data;
+    t = &p->t4;
+    for (;;)
+    {
+        pthread_mutex_lock(&p->mutex);
+        while (!p->pending  &&  !p->stop)
+            pthread_cond_wait(&p->cond, &p->mutex);
+        if (p->stop)
+        {
+            pthread_mutex_unlock(&p->mutex);
+            break;
+        }
+        /* Take a snapshot of everything which affects how the page is encoded. If
+           any of it has changed by the time the page starts, the result will not be
+           used. */
+        t->current_page = p->req.page;
+        t4_tx_set_tx_encoding(t, p->req.line_encoding);
+        t4_tx_set_min_bits_per_row(t, p->req.min_bits_per_row);
+        t4_tx_set_local_ident(t, p->req.local_ident);
+        t4_tx_set_header_info(t, p->req.header_info);
+        t->tz = p->req.tz;
+        p->pending = FALSE;
+        p->busy = TRUE;
+        p->done = FALSE;
+        pthread_mutex_unlock(&p->mutex);
+
+        result = t4_tx_start_page(t);
+
+        pthread_mutex_lock(&p->mutex);
+        p->result = result;
+        p->busy = FALSE;
+        p->done = TRUE;
+        pthread_mutex_unlock(&p->mutex);
     }
-    s->ref_runs[0] =
-    s->ref_runs[1] =
-    s->ref_runs[2] =
-    s->ref_runs[3] = s->image_width;
-    s->t4_t6_tx.ref_steps = 1;
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
 
-    s->row_bits = 0;
-    s->min_row_bits = INT_MAX;
-    s->max_row_bits = 0;
+static void pre_encode_page(t4_state_t *s, int page)
+{
+    t4_tx_pre_encoder_t *p;
+
+    if ((p = s->pre_encoder) == NULL  ||  s->t4_t6_tx.row_read_handler)
+        return;
+    if (page > s->tiff.stop_page)
+        return;
+    /* Post the request, replacing any the worker has not picked up yet. This never
+       waits for the worker. */
+    pthread_mutex_lock(&p->mutex);
+    p->req.page = page;
+    p->req.line_encoding = s->line_encoding;
+    p->req.min_bits_per_row = s->t4_t6_tx.min_bits_per_row;
+    p->req.local_ident = s->tiff.local_ident;
+    p->req.header_info = s->header_info;
+    p->req.tz = s->tz;
+    p->pending = TRUE;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+}
+/*- End of function --------------------------------------------------------*/
 
-    if (s->header_info  &&  s->header_info[0])
+static int use_pre_encoded_page(t4_state_t *s)
+{
+    t4_tx_pre_encoder_t *p;
+    t4_page_buffer_t image;
+
+    if ((p = s->pre_encoder) == NULL)
+        return FALSE;
+    pthread_mutex_lock(&p->mutex);
+    if (!p->done  ||  p->busy  ||  p->pending)
     {
-        if (t4_tx_put_fax_header(s))
-            return -1;
+        /* The page is not ready. Rather than wait for it, encode it here. */
+        pthread_mutex_unlock(&p->mutex);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Background encoding of page %d not ready\n", s->current_page);
+        return FALSE;
     }
-    if (s->t4_t6_tx.row_read_handler)
+    if (p->result
+        ||
+        p->t4.current_page != s->current_page
+        ||
+        p->t4.line_encoding != s->line_encoding
+        ||
+        p->t4.t4_t6_tx.min_bits_per_row != s->t4_t6_tx.min_bits_per_row
+        ||
+        p->t4.tiff.local_ident != s->tiff.local_ident
+        ||
+        p->t4.header_info != s->header_info
+        ||
+        p->t4.tz != s->tz
+        ||
+        s->t4_t6_tx.row_read_handler)
     {
-        for (row = 0;  ;  row++)
+        pthread_mutex_unlock(&p->mutex);
+        span_log(&s->logging, SPAN_LOG_FLOW, "Background encoding of page %d not usable\n", s->current_page);
+        return FALSE;
+    }
+    if (p->t4.image_width != s->image_width)
+    {
+        s->image_width = p->t4.image_width;
+        if (resize_row_buffers(s))
         {
-            if ((len = s->t4_t6_tx.row_read_handler(s->t4_t6_tx.row_read_user_data, s->row_buf, s->bytes_per_row)) < 0)
-            {
-                span_log(&s->logging, SPAN_LOG_WARNING, "%s: Read error at row %d.\n", s->tiff.file, row);
-                break;
-            }
-            if (len == 0)
-                break;
-            if (encode_row(s))
-                return -1;
+            pthread_mutex_unlock(&p->mutex);
+            return FALSE;
         }
-        s->image_length = row;
     }
-    else
+    /* Swap the image buffers. The old image goes back to the pool when the
+       background context starts its next page. */
+    image = s->image;
+    s->image = p->t4.image;
+    p->t4.image = image;
+
+    s->image_size = p->t4.image_size;
+    s->image_length = p->t4.image_length;
+    s->x_resolution = p->t4.x_resolution;
+    s->y_resolution = p->t4.y_resolution;
+    s->line_image_size = p->t4.line_image_size;
+    s->min_row_bits = p->t4.min_row_bits;
+    s->max_row_bits = p->t4.max_row_bits;
+    s->row_is_2d = p->t4.row_is_2d;
+    s->t4_t6_tx.max_rows_to_next_1d_row = p->t4.t4_t6_tx.max_rows_to_next_1d_row;
+    s->t4_t6_tx.rows_to_next_1d_row = p->t4.t4_t6_tx.rows_to_next_1d_row;
+    s->tiff.photo_metric = p->t4.tiff.photo_metric;
+    s->tiff.fill_order = p->t4.tiff.fill_order;
+    s->t4_t6_tx.bit_pos = 7;
+    s->t4_t6_tx.bit_ptr = 0;
+    p->done = FALSE;
+    pthread_mutex_unlock(&p->mutex);
+    return TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void free_pre_encoder(t4_state_t *s)
+{
+    t4_tx_pre_encoder_t *p;
+
+    if ((p = s->pre_encoder) == NULL)
+        return;
+    pthread_mutex_lock(&p->mutex);
+    p->stop = TRUE;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, NULL);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    t4_tx_release(&p->t4);
+    free(p);
+    s->pre_encoder = NULL;
+}
+/*- End of function --------------------------------------------------------*/
+#endif
+
+static __inline__ void page_cache_lock(void)
+{
+#if defined(T4_TX_PAGE_CACHE_LOCKING)
+    pthread_mutex_lock(&page_cache.mutex);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ void page_cache_unlock(void)
+{
+#if defined(T4_TX_PAGE_CACHE_LOCKING)
+    pthread_mutex_unlock(&page_cache.mutex);
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t page_cache_hash(uint32_t hash, const void *buf, int len)
+{
+    const uint8_t *p;
+    int i;
+
+    /* FNV-1a */
+    p = (const uint8_t *) buf;
+    for (i = 0;  i < len;  i++)
+        hash = (hash ^ p[i])*16777619U;
+    return hash;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int page_cache_make_key(t4_state_t *s, const char *header, t4_tx_page_cache_key_t *key)
+{
+    struct stat st;
+    uint32_t hash;
+    int byte_limit;
+
+    /* Don't even look at the file unless the cache is in use */
+    page_cache_lock();
+    byte_limit = page_cache.byte_limit;
+    page_cache_unlock();
+    if (byte_limit == 0  ||  s->tiff.file == NULL)
+        return -1;
+    if (stat(s->tiff.file, &st))
+        return -1;
+    memset(key, 0, sizeof(*key));
+    key->file_dev = st.st_dev;
+    key->file_ino = st.st_ino;
+    key->file_size = st.st_size;
+    key->file_mtime = st.st_mtime;
+#if defined(HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC)
+    key->file_mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+    key->file_ctime = st.st_ctime;
+    key->page = s->current_page;
+    key->encoding = s->line_encoding;
+    key->min_bits_per_row = s->t4_t6_tx.min_bits_per_row;
+    key->header = header;
+    hash = page_cache_hash(2166136261U, &key->file_dev, sizeof(key->file_dev));
+    hash = page_cache_hash(hash, &key->file_ino, sizeof(key->file_ino));
+    hash = page_cache_hash(hash, &key->file_size, sizeof(key->file_size));
+    hash = page_cache_hash(hash, &key->file_mtime, sizeof(key->file_mtime));
+    hash = page_cache_hash(hash, &key->file_mtime_nsec, sizeof(key->file_mtime_nsec));
+    hash = page_cache_hash(hash, &key->file_ctime, sizeof(key->file_ctime));
+    hash = page_cache_hash(hash, &key->page, sizeof(key->page));
+    hash = page_cache_hash(hash, &key->encoding, sizeof(key->encoding));
+    hash = page_cache_hash(hash, &key->min_bits_per_row, sizeof(key->min_bits_per_row));
+    key->hash = page_cache_hash(hash, header, strlen(header));
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int page_cache_key_matches(const t4_tx_page_cache_key_t *a, const t4_tx_page_cache_key_t *b)
+{
+    return a->hash == b->hash
+           &&
+           a->file_dev == b->file_dev
+           &&
+           a->file_ino == b->file_ino
+           &&
+           a->file_size == b->file_size
+           &&
+           a->file_mtime == b->file_mtime
+           &&
+           a->file_mtime_nsec == b->file_mtime_nsec
+           &&
+           a->file_ctime == b->file_ctime
+           &&
+           a->page == b->page
+           &&
+           a->encoding == b->encoding
+           &&
+           a->min_bits_per_row == b->min_bits_per_row
+           &&
+           strcmp(a->header, b->header) == 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+/* Drop the least recently used pages until the cache is no bigger than the specified
+   size. The cache must be locked. */
+static void page_cache_shrink(int bytes)
+{
+    t4_tx_page_cache_entry_t **pp;
+    t4_tx_page_cache_entry_t *e;
+
+    while (page_cache.bytes > bytes  &&  page_cache.entries)
     {
-        if ((s->image_length = read_tiff_image(s)) < 0)
+        for (pp = &page_cache.entries;  (*pp)->next;  pp = &(*pp)->next)
+            ;
+        e = *pp;
+        *pp = NULL;
+        page_cache.bytes -= e->len;
+        page_cache.entry_count--;
+        page_cache.evictions++;
+        free((char *) e->key.header);
+        free(e->data);
+        free(e);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int page_cache_fetch(t4_state_t *s, const t4_tx_page_cache_key_t *key)
+{
+    t4_tx_page_cache_entry_t **pp;
+    t4_tx_page_cache_entry_t *e;
+    int hit;
+
+    hit = FALSE;
+    page_cache_lock();
+    for (pp = &page_cache.entries;  (e = *pp);  pp = &e->next)
+    {
+        if (page_cache_key_matches(&e->key, key))
+        {
+            if (t4_page_buffer_put(&s->image, 0, e->data, e->len) < 0)
+                break;
+            s->image_size = e->len;
+            s->image_length = e->image_length;
+            s->min_row_bits = e->min_row_bits;
+            s->max_row_bits = e->max_row_bits;
+            /* Move the page to the front of the list, as the most recently used */
+            *pp = e->next;
+            e->next = page_cache.entries;
+            page_cache.entries = e;
+            hit = TRUE;
+            break;
+        }
+    }
+    if (hit)
+        page_cache.hits++;
+    else
+        page_cache.misses++;
+    page_cache_unlock();
+    return hit;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void page_cache_store(t4_state_t *s, const t4_tx_page_cache_key_t *key)
+{
+    t4_tx_page_cache_entry_t *e;
+
+    if ((e = (t4_tx_page_cache_entry_t *) malloc(sizeof(*e))) == NULL)
+        return;
+    memset(e, 0, sizeof(*e));
+    e->key = *key;
+    e->len = s->image_size;
+    e->image_length = s->image_length;
+    e->min_row_bits = s->min_row_bits;
+    e->max_row_bits = s->max_row_bits;
+    if ((e->key.header = strdup(key->header)) == NULL
+        ||
+        (e->data = (uint8_t *) malloc(e->len)) == NULL)
+    {
+        free((char *) e->key.header);
+        free(e);
+        return;
+    }
+    /* Copy the page outside the lock. It is only our own page buffer. */
+    t4_page_buffer_get(&s->image, 0, e->data, e->len);
+    page_cache_lock();
+    if (e->len <= page_cache.byte_limit)
+    {
+        page_cache_shrink(page_cache.byte_limit - e->len);
+        e->next = page_cache.entries;
+        page_cache.entries = e;
+        page_cache.bytes += e->len;
+        page_cache.entry_count++;
+        e = NULL;
+    }
+    page_cache_unlock();
+    if (e)
+    {
+        free((char *) e->key.header);
+        free(e->data);
+        free(e);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_page_cache_set_limit(int bytes)
+{
+    if (bytes < 0)
+        return -1;
+#if !defined(T4_TX_PAGE_CACHE_LOCKING)
+    /* The cache is shared by every context, which may be in use in different threads,
+       so it can't be used if it can't be locked. */
+    if (bytes)
+        return -1;
+#endif
+    page_cache_lock();
+    page_cache.byte_limit = bytes;
+    page_cache_shrink(bytes);
+    page_cache_unlock();
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_tx_page_cache_flush(void)
+{
+    page_cache_lock();
+    page_cache_shrink(0);
+    page_cache_unlock();
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_tx_page_cache_get_stats(t4_tx_page_cache_stats_t *stats)
+{
+    page_cache_lock();
+    stats->entries = page_cache.entry_count;
+    stats->bytes = page_cache.bytes;
+    stats->byte_limit = page_cache.byte_limit;
+    stats->hits = page_cache.hits;
+    stats->misses = page_cache.misses;
+    stats->evictions = page_cache.evictions;
+    page_cache_unlock();
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_set_pre_encoding(t4_state_t *s, int pre_encode)
+{
+#if defined(T4_TX_USE_PRE_ENCODER)
+    t4_tx_pre_encoder_t *p;
+
+    if (!pre_encode)
+    {
+        free_pre_encoder(s);
+        return 0;
+    }
+    if (s->pre_encoder)
+        return 0;
+    if (s->tiff.file == NULL)
+        return -1;
+    if ((p = (t4_tx_pre_encoder_t *) malloc(sizeof(*p))) == NULL)
+        return -1;
+    memset(p, 0, sizeof(*p));
+    if (t4_tx_init(&p->t4, s->tiff.file, s->tiff.start_page, s->tiff.stop_page) == NULL)
+    {
+        free(p);
+        return -1;
+    }
+    if (pthread_mutex_init(&p->mutex, NULL))
+    {
+        t4_tx_release(&p->t4);
+        free(p);
+        return -1;
+    }
+    if (pthread_cond_init(&p->cond, NULL))
+    {
+        pthread_mutex_destroy(&p->mutex);
+        t4_tx_release(&p->t4);
+        free(p);
+        return -1;
+    }
+    if (pthread_create(&p->thread, NULL, pre_encoder_thread, p))
+    {
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        t4_tx_release(&p->t4);
+        free(p);
+        return -1;
+    }
+    s->pre_encoder = p;
+    /* If the current page has not been started yet, it can be the first one
+       encoded in the background. Otherwise start on the next one. */
+    pre_encode_page(s, (s->image_size)  ?  s->current_page + 1  :  s->current_page);
+    return 0;
+#else
+    if (pre_encode)
+        return -1;
+    return 0;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_page(t4_state_t *s, const char *header)
+{
+    int row;
+    int len;
+
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->line_encoding == T4_COMPRESSION_ITU_T85  ||  s->line_encoding == T4_COMPRESSION_ITU_T85_L0)
+    {
+        if (start_t85_page_encoding(s, header))
             return -1;
     }
-    if (s->line_encoding == T4_COMPRESSION_ITU_T6)
+#endif
+    if (header[0])
     {
-        /* Attach an EOFB (end of facsimile block == 2 x EOLs) to the end of the page */
-        for (i = 0;  i < EOLS_TO_END_T6_TX_PAGE;  i++)
-            encode_eol(s);
+        if (t4_tx_put_fax_header(s, header))
+            return -1;
+    }
+    if (s->t4_t6_tx.row_read_handler)
+    {
+        for (row = 0;  ;  row++)
+        {
+            if ((len = s->t4_t6_tx.row_read_handler(s->t4_t6_tx.row_read_user_data, s->row_buf, s->bytes_per_row)) < 0)
+            {
+                span_log(&s->logging, SPAN_LOG_WARNING, "%s: Read error at row %d.\n", s->tiff.file, row);
+                break;
+            }
+            if (len == 0)
+                break;
+            if (encode_row(s))
+                return -1;
+        }
+        s->image_length = row;
     }
     else
     {
-        /* Attach an RTC (return to control == 6 x EOLs) to the end of the page */
-        s->row_is_2d = FALSE;
-        for (i = 0;  i < EOLS_TO_END_T4_TX_PAGE;  i++)
-            encode_eol(s);
+        if ((s->image_length = read_tiff_image(s)) < 0)
+            return -1;
     }
+    end_page_encoding(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
 
-    /* Force any partial byte in progress to flush using ones. Any post EOL padding when
-       sending is normally ones, so this is consistent. */
-    put_encoded_bits(s, 0xFF, 7);
+SPAN_DECLARE(int) t4_tx_start_page(t4_state_t *s)
+{
+    t4_tx_page_cache_key_t cache_key;
+    char header[132 + 1];
+    int old_image_width;
+
+    span_log(&s->logging, SPAN_LOG_FLOW, "Start tx page %d\n", s->current_page);
+    if (s->current_page > s->tiff.stop_page)
+        return -1;
+    if (s->tiff.tiff_file == NULL)
+        return -1;
+#if defined(T4_TX_USE_PRE_ENCODER)
+    if (use_pre_encoded_page(s))
+    {
+        pre_encode_page(s, s->current_page + 1);
+        return 0;
+    }
+#endif
+    old_image_width = s->image_width;
+    if (s->t4_t6_tx.row_read_handler == NULL)
+    {
+#if defined(HAVE_LIBTIFF)
+        if (!TIFFSetDirectory(s->tiff.tiff_file, (tdir_t) s->current_page))
+            return -1;
+        get_tiff_directory_info(s);
+#endif
+    }
+    /* Give the last page's memory back to the pool, and start afresh */
+    t4_page_buffer_release(&s->image);
+
+    /* Allow for pages being of different width. */
+    if (old_image_width != s->image_width)
+    {
+        if (resize_row_buffers(s))
+            return -1;
+    }
+    start_page_encoding(s);
+
+    /* The header is rendered once, as it is part of the cache key, and the time in it
+       could tick over between two renderings. */
+    header[0] = '\0';
+    if (s->header_info  &&  s->header_info[0])
+        make_header(s, header);
+    if (s->t4_t6_tx.row_read_handler == NULL
+        &&
+        page_cache_make_key(s, header, &cache_key) == 0)
+    {
+        if (page_cache_fetch(s, &cache_key))
+        {
+            span_log(&s->logging, SPAN_LOG_FLOW, "Using cached encoding of page %d\n", s->current_page);
+        }
+        else
+        {
+            if (encode_page(s, header))
+                return -1;
+            page_cache_store(s, &cache_key);
+        }
+    }
+    else
+    {
+        if (encode_page(s, header))
+            return -1;
+    }
     s->t4_t6_tx.bit_pos = 7;
     s->t4_t6_tx.bit_ptr = 0;
     s->line_image_size = s->image_size*8;
 
+#if defined(T4_TX_USE_PRE_ENCODER)
+    /* Get the next page ready while this one is being sent */
+    pre_encode_page(s, s->current_page + 1);
+#endif
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1425,7 +2205,7 @@ SPAN_DECLARE(int) t4_tx_get_bit(t4_state_t *s)
 
     if (s->t4_t6_tx.bit_ptr >= s->image_size)
         return SIG_STATUS_END_OF_DATA;
-    bit = (s->image_buffer[s->t4_t6_tx.bit_ptr] >> (7 - s->t4_t6_tx.bit_pos)) & 1;
+    bit = (*t4_page_buffer_byte(&s->image, s->t4_t6_tx.bit_ptr) >> (7 - s->t4_t6_tx.bit_pos)) & 1;
     if (--s->t4_t6_tx.bit_pos < 0)
     {
         s->t4_t6_tx.bit_pos = 7;
@@ -1439,7 +2219,7 @@ SPAN_DECLARE(int) t4_tx_get_byte(t4_state_t *s)
 {
     if (s->t4_t6_tx.bit_ptr >= s->image_size)
         return 0x100;
-    return s->image_buffer[s->t4_t6_tx.bit_ptr++];
+    return *t4_page_buffer_byte(&s->image, s->t4_t6_tx.bit_ptr++);
 }
 /*- End of function --------------------------------------------------------*/
 
@@ -1449,7 +2229,7 @@ SPAN_DECLARE(int) t4_tx_get_chunk(t4_state_t *s, uint8_t buf[], int max_len)
         return 0;
     if (s->t4_t6_tx.bit_ptr + max_len > s->image_size)
         max_len = s->image_size - s->t4_t6_tx.bit_ptr;
-    memcpy(buf, &s->image_buffer[s->t4_t6_tx.bit_ptr], max_len);
+    t4_page_buffer_get(&s->image, s->t4_t6_tx.bit_ptr, buf, max_len);
     s->t4_t6_tx.bit_ptr += max_len;
     return max_len;
 }
@@ -1461,7 +2241,7 @@ SPAN_DECLARE(int) t4_tx_check_bit(t4_state_t *s)
 
     if (s->t4_t6_tx.bit_ptr >= s->image_size)
         return SIG_STATUS_END_OF_DATA;
-    bit = (s->image_buffer[s->t4_t6_tx.bit_ptr] >> s->t4_t6_tx.bit_pos) & 1;
+    bit = (*t4_page_buffer_byte(&s->image, s->t4_t6_tx.bit_ptr) >> s->t4_t6_tx.bit_pos) & 1;
     return bit;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1470,6 +2250,9 @@ SPAN_DECLARE(int) t4_tx_release(t4_state_t *s)
 {
     if (s->rx)
         return -1;
+#if defined(T4_TX_USE_PRE_ENCODER)
+    free_pre_encoder(s);
+#endif
     if (s->tiff.tiff_file)
         close_tiff_input_file(s);
     free_buffers(s);
@@ -1487,6 +2270,104 @@ SPAN_DECLARE(int) t4_tx_free(t4_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
+void t4_tx_checkpoint(t4_state_t *s, checkpoint_t *c)
+{
+    t4_t6_encode_state_t *t;
+    struct tz_s *tz;
+    uint8_t have_tz;
+
+    if (c->restoring)
+    {
+        /* A freshly initialised T.30 context has not started a document, so there is
+           nothing here to lose, except a time zone which may have been set for the page
+           headers. */
+        tz = s->tz;
+        memset(s, 0, sizeof(*s));
+        s->tz = tz;
+        span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
+        span_log_set_protocol(&s->logging, "T.4");
+        t4_page_buffer_init(&s->image);
+    }
+    checkpoint_field(c, s->rx);
+    checkpoint_field(c, s->line_encoding);
+    checkpoint_field(c, s->page_start_time);
+    checkpoint_field(c, s->line_image_size);
+    checkpoint_field(c, s->bytes_per_row);
+    checkpoint_field(c, s->image_size);
+    checkpoint_field(c, s->current_page);
+    checkpoint_field(c, s->x_resolution);
+    checkpoint_field(c, s->y_resolution);
+    checkpoint_field(c, s->image_width);
+    checkpoint_field(c, s->image_length);
+    checkpoint_field(c, s->row);
+    checkpoint_field(c, s->row_is_2d);
+    checkpoint_field(c, s->row_len);
+    checkpoint_field(c, s->tx_bitstream);
+    checkpoint_field(c, s->tx_bits);
+    checkpoint_field(c, s->row_bits);
+    checkpoint_field(c, s->min_row_bits);
+    checkpoint_field(c, s->max_row_bits);
+    checkpoint_logging(c, &s->logging);
+
+    /* The header strings belong to the T.30 context, which points us at them again once
+       it has been restored. */
+    checkpoint_string(c, &s->tiff.file);
+    checkpoint_field(c, s->tiff.output_compression);
+    checkpoint_field(c, s->tiff.photo_metric);
+    checkpoint_field(c, s->tiff.fill_order);
+    checkpoint_field(c, s->tiff.output_t4_options);
+    checkpoint_field(c, s->tiff.pages_in_file);
+    checkpoint_field(c, s->tiff.start_page);
+    checkpoint_field(c, s->tiff.stop_page);
+
+    t = &s->t4_t6_tx;
+    checkpoint_field(c, t->min_bits_per_row);
+    checkpoint_field(c, t->max_rows_to_next_1d_row);
+    checkpoint_field(c, t->rows_to_next_1d_row);
+    checkpoint_field(c, t->ref_steps);
+    checkpoint_field(c, t->bit_pos);
+    checkpoint_field(c, t->bit_ptr);
+
+    checkpoint_page_buffer(c, &s->image);
+    checkpoint_buffer(c, &s->cur_runs, (s->image_width + 4)*sizeof(uint32_t));
+    checkpoint_buffer(c, &s->ref_runs, (s->image_width + 4)*sizeof(uint32_t));
+    checkpoint_buffer(c, &s->row_buf, s->bytes_per_row);
+    /* The whole page is encoded before it is sent, so the T.85 encoder is not needed
+       again for this page. */
+
+    have_tz = (s->tz != NULL);
+    checkpoint_field(c, have_tz);
+    if (have_tz  &&  !c->failed)
+    {
+        if (c->restoring  &&  s->tz == NULL  &&  (s->tz = (tz_t *) malloc(sizeof(*s->tz))) == NULL)
+        {
+            c->failed = TRUE;
+            return;
+        }
+        tz_checkpoint(s->tz, c);
+    }
+    if (c->restoring  &&  !c->failed  &&  s->tiff.file)
+    {
+        if ((s->tiff.tiff_file = TIFFOpen(s->tiff.file, "r")) == NULL
+            ||
+            !TIFFSetDirectory(s->tiff.tiff_file, (tdir_t) s->current_page))
+        {
+            c->failed = TRUE;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+void t4_tx_checkpoint_handover(t4_state_t *s)
+{
+    /* Once the checkpoint has been written the document belongs to whoever restores it.
+       Any page being encoded in the background has its own handle on the file, and is
+       simply discarded when this context is freed. */
+    if (s->tiff.tiff_file)
+        close_tiff_input_file(s);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) t4_tx_set_tx_encoding(t4_state_t *s, int encoding)
 {
     s->line_encoding = encoding;
@@ -1570,4 +2451,263 @@ SPAN_DECLARE(void) t4_tx_get_transfer_statistics(t4_state_t *s, t4_stats_t *t)
     t->line_image_size = s->line_image_size/8;
 }
 /*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_tx_get_allocated_memory(t4_state_t *s)
+{
+    int mem;
+
+    mem = t4_page_buffer_allocated_memory(&s->image);
+    if (s->cur_runs)
+        mem += 2*(s->image_width + 4)*sizeof(uint32_t);
+    if (s->row_buf)
+        mem += s->bytes_per_row;
+#if defined(SPANDSP_SUPPORT_T85)
+    if (s->t85_tx.row_buf)
+        mem += 3*(s->t85_tx.bytes_per_row + 1);
+#endif
+#if defined(T4_TX_USE_PRE_ENCODER)
+    /* A page being encoded in the background has a complete T.4 context of its own. Its
+       buffers can't be measured while the worker is changing them. */
+    if (s->pre_encoder)
+    {
+        pthread_mutex_lock(&s->pre_encoder->mutex);
+        mem += sizeof(*s->pre_encoder);
+        if (!s->pre_encoder->busy)
+            mem += t4_tx_get_allocated_memory(&s->pre_encoder->t4);
+        pthread_mutex_unlock(&s->pre_encoder->mutex);
+    }
+#endif
+    return mem;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int transcoder_flush(t4_transcoder_state_t *s)
+{
+    int i;
+    int len;
+
+    /* Only whole bytes are taken from the encoder. Any partial byte stays in its bit
+       stream, to be completed by the next row. */
+    for (i = 0;  i < s->tx.image_size;  i += len)
+    {
+        len = s->tx.image_size - i;
+        if (len > T4_PAGE_BUFFER_CHUNK_SIZE)
+            len = T4_PAGE_BUFFER_CHUNK_SIZE;
+        if (s->handler(s->user_data, t4_page_buffer_byte(&s->tx.image, i), len) < 0)
+            return -1;
+    }
+    s->tx.line_image_size += s->tx.image_size*8;
+    s->tx.image_size = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int transcoder_put_row_runs(void *user_data, const uint32_t runs[], int len)
+{
+    t4_transcoder_state_t *s;
+    uint32_t pos;
+    int steps;
+    int i;
+
+    s = (t4_transcoder_state_t *) user_data;
+    if (runs == NULL)
+    {
+        /* Repeat the previous row, which is the encoder's current reference row. */
+        steps = s->tx.t4_t6_tx.ref_steps;
+        memcpy(s->tx.cur_runs, s->tx.ref_runs, steps*sizeof(uint32_t));
+    }
+    else
+    {
+        /* The decoder gives white/black/white... run lengths, while the encoder wants
+           the positions of the changing elements. A zero length run means the colour
+           changes twice at the same position, and the two changes cancel out. Only a
+           change which was itself added at that position is cancelled, so a row
+           starting with any number of zero length runs can't take the count below
+           zero. */
+        pos = 0;
+        steps = 0;
+        for (i = 0;  i < len;  i++)
+        {
+            pos += runs[i];
+            if (steps > 0  &&  s->tx.cur_runs[steps - 1] == pos  &&  runs[i] == 0)
+                steps--;
+            else
+                s->tx.cur_runs[steps++] = pos;
+        }
+        if (steps == 0  ||  s->tx.cur_runs[steps - 1] != (uint32_t) s->tx.image_width)
+            s->tx.cur_runs[steps++] = s->tx.image_width;
+    }
+    if (encode_row_runs(&s->tx, steps))
+        return -1;
+    s->tx.image_length++;
+    return transcoder_flush(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int is_run_length_encoding(int encoding)
+{
+    return (encoding == T4_COMPRESSION_ITU_T4_1D
+            ||
+            encoding == T4_COMPRESSION_ITU_T4_2D
+            ||
+            encoding == T4_COMPRESSION_ITU_T6);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t4_transcoder_state_t *) t4_transcoder_init(t4_transcoder_state_t *s,
+                                                         int input_encoding,
+                                                         int output_encoding,
+                                                         t4_transcoder_output_handler_t handler,
+                                                         void *user_data)
+{
+    t4_transcoder_state_t *t;
+
+    if (handler == NULL)
+        return NULL;
+    /* The transcoder works on run lengths, so it only handles the T.4 and T.6 codings */
+    if (!is_run_length_encoding(input_encoding)  ||  !is_run_length_encoding(output_encoding))
+        return NULL;
+    t = s;
+    if (t == NULL)
+    {
+        if ((t = (t4_transcoder_state_t *) malloc(sizeof(*t))) == NULL)
+            return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    if (t4_rx_init(&t->rx, NULL, input_encoding) == NULL)
+    {
+        if (s == NULL)
+            free(t);
+        return NULL;
+    }
+    t4_rx_set_rx_encoding(&t->rx, input_encoding);
+    t->rx.t4_t6_rx.row_runs_handler = transcoder_put_row_runs;
+    t->rx.t4_t6_rx.row_runs_user_data = t;
+
+    span_log_init(&t->tx.logging, SPAN_LOG_NONE, NULL);
+    span_log_set_protocol(&t->tx.logging, "T.4");
+    t->tx.rx = FALSE;
+    t->tx.line_encoding = output_encoding;
+    t->tx.x_resolution = t->rx.x_resolution;
+    t->tx.y_resolution = t->rx.y_resolution;
+    t->tx.t4_t6_tx.max_rows_to_next_1d_row = 4;
+    t4_page_buffer_init(&t->tx.image);
+
+    t->handler = handler;
+    t->user_data = user_data;
+    if (t4_transcoder_set_image_width(t, t->rx.image_width))
+    {
+        t4_transcoder_release(t);
+        if (s == NULL)
+            free(t);
+        return NULL;
+    }
+    return t;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_set_image_width(t4_transcoder_state_t *s, int width)
+{
+    uint32_t *bufptr;
+    int run_space;
+
+    t4_rx_set_image_width(&s->rx, width);
+    /* Two rows of changing elements is all the encoder needs. */
+    run_space = (width + 4)*sizeof(uint32_t);
+    if ((bufptr = (uint32_t *) realloc(s->tx.cur_runs, run_space)) == NULL)
+        return -1;
+    s->tx.cur_runs = bufptr;
+    if ((bufptr = (uint32_t *) realloc(s->tx.ref_runs, run_space)) == NULL)
+        return -1;
+    s->tx.ref_runs = bufptr;
+    s->tx.image_width = width;
+    s->tx.bytes_per_row = (width + 7)/8;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_transcoder_set_y_resolution(t4_transcoder_state_t *s, int resolution)
+{
+    int i;
+
+    t4_rx_set_y_resolution(&s->rx, resolution);
+    s->tx.y_resolution = resolution;
+    s->tx.t4_t6_tx.max_rows_to_next_1d_row = 2;
+    for (i = 0;  y_res_table[i].code > 0;  i++)
+    {
+        if (y_res_table[i].code == resolution)
+        {
+            s->tx.t4_t6_tx.max_rows_to_next_1d_row = y_res_table[i].max_rows_to_next_1d_row;
+            break;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_transcoder_set_min_bits_per_row(t4_transcoder_state_t *s, int bits)
+{
+    s->tx.t4_t6_tx.min_bits_per_row = bits;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_start_page(t4_transcoder_state_t *s)
+{
+    if (s->tx.cur_runs == NULL)
+        return -1;
+    if (t4_rx_start_page(&s->rx))
+        return -1;
+    t4_page_buffer_release(&s->tx.image);
+    start_page_encoding(&s->tx);
+    s->tx.image_length = 0;
+    s->tx.line_image_size = 0;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_put_chunk(t4_transcoder_state_t *s, const uint8_t buf[], int len)
+{
+    return t4_rx_put_chunk(&s->rx, buf, len);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_end_page(t4_transcoder_state_t *s)
+{
+    int res;
+
+    /* Finishing the decode may flush out some final rows. */
+    res = t4_rx_end_page(&s->rx);
+    end_page_encoding(&s->tx);
+    if (transcoder_flush(s))
+        res = -1;
+    t4_page_buffer_release(&s->tx.image);
+    return res;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t4_transcoder_get_transfer_statistics(t4_transcoder_state_t *s, t4_stats_t *t)
+{
+    t4_rx_get_transfer_statistics(&s->rx, t);
+    t->length = s->tx.image_length;
+    t->encoding = s->tx.line_encoding;
+    t->line_image_size = s->tx.line_image_size/8;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_release(t4_transcoder_state_t *s)
+{
+    t4_rx_release(&s->rx);
+    free_buffers(&s->tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t4_transcoder_free(t4_transcoder_state_t *s)
+{
+    int ret;
+
+    ret = t4_transcoder_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,479 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t81_t82_arith_coding.c - ITU T.81 and T.82 QM-coder arithmetic encoding
+ *                          and decoding
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/t81_t82_arith_coding.h"
+
+#include "spandsp/private/t81_t82_arith_coding.h"
+
+/* T.82 defines the marker codes, and the byte stuffing, used to separate the coded data */
+#define T81_T82_ESC                 0xFF
+#define T81_T82_STUFF               0x00
+
+/* The probability estimation state machine, from T.81 table D.3 and T.82 table 24. The
+   top bit of nlps is the SWITCH flag, which says the sense of the more probable symbol
+   changes when a less probable symbol is coded in that state. */
+static const struct
+{
+    uint16_t lsz;
+    uint8_t nmps;
+    uint8_t nlps;
+} prob[113] =
+{
+    {0x5A1D,   1, 0x80 |   1},
+    {0x2586,   2,         14},
+    {0x1114,   3,         16},
+    {0x080B,   4,         18},
+    {0x03D8,   5,         20},
+    {0x01DA,   6,         23},
+    {0x00E5,   7,         25},
+    {0x006F,   8,         28},
+    {0x0036,   9,         30},
+    {0x001A,  10,         33},
+    {0x000D,  11,         35},
+    {0x0006,  12,          9},
+    {0x0003,  13,         10},
+    {0x0001,  13,         12},
+    {0x5A7F,  15, 0x80 |  15},
+    {0x3F25,  16,         36},
+    {0x2CF2,  17,         38},
+    {0x207C,  18,         39},
+    {0x17B9,  19,         40},
+    {0x1182,  20,         42},
+    {0x0CEF,  21,         43},
+    {0x09A1,  22,         45},
+    {0x072F,  23,         46},
+    {0x055C,  24,         48},
+    {0x0406,  25,         49},
+    {0x0303,  26,         51},
+    {0x0240,  27,         52},
+    {0x01B1,  28,         54},
+    {0x0144,  29,         56},
+    {0x00F5,  30,         57},
+    {0x00B7,  31,         59},
+    {0x008A,  32,         60},
+    {0x0068,  33,         62},
+    {0x004E,  34,         63},
+    {0x003B,  35,         32},
+    {0x002C,   9,         33},
+    {0x5AE1,  37, 0x80 |  37},
+    {0x484C,  38,         64},
+    {0x3A0D,  39,         65},
+    {0x2EF1,  40,         67},
+    {0x261F,  41,         68},
+    {0x1F33,  42,         69},
+    {0x19A8,  43,         70},
+    {0x1518,  44,         72},
+    {0x1177,  45,         73},
+    {0x0E74,  46,         74},
+    {0x0BFB,  47,         75},
+    {0x09F8,  48,         77},
+    {0x0861,  49,         78},
+    {0x0706,  50,         79},
+    {0x05CD,  51,         48},
+    {0x04DE,  52,         50},
+    {0x040F,  53,         50},
+    {0x0363,  54,         51},
+    {0x02D4,  55,         52},
+    {0x025C,  56,         53},
+    {0x01F8,  57,         54},
+    {0x01A4,  58,         55},
+    {0x0160,  59,         56},
+    {0x0125,  60,         57},
+    {0x00F6,  61,         58},
+    {0x00CB,  62,         59},
+    {0x00AB,  63,         61},
+    {0x008F,  32,         61},
+    {0x5B12,  65, 0x80 |  65},
+    {0x4D04,  66,         80},
+    {0x412C,  67,         81},
+    {0x37D8,  68,         82},
+    {0x2FE8,  69,         83},
+    {0x293C,  70,         84},
+    {0x2379,  71,         86},
+    {0x1EDF,  72,         87},
+    {0x1AA9,  73,         87},
+    {0x174E,  74,         72},
+    {0x1424,  75,         72},
+    {0x119C,  76,         74},
+    {0x0F6B,  77,         74},
+    {0x0D51,  78,         75},
+    {0x0BB6,  79,         77},
+    {0x0A40,  48,         77},
+    {0x5832,  81, 0x80 |  80},
+    {0x4D1C,  82,         88},
+    {0x438E,  83,         89},
+    {0x3BDD,  84,         90},
+    {0x34EE,  85,         91},
+    {0x2EAE,  86,         92},
+    {0x299A,  87,         93},
+    {0x2516,  71,         86},
+    {0x5570,  89, 0x80 |  88},
+    {0x4CA9,  90,         95},
+    {0x44D9,  91,         96},
+    {0x3E22,  92,         97},
+    {0x3824,  93,         99},
+    {0x32B4,  94,         99},
+    {0x2E17,  86,         93},
+    {0x56A8,  96, 0x80 |  95},
+    {0x4F46,  97,        101},
+    {0x47E5,  98,        102},
+    {0x41CF,  99,        103},
+    {0x3C3D, 100,        104},
+    {0x375E,  93,         99},
+    {0x5231, 102,        105},
+    {0x4C0F, 103,        106},
+    {0x4639, 104,        107},
+    {0x415E,  99,        103},
+    {0x5627, 106, 0x80 | 105},
+    {0x50E7, 107,        108},
+    {0x4B85, 103,        109},
+    {0x5597, 109,        110},
+    {0x504F, 107,        111},
+    {0x5A10, 111, 0x80 | 110},
+    {0x5522, 109,        112},
+    {0x59EB, 111, 0x80 | 112}
+};
+
+static __inline__ void output_stuffed_byte(t81_t82_arith_encode_state_t *s, int byte)
+{
+    s->output_byte_handler(s->user_data, byte);
+    if (byte == T81_T82_ESC)
+        s->output_byte_handler(s->user_data, T81_T82_STUFF);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t81_t82_arith_encode(t81_t82_arith_encode_state_t *s, int cx, int bit)
+{
+    uint8_t *st;
+    uint32_t lsz;
+    uint32_t temp;
+    int ss;
+
+    st = &s->st[cx];
+    ss = *st & 0x7F;
+    lsz = prob[ss].lsz;
+
+    s->a -= lsz;
+    if (((*st >> 7) ^ bit))
+    {
+        /* Code the less probable symbol */
+        if (s->a >= lsz)
+        {
+            /* The MPS interval is smaller than the LPS one, so exchange them */
+            s->c += s->a;
+            s->a = lsz;
+        }
+        *st = (*st & 0x80) ^ prob[ss].nlps;
+    }
+    else
+    {
+        /* Code the more probable symbol */
+        if ((s->a & 0xFFFF8000))
+            return;
+        if (s->a < lsz)
+        {
+            /* The MPS interval is smaller than the LPS one, so exchange them */
+            s->c += s->a;
+            s->a = lsz;
+        }
+        *st = (*st & 0x80) | prob[ss].nmps;
+    }
+
+    /* Renormalise */
+    do
+    {
+        s->a <<= 1;
+        s->c <<= 1;
+        if (--s->ct == 0)
+        {
+            /* Another byte is ready for output */
+            temp = s->c >> 19;
+            if ((temp & 0xFFFFFF00))
+            {
+                /* A carry has occurred. It ripples through any 0xFF bytes being held back. */
+                if (s->buffer >= 0)
+                    output_stuffed_byte(s, s->buffer + 1);
+                for (  ;  s->sc;  s->sc--)
+                    s->output_byte_handler(s->user_data, 0x00);
+                s->buffer = temp & 0xFF;
+            }
+            else if (temp == 0xFF)
+            {
+                /* Hold this back. A later carry might change it. */
+                s->sc++;
+            }
+            else
+            {
+                /* No carry can reach the bytes being held back any more */
+                if (s->buffer >= 0)
+                    s->output_byte_handler(s->user_data, s->buffer);
+                for (  ;  s->sc;  s->sc--)
+                {
+                    s->output_byte_handler(s->user_data, T81_T82_ESC);
+                    s->output_byte_handler(s->user_data, T81_T82_STUFF);
+                }
+                s->buffer = temp;
+            }
+            s->c &= 0x7FFFF;
+            s->ct = 8;
+        }
+    }
+    while (s->a < 0x8000);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t81_t82_arith_encode_flush(t81_t82_arith_encode_state_t *s)
+{
+    uint32_t temp;
+
+    /* Find the value in the coding interval with the most trailing zero bits */
+    temp = (s->a - 1 + s->c) & 0xFFFF0000;
+    s->c = (temp < s->c)  ?  (temp + 0x8000)  :  temp;
+    s->c <<= s->ct;
+    if ((s->c & 0xF8000000))
+    {
+        /* One final carry has to be handled */
+        if (s->buffer >= 0)
+            output_stuffed_byte(s, s->buffer + 1);
+        /* Zero bytes are only output if more non-zero bytes will follow */
+        if ((s->c & 0x7FFF800))
+        {
+            for (  ;  s->sc;  s->sc--)
+                s->output_byte_handler(s->user_data, 0x00);
+        }
+    }
+    else
+    {
+        if (s->buffer >= 0)
+            s->output_byte_handler(s->user_data, s->buffer);
+        for (  ;  s->sc;  s->sc--)
+        {
+            s->output_byte_handler(s->user_data, T81_T82_ESC);
+            s->output_byte_handler(s->user_data, T81_T82_STUFF);
+        }
+    }
+    /* Trailing zero bytes are dropped. The decoder pads with zeros when it reaches the
+       marker which follows the coded data. */
+    if ((s->c & 0x7FFF800))
+    {
+        output_stuffed_byte(s, (s->c >> 19) & 0xFF);
+        if ((s->c & 0x7F800))
+            output_stuffed_byte(s, (s->c >> 11) & 0xFF);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_encode_restart(t81_t82_arith_encode_state_t *s, int reuse_st)
+{
+    if (!reuse_st)
+        memset(s->st, 0, sizeof(s->st));
+    s->c = 0;
+    s->a = 0x10000;
+    s->sc = 0;
+    s->ct = 11;
+    s->buffer = -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t81_t82_arith_encode_state_t *) t81_t82_arith_encode_init(t81_t82_arith_encode_state_t *s,
+                                                                       t81_t82_arith_encode_output_handler_t output_byte_handler,
+                                                                       void *user_data)
+{
+    if (s == NULL)
+    {
+        if ((s = (t81_t82_arith_encode_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->output_byte_handler = output_byte_handler;
+    s->user_data = user_data;
+    t81_t82_arith_encode_restart(s, FALSE);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_encode_release(t81_t82_arith_encode_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_encode_free(t81_t82_arith_encode_state_t *s)
+{
+    int ret;
+
+    ret = t81_t82_arith_encode_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_decode(t81_t82_arith_decode_state_t *s, int cx)
+{
+    uint8_t *st;
+    uint32_t lsz;
+    int ss;
+    int bit;
+
+    /* Renormalise, first, so decoding can resume here if we run out of data part way through */
+    while (s->a < 0x8000  ||  s->startup)
+    {
+        while (s->ct <= 8  &&  s->ct >= 0)
+        {
+            /* There is room to move another byte into C */
+            if (s->pscd_ptr >= s->pscd_end)
+                return T81_T82_ARITH_DECODE_MORE_DATA;
+            if (*s->pscd_ptr == T81_T82_ESC)
+            {
+                /* We need to see the following byte, to know whether this is a marker */
+                if (s->pscd_ptr + 1 >= s->pscd_end)
+                    return T81_T82_ARITH_DECODE_MORE_DATA;
+                if (s->pscd_ptr[1] == T81_T82_STUFF)
+                {
+                    s->c |= 0xFFU << (8 - s->ct);
+                    s->ct += 8;
+                    s->pscd_ptr += 2;
+                }
+                else
+                {
+                    /* This is a marker. Start padding with zeros. */
+                    s->ct = -1;
+                    if (s->nopadding)
+                    {
+                        s->nopadding = FALSE;
+                        return T81_T82_ARITH_DECODE_MARKER;
+                    }
+                }
+            }
+            else
+            {
+                s->c |= (uint32_t) *s->pscd_ptr++ << (8 - s->ct);
+                s->ct += 8;
+            }
+        }
+        s->c <<= 1;
+        s->a <<= 1;
+        if (s->ct >= 0)
+            s->ct--;
+        if (s->a == 0x10000)
+            s->startup = FALSE;
+    }
+
+    st = &s->st[cx];
+    ss = *st & 0x7F;
+    lsz = prob[ss].lsz;
+
+    s->a -= lsz;
+    if ((s->c >> 16) < s->a)
+    {
+        if ((s->a & 0xFFFF8000))
+            return *st >> 7;
+        /* MPS exchange */
+        if (s->a < lsz)
+        {
+            bit = 1 - (*st >> 7);
+            *st = (*st & 0x80) ^ prob[ss].nlps;
+        }
+        else
+        {
+            bit = *st >> 7;
+            *st = (*st & 0x80) | prob[ss].nmps;
+        }
+    }
+    else
+    {
+        /* LPS exchange */
+        s->c -= s->a << 16;
+        if (s->a < lsz)
+        {
+            bit = *st >> 7;
+            *st = (*st & 0x80) | prob[ss].nmps;
+        }
+        else
+        {
+            bit = 1 - (*st >> 7);
+            *st = (*st & 0x80) ^ prob[ss].nlps;
+        }
+        s->a = lsz;
+    }
+    return bit;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_decode_restart(t81_t82_arith_decode_state_t *s, int reuse_st)
+{
+    if (!reuse_st)
+        memset(s->st, 0, sizeof(s->st));
+    s->c = 0;
+    s->a = 1;
+    s->ct = 0;
+    s->startup = TRUE;
+    s->nopadding = FALSE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t81_t82_arith_decode_state_t *) t81_t82_arith_decode_init(t81_t82_arith_decode_state_t *s)
+{
+    if (s == NULL)
+    {
+        if ((s = (t81_t82_arith_decode_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    t81_t82_arith_decode_restart(s, FALSE);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_decode_release(t81_t82_arith_decode_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t81_t82_arith_decode_free(t81_t82_arith_decode_state_t *s)
+{
+    int ret;
+
+    ret = t81_t82_arith_decode_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
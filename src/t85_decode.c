@@ -0,0 +1,576 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t85_decode.c - ITU T.85 JBIG for FAX image decompression
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tiffio.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/t4_rx.h"
+#include "spandsp/t81_t82_arith_coding.h"
+#include "spandsp/t85.h"
+
+#include "spandsp/private/t81_t82_arith_coding.h"
+#include "spandsp/private/t85.h"
+
+/* T.82 marker codes */
+#define T82_ESC                     0xFF
+#define T82_STUFF                   0x00
+#define T82_SDNORM                  0x02
+#define T82_SDRST                   0x03
+#define T82_ABORT                   0x04
+#define T82_NEWLEN                  0x05
+#define T82_ATMOVE                  0x06
+#define T82_COMMENT                 0x07
+
+/* The contexts used to code the typical prediction decision, for the two and three row templates */
+#define T82_TPB2CX                  0x195
+#define T82_TPB3CX                  0x0E5
+
+/* The length of the bi-level image header */
+#define T82_BIH_LEN                 20
+
+enum
+{
+    /*! Waiting for the bi-level image header */
+    T85_STATE_HEADER = 0,
+    /*! Between stripes, where floating marker segments may occur */
+    T85_STATE_STRIPE_START,
+    /*! Decoding the coded data of a stripe */
+    T85_STATE_STRIPE_DATA,
+    /*! Looking for the marker which ends a stripe */
+    T85_STATE_STRIPE_END,
+    /*! Skipping the body of a comment */
+    T85_STATE_COMMENT,
+    /*! The image is complete */
+    T85_STATE_COMPLETE,
+    /*! The image was aborted, or is corrupt */
+    T85_STATE_FAILED
+};
+
+/* Results from the stages of decoding */
+enum
+{
+    DECODE_MORE_DATA = 0,
+    DECODE_STRIPE_COMPLETE,
+    DECODE_FAILED
+};
+
+static __inline__ int pixel(const uint8_t row[], uint32_t x)
+{
+    return (row[x >> 3] >> (7 - (x & 7))) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static __inline__ uint32_t get_uint32(const uint8_t buf[])
+{
+    return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) | ((uint32_t) buf[2] << 8) | buf[3];
+}
+/*- End of function --------------------------------------------------------*/
+
+static int parse_header(t85_decode_state_t *s, const uint8_t buf[])
+{
+    /* T.85 only allows a single layer (DL = D = 0), with a single bit plane (P = 1). */
+    if (buf[0] != 0  ||  buf[1] != 0  ||  buf[2] != 1)
+        return -1;
+    s->xd = get_uint32(&buf[4]);
+    s->yd = get_uint32(&buf[8]);
+    s->l0 = get_uint32(&buf[12]);
+    s->mx = buf[16];
+    s->options = buf[19];
+    /* No AT moves in the vertical direction, and none of the multi-layer options */
+    if (s->xd == 0  ||  s->yd == 0  ||  s->l0 == 0  ||  s->mx > 127  ||  buf[17] != 0)
+        return -1;
+    if ((s->options & (T85_TPDON | T85_DPON | T85_DPPRIV | T85_DPLAST)))
+        return -1;
+    if (s->max_xd  &&  s->xd > s->max_xd)
+        return -1;
+    if (s->max_yd  &&  s->yd > s->max_yd)
+    {
+        /* With VLENGTH the header may legitimately hold a large dummy length, to be
+           corrected by NEWLEN later. Never decode beyond the limit, whatever it says. */
+        if (!(s->options & T85_VLENGTH))
+            return -1;
+        s->yd = s->max_yd;
+    }
+    s->bytes_per_row = (s->xd + 7)/8;
+    /* Allow a spare byte at the end of each row, so context formation can look beyond
+       the right hand edge of the image without checking. */
+    if (s->row_buf)
+        free(s->row_buf);
+    if ((s->row_buf = (uint8_t *) malloc(3*(s->bytes_per_row + 1))) == NULL)
+        return -1;
+    memset(s->row_buf, 0, 3*(s->bytes_per_row + 1));
+    s->cur_row = s->row_buf;
+    s->prev_row = s->cur_row + s->bytes_per_row + 1;
+    s->prev_row2 = s->prev_row + s->bytes_per_row + 1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void set_new_length(t85_decode_state_t *s, uint32_t new_length)
+{
+    /* NEWLEN can only shorten the image, and it can't remove rows we have already delivered */
+    if (!(s->options & T85_VLENGTH)  ||  new_length >= s->yd)
+        return;
+    s->yd = (new_length > s->y)  ?  new_length  :  s->y;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int check_marker(t85_decode_state_t *s, const uint8_t *buf, int len)
+{
+    /* We have hit a marker, but the stripe is not complete. If the image was cut short by
+       a NEWLEN, the marker which ends the stripe will be immediately followed by the NEWLEN.
+       If the marker properly ends the stripe, the rest of the stripe must be decoded,
+       padding the data with zeros. Anything else means the coded data ended early, and
+       we must not make up rows to fill the gap. */
+    if (len < 2)
+        return 0;
+    if (buf[0] != T82_ESC  ||  (buf[1] != T82_SDNORM  &&  buf[1] != T82_SDRST))
+        return -1;
+    if ((s->options & T85_VLENGTH))
+    {
+        if (len < 4)
+            return 0;
+        if (buf[2] == T82_ESC  &&  buf[3] == T82_NEWLEN)
+        {
+            if (len < 8)
+                return 0;
+            s->newlen_pending = TRUE;
+            set_new_length(s, get_uint32(&buf[4]));
+        }
+    }
+    s->marker_peek = FALSE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int output_row(t85_decode_state_t *s)
+{
+    uint8_t *t;
+
+    if (s->row_write_handler(s->row_write_user_data, s->cur_row, s->bytes_per_row) < 0)
+        return -1;
+    t = s->prev_row2;
+    s->prev_row2 = s->prev_row;
+    s->prev_row = s->cur_row;
+    s->cur_row = t;
+    s->y++;
+    s->i++;
+    s->x = 0;
+    s->row_started = FALSE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_stripe_data(t85_decode_state_t *s)
+{
+    uint32_t x;
+    uint32_t xd;
+    int pix;
+    int cx;
+    int i;
+
+    s->s.pscd_ptr = &s->buffer[s->buf_ptr];
+    s->s.pscd_end = &s->buffer[s->buf_len];
+    xd = s->xd;
+    pix = 0;
+    while (s->i < s->l0  &&  s->y < s->yd)
+    {
+        if (s->marker_peek)
+        {
+            if (check_marker(s, s->s.pscd_ptr, s->s.pscd_end - s->s.pscd_ptr))
+                return DECODE_FAILED;
+            if (s->marker_peek)
+                break;
+            /* The image may have ended at, or before, the row in progress */
+            if (s->y >= s->yd)
+                break;
+        }
+        if (!s->row_started)
+        {
+            /* Apply any AT moves which take effect at this row */
+            for (i = 0;  i < s->at_moves;  i++)
+            {
+                if (s->at_row[i] == s->i)
+                    s->tx = s->at_tx[i];
+            }
+            if ((s->options & T85_TPBON))
+            {
+                pix = t81_t82_arith_decode(&s->s, (s->options & T85_LRLTWO)  ?  T82_TPB2CX  :  T82_TPB3CX);
+                if (pix < 0)
+                {
+                    if (pix == T81_T82_ARITH_DECODE_MARKER)
+                    {
+                        s->marker_peek = TRUE;
+                        continue;
+                    }
+                    break;
+                }
+                if (!pix)
+                    s->ltp_old = !s->ltp_old;
+                if (s->ltp_old)
+                {
+                    /* This is a typical row - a copy of the one above */
+                    memcpy(s->cur_row, s->prev_row, s->bytes_per_row);
+                    if (output_row(s))
+                        return DECODE_FAILED;
+                    continue;
+                }
+            }
+            memset(s->cur_row, 0, s->bytes_per_row);
+            s->r1 = 0;
+            s->r2 = (pixel(s->prev_row, 0) << 2) | (pixel(s->prev_row, 1) << 1) | pixel(s->prev_row, 2);
+            s->r3 = (pixel(s->prev_row2, 0) << 1) | pixel(s->prev_row2, 1);
+            s->row_started = TRUE;
+        }
+        for (x = s->x;  x < xd;  x++)
+        {
+            if ((s->options & T85_LRLTWO))
+            {
+                if (s->tx)
+                {
+                    cx = ((s->r2 & 0x3E) << 4) | (s->r1 & 0x0F);
+                    if (x >= (uint32_t) s->tx)
+                        cx |= pixel(s->cur_row, x - s->tx) << 4;
+                }
+                else
+                {
+                    cx = ((s->r2 & 0x3F) << 4) | (s->r1 & 0x0F);
+                }
+            }
+            else
+            {
+                if (s->tx)
+                {
+                    cx = ((s->r3 & 0x07) << 7) | ((s->r2 & 0x1E) << 2) | (s->r1 & 0x03);
+                    if (x >= (uint32_t) s->tx)
+                        cx |= pixel(s->cur_row, x - s->tx) << 2;
+                }
+                else
+                {
+                    cx = ((s->r3 & 0x07) << 7) | ((s->r2 & 0x1F) << 2) | (s->r1 & 0x03);
+                }
+            }
+            if ((pix = t81_t82_arith_decode(&s->s, cx)) < 0)
+                break;
+            if (pix)
+                s->cur_row[x >> 3] |= (0x80 >> (x & 7));
+            s->r1 = (s->r1 << 1) | pix;
+            s->r2 = (s->r2 << 1) | pixel(s->prev_row, x + 3);
+            s->r3 = (s->r3 << 1) | pixel(s->prev_row2, x + 2);
+        }
+        s->x = x;
+        if (x < xd)
+        {
+            if (pix == T81_T82_ARITH_DECODE_MARKER)
+            {
+                s->marker_peek = TRUE;
+                continue;
+            }
+            break;
+        }
+        if (output_row(s))
+            return DECODE_FAILED;
+    }
+    s->buf_ptr = s->s.pscd_ptr - s->buffer;
+    if (s->i >= s->l0  ||  s->y >= s->yd)
+        return DECODE_STRIPE_COMPLETE;
+    return DECODE_MORE_DATA;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void start_stripe(t85_decode_state_t *s)
+{
+    if (s->reset)
+    {
+        /* After an SDRST the stripe is coded as though it were the start of the image */
+        t81_t82_arith_decode_restart(&s->s, FALSE);
+        s->ltp_old = FALSE;
+        memset(s->prev_row, 0, s->bytes_per_row);
+        memset(s->prev_row2, 0, s->bytes_per_row);
+        s->reset = FALSE;
+    }
+    else
+    {
+        t81_t82_arith_decode_restart(&s->s, TRUE);
+    }
+    /* We need to know when the end of the coded data is reached, so we can check the
+       marker there before any zero padding is used. */
+    s->s.nopadding = TRUE;
+    s->i = 0;
+    s->x = 0;
+    s->row_started = FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_buffer(t85_decode_state_t *s)
+{
+    const uint8_t *buf;
+    uint32_t len;
+    int avail;
+
+    for (;;)
+    {
+        buf = &s->buffer[s->buf_ptr];
+        avail = s->buf_len - s->buf_ptr;
+        switch (s->state)
+        {
+        case T85_STATE_HEADER:
+            if (avail < T82_BIH_LEN)
+                return DECODE_MORE_DATA;
+            if (parse_header(s, buf))
+                return DECODE_FAILED;
+            s->buf_ptr += T82_BIH_LEN;
+            s->state = T85_STATE_STRIPE_START;
+            break;
+        case T85_STATE_STRIPE_START:
+            if (s->y >= s->yd  &&  !s->newlen_pending)
+            {
+                s->state = T85_STATE_COMPLETE;
+                break;
+            }
+            if (avail < 2)
+                return DECODE_MORE_DATA;
+            if (buf[0] != T82_ESC
+                ||
+                buf[1] == T82_STUFF
+                ||
+                buf[1] == T82_SDNORM
+                ||
+                buf[1] == T82_SDRST)
+            {
+                /* This is the start of the coded data for a stripe */
+                start_stripe(s);
+                s->state = T85_STATE_STRIPE_DATA;
+                break;
+            }
+            switch (buf[1])
+            {
+            case T82_NEWLEN:
+                if (avail < 6)
+                    return DECODE_MORE_DATA;
+                set_new_length(s, get_uint32(&buf[2]));
+                s->newlen_pending = FALSE;
+                s->buf_ptr += 6;
+                break;
+            case T82_ATMOVE:
+                if (avail < 8)
+                    return DECODE_MORE_DATA;
+                /* T.85 does not allow vertical AT moves */
+                if (s->at_moves >= T85_MAX_AT_MOVES  ||  buf[7] != 0  ||  buf[6] > s->mx)
+                    return DECODE_FAILED;
+                s->at_row[s->at_moves] = get_uint32(&buf[2]);
+                s->at_tx[s->at_moves] = buf[6];
+                s->at_moves++;
+                s->buf_ptr += 8;
+                break;
+            case T82_COMMENT:
+                if (avail < 6)
+                    return DECODE_MORE_DATA;
+                s->comment_skip = get_uint32(&buf[2]);
+                s->buf_ptr += 6;
+                s->state = T85_STATE_COMMENT;
+                break;
+            default:
+                /* An ABORT, or something which should not be here */
+                return DECODE_FAILED;
+            }
+            break;
+        case T85_STATE_COMMENT:
+            len = (s->comment_skip > (uint32_t) avail)  ?  (uint32_t) avail  :  s->comment_skip;
+            s->buf_ptr += len;
+            if ((s->comment_skip -= len) > 0)
+                return DECODE_MORE_DATA;
+            s->state = T85_STATE_STRIPE_START;
+            break;
+        case T85_STATE_STRIPE_DATA:
+            switch (decode_stripe_data(s))
+            {
+            case DECODE_MORE_DATA:
+                return DECODE_MORE_DATA;
+            case DECODE_FAILED:
+                return DECODE_FAILED;
+            }
+            s->state = T85_STATE_STRIPE_END;
+            break;
+        case T85_STATE_STRIPE_END:
+            /* Skip anything left of the coded data, and find the marker which ends the stripe */
+            while (avail >= 2  &&  (buf[0] != T82_ESC  ||  buf[1] == T82_STUFF))
+            {
+                len = (buf[0] == T82_ESC)  ?  2  :  1;
+                buf += len;
+                avail -= len;
+                s->buf_ptr += len;
+            }
+            if (avail < 2)
+                return DECODE_MORE_DATA;
+            if (buf[1] != T82_SDNORM  &&  buf[1] != T82_SDRST)
+                return DECODE_FAILED;
+            s->reset = (buf[1] == T82_SDRST);
+            s->buf_ptr += 2;
+            /* AT moves only apply within the stripe which follows them */
+            s->at_moves = 0;
+            s->state = T85_STATE_STRIPE_START;
+            break;
+        case T85_STATE_COMPLETE:
+            return TRUE;
+        default:
+            return DECODE_FAILED;
+        }
+    }
+    return DECODE_FAILED;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_decode_put_chunk(t85_decode_state_t *s, const uint8_t data[], size_t len)
+{
+    size_t i;
+    int n;
+    int ret;
+
+    if (s->state == T85_STATE_COMPLETE)
+        return TRUE;
+    if (s->state == T85_STATE_FAILED)
+        return -1;
+    for (i = 0;  i < len;  i += n)
+    {
+        /* Stage the data, so anything left unused can be held over for the next call */
+        n = T85_DECODE_BUFFER_SIZE - s->buf_len;
+        if (n > (int) (len - i))
+            n = len - i;
+        memcpy(&s->buffer[s->buf_len], &data[i], n);
+        s->buf_len += n;
+        ret = decode_buffer(s);
+        if (s->buf_ptr)
+        {
+            memmove(s->buffer, &s->buffer[s->buf_ptr], s->buf_len - s->buf_ptr);
+            s->buf_len -= s->buf_ptr;
+            s->buf_ptr = 0;
+        }
+        if (ret == TRUE)
+            return TRUE;
+        if (ret == DECODE_FAILED)
+        {
+            s->state = T85_STATE_FAILED;
+            return -1;
+        }
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(void) t85_decode_set_image_size_constraints(t85_decode_state_t *s, uint32_t max_xd, uint32_t max_yd)
+{
+    s->max_xd = max_xd;
+    s->max_yd = max_yd;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint32_t) t85_decode_get_image_width(t85_decode_state_t *s)
+{
+    return s->xd;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint32_t) t85_decode_get_image_length(t85_decode_state_t *s)
+{
+    return s->y;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_decode_restart(t85_decode_state_t *s)
+{
+    s->state = T85_STATE_HEADER;
+    s->buf_len = 0;
+    s->buf_ptr = 0;
+    s->comment_skip = 0;
+    s->xd = 0;
+    s->yd = 0;
+    s->y = 0;
+    s->i = 0;
+    s->x = 0;
+    s->row_started = FALSE;
+    s->ltp_old = FALSE;
+    s->tx = 0;
+    s->at_moves = 0;
+    s->reset = FALSE;
+    s->marker_peek = FALSE;
+    s->newlen_pending = FALSE;
+    t81_t82_arith_decode_restart(&s->s, FALSE);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t85_decode_state_t *) t85_decode_init(t85_decode_state_t *s,
+                                                   t4_row_write_handler_t handler,
+                                                   void *user_data)
+{
+    if (handler == NULL)
+        return NULL;
+    if (s == NULL)
+    {
+        if ((s = (t85_decode_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+    }
+    memset(s, 0, sizeof(*s));
+    s->row_write_handler = handler;
+    s->row_write_user_data = user_data;
+    t81_t82_arith_decode_init(&s->s);
+    t85_decode_restart(s);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_decode_release(t85_decode_state_t *s)
+{
+    if (s->row_buf)
+    {
+        free(s->row_buf);
+        s->row_buf = NULL;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_decode_free(t85_decode_state_t *s)
+{
+    int ret;
+
+    ret = t85_decode_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
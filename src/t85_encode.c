@@ -0,0 +1,331 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t85_encode.c - ITU T.85 JBIG for FAX image compression
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tiffio.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/t4_rx.h"
+#include "spandsp/t81_t82_arith_coding.h"
+#include "spandsp/t85.h"
+
+#include "spandsp/private/t81_t82_arith_coding.h"
+#include "spandsp/private/t85.h"
+
+/* T.82 marker codes */
+#define T82_ESC                     0xFF
+#define T82_SDNORM                  0x02
+#define T82_NEWLEN                  0x05
+
+/* The contexts used to code the typical prediction decision, for the two and three row templates */
+#define T82_TPB2CX                  0x195
+#define T82_TPB3CX                  0x0E5
+
+static __inline__ int pixel(const uint8_t row[], uint32_t x)
+{
+    return (row[x >> 3] >> (7 - (x & 7))) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void output_uint32(t85_encode_state_t *s, uint32_t value)
+{
+    s->output_byte_handler(s->user_data, (value >> 24) & 0xFF);
+    s->output_byte_handler(s->user_data, (value >> 16) & 0xFF);
+    s->output_byte_handler(s->user_data, (value >> 8) & 0xFF);
+    s->output_byte_handler(s->user_data, value & 0xFF);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void output_header(t85_encode_state_t *s)
+{
+    /* The bi-level image header. T.85 only allows a single layer (DL = D = 0), with a single
+       bit plane (P = 1). */
+    s->output_byte_handler(s->user_data, 0);
+    s->output_byte_handler(s->user_data, 0);
+    s->output_byte_handler(s->user_data, 1);
+    s->output_byte_handler(s->user_data, 0);
+    output_uint32(s, s->xd);
+    output_uint32(s, s->yd);
+    output_uint32(s, s->l0);
+    s->output_byte_handler(s->user_data, s->mx);
+    s->output_byte_handler(s->user_data, 0);
+    s->output_byte_handler(s->user_data, 0);
+    s->output_byte_handler(s->user_data, s->options);
+    s->header_sent = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_stripe(t85_encode_state_t *s)
+{
+    t81_t82_arith_encode_flush(&s->s);
+    s->output_byte_handler(s->user_data, T82_ESC);
+    s->output_byte_handler(s->user_data, T82_SDNORM);
+    /* The probability estimates carry over into the next stripe */
+    t81_t82_arith_encode_restart(&s->s, TRUE);
+    s->i = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void encode_row(t85_encode_state_t *s)
+{
+    uint8_t *cur;
+    uint8_t *prev;
+    uint8_t *prev2;
+    uint32_t x;
+    uint32_t r1;
+    uint32_t r2;
+    uint32_t r3;
+    uint32_t xd;
+    int ltp;
+    int pix;
+
+    cur = s->cur_row;
+    prev = s->prev_row;
+    prev2 = s->prev_row2;
+    if ((s->options & T85_TPBON))
+    {
+        /* Typical prediction. A row the same as the one above it is coded as a single decision.
+           What is actually coded is whether this row's typicality is the same as the last one's. */
+        ltp = (memcmp(cur, prev, s->bytes_per_row) == 0);
+        t81_t82_arith_encode(&s->s, (s->options & T85_LRLTWO)  ?  T82_TPB2CX  :  T82_TPB3CX, ltp == s->ltp_old);
+        s->ltp_old = ltp;
+        if (ltp)
+            return;
+    }
+    /* The context registers hold the template pixels from each row, with the rightmost
+       in the least significant bit. The row buffers have a spare byte at the end, so we can
+       look beyond the right edge of the image, and find white. */
+    xd = s->xd;
+    r1 = 0;
+    r2 = (pixel(prev, 0) << 2) | (pixel(prev, 1) << 1) | pixel(prev, 2);
+    r3 = (pixel(prev2, 0) << 1) | pixel(prev2, 1);
+    if ((s->options & T85_LRLTWO))
+    {
+        for (x = 0;  x < xd;  x++)
+        {
+            pix = pixel(cur, x);
+            t81_t82_arith_encode(&s->s, ((r2 & 0x3F) << 4) | (r1 & 0x0F), pix);
+            r1 = (r1 << 1) | pix;
+            r2 = (r2 << 1) | pixel(prev, x + 3);
+        }
+    }
+    else
+    {
+        for (x = 0;  x < xd;  x++)
+        {
+            pix = pixel(cur, x);
+            t81_t82_arith_encode(&s->s, ((r3 & 0x07) << 7) | ((r2 & 0x1F) << 2) | (r1 & 0x03), pix);
+            r1 = (r1 << 1) | pix;
+            r2 = (r2 << 1) | pixel(prev, x + 3);
+            r3 = (r3 << 1) | pixel(prev2, x + 2);
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void put_row(t85_encode_state_t *s)
+{
+    uint8_t *t;
+
+    if (!s->header_sent)
+        output_header(s);
+    /* Make sure any pixels beyond the edge of the image are white */
+    if ((s->xd & 7))
+        s->cur_row[s->bytes_per_row - 1] &= 0xFF << (8 - (s->xd & 7));
+    encode_row(s);
+
+    t = s->prev_row2;
+    s->prev_row2 = s->prev_row;
+    s->prev_row = s->cur_row;
+    s->cur_row = t;
+    s->y++;
+    if (++s->i >= s->l0  ||  s->y >= s->yd)
+        end_stripe(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void put_white_row(t85_encode_state_t *s)
+{
+    memset(s->cur_row, 0, s->bytes_per_row);
+    put_row(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_put_row(t85_encode_state_t *s, const uint8_t row[])
+{
+    if (s->complete  ||  s->y >= s->yd)
+        return -1;
+    memcpy(s->cur_row, row, s->bytes_per_row);
+    put_row(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_image_complete(t85_encode_state_t *s)
+{
+    if (s->complete)
+        return 0;
+    /* An image must have at least one row */
+    if (s->y == 0)
+        put_white_row(s);
+    if (s->y < s->yd)
+    {
+        if ((s->options & T85_VLENGTH))
+        {
+            if (s->i)
+                end_stripe(s);
+            s->output_byte_handler(s->user_data, T82_ESC);
+            s->output_byte_handler(s->user_data, T82_NEWLEN);
+            output_uint32(s, s->y);
+            /* Finish with an empty stripe, so a decoder knows nothing else is coming
+               after the NEWLEN. Without this, some decoders wait for more data. */
+            s->output_byte_handler(s->user_data, T82_ESC);
+            s->output_byte_handler(s->user_data, T82_SDNORM);
+            s->yd = s->y;
+        }
+        else
+        {
+            /* Pad the image with white rows, to the length we promised */
+            while (s->y < s->yd)
+                put_white_row(s);
+        }
+    }
+    s->complete = TRUE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_set_options(t85_encode_state_t *s, uint32_t l0, int mx, int options)
+{
+    if (s->header_sent)
+        return -1;
+    if (l0 < 1  ||  mx < 0  ||  mx > 127)
+        return -1;
+    s->l0 = l0;
+    s->mx = mx;
+    s->options = (s->options & T85_VLENGTH) | (options & (T85_LRLTWO | T85_TPBON));
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_set_image_length(t85_encode_state_t *s, uint32_t length)
+{
+    if (s->header_sent)
+        return -1;
+    if (length)
+    {
+        s->yd = length;
+        s->options &= ~T85_VLENGTH;
+    }
+    else
+    {
+        /* The true length will follow in a NEWLEN marker */
+        s->yd = 0xFFFFFFFF;
+        s->options |= T85_VLENGTH;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(uint32_t) t85_encode_get_image_length(t85_encode_state_t *s)
+{
+    return s->y;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(t85_encode_state_t *) t85_encode_init(t85_encode_state_t *s,
+                                                   uint32_t image_width,
+                                                   uint32_t image_length,
+                                                   t81_t82_arith_encode_output_handler_t output_byte_handler,
+                                                   void *user_data)
+{
+    int allocated;
+
+    if (image_width == 0  ||  output_byte_handler == NULL)
+        return NULL;
+    allocated = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (t85_encode_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+        allocated = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    s->output_byte_handler = output_byte_handler;
+    s->user_data = user_data;
+    s->xd = image_width;
+    s->l0 = T85_DEFAULT_L0;
+    s->mx = 0;
+    s->options = T85_TPBON;
+    t85_encode_set_image_length(s, image_length);
+    s->bytes_per_row = (image_width + 7)/8;
+    /* Allow a spare byte at the end of each row, so context formation can look beyond
+       the right hand edge of the image without checking. */
+    if ((s->row_buf = (uint8_t *) malloc(3*(s->bytes_per_row + 1))) == NULL)
+    {
+        if (allocated)
+            free(s);
+        return NULL;
+    }
+    memset(s->row_buf, 0, 3*(s->bytes_per_row + 1));
+    s->cur_row = s->row_buf;
+    s->prev_row = s->cur_row + s->bytes_per_row + 1;
+    s->prev_row2 = s->prev_row + s->bytes_per_row + 1;
+    t81_t82_arith_encode_init(&s->s, output_byte_handler, user_data);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_release(t85_encode_state_t *s)
+{
+    if (s->row_buf)
+    {
+        free(s->row_buf);
+        s->row_buf = NULL;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) t85_encode_free(t85_encode_state_t *s)
+{
+    int ret;
+
+    ret = t85_encode_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
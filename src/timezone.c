@@ -51,6 +51,8 @@
 
 #include "spandsp/private/timezone.h"
 
+#include "checkpoint_local.h"
+
 #if !defined(FALSE)
 #define FALSE    0
 #endif
@@ -819,4 +821,15 @@ SPAN_DECLARE(int) tz_free(tz_t *tz)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void tz_checkpoint(tz_t *tz, checkpoint_t *c)
+{
+    checkpoint_field(c, tz->state);
+    checkpoint_field(c, tz->lcl_tzname);
+    checkpoint_field(c, tz->lcl_is_set);
+    /* The zone names point into the zone's own data */
+    if (c->restoring)
+        set_tzname(tz);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,708 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl.c - An implementation of the UDPTL protocol defined in T.38,
+ *           less the packet exchange part
+ *
+ * Written by Steve Underwood <steveu@coppice.org>
+ *
+ * Copyright (C) 2009 Steve Underwood
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version 2.1,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <memory.h>
+
+#include "spandsp/telephony.h"
+#include "spandsp/logging.h"
+#include "spandsp/udptl.h"
+
+#include "spandsp/private/logging.h"
+#include "spandsp/private/udptl.h"
+
+static int decode_length(const uint8_t *buf, int limit, int *len, int *pvalue)
+{
+    if (*len >= limit)
+        return -1;
+    if ((buf[*len] & 0x80) == 0)
+    {
+        *pvalue = buf[(*len)++];
+        return 0;
+    }
+    if ((buf[*len] & 0x40) == 0)
+    {
+        if (*len >= limit - 1)
+            return -1;
+        *pvalue = (buf[(*len)++] & 0x3F) << 8;
+        *pvalue |= buf[(*len)++];
+        return 0;
+    }
+    *pvalue = (buf[(*len)++] & 0x3F) << 14;
+    /* Indicate we have a fragment */
+    return 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_open_type(const uint8_t *buf, int limit, int *len, const uint8_t **p_object, int *p_num_octets)
+{
+    int octet_cnt;
+
+    /* Anything long enough to need fragmenting is far longer than any IFP packet we
+       can handle, so a fragment is treated as a fault. */
+    if (decode_length(buf, limit, len, &octet_cnt) != 0)
+        return -1;
+    /* Make sure the buffer contains at least the number of octets requested */
+    if (*len + octet_cnt > limit)
+        return -1;
+    *p_object = &buf[*len];
+    *p_num_octets = octet_cnt;
+    *len += octet_cnt;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_length(uint8_t *buf, int limit, int *len, int value)
+{
+    int multiplier;
+
+    if (value < 0x80)
+    {
+        /* 1 octet */
+        if (*len + 1 > limit)
+            return -1;
+        buf[(*len)++] = value;
+        return value;
+    }
+    if (value < 0x4000)
+    {
+        /* 2 octets */
+        if (*len + 2 > limit)
+            return -1;
+        /* Set the first bit of the first octet */
+        buf[(*len)++] = ((0x8000 | value) >> 8) & 0xFF;
+        buf[(*len)++] = value & 0xFF;
+        return value;
+    }
+    /* Fragmentation */
+    if (*len + 1 > limit)
+        return -1;
+    multiplier = (value < 0x10000)  ?  (value >> 14)  :  4;
+    /* Set the first 2 bits of the octet */
+    buf[(*len)++] = 0xC0 | multiplier;
+    return multiplier << 14;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int encode_open_type(uint8_t *buf, int limit, int *len, const uint8_t *data, int num_octets)
+{
+    int enclen;
+    int octet_idx;
+    static const uint8_t zero_byte = 0;
+
+    /* If open type is of zero length, add a single zero byte (10.1) */
+    if (num_octets == 0)
+    {
+        data = &zero_byte;
+        num_octets = 1;
+    }
+    /* Encode the open type */
+    for (octet_idx = 0;  ;  num_octets -= enclen, octet_idx += enclen)
+    {
+        if ((enclen = encode_length(buf, limit, len, num_octets)) < 0)
+            return -1;
+        if (enclen > 0)
+        {
+            if (*len + enclen > limit)
+                return -1;
+            memcpy(&buf[*len], &data[octet_idx], enclen);
+            *len += enclen;
+        }
+        if (enclen >= num_octets)
+            break;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int open_type_len(int num_octets)
+{
+    if (num_octets <= 0)
+        return 2;
+    return ((num_octets < 0x80)  ?  1  :  2) + num_octets;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void clear_rx_entry(udptl_state_t *s, int x)
+{
+    s->rx[x].buf_len = -1;
+    s->rx[x].fec_len[0] = 0;
+    s->rx[x].fec_span = 0;
+    s->rx[x].fec_entries = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void save_rx_entry(udptl_state_t *s, int x, const uint8_t msg[], int msg_len)
+{
+    memcpy(s->rx[x].buf, msg, msg_len);
+    s->rx[x].buf_len = msg_len;
+    s->rx[x].fec_len[0] = 0;
+    s->rx[x].fec_span = 0;
+    s->rx[x].fec_entries = 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void deliver_ifp(udptl_state_t *s, const uint8_t msg[], int msg_len, int seq_no)
+{
+    if (s->rx_packet_handler(s->user_data, msg, msg_len, seq_no) < 0)
+        span_log(&s->logging, SPAN_LOG_PROTOCOL_WARNING, "Bad IFP in packet %d\n", seq_no);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int fec_repair(udptl_state_t *s, int x, int repaired[])
+{
+    int dist;
+    int l;
+    int m;
+    int k;
+    int j;
+    int limit;
+    int which;
+    int reach;
+    int progress;
+
+    /* Step back through the FEC we have received, looking for groups in which just one
+       packet is missing. That one can be rebuilt from the others. Only look at groups
+       which lie wholly within our history. */
+    progress = FALSE;
+    for (dist = 0;  dist <= UDPTL_BUF_MASK;  dist++)
+    {
+        l = (x - dist) & UDPTL_BUF_MASK;
+        if (s->rx[l].fec_entries <= 0)
+            continue;
+        reach = s->rx[l].fec_span*s->rx[l].fec_entries;
+        if (dist + reach > UDPTL_BUF_MASK)
+            continue;
+        for (m = 0;  m < s->rx[l].fec_entries;  m++)
+        {
+            limit = (l + m) & UDPTL_BUF_MASK;
+            which = -1;
+            for (k = (limit - reach) & UDPTL_BUF_MASK;  k != limit;  k = (k + s->rx[l].fec_entries) & UDPTL_BUF_MASK)
+            {
+                if (s->rx[k].buf_len < 0)
+                    which = (which == -1)  ?  k  :  -2;
+            }
+            if (which < 0)
+                continue;
+            /* Repairable */
+            for (j = 0;  j < s->rx[l].fec_len[m];  j++)
+            {
+                s->rx[which].buf[j] = s->rx[l].fec[m][j];
+                for (k = (limit - reach) & UDPTL_BUF_MASK;  k != limit;  k = (k + s->rx[l].fec_entries) & UDPTL_BUF_MASK)
+                {
+                    if (s->rx[k].buf_len > j)
+                        s->rx[which].buf[j] ^= s->rx[k].buf[j];
+                }
+            }
+            s->rx[which].buf_len = s->rx[l].fec_len[m];
+            repaired[which] = TRUE;
+            progress = TRUE;
+        }
+    }
+    return progress;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_rx_packet(udptl_state_t *s, const uint8_t buf[], int len)
+{
+    int stat;
+    int i;
+    int l;
+    int x;
+    int ptr;
+    int count;
+    int total_count;
+    int seq_no;
+    int missing;
+    const uint8_t *msg;
+    int msg_len;
+    int repaired[UDPTL_BUF_MASK + 1];
+    const uint8_t *bufs[UDPTL_BUF_MASK + 1];
+    int lengths[UDPTL_BUF_MASK + 1];
+    const uint8_t *fec[UDPTL_MAX_FEC_ENTRIES];
+    int fec_lengths[UDPTL_MAX_FEC_ENTRIES];
+    const uint8_t *data;
+    int data_len;
+    int fec_mode;
+    int span;
+    int entries;
+
+    /* Check the whole packet is sound, before we act on any of it. */
+    ptr = 0;
+    /* Decode seq_number */
+    if (ptr + 2 > len)
+        return -1;
+    seq_no = (buf[0] << 8) | buf[1];
+    ptr += 2;
+    /* Break out the primary packet */
+    if (decode_open_type(buf, len, &ptr, &msg, &msg_len) != 0)
+        return -1;
+    /* Our buffers cannot tolerate overlength packets */
+    if (msg_len > UDPTL_MAX_IFP_LEN)
+        return -1;
+    /* Decode error_recovery */
+    if (ptr + 1 > len)
+        return -1;
+    total_count = 0;
+    span = 0;
+    entries = 0;
+    fec_mode = ((buf[ptr++] & 0x80) != 0);
+    if (!fec_mode)
+    {
+        /* Secondary packet mode for error recovery */
+        /* We might have the packet we want, but we need to check through
+           the redundant stuff, and verify the integrity of the UDPTL.
+           This greatly reduces our chances of accepting garbage. Only the newest
+           secondary packets can be of any use to us. Older ones are checked, but
+           not kept. */
+        do
+        {
+            if ((stat = decode_length(buf, len, &ptr, &count)) < 0)
+                return -1;
+            for (i = 0;  i < count;  i++)
+            {
+                if (decode_open_type(buf, len, &ptr, &data, &data_len) != 0)
+                    return -1;
+                if (total_count <= UDPTL_BUF_MASK)
+                {
+                    if (data_len > UDPTL_MAX_IFP_LEN)
+                        return -1;
+                    bufs[total_count] = data;
+                    lengths[total_count] = data_len;
+                    total_count++;
+                }
+            }
+        }
+        while (stat > 0);
+    }
+    else
+    {
+        /* FEC mode for error recovery */
+        /* The span is defined as an unconstrained integer, but will never be more
+           than a small value. */
+        if (ptr + 2 > len)
+            return -1;
+        if (buf[ptr++] != 1)
+            return -1;
+        span = buf[ptr++];
+        /* The number of entries is defined as a length, but will only ever be a small
+           value. Treat it as such. */
+        if (ptr + 1 > len)
+            return -1;
+        entries = buf[ptr++];
+        if (entries > UDPTL_MAX_FEC_ENTRIES)
+            return -1;
+        /* Decode the elements */
+        for (i = 0;  i < entries;  i++)
+        {
+            if (decode_open_type(buf, len, &ptr, &fec[i], &fec_lengths[i]) != 0)
+                return -1;
+            if (fec_lengths[i] > UDPTL_MAX_IFP_LEN)
+                return -1;
+        }
+    }
+    /* We should now be exactly at the end of the packet. If not, this is a fault. */
+    if (ptr != len)
+        return -1;
+
+    /* Work out where this packet sits in the sequence. */
+    if (s->rx_seq_no < 0)
+    {
+        missing = 0;
+    }
+    else
+    {
+        missing = (seq_no - s->rx_seq_no) & 0xFFFF;
+        if (missing >= 0x8000)
+        {
+            if (0x10000 - missing <= UDPTL_BUF_MASK + 1)
+            {
+                /* If packets are received out of sequence, we will already have processed
+                   this packet, or given up on it. */
+                span_log(&s->logging, SPAN_LOG_FLOW, "Late packet %d ignored\n", seq_no);
+                return 0;
+            }
+            /* The sequence has jumped a long way back. The far end must have restarted
+               its numbering, so nothing in our history is relevant any more. */
+            span_log(&s->logging, SPAN_LOG_FLOW, "Sequence jumped from %d to %d\n", s->rx_seq_no, seq_no);
+            for (i = 0;  i <= UDPTL_BUF_MASK;  i++)
+                clear_rx_entry(s, i);
+            missing = 0;
+        }
+    }
+    /* Update any missed slots in the buffer */
+    for (i = 1;  i <= missing  &&  i <= UDPTL_BUF_MASK;  i++)
+        clear_rx_entry(s, (seq_no - i) & UDPTL_BUF_MASK);
+    /* Save the new packet. Pure redundancy mode won't use this, but some systems will switch
+       into FEC mode after sending some redundant packets. */
+    x = seq_no & UDPTL_BUF_MASK;
+    save_rx_entry(s, x, msg, msg_len);
+
+    if (!fec_mode)
+    {
+        /* We received a later packet than we expected, so we need to check if we can fill in
+           the gap from the secondary packets. Step through in reverse order, so we go oldest
+           to newest. */
+        for (i = (total_count < missing)  ?  total_count  :  missing;  i > 0;  i--)
+        {
+            span_log(&s->logging, SPAN_LOG_FLOW, "Secondary packet %d, len %d\n", (seq_no - i) & 0xFFFF, lengths[i - 1]);
+            save_rx_entry(s, (seq_no - i) & UDPTL_BUF_MASK, bufs[i - 1], lengths[i - 1]);
+            deliver_ifp(s, bufs[i - 1], lengths[i - 1], (seq_no - i) & 0xFFFF);
+        }
+    }
+    else
+    {
+        /* Save the new FEC data */
+        s->rx[x].fec_span = span;
+        s->rx[x].fec_entries = entries;
+        for (i = 0;  i < entries;  i++)
+        {
+            memcpy(s->rx[x].fec[i], fec[i], fec_lengths[i]);
+            s->rx[x].fec_len[i] = fec_lengths[i];
+        }
+        /* See if we can reconstruct anything which is missing. Each repair may make
+           another possible, so keep going until nothing more can be done. */
+        memset(repaired, 0, sizeof(repaired));
+        while (fec_repair(s, x, repaired))
+            ;
+        /* Now play any new packets forwards in time */
+        for (i = UDPTL_BUF_MASK;  i > 0;  i--)
+        {
+            l = (seq_no - i) & UDPTL_BUF_MASK;
+            if (repaired[l])
+            {
+                span_log(&s->logging, SPAN_LOG_FLOW, "Fixed packet %d, len %d\n", (seq_no - i) & 0xFFFF, s->rx[l].buf_len);
+                deliver_ifp(s, s->rx[l].buf, s->rx[l].buf_len, (seq_no - i) & 0xFFFF);
+            }
+        }
+    }
+    /* Decode the primary packet */
+    span_log(&s->logging, SPAN_LOG_FLOW, "Primary packet %d, len %d\n", seq_no, msg_len);
+    deliver_ifp(s, msg, msg_len, seq_no);
+
+    s->rx_seq_no = (seq_no + 1) & 0xFFFF;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_build_packet(udptl_state_t *s, uint8_t buf[], int max_len, const uint8_t msg[], int msg_len)
+{
+    uint8_t *fec;
+    int i;
+    int j;
+    int seq;
+    int entry;
+    int entries;
+    int span;
+    int m;
+    int len;
+    int limit;
+    int high_tide;
+    int total;
+
+    /* UDPTL cannot cope with zero length messages, and our buffering for redundancy limits their
+       maximum length. */
+    if (msg_len < 1  ||  msg_len > UDPTL_MAX_IFP_LEN)
+        return -1;
+    seq = s->tx_seq_no & 0xFFFF;
+
+    /* Map the sequence number to an entry in the circular buffer */
+    entry = seq & UDPTL_BUF_MASK;
+
+    /* We save the message in a circular buffer, for generating FEC or
+       redundancy sets later on. */
+    s->tx[entry].buf_len = msg_len;
+    memcpy(s->tx[entry].buf, msg, msg_len);
+
+    /* Build the UDPTL packet, directly in the caller's buffer */
+    len = 0;
+    /* Encode the sequence number */
+    if (max_len < 2)
+        return -1;
+    buf[len++] = (seq >> 8) & 0xFF;
+    buf[len++] = seq & 0xFF;
+
+    /* Encode the primary packet */
+    if (encode_open_type(buf, max_len, &len, msg, msg_len) < 0)
+        return -1;
+
+    /* Encode the appropriate type of error recovery information */
+    if (len + 1 > max_len)
+        return -1;
+    switch (s->error_correction_scheme)
+    {
+    case UDPTL_ERROR_CORRECTION_NONE:
+        /* Encode the error recovery type */
+        buf[len++] = 0x00;
+        /* The number of entries will always be zero, so it is pointless allowing
+           for the fragmented case here. */
+        if (encode_length(buf, max_len, &len, 0) < 0)
+            return -1;
+        break;
+    case UDPTL_ERROR_CORRECTION_REDUNDANCY:
+        /* Encode the error recovery type */
+        buf[len++] = 0x00;
+        entries = (s->tx_seq_no > s->error_correction_entries)  ?  s->error_correction_entries  :  s->tx_seq_no;
+        /* Leave out the oldest entries, if they would make the packet too long for our
+           buffer, or for the far end. */
+        limit = (max_len < s->far_max_datagram_size)  ?  max_len  :  s->far_max_datagram_size;
+        total = len + 1;
+        for (i = 0;  i < entries;  i++)
+        {
+            total += open_type_len(s->tx[(entry - i - 1) & UDPTL_BUF_MASK].buf_len);
+            if (total > limit)
+                break;
+        }
+        entries = i;
+        /* The number of entries will always be small, so it is pointless allowing
+           for the fragmented case here. */
+        if (encode_length(buf, max_len, &len, entries) < 0)
+            return -1;
+        /* Encode the elements */
+        for (i = 0;  i < entries;  i++)
+        {
+            j = (entry - i - 1) & UDPTL_BUF_MASK;
+            if (encode_open_type(buf, max_len, &len, s->tx[j].buf, s->tx[j].buf_len) < 0)
+                return -1;
+        }
+        break;
+    case UDPTL_ERROR_CORRECTION_FEC:
+        span = s->error_correction_span;
+        entries = s->error_correction_entries;
+        if (s->tx_seq_no < span*entries)
+        {
+            /* In the initial stages, wind up the FEC smoothly */
+            entries = s->tx_seq_no/span;
+            if (s->tx_seq_no < span)
+                span = 0;
+        }
+        if (len + 3 > max_len)
+            return -1;
+        /* Encode the error recovery type */
+        buf[len++] = 0x80;
+        /* Span is defined as an inconstrained integer, which it dumb. It will only
+           ever be a small value. Treat it as such. */
+        buf[len++] = 1;
+        buf[len++] = span;
+        /* The number of entries is defined as a length, but will only ever be a small
+           value. Treat it as such. */
+        if (encode_length(buf, max_len, &len, entries) < 0)
+            return -1;
+        for (m = 0;  m < entries;  m++)
+        {
+            /* Make an XOR'ed entry the maximum length */
+            limit = (entry + m) & UDPTL_BUF_MASK;
+            high_tide = 0;
+            for (i = (limit - span*entries) & UDPTL_BUF_MASK;  i != limit;  i = (i + entries) & UDPTL_BUF_MASK)
+            {
+                if (high_tide < s->tx[i].buf_len)
+                    high_tide = s->tx[i].buf_len;
+            }
+            if (high_tide == 0)
+            {
+                if (encode_open_type(buf, max_len, &len, NULL, 0) < 0)
+                    return -1;
+                continue;
+            }
+            /* Build the entry in place */
+            if (encode_length(buf, max_len, &len, high_tide) < 0  ||  len + high_tide > max_len)
+                return -1;
+            fec = &buf[len];
+            memset(fec, 0, high_tide);
+            for (i = (limit - span*entries) & UDPTL_BUF_MASK;  i != limit;  i = (i + entries) & UDPTL_BUF_MASK)
+            {
+                for (j = 0;  j < s->tx[i].buf_len;  j++)
+                    fec[j] ^= s->tx[i].buf[j];
+            }
+            len += high_tide;
+        }
+        break;
+    }
+    s->tx_seq_no++;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_error_correction(udptl_state_t *s, int ec_scheme, int span, int entries)
+{
+    switch (ec_scheme)
+    {
+    case UDPTL_ERROR_CORRECTION_FEC:
+    case UDPTL_ERROR_CORRECTION_REDUNDANCY:
+    case UDPTL_ERROR_CORRECTION_NONE:
+        break;
+    case -1:
+        /* Just don't change the scheme */
+        ec_scheme = s->error_correction_scheme;
+        break;
+    default:
+        return -1;
+    }
+    if (span < 0)
+        span = s->error_correction_span;
+    if (entries < 0)
+        entries = s->error_correction_entries;
+    /* Everything we send error correction for must still be in our history */
+    if (entries > UDPTL_BUF_MASK)
+        return -1;
+    if (ec_scheme == UDPTL_ERROR_CORRECTION_FEC
+        &&
+        (span < 1  ||  span*entries > UDPTL_BUF_MASK + 1))
+    {
+        return -1;
+    }
+    s->error_correction_scheme = ec_scheme;
+    s->error_correction_span = span;
+    s->error_correction_entries = entries;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_error_correction(udptl_state_t *s, int *ec_scheme, int *span, int *entries)
+{
+    if (ec_scheme)
+        *ec_scheme = s->error_correction_scheme;
+    if (span)
+        *span = s->error_correction_span;
+    if (entries)
+        *entries = s->error_correction_entries;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_local_max_datagram(udptl_state_t *s, int max_datagram)
+{
+    s->local_max_datagram_size = max_datagram;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_local_max_datagram(udptl_state_t *s)
+{
+    return s->local_max_datagram_size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_set_far_max_datagram(udptl_state_t *s, int max_datagram)
+{
+    s->far_max_datagram_size = max_datagram;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_get_far_max_datagram(udptl_state_t *s)
+{
+    return s->far_max_datagram_size;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(logging_state_t *) udptl_get_logging_state(udptl_state_t *s)
+{
+    return &s->logging;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_restart(udptl_state_t *s)
+{
+    int i;
+
+    s->tx_seq_no = 0;
+    s->rx_seq_no = -1;
+    for (i = 0;  i <= UDPTL_BUF_MASK;  i++)
+    {
+        s->tx[i].buf_len = -1;
+        clear_rx_entry(s, i);
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(udptl_state_t *) udptl_init(udptl_state_t *s,
+                                         int ec_scheme,
+                                         int span,
+                                         int entries,
+                                         udptl_rx_packet_handler_t *rx_packet_handler,
+                                         void *user_data)
+{
+    int allocated;
+
+    if (rx_packet_handler == NULL)
+        return NULL;
+
+    allocated = FALSE;
+    if (s == NULL)
+    {
+        if ((s = (udptl_state_t *) malloc(sizeof(*s))) == NULL)
+            return NULL;
+        allocated = TRUE;
+    }
+    memset(s, 0, sizeof(*s));
+    span_log_init(&s->logging, SPAN_LOG_NONE, NULL);
+    span_log_set_protocol(&s->logging, "UDPTL");
+
+    if (udptl_set_error_correction(s, ec_scheme, span, entries))
+    {
+        if (allocated)
+            free(s);
+        return NULL;
+    }
+
+    s->far_max_datagram_size = UDPTL_MAX_IFP_LEN;
+    s->local_max_datagram_size = UDPTL_MAX_IFP_LEN;
+
+    s->rx_packet_handler = rx_packet_handler;
+    s->user_data = user_data;
+
+    udptl_restart(s);
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_release(udptl_state_t *s)
+{
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE(int) udptl_free(udptl_state_t *s)
+{
+    int ret;
+
+    ret = udptl_release(s);
+    free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
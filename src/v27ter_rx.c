@@ -59,8 +59,11 @@
 #include "spandsp/v27ter_rx.h"
 
 #include "spandsp/private/logging.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/v27ter_rx.h"
 
+#include "checkpoint_local.h"
+
 #if defined(SPANDSP_USE_FIXED_POINT)
 #include "v27ter_rx_4800_fixed_rrc.h"
 #include "v27ter_rx_2400_fixed_rrc.h"
@@ -165,6 +168,10 @@ SPAN_DECLARE(void) v27ter_rx_signal_cutoff(v27ter_rx_state_t *s, float cutoff)
 
 static void report_status_change(v27ter_rx_state_t *s, int status)
 {
+    /* Make sure everything received before the status change is delivered first,
+       including the odd bits at the end of the data. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -413,7 +420,10 @@ static __inline__ void put_bit(v27ter_rx_state_t *s, int bit)
        go to the application. */
     if (s->training_stage == TRAINING_STAGE_NORMAL_OPERATION)
     {
-        s->put_bit(s->put_bit_user_data, out_bit);
+        if (s->chunk.put_chunk)
+            chunk_rx_put_bit(&s->chunk, out_bit);
+        else
+            s->put_bit(s->put_bit_user_data, out_bit);
     }
     else
     {
@@ -973,6 +983,7 @@ SPAN_DECLARE_NONSTD(int) v27ter_rx(v27ter_rx_state_t *s, const int16_t amp[], in
 #endif
         }
     }
+    chunk_rx_flush(&s->chunk);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1019,6 +1030,15 @@ SPAN_DECLARE(void) v27ter_rx_set_put_bit(v27ter_rx_state_t *s, put_bit_func_t pu
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v27ter_rx_set_put_chunk(v27ter_rx_state_t *s, put_chunk_func_t put_chunk, void *user_data, int lsb_first)
+{
+    /* Anything still waiting belongs to the old handler */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
+    chunk_rx_init(&s->chunk, put_chunk, user_data, lsb_first);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v27ter_rx_set_modem_status_handler(v27ter_rx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -1045,6 +1065,10 @@ SPAN_DECLARE(int) v27ter_rx_restart(v27ter_rx_state_t *s, int bit_rate, int old_
     vec_zerof(s->rrc_filter, sizeof(s->rrc_filter)/sizeof(s->rrc_filter[0]));
 #endif
     s->rrc_filter_step = 0;
+    /* Anything received before the restart is still delivered, including any
+       partial octet. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
 
     s->scramble_reg = 0x3C;
     s->scrambler_pattern_count = 0;
@@ -1145,4 +1169,50 @@ SPAN_DECLARE(void) v27ter_rx_set_qam_report_handler(v27ter_rx_state_t *s, qam_re
     s->qam_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
+
+void v27ter_rx_checkpoint(v27ter_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->bit_rate);
+    chunk_rx_checkpoint(&s->chunk, c);
+    checkpoint_field(c, s->rrc_filter);
+    checkpoint_field(c, s->rrc_filter_step);
+    checkpoint_field(c, s->scramble_reg);
+    checkpoint_field(c, s->scrambler_pattern_count);
+    checkpoint_field(c, s->training_bc);
+    checkpoint_field(c, s->old_train);
+    checkpoint_field(c, s->training_stage);
+    checkpoint_field(c, s->training_count);
+    checkpoint_field(c, s->training_error);
+    checkpoint_field(c, s->last_sample);
+    checkpoint_field(c, s->signal_present);
+    checkpoint_field(c, s->carrier_drop_pending);
+    checkpoint_field(c, s->low_samples);
+    checkpoint_field(c, s->high_sample);
+    checkpoint_field(c, s->constellation_state);
+    checkpoint_field(c, s->carrier_phase);
+    checkpoint_field(c, s->carrier_phase_rate);
+    checkpoint_field(c, s->carrier_phase_rate_save);
+    checkpoint_field(c, s->carrier_track_p);
+    checkpoint_field(c, s->carrier_track_i);
+    checkpoint_field(c, s->power);
+    checkpoint_field(c, s->carrier_on_power);
+    checkpoint_field(c, s->carrier_off_power);
+    checkpoint_field(c, s->eq_step);
+    checkpoint_field(c, s->eq_put_step);
+    checkpoint_field(c, s->eq_skip);
+    checkpoint_field(c, s->baud_half);
+    checkpoint_field(c, s->agc_scaling);
+    checkpoint_field(c, s->agc_scaling_save);
+    checkpoint_field(c, s->eq_delta);
+    checkpoint_field(c, s->eq_coeff);
+    checkpoint_field(c, s->eq_coeff_save);
+    checkpoint_field(c, s->eq_buf);
+    checkpoint_field(c, s->gardner_integrate);
+    checkpoint_field(c, s->gardner_step);
+    checkpoint_field(c, s->total_baud_timing_correction);
+    checkpoint_field(c, s->start_angles);
+    checkpoint_field(c, s->angles);
+    checkpoint_logging(c, &s->logging);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
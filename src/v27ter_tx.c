@@ -40,6 +40,10 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define V27TER_TX_TRAINING_CACHE_LOCKING
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/fast_convert.h"
@@ -56,8 +60,11 @@
 #include "spandsp/v27ter_tx.h"
 
 #include "spandsp/private/logging.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/v27ter_tx.h"
 
+#include "checkpoint_local.h"
+
 #if defined(SPANDSP_USE_FIXED_POINT)
 #include "v27ter_tx_4800_fixed_rrc.h"
 #include "v27ter_tx_2400_fixed_rrc.h"
@@ -87,12 +94,67 @@
 /*! The end of the shutdown sequence, in symbols */
 #define V27TER_TRAINING_SHUTDOWN_END    (V27TER_TRAINING_END + 32)
 
+/*!
+    An unscaled image of the start of a V.27ter training sequence, from the restart
+    of the transmitter up to the start of segment 5, together with the modulator
+    state at the end of that waveform. These are built once, and shared read-only
+    by all transmitter instances which ask for them.
+*/
+struct v27ter_tx_training_cache_s
+{
+    /*! \brief The number of samples in the cached waveform. */
+    int len;
+    /*! \brief The cached waveform, before the output gain is applied. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t *amp;
+#else
+    float *amp;
+#endif
+    /*! \brief The RRC pulse shaping filter buffer at the end of the waveform. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    complexi16_t rrc_filter[2*V27TER_TX_FILTER_STEPS];
+#else
+    complexf_t rrc_filter[2*V27TER_TX_FILTER_STEPS];
+#endif
+    /*! \brief The RRC pulse shaping filter buffer offset at the end of the waveform. */
+    int rrc_filter_step;
+    /*! \brief The scrambler register at the end of the waveform. */
+    unsigned int scramble_reg;
+    /*! \brief The scrambler repeating pattern count at the end of the waveform. */
+    int scrambler_pattern_count;
+    /*! \brief The training step at the end of the waveform. */
+    int training_step;
+    /*! \brief The carrier phase at the end of the waveform. */
+    uint32_t carrier_phase;
+    /*! \brief The baud phase at the end of the waveform. */
+    int baud_phase;
+    /*! \brief The constellation position at the end of the waveform. */
+    int constellation_state;
+};
+
+/* Indexed by bit rate (4800, 2400) and TEP */
+static struct v27ter_tx_training_cache_s training_cache[2][2];
+static int training_cache_ready = FALSE;
+#if defined(V27TER_TX_TRAINING_CACHE_LOCKING)
+static pthread_once_t training_cache_once = PTHREAD_ONCE_INIT;
+#endif
+
 static int fake_get_bit(void *user_data)
 {
     return 1;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(v27ter_tx_state_t *s)
+{
+    /* Real data comes from the chunk buffer, if there is one. Training and shutdown
+       still use the fake get_bit routine. */
+    if (s->chunk.get_chunk  &&  s->current_get_bit == s->get_bit)
+        return chunk_tx_get_bit(&s->chunk);
+    return s->current_get_bit(s->get_bit_user_data);
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int scramble(v27ter_tx_state_t *s, int in_bit)
 {
     int out_bit;
@@ -120,7 +182,7 @@ static __inline__ int get_scrambled_bit(v27ter_tx_state_t *s)
 {
     int bit;
     
-    if ((bit = s->current_get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+    if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
     {
         /* End of real data. Switch to the fake get_bit routine, until we
            have shut down completely. */
@@ -244,7 +306,11 @@ static complexf_t getbaud(v27ter_tx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
+#if defined(SPANDSP_USE_FIXED_POINT)
+static __inline__ int32_t tx_sample_4800(v27ter_tx_state_t *s)
+#else
+static __inline__ float tx_sample_4800(v27ter_tx_state_t *s)
+#endif
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
     complexi_t x;
@@ -254,6 +320,203 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
     complexf_t z;
 #endif
     int i;
+
+    if (++s->baud_phase >= 5)
+    {
+        s->baud_phase -= 5;
+        s->rrc_filter[s->rrc_filter_step] =
+        s->rrc_filter[s->rrc_filter_step + V27TER_TX_FILTER_STEPS] = getbaud(s);
+        if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
+            s->rrc_filter_step = 0;
+    }
+    /* Root raised cosine pulse shaping at baseband */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    x = complex_seti(0, 0);
+    for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
+    {
+        x.re += (int32_t) tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += (int32_t) tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    x.re >>= 14;
+    x.im >>= 14;
+    z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+    /* Don't bother saturating. We should never clip. */
+    return (x.re*z.re - x.im*z.im) >> 15;
+#else
+    x = complex_setf(0.0f, 0.0f);
+    for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
+    {
+        x.re += tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+    return x.re*z.re - x.im*z.im;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+#if defined(SPANDSP_USE_FIXED_POINT)
+static __inline__ int32_t tx_sample_2400(v27ter_tx_state_t *s)
+#else
+static __inline__ float tx_sample_2400(v27ter_tx_state_t *s)
+#endif
+{
+#if defined(SPANDSP_USE_FIXED_POINT)
+    complexi_t x;
+    complexi_t z;
+#else
+    complexf_t x;
+    complexf_t z;
+#endif
+    int i;
+
+    if ((s->baud_phase += 3) >= 20)
+    {
+        s->baud_phase -= 20;
+        s->rrc_filter[s->rrc_filter_step] =
+        s->rrc_filter[s->rrc_filter_step + V27TER_TX_FILTER_STEPS] = getbaud(s);
+        if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
+            s->rrc_filter_step = 0;
+    }
+    /* Root raised cosine pulse shaping at baseband */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    x = complex_seti(0, 0);
+    for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
+    {
+        x.re += (int32_t) tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += (int32_t) tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    x.re >>= 14;
+    x.im >>= 14;
+    z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+    /* Don't bother saturating. We should never clip. */
+    return (x.re*z.re - x.im*z.im) >> 15;
+#else
+    x = complex_setf(0.0f, 0.0f);
+    for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
+    {
+        x.re += tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+    return x.re*z.re - x.im*z.im;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static void save_training_cache_state(struct v27ter_tx_training_cache_s *c, const v27ter_tx_state_t *t)
+{
+    memcpy(c->rrc_filter, t->rrc_filter, sizeof(c->rrc_filter));
+    c->rrc_filter_step = t->rrc_filter_step;
+    c->scramble_reg = t->scramble_reg;
+    c->scrambler_pattern_count = t->scrambler_pattern_count;
+    c->training_step = t->training_step;
+    c->carrier_phase = t->carrier_phase;
+    c->baud_phase = t->baud_phase;
+    c->constellation_state = t->constellation_state;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void build_training_cache(void)
+{
+    struct v27ter_tx_training_cache_s *c;
+    v27ter_tx_state_t t;
+    int tep;
+    int max_len;
+
+    for (tep = 0;  tep < 2;  tep++)
+    {
+        /* 4800bps has a baud interval of 5 samples */
+        c = &training_cache[0][tep];
+        if (c->amp == NULL)
+        {
+            max_len = (V27TER_TRAINING_SEG_5 - ((tep)  ?  V27TER_TRAINING_SEG_1  :  V27TER_TRAINING_SEG_2) + 1)*5 + 1;
+            if ((c->amp = malloc(max_len*sizeof(c->amp[0]))) == NULL)
+                return;
+        }
+        v27ter_tx_init(&t, 4800, tep, fake_get_bit, NULL);
+        /* Everything up to the first baud of segment 5 (the ones) is fixed for a given
+           bit rate and TEP setting. Stop just before that baud enters the RRC filter. */
+        for (c->len = 0;  t.training_step < V27TER_TRAINING_SEG_5  ||  t.baud_phase + 1 < 5;  c->len++)
+            c->amp[c->len] = tx_sample_4800(&t);
+        save_training_cache_state(c, &t);
+
+        /* 2400bps has a baud interval of 20/3 samples */
+        c = &training_cache[1][tep];
+        if (c->amp == NULL)
+        {
+            max_len = ((V27TER_TRAINING_SEG_5 - ((tep)  ?  V27TER_TRAINING_SEG_1  :  V27TER_TRAINING_SEG_2) + 1)*20)/3 + 1;
+            if ((c->amp = malloc(max_len*sizeof(c->amp[0]))) == NULL)
+                return;
+        }
+        v27ter_tx_init(&t, 2400, tep, fake_get_bit, NULL);
+        for (c->len = 0;  t.training_step < V27TER_TRAINING_SEG_5  ||  t.baud_phase + 3 < 20;  c->len++)
+            c->amp[c->len] = tx_sample_2400(&t);
+        save_training_cache_state(c, &t);
+    }
+    training_cache_ready = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int get_training_cache(void)
+{
+    /* The cache is built just once, by whichever transmitter asks for it first. Any
+       others asking at the same time wait until it is complete. */
+#if defined(V27TER_TX_TRAINING_CACHE_LOCKING)
+    pthread_once(&training_cache_once, build_training_cache);
+#else
+    if (!training_cache_ready)
+        build_training_cache();
+#endif
+    return (training_cache_ready)  ?  0  :  -1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int replay_training_cache(v27ter_tx_state_t *s, int16_t amp[], int len)
+{
+    const struct v27ter_tx_training_cache_s *c;
+    int i;
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t gain;
+#else
+    float gain;
+#endif
+
+    c = s->training_cache;
+    gain = (s->bit_rate == 4800)  ?  s->gain_4800  :  s->gain_2400;
+    if (len > c->len - s->training_cache_pos)
+        len = c->len - s->training_cache_pos;
+    for (i = 0;  i < len;  i++)
+    {
+#if defined(SPANDSP_USE_FIXED_POINT)
+        amp[i] = (int16_t) ((c->amp[s->training_cache_pos + i]*gain) >> 15);
+#else
+        amp[i] = (int16_t) lfastrintf(c->amp[s->training_cache_pos + i]*gain);
+#endif
+    }
+    if ((s->training_cache_pos += len) >= c->len)
+    {
+        /* Pick up the live modulator exactly where the cached waveform ends */
+        memcpy(s->rrc_filter, c->rrc_filter, sizeof(s->rrc_filter));
+        s->rrc_filter_step = c->rrc_filter_step;
+        s->scramble_reg = c->scramble_reg;
+        s->scrambler_pattern_count = c->scrambler_pattern_count;
+        s->training_step = c->training_step;
+        s->carrier_phase = c->carrier_phase;
+        s->baud_phase = c->baud_phase;
+        s->constellation_state = c->constellation_state;
+        s->training_cache = NULL;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
+{
     int sample;
 
     if (s->training_step >= V27TER_TRAINING_SHUTDOWN_END)
@@ -261,88 +524,31 @@ SPAN_DECLARE_NONSTD(int) v27ter_tx(v27ter_tx_state_t *s, int16_t amp[], int len)
         /* Once we have sent the shutdown symbols, we stop sending completely. */
         return 0;
     }
+    sample = 0;
+    if (s->training_cache)
+        sample = replay_training_cache(s, amp, len);
     /* The symbol rates for the two bit rates are different. This makes it difficult to
        merge both generation procedures into a single efficient loop. We do not bother
        trying. We use two independent loops, filter coefficients, etc. */
     if (s->bit_rate == 4800)
     {
-        for (sample = 0;  sample < len;  sample++)
+        for (  ;  sample < len;  sample++)
         {
-            if (++s->baud_phase >= 5)
-            {
-                s->baud_phase -= 5;
-                s->rrc_filter[s->rrc_filter_step] =
-                s->rrc_filter[s->rrc_filter_step + V27TER_TX_FILTER_STEPS] = getbaud(s);
-                if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
-                    s->rrc_filter_step = 0;
-            }
-            /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
-            x = complex_seti(0, 0);
-            for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
-            {
-                x.re += (int32_t) tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
-                x.im += (int32_t) tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
-            }
-            /* Now create and modulate the carrier */
-            x.re >>= 14;
-            x.im >>= 14;
-            z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
-            /* Don't bother saturating. We should never clip. */
-            i = (x.re*z.re - x.im*z.im) >> 15;
-            amp[sample] = (int16_t) ((i*s->gain_4800) >> 15);
+            amp[sample] = (int16_t) ((tx_sample_4800(s)*s->gain_4800) >> 15);
 #else
-            x = complex_setf(0.0f, 0.0f);
-            for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
-            {
-                x.re += tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
-                x.im += tx_pulseshaper_4800[TX_PULSESHAPER_4800_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
-            }
-            /* Now create and modulate the carrier */
-            z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
-            /* Don't bother saturating. We should never clip. */
-            amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain_4800);
+            amp[sample] = (int16_t) lfastrintf(tx_sample_4800(s)*s->gain_4800);
 #endif
         }
     }
     else
     {
-        for (sample = 0;  sample < len;  sample++)
+        for (  ;  sample < len;  sample++)
         {
-            if ((s->baud_phase += 3) >= 20)
-            {
-                s->baud_phase -= 20;
-                s->rrc_filter[s->rrc_filter_step] =
-                s->rrc_filter[s->rrc_filter_step + V27TER_TX_FILTER_STEPS] = getbaud(s);
-                if (++s->rrc_filter_step >= V27TER_TX_FILTER_STEPS)
-                    s->rrc_filter_step = 0;
-            }
-            /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
-            x = complex_seti(0, 0);
-            for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
-            {
-                x.re += (int32_t) tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
-                x.im += (int32_t) tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
-            }
-            /* Now create and modulate the carrier */
-            x.re >>= 14;
-            x.im >>= 14;
-            z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
-            /* Don't bother saturating. We should never clip. */
-            i = (x.re*z.re - x.im*z.im) >> 15;
-            amp[sample] = (int16_t) ((i*s->gain_2400) >> 15);
+            amp[sample] = (int16_t) ((tx_sample_2400(s)*s->gain_2400) >> 15);
 #else
-            x = complex_setf(0.0f, 0.0f);
-            for (i = 0;  i < V27TER_TX_FILTER_STEPS;  i++)
-            {
-                x.re += tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
-                x.im += tx_pulseshaper_2400[TX_PULSESHAPER_2400_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
-            }
-            /* Now create and modulate the carrier */
-            z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
-            /* Don't bother saturating. We should never clip. */
-            amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain_2400);
+            amp[sample] = (int16_t) lfastrintf(tx_sample_2400(s)*s->gain_2400);
 #endif
         }
     }
@@ -374,6 +580,12 @@ SPAN_DECLARE(void) v27ter_tx_set_get_bit(v27ter_tx_state_t *s, get_bit_func_t ge
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v27ter_tx_set_get_chunk(v27ter_tx_state_t *s, get_chunk_func_t get_chunk, void *user_data, int lsb_first)
+{
+    chunk_tx_init(&s->chunk, get_chunk, user_data, lsb_first);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v27ter_tx_set_modem_status_handler(v27ter_tx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -381,6 +593,15 @@ SPAN_DECLARE(void) v27ter_tx_set_modem_status_handler(v27ter_tx_state_t *s, mode
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) v27ter_tx_set_training_cache(v27ter_tx_state_t *s, int use_cache)
+{
+    if (use_cache  &&  get_training_cache())
+        return -1;
+    s->use_training_cache = use_cache;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(logging_state_t *) v27ter_tx_get_logging_state(v27ter_tx_state_t *s)
 {
     return &s->logging;
@@ -406,6 +627,12 @@ SPAN_DECLARE(int) v27ter_tx_restart(v27ter_tx_state_t *s, int bit_rate, int tep)
     s->baud_phase = 0;
     s->constellation_state = 0;
     s->current_get_bit = fake_get_bit;
+    /* Anything left over from a previous transmission is discarded */
+    chunk_tx_restart(&s->chunk);
+    s->training_cache = NULL;
+    s->training_cache_pos = 0;
+    if (s->use_training_cache  &&  training_cache_ready)
+        s->training_cache = &training_cache[(bit_rate == 4800)  ?  0  :  1][(tep)  ?  1  :  0];
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -449,4 +676,44 @@ SPAN_DECLARE(int) v27ter_tx_free(v27ter_tx_state_t *s)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void v27ter_tx_checkpoint(v27ter_tx_state_t *s, checkpoint_t *c)
+{
+    int cache_entry;
+
+    checkpoint_field(c, s->bit_rate);
+    chunk_tx_checkpoint(&s->chunk, c);
+    checkpoint_field(c, s->gain_2400);
+    checkpoint_field(c, s->gain_4800);
+    checkpoint_field(c, s->rrc_filter);
+    checkpoint_field(c, s->rrc_filter_step);
+    checkpoint_field(c, s->scramble_reg);
+    checkpoint_field(c, s->scrambler_pattern_count);
+    checkpoint_field(c, s->in_training);
+    checkpoint_field(c, s->training_step);
+    checkpoint_field(c, s->carrier_phase);
+    checkpoint_field(c, s->carrier_phase_rate);
+    checkpoint_field(c, s->baud_phase);
+    checkpoint_field(c, s->constellation_state);
+    checkpoint_field(c, s->use_training_cache);
+    /* A training waveform being replayed is recorded as its place in the cache */
+    cache_entry = (s->training_cache)  ?  (int) (s->training_cache - &training_cache[0][0])  :  -1;
+    checkpoint_field(c, cache_entry);
+    checkpoint_field(c, s->training_cache_pos);
+    checkpoint_logging(c, &s->logging);
+    if (c->restoring)
+    {
+        /* Which get_bit routine is in use follows from whether we are training */
+        s->current_get_bit = (s->in_training)  ?  fake_get_bit  :  s->get_bit;
+        s->training_cache = NULL;
+        if (cache_entry >= 0)
+        {
+            if (cache_entry >= (int) (sizeof(training_cache)/sizeof(training_cache[0][0]))  ||  get_training_cache())
+                c->failed = TRUE;
+            else
+                s->training_cache = &training_cache[0][0] + cache_entry;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
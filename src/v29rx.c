@@ -58,8 +58,11 @@
 #include "spandsp/v29rx.h"
 
 #include "spandsp/private/logging.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/v29rx.h"
 
+#include "checkpoint_local.h"
+
 #include "v29tx_constellation_maps.h"
 #if defined(SPANDSP_USE_FIXED_POINT)
 #include "v29rx_fixed_rrc.h"
@@ -178,6 +181,10 @@ SPAN_DECLARE(void) v29_rx_signal_cutoff(v29_rx_state_t *s, float cutoff)
 
 static void report_status_change(v29_rx_state_t *s, int status)
 {
+    /* Make sure everything received before the status change is delivered first,
+       including the odd bits at the end of the data. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
     if (s->status_handler)
         s->status_handler(s->status_user_data, status);
     else if (s->put_bit)
@@ -388,7 +395,10 @@ static __inline__ void put_bit(v29_rx_state_t *s, int bit)
        before we let data go to the application. */
     if (s->training_stage == TRAINING_STAGE_NORMAL_OPERATION)
     {
-        s->put_bit(s->put_bit_user_data, out_bit);
+        if (s->chunk.put_chunk)
+            chunk_rx_put_bit(&s->chunk, out_bit);
+        else
+            s->put_bit(s->put_bit_user_data, out_bit);
     }
     else
     {
@@ -1013,6 +1023,7 @@ SPAN_DECLARE_NONSTD(int) v29_rx(v29_rx_state_t *s, const int16_t amp[], int len)
         dds_advancef(&s->carrier_phase, s->carrier_phase_rate);
 #endif
     }
+    chunk_rx_flush(&s->chunk);
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -1052,6 +1063,15 @@ SPAN_DECLARE(void) v29_rx_set_put_bit(v29_rx_state_t *s, put_bit_func_t put_bit,
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v29_rx_set_put_chunk(v29_rx_state_t *s, put_chunk_func_t put_chunk, void *user_data, int lsb_first)
+{
+    /* Anything still waiting belongs to the old handler */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
+    chunk_rx_init(&s->chunk, put_chunk, user_data, lsb_first);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v29_rx_set_modem_status_handler(v29_rx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -1091,6 +1111,10 @@ SPAN_DECLARE(int) v29_rx_restart(v29_rx_state_t *s, int bit_rate, int old_train)
     vec_zerof(s->rrc_filter, sizeof(s->rrc_filter)/sizeof(s->rrc_filter[0]));
 #endif
     s->rrc_filter_step = 0;
+    /* Anything received before the restart is still delivered, including any
+       partial octet. */
+    chunk_rx_flush(&s->chunk);
+    chunk_rx_put_residue(&s->chunk, s->put_bit, s->put_bit_user_data);
 
     s->scramble_reg = 0;
     s->training_scramble_reg = 0x2A;
@@ -1216,4 +1240,52 @@ SPAN_DECLARE(void) v29_rx_set_qam_report_handler(v29_rx_state_t *s, qam_report_h
     s->qam_user_data = user_data;
 }
 /*- End of function --------------------------------------------------------*/
+
+void v29_rx_checkpoint(v29_rx_state_t *s, checkpoint_t *c)
+{
+    checkpoint_field(c, s->bit_rate);
+    chunk_rx_checkpoint(&s->chunk, c);
+    checkpoint_field(c, s->rrc_filter);
+    checkpoint_field(c, s->rrc_filter_step);
+    checkpoint_field(c, s->scramble_reg);
+    checkpoint_field(c, s->training_scramble_reg);
+    checkpoint_field(c, s->training_cd);
+    checkpoint_field(c, s->old_train);
+    checkpoint_field(c, s->training_stage);
+    checkpoint_field(c, s->training_count);
+    checkpoint_field(c, s->training_error);
+    checkpoint_field(c, s->last_sample);
+    checkpoint_field(c, s->signal_present);
+    checkpoint_field(c, s->carrier_drop_pending);
+    checkpoint_field(c, s->low_samples);
+    checkpoint_field(c, s->high_sample);
+    checkpoint_field(c, s->constellation_state);
+    checkpoint_field(c, s->carrier_phase);
+    checkpoint_field(c, s->carrier_phase_rate);
+    checkpoint_field(c, s->carrier_phase_rate_save);
+    checkpoint_field(c, s->carrier_track_p);
+    checkpoint_field(c, s->carrier_track_i);
+    checkpoint_field(c, s->power);
+    checkpoint_field(c, s->carrier_on_power);
+    checkpoint_field(c, s->carrier_off_power);
+    checkpoint_field(c, s->eq_step);
+    checkpoint_field(c, s->eq_put_step);
+    checkpoint_field(c, s->eq_skip);
+    checkpoint_field(c, s->baud_half);
+    checkpoint_field(c, s->agc_scaling);
+    checkpoint_field(c, s->agc_scaling_save);
+    checkpoint_field(c, s->eq_delta);
+    checkpoint_field(c, s->eq_coeff);
+    checkpoint_field(c, s->eq_coeff_save);
+    checkpoint_field(c, s->eq_buf);
+    checkpoint_field(c, s->symbol_sync_low);
+    checkpoint_field(c, s->symbol_sync_high);
+    checkpoint_field(c, s->symbol_sync_dc_filter);
+    checkpoint_field(c, s->baud_phase);
+    checkpoint_field(c, s->total_baud_timing_correction);
+    checkpoint_field(c, s->start_angles);
+    checkpoint_field(c, s->angles);
+    checkpoint_logging(c, &s->logging);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -40,6 +40,10 @@
 #include <math.h>
 #endif
 #include "floating_fudge.h"
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#define V29_TX_TRAINING_CACHE_LOCKING
+#endif
 
 #include "spandsp/telephony.h"
 #include "spandsp/fast_convert.h"
@@ -56,8 +60,11 @@
 #include "spandsp/v29tx.h"
 
 #include "spandsp/private/logging.h"
+#include "spandsp/private/async.h"
 #include "spandsp/private/v29tx.h"
 
+#include "checkpoint_local.h"
+
 #include "v29tx_constellation_maps.h"
 #if defined(SPANDSP_USE_FIXED_POINT)
 #include "v29tx_fixed_rrc.h"
@@ -84,18 +91,69 @@
 /*! The end of the shutdown sequence, in symbols */
 #define V29_TRAINING_SHUTDOWN_END   (V29_TRAINING_END + 32)
 
+/*!
+    An unscaled image of the start of a V.29 training sequence, from the restart
+    of the transmitter up to the start of segment 4, together with the modulator
+    state at the end of that waveform. These are built once, and shared read-only
+    by all transmitter instances which ask for them.
+*/
+struct v29_tx_training_cache_s
+{
+    /*! \brief The number of samples in the cached waveform. */
+    int len;
+    /*! \brief The cached waveform, before the output gain is applied. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    int32_t *amp;
+#else
+    float *amp;
+#endif
+    /*! \brief The RRC pulse shaping filter buffer at the end of the waveform. */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    complexi16_t rrc_filter[2*V29_TX_FILTER_STEPS];
+#else
+    complexf_t rrc_filter[2*V29_TX_FILTER_STEPS];
+#endif
+    /*! \brief The RRC pulse shaping filter buffer offset at the end of the waveform. */
+    int rrc_filter_step;
+    /*! \brief The training scrambler register at the end of the waveform. */
+    uint8_t training_scramble_reg;
+    /*! \brief The training step at the end of the waveform. */
+    int training_step;
+    /*! \brief The carrier phase at the end of the waveform. */
+    uint32_t carrier_phase;
+    /*! \brief The baud phase at the end of the waveform. */
+    int baud_phase;
+};
+
+/* Indexed by bit rate (9600, 7200, 4800) and TEP */
+static struct v29_tx_training_cache_s training_cache[3][2];
+static int training_cache_ready = FALSE;
+#if defined(V29_TX_TRAINING_CACHE_LOCKING)
+static pthread_once_t training_cache_once = PTHREAD_ONCE_INIT;
+#endif
+
 static int fake_get_bit(void *user_data)
 {
     return 1;
 }
 /*- End of function --------------------------------------------------------*/
 
+static __inline__ int get_data_bit(v29_tx_state_t *s)
+{
+    /* Real data comes from the chunk buffer, if there is one. Training and shutdown
+       still use the fake get_bit routine. */
+    if (s->chunk.get_chunk  &&  s->current_get_bit == s->get_bit)
+        return chunk_tx_get_bit(&s->chunk);
+    return s->current_get_bit(s->get_bit_user_data);
+}
+/*- End of function --------------------------------------------------------*/
+
 static __inline__ int get_scrambled_bit(v29_tx_state_t *s)
 {
     int bit;
     int out_bit;
 
-    if ((bit = s->current_get_bit(s->get_bit_user_data)) == SIG_STATUS_END_OF_DATA)
+    if ((bit = get_data_bit(s)) == SIG_STATUS_END_OF_DATA)
     {
         /* End of real data. Switch to the fake get_bit routine, until we
            have shut down completely. */
@@ -202,7 +260,11 @@ static __inline__ complexf_t getbaud(v29_tx_state_t *s)
 }
 /*- End of function --------------------------------------------------------*/
 
-SPAN_DECLARE_NONSTD(int) v29_tx(v29_tx_state_t *s, int16_t amp[], int len)
+#if defined(SPANDSP_USE_FIXED_POINT)
+static __inline__ int32_t tx_sample(v29_tx_state_t *s)
+#else
+static __inline__ float tx_sample(v29_tx_state_t *s)
+#endif
 {
 #if defined(SPANDSP_USE_FIXED_POINT)
     complexi_t x;
@@ -212,6 +274,131 @@ SPAN_DECLARE_NONSTD(int) v29_tx(v29_tx_state_t *s, int16_t amp[], int len)
     complexf_t z;
 #endif
     int i;
+
+    if ((s->baud_phase += 3) >= 10)
+    {
+        s->baud_phase -= 10;
+        s->rrc_filter[s->rrc_filter_step] =
+        s->rrc_filter[s->rrc_filter_step + V29_TX_FILTER_STEPS] = getbaud(s);
+        if (++s->rrc_filter_step >= V29_TX_FILTER_STEPS)
+            s->rrc_filter_step = 0;
+    }
+    /* Root raised cosine pulse shaping at baseband */
+#if defined(SPANDSP_USE_FIXED_POINT)
+    x = complex_seti(0, 0);
+    for (i = 0;  i < V29_TX_FILTER_STEPS;  i++)
+    {
+        x.re += (int32_t) tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += (int32_t) tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    x.re >>= 4;
+    x.im >>= 4;
+    z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
+    /* Don't bother saturating. We should never clip. */
+    return (x.re*z.re - x.im*z.im) >> 15;
+#else
+    x = complex_setf(0.0f, 0.0f);
+    for (i = 0;  i < V29_TX_FILTER_STEPS;  i++)
+    {
+        x.re += tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
+        x.im += tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
+    }
+    /* Now create and modulate the carrier */
+    z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
+    return x.re*z.re - x.im*z.im;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+static void build_training_cache(void)
+{
+    static const int bit_rates[3] =
+    {
+        9600, 7200, 4800
+    };
+    struct v29_tx_training_cache_s *c;
+    v29_tx_state_t t;
+    int i;
+    int tep;
+    int max_len;
+
+    for (i = 0;  i < 3;  i++)
+    {
+        for (tep = 0;  tep < 2;  tep++)
+        {
+            c = &training_cache[i][tep];
+            if (c->amp == NULL)
+            {
+                /* The baud interval is 10/3 samples */
+                max_len = ((V29_TRAINING_SEG_4 - ((tep)  ?  V29_TRAINING_SEG_TEP  :  V29_TRAINING_SEG_1) + 1)*10)/3 + 1;
+                if ((c->amp = malloc(max_len*sizeof(c->amp[0]))) == NULL)
+                    return;
+            }
+            v29_tx_init(&t, bit_rates[i], tep, fake_get_bit, NULL);
+            /* Everything up to the first baud of segment 4 is fixed for a given bit
+               rate and TEP setting. Stop just before that baud enters the RRC filter. */
+            for (c->len = 0;  t.training_step < V29_TRAINING_SEG_4  ||  t.baud_phase + 3 < 10;  c->len++)
+                c->amp[c->len] = tx_sample(&t);
+            memcpy(c->rrc_filter, t.rrc_filter, sizeof(c->rrc_filter));
+            c->rrc_filter_step = t.rrc_filter_step;
+            c->training_scramble_reg = t.training_scramble_reg;
+            c->training_step = t.training_step;
+            c->carrier_phase = t.carrier_phase;
+            c->baud_phase = t.baud_phase;
+        }
+    }
+    training_cache_ready = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int get_training_cache(void)
+{
+    /* The cache is built just once, by whichever transmitter asks for it first. Any
+       others asking at the same time wait until it is complete. */
+#if defined(V29_TX_TRAINING_CACHE_LOCKING)
+    pthread_once(&training_cache_once, build_training_cache);
+#else
+    if (!training_cache_ready)
+        build_training_cache();
+#endif
+    return (training_cache_ready)  ?  0  :  -1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int replay_training_cache(v29_tx_state_t *s, int16_t amp[], int len)
+{
+    const struct v29_tx_training_cache_s *c;
+    int i;
+
+    c = s->training_cache;
+    if (len > c->len - s->training_cache_pos)
+        len = c->len - s->training_cache_pos;
+    for (i = 0;  i < len;  i++)
+    {
+#if defined(SPANDSP_USE_FIXED_POINT)
+        amp[i] = (int16_t) ((c->amp[s->training_cache_pos + i]*s->gain) >> 15);
+#else
+        amp[i] = (int16_t) lfastrintf(c->amp[s->training_cache_pos + i]*s->gain);
+#endif
+    }
+    if ((s->training_cache_pos += len) >= c->len)
+    {
+        /* Pick up the live modulator exactly where the cached waveform ends */
+        memcpy(s->rrc_filter, c->rrc_filter, sizeof(s->rrc_filter));
+        s->rrc_filter_step = c->rrc_filter_step;
+        s->training_scramble_reg = c->training_scramble_reg;
+        s->training_step = c->training_step;
+        s->carrier_phase = c->carrier_phase;
+        s->baud_phase = c->baud_phase;
+        s->training_cache = NULL;
+    }
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+SPAN_DECLARE_NONSTD(int) v29_tx(v29_tx_state_t *s, int16_t amp[], int len)
+{
     int sample;
 
     if (s->training_step >= V29_TRAINING_SHUTDOWN_END)
@@ -219,42 +406,15 @@ SPAN_DECLARE_NONSTD(int) v29_tx(v29_tx_state_t *s, int16_t amp[], int len)
         /* Once we have sent the shutdown symbols, we stop sending completely. */
         return 0;
     }
-    for (sample = 0;  sample < len;  sample++)
+    sample = 0;
+    if (s->training_cache)
+        sample = replay_training_cache(s, amp, len);
+    for (  ;  sample < len;  sample++)
     {
-        if ((s->baud_phase += 3) >= 10)
-        {
-            s->baud_phase -= 10;
-            s->rrc_filter[s->rrc_filter_step] =
-            s->rrc_filter[s->rrc_filter_step + V29_TX_FILTER_STEPS] = getbaud(s);
-            if (++s->rrc_filter_step >= V29_TX_FILTER_STEPS)
-                s->rrc_filter_step = 0;
-        }
-        /* Root raised cosine pulse shaping at baseband */
 #if defined(SPANDSP_USE_FIXED_POINT)
-        x = complex_seti(0, 0);
-        for (i = 0;  i < V29_TX_FILTER_STEPS;  i++)
-        {
-            x.re += (int32_t) tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].re;
-            x.im += (int32_t) tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*(int32_t) s->rrc_filter[i + s->rrc_filter_step].im;
-        }
-        /* Now create and modulate the carrier */
-        x.re >>= 4;
-        x.im >>= 4;
-        z = dds_complexi(&(s->carrier_phase), s->carrier_phase_rate);
-        /* Don't bother saturating. We should never clip. */
-        i = (x.re*z.re - x.im*z.im) >> 15;
-        amp[sample] = (int16_t) ((i*s->gain) >> 15);
+        amp[sample] = (int16_t) ((tx_sample(s)*s->gain) >> 15);
 #else
-        x = complex_setf(0.0f, 0.0f);
-        for (i = 0;  i < V29_TX_FILTER_STEPS;  i++)
-        {
-            x.re += tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].re;
-            x.im += tx_pulseshaper[TX_PULSESHAPER_COEFF_SETS - 1 - s->baud_phase][i]*s->rrc_filter[i + s->rrc_filter_step].im;
-        }
-        /* Now create and modulate the carrier */
-        z = dds_complexf(&(s->carrier_phase), s->carrier_phase_rate);
-        /* Don't bother saturating. We should never clip. */
-        amp[sample] = (int16_t) lfastrintf((x.re*z.re - x.im*z.im)*s->gain);
+        amp[sample] = (int16_t) lfastrintf(tx_sample(s)*s->gain);
 #endif
     }
     return sample;
@@ -316,6 +476,12 @@ SPAN_DECLARE(void) v29_tx_set_get_bit(v29_tx_state_t *s, get_bit_func_t get_bit,
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(void) v29_tx_set_get_chunk(v29_tx_state_t *s, get_chunk_func_t get_chunk, void *user_data, int lsb_first)
+{
+    chunk_tx_init(&s->chunk, get_chunk, user_data, lsb_first);
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(void) v29_tx_set_modem_status_handler(v29_tx_state_t *s, modem_tx_status_func_t handler, void *user_data)
 {
     s->status_handler = handler;
@@ -323,6 +489,15 @@ SPAN_DECLARE(void) v29_tx_set_modem_status_handler(v29_tx_state_t *s, modem_tx_s
 }
 /*- End of function --------------------------------------------------------*/
 
+SPAN_DECLARE(int) v29_tx_set_training_cache(v29_tx_state_t *s, int use_cache)
+{
+    if (use_cache  &&  get_training_cache())
+        return -1;
+    s->use_training_cache = use_cache;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 SPAN_DECLARE(logging_state_t *) v29_tx_get_logging_state(v29_tx_state_t *s)
 {
     return &s->logging;
@@ -362,6 +537,12 @@ SPAN_DECLARE(int) v29_tx_restart(v29_tx_state_t *s, int bit_rate, int tep)
     s->baud_phase = 0;
     s->constellation_state = 0;
     s->current_get_bit = fake_get_bit;
+    /* Anything left over from a previous transmission is discarded */
+    chunk_tx_restart(&s->chunk);
+    s->training_cache = NULL;
+    s->training_cache_pos = 0;
+    if (s->use_training_cache  &&  training_cache_ready)
+        s->training_cache = &training_cache[s->training_offset >> 1][(tep)  ?  1  :  0];
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
@@ -406,4 +587,45 @@ SPAN_DECLARE(int) v29_tx_free(v29_tx_state_t *s)
     return 0;
 }
 /*- End of function --------------------------------------------------------*/
+
+void v29_tx_checkpoint(v29_tx_state_t *s, checkpoint_t *c)
+{
+    int cache_entry;
+
+    checkpoint_field(c, s->bit_rate);
+    chunk_tx_checkpoint(&s->chunk, c);
+    checkpoint_field(c, s->base_gain);
+    checkpoint_field(c, s->gain);
+    checkpoint_field(c, s->rrc_filter);
+    checkpoint_field(c, s->rrc_filter_step);
+    checkpoint_field(c, s->scramble_reg);
+    checkpoint_field(c, s->training_scramble_reg);
+    checkpoint_field(c, s->in_training);
+    checkpoint_field(c, s->training_step);
+    checkpoint_field(c, s->training_offset);
+    checkpoint_field(c, s->carrier_phase);
+    checkpoint_field(c, s->carrier_phase_rate);
+    checkpoint_field(c, s->baud_phase);
+    checkpoint_field(c, s->constellation_state);
+    checkpoint_field(c, s->use_training_cache);
+    /* A training waveform being replayed is recorded as its place in the cache */
+    cache_entry = (s->training_cache)  ?  (int) (s->training_cache - &training_cache[0][0])  :  -1;
+    checkpoint_field(c, cache_entry);
+    checkpoint_field(c, s->training_cache_pos);
+    checkpoint_logging(c, &s->logging);
+    if (c->restoring)
+    {
+        /* Which get_bit routine is in use follows from whether we are training */
+        s->current_get_bit = (s->in_training)  ?  fake_get_bit  :  s->get_bit;
+        s->training_cache = NULL;
+        if (cache_entry >= 0)
+        {
+            if (cache_entry >= (int) (sizeof(training_cache)/sizeof(training_cache[0][0]))  ||  get_training_cache())
+                c->failed = TRUE;
+            else
+                s->training_cache = &training_cache[0][0] + cache_entry;
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
@@ -47,7 +47,7 @@
 
 uint8_t buffer[256];
 
-#define PATTERN             0x11111111
+#define PATTERN             0x11111111U
 #define SEQUENCE_LENGTH     17
 
 uint8_t left[] =
@@ -97,6 +97,231 @@ uint8_t right[] =
     0x01        /* 1 of 17 */
 };
 
+static int test_fields(int lsb_first, const uint8_t *expected, int expected_len)
+{
+    bitstream_state_t state;
+    bitstream_state_t *s;
+    const uint8_t *r;
+    uint8_t *w;
+    uint32_t values[SEQUENCE_LENGTH];
+    uint32_t x[SEQUENCE_LENGTH];
+    uint8_t bits[SEQUENCE_LENGTH];
+    int i;
+
+    /* Write the same sequence as a single put of the first field, and bulk puts of the
+       rest, so the bulk routines have to pick up from a partial byte. */
+    for (i = 0;  i < SEQUENCE_LENGTH;  i++)
+    {
+        values[i] = PATTERN*i;
+        bits[i] = (uint8_t) (i + 1);
+    }
+    s = bitstream_init(&state, lsb_first);
+    w = buffer;
+    bitstream_put(s, &w, values[0], bits[0]);
+    bitstream_put_fields(s, &w, &values[1], &bits[1], 5);
+    bitstream_put_fields(s, &w, &values[6], &bits[6], SEQUENCE_LENGTH - 6);
+    bitstream_flush(s, &w);
+    if ((w - buffer) != expected_len  ||  memcmp(buffer, expected, expected_len))
+    {
+        printf("Bulk put error\n");
+        return -1;
+    }
+
+    s = bitstream_init(&state, lsb_first);
+    r = buffer;
+    x[0] = bitstream_get(s, &r, bits[0]);
+    bitstream_get_fields(s, &r, &x[1], &bits[1], 5);
+    bitstream_get_fields(s, &r, &x[6], &bits[6], SEQUENCE_LENGTH - 6);
+    for (i = 0;  i < SEQUENCE_LENGTH;  i++)
+    {
+        if (x[i] != (values[i] & ((1 << bits[i]) - 1)))
+        {
+            printf("Bulk get error 0x%X 0x%X\n", x[i], values[i] & ((1 << bits[i]) - 1));
+            return -1;
+        }
+    }
+    /* We should have read exactly the bytes of the sequence, and no more */
+    if ((r - buffer) != expected_len)
+    {
+        printf("Bulk get consumed %d bytes\n", (int) (r - buffer));
+        return -1;
+    }
+
+    /* Full 32 bit fields should pass through intact */
+    values[0] = 0xDEADBEEF;
+    values[1] = 0x5;
+    values[2] = 0x87654321;
+    bits[0] = 32;
+    bits[1] = 3;
+    bits[2] = 32;
+    s = bitstream_init(&state, lsb_first);
+    w = buffer;
+    bitstream_put_fields(s, &w, values, bits, 3);
+    bitstream_flush(s, &w);
+    s = bitstream_init(&state, lsb_first);
+    r = buffer;
+    bitstream_get_fields(s, &r, x, bits, 3);
+    if (x[0] != values[0]  ||  x[1] != values[1]  ||  x[2] != values[2])
+    {
+        printf("32 bit field error 0x%X 0x%X 0x%X\n", x[0], x[1], x[2]);
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+#define TIMING_FRAMES       10000
+
+/* The widths of the fields in a 33 byte VoIP style GSM 06.10 frame - a 4 bit magic
+   number and the 8 LARs, then 4 sub-frames of 17 fields each. */
+static const uint8_t gsm_bits[9 + 4*17] =
+{
+    4, 6, 6, 5, 5, 4, 4, 3, 3,
+    7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    7, 2, 2, 6, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+};
+
+static void gsm_frame_to_values(uint32_t values[], const gsm0610_frame_t *f)
+{
+    int i;
+    int j;
+    int k;
+
+    k = 0;
+    values[k++] = 0xD;
+    for (i = 0;  i < 8;  i++)
+        values[k++] = f->LARc[i];
+    for (i = 0;  i < 4;  i++)
+    {
+        values[k++] = f->Nc[i];
+        values[k++] = f->bc[i];
+        values[k++] = f->Mc[i];
+        values[k++] = f->xmaxc[i];
+        for (j = 0;  j < 13;  j++)
+            values[k++] = f->xMc[i][j];
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_timing(void)
+{
+    static gsm0610_frame_t frames[TIMING_FRAMES];
+    static uint32_t values[TIMING_FRAMES][9 + 4*17];
+    static uint8_t packed[3][TIMING_FRAMES][33];
+    bitstream_state_t state;
+    bitstream_state_t *s;
+    gsm0610_frame_t frame;
+    const uint8_t *r;
+    uint8_t *w;
+    uint32_t x[9 + 4*17];
+    int64_t start;
+    int64_t end;
+    int i;
+    int j;
+    int k;
+
+    /* Compare the generic field at a time and bulk routines with the hand written
+       shifts the GSM 06.10 codec uses to pack and unpack the same frame layout. The
+       codec's routines are much faster, which is why they do not use these. */
+    srand(1234);
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+    {
+        for (j = 0;  j < 8;  j++)
+            frames[i].LARc[j] = (int16_t) (rand() & ((1 << gsm_bits[j + 1]) - 1));
+        for (j = 0;  j < 4;  j++)
+        {
+            frames[i].Nc[j] = (int16_t) (rand() & 0x7F);
+            frames[i].bc[j] = (int16_t) (rand() & 0x3);
+            frames[i].Mc[j] = (int16_t) (rand() & 0x3);
+            frames[i].xmaxc[j] = (int16_t) (rand() & 0x3F);
+            for (k = 0;  k < 13;  k++)
+                frames[i].xMc[j][k] = (int16_t) (rand() & 0x7);
+        }
+        gsm_frame_to_values(values[i], &frames[i]);
+    }
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+    {
+        s = bitstream_init(&state, FALSE);
+        w = packed[0][i];
+        for (j = 0;  j < 9 + 4*17;  j++)
+            bitstream_put(s, &w, values[i][j], gsm_bits[j]);
+        bitstream_flush(s, &w);
+    }
+    end = rdtscll();
+    printf("bitstream_put():          %.1f ticks per GSM frame packed\n", (double) (end - start)/TIMING_FRAMES);
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+    {
+        s = bitstream_init(&state, FALSE);
+        w = packed[1][i];
+        bitstream_put_fields(s, &w, values[i], gsm_bits, 9 + 4*17);
+        bitstream_flush(s, &w);
+    }
+    end = rdtscll();
+    printf("bitstream_put_fields():   %.1f ticks per GSM frame packed\n", (double) (end - start)/TIMING_FRAMES);
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+        gsm0610_pack_voip(packed[2][i], &frames[i]);
+    end = rdtscll();
+    printf("gsm0610_pack_voip():      %.1f ticks per GSM frame packed\n", (double) (end - start)/TIMING_FRAMES);
+
+    if (memcmp(packed[0], packed[1], sizeof(packed[0]))  ||  memcmp(packed[0], packed[2], sizeof(packed[0])))
+    {
+        printf("Packed GSM frames differ\n");
+        return -1;
+    }
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+    {
+        s = bitstream_init(&state, FALSE);
+        r = packed[0][i];
+        for (j = 0;  j < 9 + 4*17;  j++)
+            x[j] = bitstream_get(s, &r, gsm_bits[j]);
+    }
+    end = rdtscll();
+    printf("bitstream_get():          %.1f ticks per GSM frame unpacked\n", (double) (end - start)/TIMING_FRAMES);
+    if (memcmp(x, values[TIMING_FRAMES - 1], sizeof(x)))
+    {
+        printf("Unpacked GSM frames differ\n");
+        return -1;
+    }
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+    {
+        s = bitstream_init(&state, FALSE);
+        r = packed[0][i];
+        bitstream_get_fields(s, &r, x, gsm_bits, 9 + 4*17);
+    }
+    end = rdtscll();
+    printf("bitstream_get_fields():   %.1f ticks per GSM frame unpacked\n", (double) (end - start)/TIMING_FRAMES);
+    if (memcmp(x, values[TIMING_FRAMES - 1], sizeof(x)))
+    {
+        printf("Unpacked GSM frames differ\n");
+        return -1;
+    }
+
+    start = rdtscll();
+    for (i = 0;  i < TIMING_FRAMES;  i++)
+        gsm0610_unpack_voip(&frame, packed[0][i]);
+    end = rdtscll();
+    printf("gsm0610_unpack_voip():    %.1f ticks per GSM frame unpacked\n", (double) (end - start)/TIMING_FRAMES);
+    if (memcmp(&frame, &frames[TIMING_FRAMES - 1], sizeof(frame)))
+    {
+        printf("Unpacked GSM frames differ\n");
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -182,6 +407,18 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (test_fields(TRUE, right, sizeof(right))  ||  test_fields(FALSE, left, sizeof(left)))
+    {
+        printf("Test failed\n");
+        exit(2);
+    }
+
+    if (test_timing())
+    {
+        printf("Test failed\n");
+        exit(2);
+    }
+
     printf("Tests passed.\n");
     return 0;
 }
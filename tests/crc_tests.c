@@ -41,6 +41,8 @@ correct operation.
 
 #include "spandsp.h"
 
+#define LONG_BLOCK_LEN  65536
+
 int ref_len;
 uint8_t buf[1000];
 
@@ -68,6 +70,88 @@ static int cook_up_msg(uint8_t *buf)
 }
 /*- End of function --------------------------------------------------------*/
 
+static uint32_t crc_itu32_bitwise(const uint8_t *buf, int len, uint32_t crc)
+{
+    int i;
+    int j;
+
+    for (i = 0;  i < len;  i++)
+    {
+        crc ^= buf[i];
+        for (j = 0;  j < 8;  j++)
+            crc = (crc & 1)  ?  ((crc >> 1) ^ 0xEDB88320)  :  (crc >> 1);
+    }
+    return crc;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_crc_engines(void)
+{
+    static uint8_t big[LONG_BLOCK_LEN + 64];
+    uint32_t crc32a;
+    uint32_t crc32b;
+    uint16_t crc16a;
+    uint16_t crc16b;
+    uint64_t start;
+    uint64_t end;
+    int lens[] = {16, 256, 2048, LONG_BLOCK_LEN, -1};
+    int i;
+    int j;
+    int len;
+    int offset;
+
+    /* The library picks between a slicing by 8 table engine, and a carry-less multiply
+       folding engine for long buffers where the CPU supports it. Check every length
+       either side of the switch over point, at every alignment, against bit by bit
+       calculations. */
+    printf("Testing the CRC engines against bit by bit calculation\n");
+    for (i = 0;  i < LONG_BLOCK_LEN + 64;  i++)
+        big[i] = my_rand();
+    for (len = 0;  len < 600;  len++)
+    {
+        for (offset = 0;  offset < 16;  offset++)
+        {
+            crc32a = crc_itu32_calc(&big[offset], len, 0xFFFFFFFF - len);
+            crc32b = crc_itu32_bitwise(&big[offset], len, 0xFFFFFFFF - len);
+            crc16a = crc_itu16_calc(&big[offset], len, (uint16_t) (0xFFFF - len));
+            crc16b = (uint16_t) (0xFFFF - len);
+            for (j = 0;  j < len;  j++)
+                crc16b = crc_itu16_bits(big[offset + j], 8, crc16b);
+            if (crc32a != crc32b  ||  crc16a != crc16b)
+            {
+                printf("CRC mismatch for length %d, offset %d - %08X/%08X, %04X/%04X\n", len, offset, crc32a, crc32b, crc16a, crc16b);
+                return -1;
+            }
+        }
+    }
+    if (crc_itu32_calc(big, LONG_BLOCK_LEN, 0xFFFFFFFF) != crc_itu32_bitwise(big, LONG_BLOCK_LEN, 0xFFFFFFFF))
+    {
+        printf("CRC-32 mismatch for a long block\n");
+        return -1;
+    }
+    printf("Test passed.\n\n");
+
+    printf("Measuring the CRC speed\n");
+    for (i = 0;  lens[i] > 0;  i++)
+    {
+        crc32a = 0xFFFFFFFF;
+        start = rdtscll();
+        for (j = 0;  j < LONG_BLOCK_LEN/lens[i];  j++)
+            crc32a = crc_itu32_calc(big, lens[i], crc32a);
+        end = rdtscll();
+        printf("CRC-32 on %6d byte blocks: %.3f bytes per tick\n", lens[i], (double) LONG_BLOCK_LEN/(end - start));
+        crc16a = 0xFFFF;
+        start = rdtscll();
+        for (j = 0;  j < LONG_BLOCK_LEN/lens[i];  j++)
+            crc16a = crc_itu16_calc(big, lens[i], crc16a);
+        end = rdtscll();
+        printf("CRC-16 on %6d byte blocks: %.3f bytes per tick\n", lens[i], (double) LONG_BLOCK_LEN/(end - start));
+    }
+    printf("\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -123,7 +207,14 @@ int main(int argc, char *argv[])
             exit(2);
         }
     }
-    printf("Test passed.\n");
+    printf("Test passed.\n\n");
+
+    if (test_crc_engines())
+    {
+        printf("Tests failed.\n");
+        exit(2);
+    }
+    printf("Tests passed.\n");
     return  0;
 }
 /*- End of function --------------------------------------------------------*/
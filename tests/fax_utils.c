@@ -105,4 +105,22 @@ void log_transfer_statistics(t30_state_t *s, const char *tag)
 #endif
 }
 /*- End of function --------------------------------------------------------*/
+
+void log_timing_statistics(t30_state_t *s, const char *tag)
+{
+    t30_timing_stats_t t;
+
+    t30_get_timing_statistics(s, &t);
+    printf("%s: call time %dms, first page at %dms\n", tag, t.call_time, t.first_page_time);
+    printf("%s: phase A %dms, B %dms, C %dms, D %dms, E %dms\n",
+           tag,
+           t.phase_a_time,
+           t.phase_b_time,
+           t.phase_c_time,
+           t.phase_d_time,
+           t.phase_e_time);
+    printf("%s: TCF %dms in %d TCFs, images %dms\n", tag, t.tcf_time, t.tcfs, t.image_time);
+    printf("%s: retrains %d, fallbacks %d, PPS %d, PPR %d\n", tag, t.retrains, t.fallbacks, t.pps_rounds, t.pprs);
+}
+/*- End of function --------------------------------------------------------*/
 /*- End of file ------------------------------------------------------------*/
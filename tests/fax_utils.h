@@ -39,6 +39,8 @@ void log_rx_parameters(t30_state_t *s, const char *tag);
 
 void log_transfer_statistics(t30_state_t *s, const char *tag);
 
+void log_timing_statistics(t30_state_t *s, const char *tag);
+
 #if defined(__cplusplus)
 }
 #endif
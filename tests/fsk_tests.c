@@ -62,6 +62,9 @@ These tests allow either:
 
 #define OUTPUT_FILE_NAME    "fsk.wav"
 
+#define BANK_CHANNELS       30
+#define BANK_TEST_SAMPLES   (10*SAMPLE_RATE)
+
 char *decode_test_file = NULL;
 both_ways_line_model_state_t *model;
 int rx_bits = 0;
@@ -160,6 +163,124 @@ static void reporter(void *user_data, int reason, bert_results_t *results)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int bank_tests(int modem)
+{
+    fsk_tx_state_t *tx;
+    fsk_rx_state_t *rx[BANK_CHANNELS];
+    fsk_rx_state_t *bank_rx[BANK_CHANNELS];
+    fsk_rx_bank_state_t *bank;
+    bert_state_t rx_bert[BANK_CHANNELS];
+    bert_state_t bank_bert[BANK_CHANNELS];
+    bert_results_t bert_results;
+    awgn_state_t noise_source;
+    int16_t *amp[BANK_CHANNELS];
+    const int16_t *bank_amp[BANK_CHANNELS];
+    uint64_t start;
+    uint64_t end;
+    uint64_t rx_cycles;
+    uint64_t bank_cycles;
+    int test_bps;
+    int ch;
+    int i;
+    int j;
+
+    printf("Test a bank of %d receivers against %d separate receivers\n", BANK_CHANNELS, BANK_CHANNELS);
+    test_bps = preset_fsk_specs[modem].baud_rate;
+    if ((bank = fsk_rx_bank_init(NULL, &preset_fsk_specs[modem], BANK_CHANNELS)) == NULL)
+    {
+        fprintf(stderr, "    Failed to create receiver bank\n");
+        exit(2);
+    }
+    for (ch = 0;  ch < BANK_CHANNELS;  ch++)
+    {
+        /* Give each channel its own level, noise and start time, so the channels
+           are not in lock step. */
+        bert_init(&rx_bert[ch], 0, BERT_PATTERN_ITU_O152_11, test_bps, 20);
+        bert_init(&bank_bert[ch], 0, BERT_PATTERN_ITU_O152_11, test_bps, 20);
+        if ((amp[ch] = (int16_t *) malloc(BANK_TEST_SAMPLES*sizeof(int16_t))) == NULL)
+        {
+            fprintf(stderr, "    Failed to allocate audio buffer\n");
+            exit(2);
+        }
+        memset(amp[ch], 0, BANK_TEST_SAMPLES*sizeof(int16_t));
+        tx = fsk_tx_init(NULL, &preset_fsk_specs[modem], (get_bit_func_t) bert_get_bit, &rx_bert[ch]);
+        fsk_tx_power(tx, -10.0f - ch/2);
+        fsk_tx(tx, amp[ch] + 37*ch, BANK_TEST_SAMPLES - 37*ch);
+        fsk_tx_free(tx);
+        awgn_init_dbm0(&noise_source, 1234567 + ch, -45.0f);
+        for (i = 0;  i < BANK_TEST_SAMPLES;  i++)
+            amp[ch][i] = saturate(amp[ch][i] + awgn(&noise_source));
+        rx[ch] = fsk_rx_init(NULL, &preset_fsk_specs[modem], FSK_FRAME_MODE_SYNC, (put_bit_func_t) bert_put_bit, &rx_bert[ch]);
+        bank_rx[ch] = fsk_rx_init(NULL, &preset_fsk_specs[modem], FSK_FRAME_MODE_SYNC, (put_bit_func_t) bert_put_bit, &bank_bert[ch]);
+        if (fsk_rx_bank_set_channel(bank, ch, bank_rx[ch]))
+        {
+            fprintf(stderr, "    Failed to attach receiver to bank\n");
+            exit(2);
+        }
+    }
+
+    start = rdtscll();
+    for (i = 0;  i < BANK_TEST_SAMPLES;  i += BLOCK_LEN)
+    {
+        for (ch = 0;  ch < BANK_CHANNELS;  ch++)
+            fsk_rx(rx[ch], amp[ch] + i, BLOCK_LEN);
+    }
+    end = rdtscll();
+    rx_cycles = end - start;
+
+    start = rdtscll();
+    for (i = 0;  i < BANK_TEST_SAMPLES;  i += BLOCK_LEN)
+    {
+        for (ch = 0;  ch < BANK_CHANNELS;  ch++)
+            bank_amp[ch] = amp[ch] + i;
+        fsk_rx_bank(bank, bank_amp, BLOCK_LEN);
+    }
+    end = rdtscll();
+    bank_cycles = end - start;
+
+    printf("Separate receivers %llu cycles, bank %llu cycles - %.2f times faster\n",
+           (unsigned long long int) rx_cycles,
+           (unsigned long long int) bank_cycles,
+           (double) rx_cycles/(double) bank_cycles);
+
+    for (ch = 0;  ch < BANK_CHANNELS;  ch++)
+    {
+        /* A channel of the bank should behave exactly like a separate receiver */
+        bert_result(&rx_bert[ch], &bert_results);
+        i = bert_results.total_bits;
+        bert_result(&bank_bert[ch], &bert_results);
+        if (bert_results.total_bits != i)
+        {
+            printf("Channel %d: separate receiver %d bits, bank %d bits\n", ch, i, bert_results.total_bits);
+            return -1;
+        }
+        for (j = 0;  j < 2;  j++)
+        {
+            bert_result((j == 0)  ?  &rx_bert[ch]  :  &bank_bert[ch], &bert_results);
+            if (bert_results.total_bits < (BANK_TEST_SAMPLES/SAMPLE_RATE - 1)*test_bps/100
+                ||
+                bert_results.bad_bits != 0
+                ||
+                bert_results.resyncs != 0)
+            {
+                printf("Channel %d (%s): %d bits, %d bad bits, %d resyncs\n",
+                       ch,
+                       (j == 0)  ?  "separate"  :  "bank",
+                       bert_results.total_bits,
+                       bert_results.bad_bits,
+                       bert_results.resyncs);
+                return -1;
+            }
+        }
+        fsk_rx_free(rx[ch]);
+        fsk_rx_free(bank_rx[ch]);
+        free(amp[ch]);
+    }
+    fsk_rx_bank_free(bank);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     fsk_tx_state_t *caller_tx;
@@ -515,6 +636,11 @@ int main(int argc, char *argv[])
                 bert_set_report(&answerer_bert, 100000, reporter, (void *) (intptr_t) 2);
             }
         }
+        if (modem_under_test_1 >= 0  &&  bank_tests(modem_under_test_1))
+        {
+            printf("Tests failed.\n");
+            exit(2);
+        }
         printf("Tests passed.\n");
     }
     if (log_audio)
@@ -43,6 +43,8 @@ using both 16 and 32 bit CRCs.
 #include "spandsp.h"
 #include "spandsp/private/hdlc.h"
 
+#define STREAM_BYTES    1000000
+
 int ref_len;
 uint8_t buf[1000];
 
@@ -415,6 +417,165 @@ static int test_hdlc_modes(void)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void stream_frame_handler(void *user_data, const uint8_t *pkt, int len, int ok)
+{
+    uint32_t *sum;
+    int i;
+
+    sum = (uint32_t *) user_data;
+    *sum = *sum*31 + len;
+    if (len < 0)
+        return;
+    *sum = *sum*31 + ok;
+    for (i = 0;  i < len;  i++)
+        *sum = *sum*31 + pkt[i];
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_hdlc_rx_bit_vs_byte(void)
+{
+    static uint8_t stream[STREAM_BYTES];
+    hdlc_rx_stats_t bit_stats;
+    hdlc_rx_stats_t byte_stats;
+    uint32_t bit_sum;
+    uint32_t byte_sum;
+    uint64_t bit_ticks;
+    uint64_t byte_ticks;
+    int i;
+    int j;
+
+    /* Feed the same bit stream to the receiver bit by bit, and in chunks of octets. The
+       chunked path destuffs a whole octet per table lookup, and must produce exactly
+       the same frames, status reports and statistics. */
+    printf("Testing bit by bit against chunk by chunk reception\n");
+    hdlc_tx_init(&tx, FALSE, 1, FALSE, underflow_handler, NULL);
+    underflow_reported = TRUE;
+    hdlc_tx_flags(&tx, 40);
+    for (i = 0;  i < STREAM_BYTES;  i++)
+    {
+        if (underflow_reported)
+        {
+            underflow_reported = FALSE;
+            ref_len = cook_up_msg(buf);
+            hdlc_tx_frame(&tx, buf, ref_len);
+            /* Sprinkle in some corrupt and aborted frames */
+            j = my_rand();
+            if ((j & 0x1F) == 0)
+                hdlc_tx_corrupt_frame(&tx);
+            else if ((j & 0x1F) == 1)
+                hdlc_tx_abort(&tx);
+        }
+        stream[i] = hdlc_tx_get_byte(&tx);
+    }
+
+    bit_sum = 0;
+    hdlc_rx_init(&rx, FALSE, TRUE, 5, stream_frame_handler, &bit_sum);
+    start = rdtscll();
+    for (i = 0;  i < STREAM_BYTES;  i++)
+    {
+        for (j = 7;  j >= 0;  j--)
+            hdlc_rx_put_bit(&rx, (stream[i] >> j) & 1);
+    }
+    end = rdtscll();
+    bit_ticks = end - start;
+    hdlc_rx_get_stats(&rx, &bit_stats);
+
+    byte_sum = 0;
+    hdlc_rx_init(&rx, FALSE, TRUE, 5, stream_frame_handler, &byte_sum);
+    start = rdtscll();
+    for (i = 0;  i < STREAM_BYTES;  i += 100)
+        hdlc_rx_put(&rx, &stream[i], 100);
+    end = rdtscll();
+    byte_ticks = end - start;
+    hdlc_rx_get_stats(&rx, &byte_stats);
+
+    printf("%lu good frames, %lu CRC errors, %lu length errors, %lu aborts\n",
+           byte_stats.good_frames,
+           byte_stats.crc_errors,
+           byte_stats.length_errors,
+           byte_stats.aborts);
+    printf("Bit by bit %" PRIu64 " ticks, chunk by chunk %" PRIu64 " ticks\n", bit_ticks, byte_ticks);
+    if (byte_sum != bit_sum
+        ||
+        byte_stats.bytes != bit_stats.bytes
+        ||
+        byte_stats.good_frames != bit_stats.good_frames
+        ||
+        byte_stats.crc_errors != bit_stats.crc_errors
+        ||
+        byte_stats.length_errors != bit_stats.length_errors
+        ||
+        byte_stats.aborts != bit_stats.aborts
+        ||
+        byte_stats.good_frames == 0)
+    {
+        printf("Chunk by chunk reception does not match bit by bit reception.\n");
+        return -1;
+    }
+    printf("Test passed.\n\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void stream_underflow_handler(void *user_data)
+{
+    int *frames;
+    int i;
+
+    /* Keep the transmitter fed with a fresh frame each time it runs dry. The frame
+       contents only depend on the frame count, so each run sends the same frames. */
+    frames = (int *) user_data;
+    ref_len = (*frames & 0x3F) + 100;
+    for (i = 0;  i < ref_len;  i++)
+        buf[i] = (i & 0x04)  ?  0xFF  :  (uint8_t) (*frames*31 + i*7);
+    hdlc_tx_frame(&tx, buf, ref_len);
+    (*frames)++;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int test_hdlc_tx_byte_vs_chunk(void)
+{
+    static uint8_t byte_stream[STREAM_BYTES];
+    static uint8_t chunk_stream[STREAM_BYTES];
+    uint64_t byte_ticks;
+    uint64_t chunk_ticks;
+    int byte_frames;
+    int chunk_frames;
+    int i;
+
+    /* Generate the same frames byte by byte, and in chunks of octets. The chunked path
+       stuffs several octets at a time, and must produce exactly the same bit stream. */
+    printf("Testing byte by byte against chunk by chunk transmission\n");
+    byte_frames = 0;
+    hdlc_tx_init(&tx, FALSE, 1, FALSE, stream_underflow_handler, &byte_frames);
+    hdlc_tx_flags(&tx, 40);
+    start = rdtscll();
+    for (i = 0;  i < STREAM_BYTES;  i++)
+        byte_stream[i] = hdlc_tx_get_byte(&tx);
+    end = rdtscll();
+    byte_ticks = end - start;
+
+    chunk_frames = 0;
+    hdlc_tx_init(&tx, FALSE, 1, FALSE, stream_underflow_handler, &chunk_frames);
+    hdlc_tx_flags(&tx, 40);
+    start = rdtscll();
+    for (i = 0;  i < STREAM_BYTES;  i += 100)
+        hdlc_tx_get(&tx, &chunk_stream[i], 100);
+    end = rdtscll();
+    chunk_ticks = end - start;
+
+    printf("%d frames sent\n", chunk_frames);
+    printf("Byte by byte %" PRIu64 " ticks, chunk by chunk %" PRIu64 " ticks\n", byte_ticks, chunk_ticks);
+    if (chunk_frames != byte_frames  ||  memcmp(byte_stream, chunk_stream, STREAM_BYTES))
+    {
+        printf("Chunk by chunk transmission does not match byte by byte transmission.\n");
+        return -1;
+    }
+    printf("Test passed.\n\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int test_hdlc_frame_length_error_handling(void)
 {
     int i;
@@ -760,6 +921,16 @@ static void hdlc_tests(void)
         printf("Tests failed\n");
         exit(2);
     }
+    if (test_hdlc_rx_bit_vs_byte())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    if (test_hdlc_tx_byte_vs_chunk())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
     if (test_hdlc_frame_length_error_handling())
     {
         printf("Tests failed\n");
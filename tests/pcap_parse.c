@@ -51,7 +51,6 @@
 #include <netinet/udp.h>
 #include <time.h>
 
-#include "udptl.h"
 #include "spandsp.h"
 #include "pcap_parse.h"
 
@@ -633,6 +633,24 @@ then
     echo t38_terminal_to_gateway_tests -e failed!
     exit $RETVAL
 fi
+# Move the call to new contexts part way through each page, first without ECM, then with ECM. The test
+# checks the pages received match those from a call which is not moved.
+rm -f t38.tif t38_reference.tif
+./t38_terminal_to_gateway_tests -c >$STDOUT_DEST 2>$STDERR_DEST
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo t38_terminal_to_gateway_tests -c failed!
+    exit $RETVAL
+fi
+rm -f t38.tif t38_reference.tif
+./t38_terminal_to_gateway_tests -c -e >$STDOUT_DEST 2>$STDERR_DEST
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo t38_terminal_to_gateway_tests -c -e failed!
+    exit $RETVAL
+fi
 echo t38_terminal_to_gateway_tests completed OK
 
 rm -f t38.tif
@@ -701,16 +719,14 @@ echo t4_tests completed OK
 #echo t81_t82_arith_coding_tests completed OK
 echo t81_t82_arith_coding_tests not enabled
 
-#rm -f t85_tests_receive.tif
-#./t4_tests >$STDOUT_DEST 2>$STDERR_DEST
-#RETVAL=$?
-#if [ $RETVAL != 0 ]
-#then
-#    echo t85_tests failed!
-#    exit $RETVAL
-#fi
-#echo t85_tests completed OK
-echo t85_tests not enabled
+./t85_tests >$STDOUT_DEST 2>$STDERR_DEST
+RETVAL=$?
+if [ $RETVAL != 0 ]
+then
+    echo t85_tests failed!
+    exit $RETVAL
+fi
+echo t85_tests completed OK
 
 #./time_scale_tests >$STDOUT_DEST 2>$STDERR_DEST
 #RETVAL=$?
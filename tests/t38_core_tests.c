@@ -66,6 +66,12 @@ int skip;
 uint8_t field_body[MAX_FIELDS][MAX_FIELD_LEN];
 int field_len[MAX_FIELDS];
 
+int batch_calls;
+int batch_datagrams;
+int batch_offsets[100];
+int reordered_indicators[20];
+int reordered_count;
+
 static int rx_missing_handler(t38_core_state_t *s, void *user_data, int rx_seq_no, int expected_seq_no)
 {
     missing_packets++;
@@ -232,6 +238,160 @@ static int encode_decode_tests(t38_core_state_t *a, t38_core_state_t *b)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int tx_packet_batch_handler(t38_core_state_t *s, void *user_data, const t38_tx_datagram_t datagrams[], int count)
+{
+    t38_core_state_t *t;
+    int i;
+
+    t = (t38_core_state_t *) user_data;
+    batch_calls++;
+    for (i = 0;  i < count;  i++)
+    {
+        span_log(&s->logging, SPAN_LOG_FLOW, "Send seq %d, len %d, offset %d\n", datagrams[i].seq_no, datagrams[i].len, datagrams[i].offset);
+        /* The datagrams must come in the order they are to be sent */
+        if (i > 0  &&  datagrams[i].offset < datagrams[i - 1].offset)
+            succeeded = FALSE;
+        batch_offsets[batch_datagrams++] = datagrams[i].offset;
+        if (t38_core_rx_ifp_packet(t, datagrams[i].buf, datagrams[i].len, datagrams[i].seq_no) < 0)
+            succeeded = FALSE;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int batch_tests(t38_core_state_t *a, t38_core_state_t *b)
+{
+    static const int expected_offsets[9] =
+    {
+        0, 0, 0, 100, 100, 100, 40, 40, 40
+    };
+    int i;
+
+    /* Send three indicators, each repeated three times at 100 sample intervals, and check
+       they come out in two batches of the right shape, as 160 sample ticks pass. Start the
+       schedule's clock just short of wrapping around, so the wrap is crossed on the way. */
+    t38_core_set_tx_packet_batch_handler(a, tx_packet_batch_handler, b, 100);
+    a->tx_schedule_samples = 0xFFFFFF00;
+    t38_set_redundancy_control(a, T38_PACKET_CATEGORY_INDICATOR, 3);
+    batch_calls = 0;
+    batch_datagrams = 0;
+    ok_indicator_packets = 0;
+    bad_indicator_packets = 0;
+    for (i = 0;  i < 3;  i++)
+    {
+        current_indicator = T38_IND_CNG + i;
+        t38_core_send_indicator(a, current_indicator);
+    }
+    if (batch_calls != 0)
+    {
+        printf("Batch sent before its tick\n");
+        return -1;
+    }
+    for (i = 0;  i < 4;  i++)
+        t38_core_send_scheduled(a, 160);
+    printf("Batches = %d, datagrams = %d\n", batch_calls, batch_datagrams);
+    if (batch_calls != 2  ||  batch_datagrams != 9)
+        return -1;
+    for (i = 0;  i < 9;  i++)
+    {
+        if (batch_offsets[i] != expected_offsets[i])
+        {
+            printf("Datagram %d has offset %d\n", i, batch_offsets[i]);
+            return -1;
+        }
+    }
+    /* The repeats must have been recognised, and ignored, by the receiver */
+    if (ok_indicator_packets + bad_indicator_packets > 3)
+        return -1;
+    t38_core_set_tx_packet_batch_handler(a, NULL, NULL, 0);
+    t38_set_redundancy_control(a, T38_PACKET_CATEGORY_INDICATOR, 1);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int reorder_indicator_handler(t38_core_state_t *s, void *user_data, int indicator)
+{
+    if (reordered_count < 20)
+        reordered_indicators[reordered_count] = indicator;
+    reordered_count++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int reorder_tests(void)
+{
+    /* Packets 3 and 7 arrive late, but within the hold time. Packet 11 never arrives. */
+    static const int arrival_order[13] =
+    {
+        0, 1, 2, 4, 3, 5, 6, 8, 9, 7, 10, 12, 13
+    };
+    t38_core_state_t *s;
+    uint8_t buf[1];
+    int seq_no;
+    int i;
+
+    if ((s = t38_core_init(NULL,
+                           reorder_indicator_handler,
+                           rx_data_handler,
+                           rx_missing_handler,
+                           NULL,
+                           tx_packet_handler,
+                           NULL)) == NULL)
+    {
+        return -1;
+    }
+    span_log_set_level(&s->logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG);
+    span_log_set_tag(&s->logging, "T.38-R");
+    t38_set_rx_reorder_hold_time(s, 400);
+    /* Start the clock just short of wrapping around, so the wrap is crossed while packets
+       are held */
+    s->rx_reorder_samples = 0xFFFFFC00;
+    missing_packets = 0;
+    reordered_count = 0;
+    for (i = 0;  i < 13;  i++)
+    {
+        /* Each packet carries an indicator equal to its sequence number, so the order of
+           delivery can be checked. */
+        seq_no = arrival_order[i];
+        buf[0] = (uint8_t) (seq_no << 1);
+        t38_core_rx_ifp_packet(s, buf, 1, (uint16_t) seq_no);
+        /* A repeat of a held packet should be ignored */
+        t38_core_rx_ifp_packet(s, buf, 1, (uint16_t) seq_no);
+        t38_core_timer_update(s, 160);
+    }
+    /* Packets 12 and 13 should still be held, waiting for 11 */
+    if (reordered_count != 11  ||  missing_packets != 0)
+    {
+        printf("Reordering failed - %d delivered, %d missing\n", reordered_count, missing_packets);
+        return -1;
+    }
+    for (i = 0;  i < 3;  i++)
+        t38_core_timer_update(s, 160);
+    printf("Delivered %d, missing %d\n", reordered_count, missing_packets);
+    if (reordered_count != 13  ||  missing_packets != 1)
+        return -1;
+    for (i = 0;  i < 13;  i++)
+    {
+        if (reordered_indicators[i] != ((i < 11)  ?  i  :  i + 1))
+        {
+            printf("Packet %d delivered out of order\n", i);
+            return -1;
+        }
+    }
+    /* Without reordering, the late packet should be treated as missing */
+    t38_set_rx_reorder_hold_time(s, 0);
+    for (i = 15;  i >= 14;  i--)
+    {
+        buf[0] = (uint8_t) (i << 1);
+        t38_core_rx_ifp_packet(s, buf, 1, (uint16_t) i);
+    }
+    if (reordered_count != 14  ||  missing_packets != 2)
+        return -1;
+    t38_core_free(s);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
 static int attack_tests(t38_core_state_t *s)
 {
     return 0;
@@ -283,6 +443,16 @@ int main(int argc, char *argv[])
             printf("Encode/decode tests failed\n");
             exit(2);
         }
+        if (batch_tests(&t38_core_a, &t38_core_b))
+        {
+            printf("Batched transmission tests failed\n");
+            exit(2);
+        }
+        if (reorder_tests())
+        {
+            printf("Reordering tests failed\n");
+            exit(2);
+        }
         if (attack_tests(&t38_core_a))
         {
             printf("Attack tests failed\n");
@@ -87,6 +87,8 @@ int succeeded[2] = {FALSE, FALSE};
 
 int simulate_incrementing_repeats = FALSE;
 
+int packets_sent[2] = {0, 0};
+
 static int phase_b_handler(t30_state_t *s, void *user_data, int result)
 {
     int i;
@@ -168,6 +170,7 @@ static int tx_packet_handler_a(t38_core_state_t *s, void *user_data, const uint8
             g1050_put(path_a_to_b, buf, len, subst_seq, when);
             subst_seq = (subst_seq + 1) & 0xFFFF;
         }
+        packets_sent[0] += count;
     }
     else
     {
@@ -175,6 +178,7 @@ static int tx_packet_handler_a(t38_core_state_t *s, void *user_data, const uint8
 
         for (i = 0;  i < count;  i++)
             g1050_put(path_a_to_b, buf, len, s->tx_seq_no, when);
+        packets_sent[0] += count;
     }
     return 0;
 }
@@ -197,6 +201,7 @@ static int tx_packet_handler_b(t38_core_state_t *s, void *user_data, const uint8
             g1050_put(path_b_to_a, buf, len, subst_seq, when);
             subst_seq = (subst_seq + 1) & 0xFFFF;
         }
+        packets_sent[1] += count;
     }
     else
     {
@@ -204,6 +209,7 @@ static int tx_packet_handler_b(t38_core_state_t *s, void *user_data, const uint8
 
         for (i = 0;  i < count;  i++)
             g1050_put(path_b_to_a, buf, len, s->tx_seq_no, when);
+        packets_sent[1] += count;
     }
     return 0;
 }
@@ -247,6 +253,7 @@ int main(int argc, char *argv[])
     int opt;
     int drop_frame;
     int drop_frame_rate;
+    int adaptive_packetisation;
     t38_stats_t stats;
     fax_state_t *fax;
     t30_state_t *t30;
@@ -269,10 +276,14 @@ int main(int argc, char *argv[])
     supported_modems = T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17;
     drop_frame = 0;
     drop_frame_rate = 0;
-    while ((opt = getopt(argc, argv, "D:efFgi:Ilm:M:s:tv:")) != -1)
+    adaptive_packetisation = FALSE;
+    while ((opt = getopt(argc, argv, "aD:efFgi:Ilm:M:s:tv:")) != -1)
     {
         switch (opt)
         {
+        case 'a':
+            adaptive_packetisation = TRUE;
+            break;
         case 'D':
             drop_frame_rate =
             drop_frame = atoi(optarg);
@@ -400,6 +411,15 @@ int main(int argc, char *argv[])
     t38_gateway_set_real_time_frame_handler(t38, real_time_frame_handler, NULL);
     t38_set_t38_version(t38_core, t38_version);
     t38_gateway_set_ecm_capability(t38, use_ecm);
+    if (adaptive_packetisation)
+    {
+        /* The G.1050 models have a modest delay, and we leave the loss to be measured. Our
+           own redundancy setting for image data should be the least adaptation uses, and
+           should come back when adaptation stops. */
+        t38_set_redundancy_control(t38_core, T38_PACKET_CATEGORY_IMAGE_DATA, 2);
+        t38_gateway_set_adaptive_packetisation(t38, TRUE);
+        t38_gateway_report_network_conditions(t38, 0, 50);
+    }
 
     logging = t38_gateway_get_logging_state(t38);
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
@@ -423,6 +443,12 @@ int main(int argc, char *argv[])
     t38_gateway_set_fill_bit_removal(t38, fill_removal);
     t38_set_t38_version(t38_core, t38_version);
     t38_gateway_set_ecm_capability(t38, use_ecm);
+    if (adaptive_packetisation)
+    {
+        /* The G.1050 models have a modest delay, and we leave the loss to be measured */
+        t38_gateway_set_adaptive_packetisation(t38, TRUE);
+        t38_gateway_report_network_conditions(t38, 0, 50);
+    }
 
     logging = t38_gateway_get_logging_state(t38);
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
@@ -643,6 +669,19 @@ int main(int argc, char *argv[])
            stats.pages_transferred,
            stats.bit_rate,
            (stats.error_correcting_mode)  ?  "ECM"  :  "non-ECM");
+    printf("A side sent %d packets, B side sent %d packets\n", packets_sent[0], packets_sent[1]);
+    if (adaptive_packetisation)
+    {
+        t38_gateway_set_adaptive_packetisation(t38_state_a, FALSE);
+        t38_core = t38_gateway_get_t38_core_state(t38_state_a);
+        if (t38_core->category_control[T38_PACKET_CATEGORY_CONTROL_DATA] != 1
+            ||
+            t38_core->category_control[T38_PACKET_CATEGORY_IMAGE_DATA] != 2)
+        {
+            printf("Redundancy settings were not restored\n");
+            succeeded[0] = FALSE;
+        }
+    }
     fax_release(fax_state_a);
     fax_release(fax_state_b);
     if (log_audio)
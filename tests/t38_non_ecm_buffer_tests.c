@@ -130,6 +130,99 @@ static int xxx(t38_non_ecm_buffer_state_t *s, logging_state_t *l, int log_bits,
 }
 /*- End of function --------------------------------------------------------*/
 
+static int get_octet_by_bits(t38_non_ecm_buffer_state_t *s)
+{
+    int i;
+    int bit;
+    int octet;
+
+    octet = 0;
+    for (i = 0;  i < 8;  i++)
+    {
+        if ((bit = t38_non_ecm_buffer_get_bit((void *) s)) < 0)
+            return bit;
+        octet = (octet << 1) | bit;
+    }
+    return octet;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int chunk_tests(int mode, int min_row_bits)
+{
+    t38_non_ecm_buffer_state_t bits;
+    t38_non_ecm_buffer_state_t bytes;
+    t38_non_ecm_buffer_state_t chunks;
+    uint8_t buf[48];
+    uint8_t chunk[64];
+    int total;
+    int len;
+    int want;
+    int octet;
+    int i;
+    int j;
+
+    /* Whatever mix of data and flow control fill comes out bit by bit should come out
+       identically byte by byte, and chunk by chunk. On average we take out a little
+       more than we put in, so the buffer never overflows. */
+    t38_non_ecm_buffer_init(&bits, mode, min_row_bits);
+    t38_non_ecm_buffer_init(&bytes, mode, min_row_bits);
+    t38_non_ecm_buffer_init(&chunks, mode, min_row_bits);
+    srand(1234);
+    total = 0;
+    for (i = 0;  i < 3000;  i++)
+    {
+        if (i < 2000)
+        {
+            /* Some image rows of assorted lengths, or some TCF, in assorted pieces */
+            len = 2 + rand()%(sizeof(buf) - 1);
+            for (j = 0;  j < len;  j++)
+                buf[j] = (mode)  ?  (rand() | 0x11)  :  ((i < 5)  ?  0xFF  :  0x00);
+            if (mode  &&  (rand() & 1))
+            {
+                /* End the piece with an EOL */
+                buf[len - 2] = 0x00;
+                buf[len - 1] = 0x01;
+            }
+            t38_non_ecm_buffer_inject(&bits, buf, len);
+            t38_non_ecm_buffer_inject(&bytes, buf, len);
+            t38_non_ecm_buffer_inject(&chunks, buf, len);
+        }
+        else if (i == 2000)
+        {
+            t38_non_ecm_buffer_push(&bits);
+            t38_non_ecm_buffer_push(&bytes);
+            t38_non_ecm_buffer_push(&chunks);
+        }
+        /* Sometimes take out more than went in, to force flow control fill */
+        want = 1 + rand()%sizeof(chunk);
+        len = t38_non_ecm_buffer_get_chunk((void *) &chunks, chunk, want);
+        for (j = 0;  j < want;  j++)
+        {
+            octet = get_octet_by_bits(&bits);
+            if (j >= len)
+            {
+                /* The chunk was short, so this must be the end of the data */
+                if (octet != SIG_STATUS_END_OF_DATA  ||  t38_non_ecm_buffer_get_byte((void *) &bytes) != SIG_STATUS_END_OF_DATA)
+                {
+                    printf("Tests failed - chunk ended early at octet %d\n", total);
+                    return -1;
+                }
+                printf("    %d octets matched\n", total);
+                return 0;
+            }
+            if (octet != chunk[j]  ||  t38_non_ecm_buffer_get_byte((void *) &bytes) != chunk[j])
+            {
+                printf("Tests failed - mismatch at octet %d\n", total);
+                return -1;
+            }
+            total++;
+        }
+    }
+    printf("Tests failed - the end of the data was not seen\n");
+    return -1;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     t38_non_ecm_buffer_state_t buffer;
@@ -698,6 +791,13 @@ int main(int argc, char *argv[])
     t38_non_ecm_buffer_report_input_status(&buffer, &logging);
     t38_non_ecm_buffer_report_output_status(&buffer, &logging);
 
+    printf("8 - Chunk and octet extraction match bit extraction, for image data\n");
+    if (chunk_tests(TRUE, 400))
+        exit(2);
+    printf("9 - Chunk and octet extraction match bit extraction, for TCF\n");
+    if (chunk_tests(FALSE, 0))
+        exit(2);
+
     printf("Tests passed\n");
     return  0;
 }
@@ -0,0 +1,563 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t38_replay_bench.c - Replay captured T.38 sessions through T.38 terminals or gateways,
+ *                      as fast as possible, to measure their capacity.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page t38_replay_bench_page T.38 replay benchmark
+\section t38_replay_bench_page_sec_1 What does it do?
+This tool replays the T.38 packets from one or more PCAP captures of real calls, as
+t38_decode does, but without pacing them in real time, and without any logging. Each
+capture is replayed into a receiving T.38 terminal, or into a T.38 gateway with a
+receiving FAX terminal on its audio side. The captures can be replayed many times, and
+the sessions can be spread across several threads. When all the sessions have finished,
+the tool reports the sessions and pages processed per second of elapsed time, the CPU
+time used per page, and the state of the shared buffer pools, so the capacity of a build
+can be checked against real field captures.
+
+\section t38_replay_bench_page_sec_2 How is it used?
+t38_replay_bench [-g] [-j threads] [-n repeats] [-v version] [-S addr] [-s port] [-D addr] [-d port] file.pcap ...
+
+The address and port options select the packets to be replayed, as for t38_decode.
+More than one thread may only be used when spandsp is built with thread support.
+
+Only one side of each call is replayed, and nothing is sent back to the far end.
+A gateway's audio side answers at the pace of real modems, so its exchanges can
+drift from the captured call. Some pages may then need to be renegotiated, and
+fewer pages may be received than the capture contains.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+#include <pthread.h>
+#endif
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "spandsp.h"
+
+#include "pcap_parse.h"
+
+#define INPUT_FILE_NAME         "t38.pcap"
+#define OUTPUT_FILE_NAME        "t38_replay_%d.tif"
+
+#define SAMPLES_PER_CHUNK       160
+
+#define MAX_THREADS             64
+
+/*! The time allowed, after the last packet in a capture, for a session to finish, in samples */
+#define FLUSH_SAMPLES           (60*SAMPLE_RATE)
+
+enum
+{
+    REPLAY_TERMINAL = 0,
+    REPLAY_GATEWAY
+};
+
+/*! A captured UDPTL packet */
+typedef struct
+{
+    /*! The time of the packet, in samples from the start of the capture */
+    int64_t when;
+    /*! The length of the packet */
+    int len;
+    /*! The offset of the packet in the capture's data buffer */
+    int offset;
+} captured_packet_t;
+
+/*! A capture, loaded into memory so it can be replayed without any file I/O */
+typedef struct
+{
+    const char *file_name;
+    captured_packet_t *packets;
+    int packet_count;
+    int packet_space;
+    uint8_t *data;
+    int data_len;
+    int data_space;
+    int64_t first_when;
+    int64_t current_when;
+} capture_t;
+
+/*! The state of one replayed session */
+typedef struct
+{
+    t38_terminal_state_t *terminal;
+    t38_gateway_state_t *gateway;
+    fax_state_t *fax;
+    t30_state_t *t30;
+    t38_core_state_t *t38_core;
+    udptl_state_t *udptl;
+    int finished;
+    int result;
+    int16_t gateway_amp[SAMPLES_PER_CHUNK];
+    int16_t fax_amp[SAMPLES_PER_CHUNK];
+} session_t;
+
+capture_t *captures;
+int capture_count;
+
+int replay_mode = REPLAY_TERMINAL;
+int t38_version = 1;
+int total_sessions;
+
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+pthread_mutex_t results_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+int next_session = 0;
+int completed_sessions = 0;
+int successful_sessions = 0;
+int total_pages = 0;
+int max_footprint = 0;
+
+static int capture_timing_update(void *user_data, struct timeval *ts)
+{
+    capture_t *cap;
+
+    cap = (capture_t *) user_data;
+    cap->current_when = ts->tv_sec*1000000LL + ts->tv_usec;
+    if (cap->first_when < 0)
+        cap->first_when = cap->current_when;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int capture_packet(void *user_data, const uint8_t *pkt, int len)
+{
+    capture_t *cap;
+    captured_packet_t *packets;
+    uint8_t *data;
+
+    cap = (capture_t *) user_data;
+    if (len <= 0)
+        return 0;
+    if (cap->packet_count >= cap->packet_space)
+    {
+        cap->packet_space = (cap->packet_space)  ?  2*cap->packet_space  :  1024;
+        if ((packets = (captured_packet_t *) realloc(cap->packets, cap->packet_space*sizeof(*packets))) == NULL)
+            return -1;
+        cap->packets = packets;
+    }
+    while (cap->data_len + len > cap->data_space)
+    {
+        cap->data_space = (cap->data_space)  ?  2*cap->data_space  :  65536;
+        if ((data = (uint8_t *) realloc(cap->data, cap->data_space)) == NULL)
+            return -1;
+        cap->data = data;
+    }
+    memcpy(cap->data + cap->data_len, pkt, len);
+    cap->packets[cap->packet_count].when = (cap->current_when - cap->first_when)/125LL;
+    cap->packets[cap->packet_count].len = len;
+    cap->packets[cap->packet_count].offset = cap->data_len;
+    cap->packet_count++;
+    cap->data_len += len;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int tx_packet_handler(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
+{
+    /* The replay is one sided, so anything we send is simply dropped */
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int ifp_handler(void *user_data, const uint8_t msg[], int len, int seq_no)
+{
+    session_t *s;
+
+    s = (session_t *) user_data;
+    t38_core_rx_ifp_packet(s->t38_core, msg, len, seq_no);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void phase_e_handler(t30_state_t *t, void *user_data, int result)
+{
+    session_t *s;
+
+    s = (session_t *) user_data;
+    s->result = result;
+    s->finished = TRUE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void configure_t30(session_t *s, int thread_no)
+{
+    char file_name[64];
+
+    snprintf(file_name, sizeof(file_name), OUTPUT_FILE_NAME, thread_no);
+    t30_set_supported_modems(s->t30, T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17);
+    t30_set_tx_ident(s->t30, "11111111");
+    t30_set_rx_file(s->t30, file_name, -1);
+    t30_set_phase_e_handler(s->t30, phase_e_handler, (void *) s);
+    t30_set_ecm_capability(s->t30, TRUE);
+    t30_set_supported_compressions(s->t30, T30_SUPPORT_T4_1D_COMPRESSION | T30_SUPPORT_T4_2D_COMPRESSION | T30_SUPPORT_T6_COMPRESSION | T30_SUPPORT_T85_COMPRESSION);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int start_session(session_t *s, int thread_no)
+{
+    memset(s, 0, sizeof(*s));
+    s->result = -1;
+    if (replay_mode == REPLAY_GATEWAY)
+    {
+        if ((s->gateway = t38_gateway_init(NULL, tx_packet_handler, NULL)) == NULL)
+            return -1;
+        s->t38_core = t38_gateway_get_t38_core_state(s->gateway);
+        t38_gateway_set_ecm_capability(s->gateway, TRUE);
+        if ((s->fax = fax_init(NULL, FALSE)) == NULL)
+            return -1;
+        s->t30 = fax_get_t30_state(s->fax);
+    }
+    else
+    {
+        if ((s->terminal = t38_terminal_init(NULL, FALSE, tx_packet_handler, NULL)) == NULL)
+            return -1;
+        s->t38_core = t38_terminal_get_t38_core_state(s->terminal);
+        s->t30 = t38_terminal_get_t30_state(s->terminal);
+    }
+    t38_set_t38_version(s->t38_core, t38_version);
+    configure_t30(s, thread_no);
+    if ((s->udptl = udptl_init(NULL, UDPTL_ERROR_CORRECTION_REDUNDANCY, 3, 3, ifp_handler, (void *) s)) == NULL)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int session_footprint(session_t *s)
+{
+    if (replay_mode == REPLAY_GATEWAY)
+        return t38_gateway_get_memory_footprint(s->gateway) + fax_get_memory_footprint(s->fax);
+    return t38_terminal_get_memory_footprint(s->terminal);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void end_session(session_t *s)
+{
+    udptl_free(s->udptl);
+    if (s->gateway)
+        t38_gateway_free(s->gateway);
+    if (s->fax)
+        fax_free(s->fax);
+    if (s->terminal)
+        t38_terminal_free(s->terminal);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int advance_session(session_t *s, int samples)
+{
+    int len;
+
+    if (replay_mode == REPLAY_TERMINAL)
+    {
+        if (t38_terminal_send_timeout(s->terminal, samples))
+            s->finished = TRUE;
+        return s->finished;
+    }
+    /* Pass the gateway's audio to the FAX terminal, and the FAX terminal's audio back */
+    len = t38_gateway_tx(s->gateway, s->gateway_amp, samples);
+    if (len < samples)
+        memset(s->gateway_amp + len, 0, (samples - len)*sizeof(int16_t));
+    fax_rx(s->fax, s->gateway_amp, samples);
+    len = fax_tx(s->fax, s->fax_amp, samples);
+    if (len < samples)
+        memset(s->fax_amp + len, 0, (samples - len)*sizeof(int16_t));
+    t38_gateway_rx(s->gateway, s->fax_amp, samples);
+    return s->finished;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int advance_session_to(session_t *s, int64_t *now, int64_t when)
+{
+    int samples;
+
+    while (*now < when)
+    {
+        samples = (when - *now > SAMPLES_PER_CHUNK)  ?  SAMPLES_PER_CHUNK  :  (int) (when - *now);
+        *now += samples;
+        if (advance_session(s, samples))
+            return TRUE;
+    }
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int replay_session(const capture_t *cap, int thread_no, int *pages, int *footprint)
+{
+    session_t s;
+    t30_stats_t stats;
+    int64_t now;
+    int i;
+
+    if (start_session(&s, thread_no))
+    {
+        fprintf(stderr, "Cannot start a session\n");
+        return -1;
+    }
+    now = 0;
+    for (i = 0;  i < cap->packet_count;  i++)
+    {
+        if (advance_session_to(&s, &now, cap->packets[i].when))
+            break;
+        udptl_rx_packet(s.udptl, cap->data + cap->packets[i].offset, cap->packets[i].len);
+    }
+    /* Push the time along, to flush out any remaining activity */
+    if (!s.finished)
+        advance_session_to(&s, &now, now + FLUSH_SAMPLES);
+    t30_get_transfer_statistics(s.t30, &stats);
+    *pages = stats.pages_rx;
+    *footprint = session_footprint(&s);
+    end_session(&s);
+    return (s.result == T30_ERR_OK)  ?  0  :  -1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void *replay_thread(void *user_data)
+{
+    int thread_no;
+    int session_no;
+    int pages;
+    int footprint;
+    int res;
+
+    thread_no = (int) (intptr_t) user_data;
+    for (;;)
+    {
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+        pthread_mutex_lock(&results_mutex);
+#endif
+        session_no = next_session++;
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+        pthread_mutex_unlock(&results_mutex);
+#endif
+        if (session_no >= total_sessions)
+            break;
+        res = replay_session(&captures[session_no%capture_count], thread_no, &pages, &footprint);
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+        pthread_mutex_lock(&results_mutex);
+#endif
+        completed_sessions++;
+        if (res == 0)
+            successful_sessions++;
+        total_pages += pages;
+        if (footprint > max_footprint)
+            max_footprint = footprint;
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+        pthread_mutex_unlock(&results_mutex);
+#endif
+    }
+    return NULL;
+}
+/*- End of function --------------------------------------------------------*/
+
+static double cpu_seconds(void)
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec/1000000.0
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static double wall_seconds(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec/1000000.0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+    pthread_t threads[MAX_THREADS];
+#endif
+    t30_ecm_pool_stats_t ecm_pool_stats;
+    t4_page_buffer_pool_stats_t page_pool_stats;
+    double start_wall;
+    double start_cpu;
+    double elapsed;
+    double cpu;
+    int thread_count;
+    int repeats;
+    int opt;
+    int i;
+    uint32_t src_addr;
+    uint16_t src_port;
+    uint32_t dest_addr;
+    uint16_t dest_port;
+
+    thread_count = 1;
+    repeats = 1;
+    src_addr = 0;
+    src_port = 0;
+    dest_addr = 0;
+    dest_port = 0;
+    while ((opt = getopt(argc, argv, "D:d:gj:n:S:s:v:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'D':
+            dest_addr = atoi(optarg);
+            break;
+        case 'd':
+            dest_port = atoi(optarg);
+            break;
+        case 'g':
+            replay_mode = REPLAY_GATEWAY;
+            break;
+        case 'j':
+            thread_count = atoi(optarg);
+            if (thread_count < 1  ||  thread_count > MAX_THREADS)
+            {
+                fprintf(stderr, "Thread count must be between 1 and %d\n", MAX_THREADS);
+                exit(2);
+            }
+#if !defined(HAVE_PTHREAD_H)  ||  !defined(HAVE_LIBPTHREAD)
+            /* Without thread support nothing is locked, so the sessions must run one at a time */
+            if (thread_count > 1)
+            {
+                fprintf(stderr, "This build has no thread support, so only one thread may be used\n");
+                exit(2);
+            }
+#endif
+            break;
+        case 'n':
+            repeats = atoi(optarg);
+            break;
+        case 'S':
+            src_addr = atoi(optarg);
+            break;
+        case 's':
+            src_port = atoi(optarg);
+            break;
+        case 'v':
+            t38_version = atoi(optarg);
+            break;
+        default:
+            //usage();
+            exit(2);
+            break;
+        }
+    }
+
+    /* Load all the captures before the clock starts, so the replay involves no file I/O */
+    capture_count = (optind < argc)  ?  (argc - optind)  :  1;
+    if ((captures = (capture_t *) calloc(capture_count, sizeof(*captures))) == NULL)
+    {
+        fprintf(stderr, "Cannot allocate memory for the captures\n");
+        exit(2);
+    }
+    for (i = 0;  i < capture_count;  i++)
+    {
+        captures[i].file_name = (optind < argc)  ?  argv[optind + i]  :  INPUT_FILE_NAME;
+        captures[i].first_when = -1;
+        if (pcap_scan_pkts(captures[i].file_name,
+                           src_addr,
+                           src_port,
+                           dest_addr,
+                           dest_port,
+                           capture_timing_update,
+                           capture_packet,
+                           &captures[i]))
+        {
+            exit(2);
+        }
+        printf("%s: %d packets, %.1fs\n",
+               captures[i].file_name,
+               captures[i].packet_count,
+               (captures[i].packet_count)  ?  captures[i].packets[captures[i].packet_count - 1].when/(double) SAMPLE_RATE  :  0.0);
+    }
+    total_sessions = capture_count*repeats;
+
+    start_wall = wall_seconds();
+    start_cpu = cpu_seconds();
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+    for (i = 0;  i < thread_count;  i++)
+    {
+        if (pthread_create(&threads[i], NULL, replay_thread, (void *) (intptr_t) i))
+        {
+            fprintf(stderr, "Failed to create thread\n");
+            exit(2);
+        }
+    }
+    for (i = 0;  i < thread_count;  i++)
+        pthread_join(threads[i], NULL);
+#else
+    replay_thread((void *) (intptr_t) 0);
+#endif
+    elapsed = wall_seconds() - start_wall;
+    cpu = cpu_seconds() - start_cpu;
+
+    printf("Replayed %d sessions through %s, in %d threads\n",
+           completed_sessions,
+           (replay_mode == REPLAY_GATEWAY)  ?  "T.38 gateways"  :  "T.38 terminals",
+           thread_count);
+    printf("%d sessions ended normally, %d pages received\n", successful_sessions, total_pages);
+    printf("Elapsed time %.3fs - %.1f sessions/s, %.1f pages/s\n",
+           elapsed,
+           (elapsed > 0.0)  ?  completed_sessions/elapsed  :  0.0,
+           (elapsed > 0.0)  ?  total_pages/elapsed  :  0.0);
+    printf("CPU time %.3fs - %.2fms per session, %.2fms per page\n",
+           cpu,
+           (completed_sessions)  ?  1000.0*cpu/completed_sessions  :  0.0,
+           (total_pages)  ?  1000.0*cpu/total_pages  :  0.0);
+    printf("Largest session footprint %d bytes\n", max_footprint);
+    t30_ecm_pool_get_stats(&ecm_pool_stats);
+    printf("ECM buffer pool - %d buffers of %d bytes allocated, peak %d in use, %d still in use\n",
+           ecm_pool_stats.buffers_allocated,
+           ecm_pool_stats.buffer_size,
+           ecm_pool_stats.peak_buffers_in_use,
+           ecm_pool_stats.buffers_in_use);
+    t4_page_buffer_pool_get_stats(&page_pool_stats);
+    printf("Page buffer pool - %d chunks of %d bytes allocated, peak %d in use, %d still in use, %d requests failed\n",
+           page_pool_stats.chunks_allocated,
+           page_pool_stats.chunk_size,
+           page_pool_stats.peak_chunks_in_use,
+           page_pool_stats.chunks_in_use,
+           page_pool_stats.failed_requests);
+    for (i = 0;  i < capture_count;  i++)
+    {
+        free(captures[i].packets);
+        free(captures[i].data);
+    }
+    free(captures);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -89,6 +89,12 @@ int succeeded[2] = {FALSE, FALSE};
 
 int simulate_incrementing_repeats = FALSE;
 
+int event_driven = FALSE;
+int pending_samples[2] = {0, 0};
+int next_action[2] = {0, 0};
+int wakeups = 0;
+int ticks = 0;
+
 static int phase_b_handler(t30_state_t *s, void *user_data, int result)
 {
     if(enableLog) {
@@ -135,6 +141,7 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
         log_transfer_statistics(s, tag);
         log_tx_parameters(s, tag);
         log_rx_parameters(s, tag);
+        log_timing_statistics(s, tag);
         t30_get_transfer_statistics(s, &t);
         succeeded[i - 'A'] = (result == T30_ERR_OK);//  &&  (t.pages_tx == 12  ||  t.pages_rx == 12);
     }
@@ -235,6 +242,24 @@ static int tx_packet_handler_b(t38_core_state_t *s, void *user_data, const uint8
 }
 /*- End of function --------------------------------------------------------*/
 
+static int wake_terminal(t38_terminal_state_t *s, int i)
+{
+    int finished;
+
+    /* Report all the time which has passed since the terminal was last woken, and then deal
+       with anything else which has become due. */
+    finished = t38_terminal_send_timeout(s, pending_samples[i]);
+    pending_samples[i] = 0;
+    wakeups++;
+    while (!finished  &&  (next_action[i] = t38_terminal_time_to_next_action(s)) == 0)
+    {
+        finished = t38_terminal_send_timeout(s, 0);
+        wakeups++;
+    }
+    return finished;
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     int msg_len;
@@ -255,6 +280,7 @@ int main(int argc, char *argv[])
     t30_state_t *t30;
     t38_core_state_t *t38_core;
     logging_state_t *logging;
+    t30_ecm_pool_stats_t ecm_pool_stats;
 
     const char *pipe_name;
 
@@ -269,7 +295,7 @@ int main(int argc, char *argv[])
     g1050_speed_pattern_no = 1;
     use_gui = FALSE;
     supported_modems = T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17;
-    while ((opt = getopt(argc, argv, "befgi:Im:M:oOs:P:tv:L")) != -1)
+    while ((opt = getopt(argc, argv, "befgi:Im:M:oOs:P:tv:Lw")) != -1)
     {
         switch (opt)
         {
@@ -328,6 +354,9 @@ int main(int argc, char *argv[])
         case 'v':
             t38_version = atoi(optarg);
             break;
+        case 'w':
+            event_driven = TRUE;
+            break;
         default:
             //usage();
             exit(2);
@@ -444,8 +473,23 @@ int main(int argc, char *argv[])
             logging = t30_get_logging_state(t30);
             span_log_bump_samples(logging, SAMPLES_PER_CHUNK);
 
-            done[0] = t38_terminal_send_timeout(t38_state_a, SAMPLES_PER_CHUNK);
-            done[1] = t38_terminal_send_timeout(t38_state_b, SAMPLES_PER_CHUNK);
+            if (event_driven)
+            {
+                /* Only wake each terminal when it has something to do */
+                pending_samples[0] += SAMPLES_PER_CHUNK;
+                if (!done[0]  &&  next_action[0] >= 0  &&  pending_samples[0] >= next_action[0])
+                    done[0] = wake_terminal(t38_state_a, 0);
+                pending_samples[1] += SAMPLES_PER_CHUNK;
+                if (!done[1]  &&  next_action[1] >= 0  &&  pending_samples[1] >= next_action[1])
+                    done[1] = wake_terminal(t38_state_b, 1);
+            }
+            else
+            {
+                done[0] = t38_terminal_send_timeout(t38_state_a, SAMPLES_PER_CHUNK);
+                done[1] = t38_terminal_send_timeout(t38_state_b, SAMPLES_PER_CHUNK);
+                wakeups += 2;
+            }
+            ticks += 2;
 
             when += (float) SAMPLES_PER_CHUNK/(float) SAMPLE_RATE;
 
@@ -455,8 +499,14 @@ int main(int argc, char *argv[])
                 if (use_gui)
                     media_monitor_rx(seq_no, tx_when, rx_when);
     #endif
+                /* Bring the terminal's clock up to date before it sees the packet */
+                if (event_driven  &&  !done[1]  &&  pending_samples[1])
+                    done[1] = wake_terminal(t38_state_b, 1);
                 t38_core = t38_terminal_get_t38_core_state(t38_state_b);
                 t38_core_rx_ifp_packet(t38_core, msg, msg_len, seq_no);
+                /* The packet may have given the terminal something to do */
+                if (event_driven  &&  !done[1])
+                    done[1] = wake_terminal(t38_state_b, 1);
             }
             while ((msg_len = g1050_get(path_b_to_a, msg, 1024, when, &seq_no, &tx_when, &rx_when)) >= 0)
             {
@@ -464,8 +514,14 @@ int main(int argc, char *argv[])
                 if (use_gui)
                     media_monitor_rx(seq_no, tx_when, rx_when);
     #endif
+                /* Bring the terminal's clock up to date before it sees the packet */
+                if (event_driven  &&  !done[0]  &&  pending_samples[0])
+                    done[0] = wake_terminal(t38_state_a, 0);
                 t38_core = t38_terminal_get_t38_core_state(t38_state_a);
                 t38_core_rx_ifp_packet(t38_core, msg, msg_len, seq_no);
+                /* The packet may have given the terminal something to do */
+                if (event_driven  &&  !done[0])
+                    done[0] = wake_terminal(t38_state_a, 0);
             }
             if (done[0]  &&  done[1])
                 break;
@@ -474,6 +530,7 @@ int main(int argc, char *argv[])
                 media_monitor_update_display();
     #endif
         }
+        printf("Terminals woken %d times, in %d ticks\n", wakeups, ticks);
         t38_terminal_release(t38_state_a);
         t38_terminal_release(t38_state_b);
         if (!succeeded[0]  ||  !succeeded[1])
@@ -481,6 +538,17 @@ int main(int argc, char *argv[])
             printf("Tests failed\n");
             exit(2);
         }
+        /* Every ECM buffer should be back in the pool, once the calls are over */
+        t30_ecm_pool_get_stats(&ecm_pool_stats);
+        printf("ECM buffer pool - %d allocated, peak %d in use\n",
+               ecm_pool_stats.buffers_allocated,
+               ecm_pool_stats.peak_buffers_in_use);
+        if (ecm_pool_stats.buffers_in_use)
+        {
+            printf("%d ECM buffers still in use\n", ecm_pool_stats.buffers_in_use);
+            printf("Tests failed\n");
+            exit(2);
+        }
         printf("Tests passed\n");
     }
 
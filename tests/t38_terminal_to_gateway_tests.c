@@ -30,6 +30,12 @@
 These tests exercise the path
 
     T.38 termination -> T.38 gateway -> FAX machine
+
+With the -c option, all three contexts are checkpointed part way through every
+page, and the call is carried on by fresh contexts restored from the checkpoints.
+Use it with and without -e, to cover checkpoints taken during ECM and non-ECM
+pages. The call is first made without any checkpoints, and the document received
+then must match the one received when the call is moved.
 */
 
 /* Enable the following definition to enable direct probing into the FAX structures */
@@ -70,6 +76,7 @@ These tests exercise the path
 
 #define INPUT_FILE_NAME         "../test-data/itu/fax/itutests.tif"
 #define OUTPUT_FILE_NAME        "t38.tif"
+#define REFERENCE_FILE_NAME     "t38_reference.tif"
 #define OUTPUT_FILE_NAME_WAVE   "t38_terminal_to_gateway.wav"
 
 t38_terminal_state_t *t38_state_a;
@@ -79,13 +86,31 @@ fax_state_t *fax_state_b;
 g1050_state_t *path_a_to_b;
 g1050_state_t *path_b_to_a;
 
-double when = 0.0;
+double when;
 
-int done[2] = {FALSE, FALSE};
-int succeeded[2] = {FALSE, FALSE};
+int done[2];
+int succeeded[2];
 
 int simulate_incrementing_repeats = FALSE;
 
+int t38_version;
+int use_ecm;
+int use_tep;
+int use_transmit_on_idle;
+int supported_modems;
+const char *input_file_name;
+
+const char *output_file_name;
+int g1050_model_no;
+int g1050_speed_pattern_no;
+SNDFILE *wave_handle;
+int feedback_audio;
+int use_gui;
+
+int use_checkpoints = FALSE;
+int checkpoint_countdown;
+int checkpoints_taken;
+
 static int phase_b_handler(t30_state_t *s, void *user_data, int result)
 {
     int i;
@@ -132,6 +157,23 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
 }
 /*- End of function --------------------------------------------------------*/
 
+static void timing_handler(t30_state_t *s, void *user_data, int event, int when, int value)
+{
+    /* Move the call to new contexts a few seconds into each page. The move is called
+       off if the page ends first, so every checkpoint catches a page part way through. */
+    switch (event)
+    {
+    case T30_TIMING_PAGE_START:
+        if (use_checkpoints)
+            checkpoint_countdown = 150;
+        break;
+    case T30_TIMING_PAGE_END:
+        checkpoint_countdown = -1;
+        break;
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 static int tx_packet_handler_a(t38_core_state_t *s, void *user_data, const uint8_t *buf, int len, int count)
 {
     t38_terminal_state_t *t;
@@ -190,134 +232,23 @@ static int tx_packet_handler_b(t38_core_state_t *s, void *user_data, const uint8
 }
 /*- End of function --------------------------------------------------------*/
 
-int main(int argc, char *argv[])
+static t38_terminal_state_t *start_t38_terminal_a(void)
 {
-    int16_t t38_amp_b[SAMPLES_PER_CHUNK];
-    int16_t t30_amp_b[SAMPLES_PER_CHUNK];
-    int16_t out_amp[2*SAMPLES_PER_CHUNK];
-    int t38_len_b;
-    int t30_len_b;
-    int msg_len;
-    uint8_t msg[1024];
-    int log_audio;
-    int outframes;
-    SNDFILE *wave_handle;
-    int t38_version;
-    int use_ecm;
-    int use_tep;
-    int feedback_audio;
-    int use_transmit_on_idle;
-    const char *input_file_name;
-    int i;
-    int seq_no;
-    int g1050_model_no;
-    int g1050_speed_pattern_no;
-    double tx_when;
-    double rx_when;
-    int use_gui;
-    int supported_modems;
-    int opt;
+    t38_terminal_state_t *s;
     t30_state_t *t30;
     t38_core_state_t *t38_core;
     logging_state_t *logging;
 
-    log_audio = FALSE;
-    t38_version = 1;
-    use_ecm = FALSE;
-    input_file_name = INPUT_FILE_NAME;
-    simulate_incrementing_repeats = FALSE;
-    g1050_model_no = 0;
-    g1050_speed_pattern_no = 1;
-    use_gui = FALSE;
-    use_tep = FALSE;
-    feedback_audio = FALSE;
-    use_transmit_on_idle = TRUE;
-    supported_modems = T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17;
-    while ((opt = getopt(argc, argv, "efgi:Ilm:M:s:tv:")) != -1)
-    {
-        switch (opt)
-        {
-        case 'e':
-            use_ecm = TRUE;
-            break;
-        case 'f':
-            feedback_audio = TRUE;
-            break;
-        case 'g':
-#if defined(ENABLE_GUI)
-            use_gui = TRUE;
-#else
-            fprintf(stderr, "Graphical monitoring not available\n");
-            exit(2);
-#endif
-            break;
-        case 'i':
-            input_file_name = optarg;
-            break;
-        case 'I':
-            simulate_incrementing_repeats = TRUE;
-            break;
-        case 'l':
-            log_audio = TRUE;
-            break;
-        case 'm':
-            supported_modems = atoi(optarg);
-            break;
-        case 'M':
-            g1050_model_no = optarg[0] - 'A' + 1;
-            break;
-        case 's':
-            g1050_speed_pattern_no = atoi(optarg);
-            break;
-        case 't':
-            use_tep = TRUE;
-            break;
-        case 'v':
-            t38_version = atoi(optarg);
-            break;
-        default:
-            //usage();
-            exit(2);
-            break;
-        }
-    }
-
-    printf("Using T.38 version %d\n", t38_version);
-    if (use_ecm)
-        printf("Using ECM\n");
-
-    wave_handle = NULL;
-    if (log_audio)
-    {
-        if ((wave_handle = sf_open_telephony_write(OUTPUT_FILE_NAME_WAVE, 2)) == NULL)
-        {
-            fprintf(stderr, "    Cannot create audio file '%s'\n", OUTPUT_FILE_NAME_WAVE);
-            exit(2);
-        }
-    }
-
-    srand48(0x1234567);
-    if ((path_a_to_b = g1050_init(g1050_model_no, g1050_speed_pattern_no, 100, 33)) == NULL)
-    {
-        fprintf(stderr, "Failed to start IP network path model\n");
-        exit(2);
-    }
-    if ((path_b_to_a = g1050_init(g1050_model_no, g1050_speed_pattern_no, 100, 33)) == NULL)
-    {
-        fprintf(stderr, "Failed to start IP network path model\n");
-        exit(2);
-    }
-
-    if ((t38_state_a = t38_terminal_init(NULL, TRUE, tx_packet_handler_a, &t38_state_b)) == NULL)
+    if ((s = t38_terminal_init(NULL, TRUE, tx_packet_handler_a, &t38_state_b)) == NULL)
     {
         fprintf(stderr, "Cannot start the T.38 channel\n");
         exit(2);
     }
-    t30 = t38_terminal_get_t30_state(t38_state_a);
-    t38_core = t38_terminal_get_t38_core_state(t38_state_a);
+    t30 = t38_terminal_get_t30_state(s);
+    t38_core = t38_terminal_get_t38_core_state(s);
     t38_set_t38_version(t38_core, t38_version);
 
-    logging = t38_terminal_get_logging_state(t38_state_a);
+    logging = t38_terminal_get_logging_state(s);
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "T.38-A");
 
@@ -339,17 +270,27 @@ int main(int argc, char *argv[])
     if (use_ecm)
         t30_set_supported_compressions(t30, T30_SUPPORT_T4_1D_COMPRESSION | T30_SUPPORT_T4_2D_COMPRESSION | T30_SUPPORT_T6_COMPRESSION);
 
-    if ((t38_state_b = t38_gateway_init(NULL, tx_packet_handler_b, &t38_state_a)) == NULL)
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+static t38_gateway_state_t *start_t38_gateway_b(void)
+{
+    t38_gateway_state_t *s;
+    t38_core_state_t *t38_core;
+    logging_state_t *logging;
+
+    if ((s = t38_gateway_init(NULL, tx_packet_handler_b, &t38_state_a)) == NULL)
     {
         fprintf(stderr, "Cannot start the T.38 channel\n");
         exit(2);
     }
-    t38_core = t38_gateway_get_t38_core_state(t38_state_b);
-    t38_gateway_set_transmit_on_idle(t38_state_b, use_transmit_on_idle);
+    t38_core = t38_gateway_get_t38_core_state(s);
+    t38_gateway_set_transmit_on_idle(s, use_transmit_on_idle);
     t38_set_t38_version(t38_core, t38_version);
-    t38_gateway_set_ecm_capability(t38_state_b, use_ecm);
+    t38_gateway_set_ecm_capability(s, use_ecm);
 
-    logging = t38_gateway_get_logging_state(t38_state_b);
+    logging = t38_gateway_get_logging_state(s);
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "T.38-B");
 
@@ -357,28 +298,37 @@ int main(int argc, char *argv[])
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "T.38-B");
 
-    memset(t38_amp_b, 0, sizeof(t38_amp_b));
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
 
-    if ((fax_state_b = fax_init(NULL, FALSE)) == NULL)
+static fax_state_t *start_fax_b(void)
+{
+    fax_state_t *s;
+    t30_state_t *t30;
+    logging_state_t *logging;
+
+    if ((s = fax_init(NULL, FALSE)) == NULL)
     {
         fprintf(stderr, "Cannot start FAX\n");
         exit(2);
     }
-    t30 = fax_get_t30_state(fax_state_b);
-    fax_set_transmit_on_idle(fax_state_b, use_transmit_on_idle);
-    fax_set_tep_mode(fax_state_b, use_tep);
+    t30 = fax_get_t30_state(s);
+    fax_set_transmit_on_idle(s, use_transmit_on_idle);
+    fax_set_tep_mode(s, use_tep);
     t30_set_supported_modems(t30, supported_modems);
     t30_set_tx_ident(t30, "22222222");
     t30_set_tx_nsf(t30, (const uint8_t *) "\x50\x00\x00\x00Spandsp\x00", 12);
-    t30_set_rx_file(t30, OUTPUT_FILE_NAME, -1);
+    t30_set_rx_file(t30, output_file_name, -1);
     t30_set_phase_b_handler(t30, phase_b_handler, (void *) (intptr_t) 'B');
     t30_set_phase_d_handler(t30, phase_d_handler, (void *) (intptr_t) 'B');
     t30_set_phase_e_handler(t30, phase_e_handler, (void *) (intptr_t) 'B');
+    t30_set_timing_handler(t30, timing_handler, (void *) (intptr_t) 'B');
     t30_set_ecm_capability(t30, use_ecm);
     if (use_ecm)
         t30_set_supported_compressions(t30, T30_SUPPORT_T4_1D_COMPRESSION | T30_SUPPORT_T4_2D_COMPRESSION | T30_SUPPORT_T6_COMPRESSION);
 
-    logging = fax_get_logging_state(fax_state_b);
+    logging = fax_get_logging_state(s);
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "FAX-B ");
 
@@ -386,12 +336,190 @@ int main(int argc, char *argv[])
     span_log_set_level(logging, SPAN_LOG_DEBUG | SPAN_LOG_SHOW_TAG | SPAN_LOG_SHOW_SAMPLE_TIME);
     span_log_set_tag(logging, "FAX-B ");
 
+    return s;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void migrate_call(void)
+{
+    t38_terminal_state_t *new_t38_state_a;
+    t38_gateway_state_t *new_t38_state_b;
+    fax_state_t *new_fax_state_b;
+    uint8_t *buf[3];
+    int len[3];
+
+    /* Take a checkpoint of each end of the call, then carry on with fresh contexts,
+       as a new process taking over the calls of an old one would. */
+    if ((len[0] = t38_terminal_checkpoint(t38_state_a, NULL, 0)) < 0
+        ||
+        (len[1] = t38_gateway_checkpoint(t38_state_b, NULL, 0)) < 0
+        ||
+        (len[2] = fax_checkpoint(fax_state_b, NULL, 0)) < 0)
+    {
+        fprintf(stderr, "Cannot size the checkpoints\n");
+        exit(2);
+    }
+    if ((buf[0] = malloc(len[0])) == NULL
+        ||
+        (buf[1] = malloc(len[1])) == NULL
+        ||
+        (buf[2] = malloc(len[2])) == NULL)
+    {
+        fprintf(stderr, "No memory for the checkpoints\n");
+        exit(2);
+    }
+    if (t38_terminal_checkpoint(t38_state_a, buf[0], len[0] - 1) >= 0)
+    {
+        fprintf(stderr, "Checkpoint written to a short buffer\n");
+        exit(2);
+    }
+    if (t38_terminal_checkpoint(t38_state_a, buf[0], len[0]) != len[0]
+        ||
+        t38_gateway_checkpoint(t38_state_b, buf[1], len[1]) != len[1]
+        ||
+        fax_checkpoint(fax_state_b, buf[2], len[2]) != len[2])
+    {
+        fprintf(stderr, "Cannot write the checkpoints\n");
+        exit(2);
+    }
+    t38_terminal_free(t38_state_a);
+    t38_gateway_free(t38_state_b);
+    fax_free(fax_state_b);
+
+    new_t38_state_a = start_t38_terminal_a();
+    new_t38_state_b = start_t38_gateway_b();
+    new_fax_state_b = start_fax_b();
+    if (t38_terminal_restore(new_t38_state_a, buf[0], len[0])
+        ||
+        t38_gateway_restore(new_t38_state_b, buf[1], len[1])
+        ||
+        fax_restore(new_fax_state_b, buf[2], len[2]))
+    {
+        fprintf(stderr, "Cannot restore the checkpoints\n");
+        exit(2);
+    }
+    t38_state_a = new_t38_state_a;
+    t38_state_b = new_t38_state_b;
+    fax_state_b = new_fax_state_b;
+    checkpoints_taken++;
+    printf("Call moved to new contexts, with checkpoints of %d, %d and %d bytes\n", len[0], len[1], len[2]);
+    free(buf[0]);
+    free(buf[1]);
+    free(buf[2]);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void compare_received_documents(const char *file_a, const char *file_b)
+{
+    TIFF *a;
+    TIFF *b;
+    uint8_t *row_a;
+    uint8_t *row_b;
+    uint32_t width;
+    uint32_t length;
+    uint32_t row;
+    int pages;
+    int page;
+
+    if ((a = TIFFOpen(file_a, "r")) == NULL  ||  (b = TIFFOpen(file_b, "r")) == NULL)
+    {
+        fprintf(stderr, "Cannot open the received documents\n");
+        exit(2);
+    }
+    pages = TIFFNumberOfDirectories(a);
+    if (TIFFNumberOfDirectories(b) != pages)
+    {
+        printf("The documents have %d and %d pages\n", pages, TIFFNumberOfDirectories(b));
+        printf("Tests failed\n");
+        exit(2);
+    }
+    row_a = malloc(TIFFScanlineSize(a) + 1024);
+    row_b = malloc(TIFFScanlineSize(a) + 1024);
+    for (page = 0;  page < pages;  page++)
+    {
+        if (!TIFFSetDirectory(a, (tdir_t) page)  ||  !TIFFSetDirectory(b, (tdir_t) page))
+        {
+            fprintf(stderr, "Cannot find page %d of the received documents\n", page);
+            exit(2);
+        }
+        TIFFGetField(a, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(a, TIFFTAG_IMAGELENGTH, &length);
+        if (!TIFFGetField(b, TIFFTAG_IMAGEWIDTH, &row)  ||  row != width
+            ||
+            !TIFFGetField(b, TIFFTAG_IMAGELENGTH, &row)  ||  row != length)
+        {
+            printf("Page %d differs in size\n", page);
+            printf("Tests failed\n");
+            exit(2);
+        }
+        for (row = 0;  row < length;  row++)
+        {
+            if (TIFFReadScanline(a, row_a, row, 0) < 0
+                ||
+                TIFFReadScanline(b, row_b, row, 0) < 0
+                ||
+                memcmp(row_a, row_b, (width + 7)/8))
+            {
+                printf("Page %d differs at row %d\n", page, row);
+                printf("Tests failed\n");
+                exit(2);
+            }
+        }
+    }
+    free(row_a);
+    free(row_b);
+    TIFFClose(a);
+    TIFFClose(b);
+    printf("The %d pages received match the reference copy\n", pages);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void run_call(const char *file_name)
+{
+    int16_t t38_amp_b[SAMPLES_PER_CHUNK];
+    int16_t t30_amp_b[SAMPLES_PER_CHUNK];
+    int16_t out_amp[2*SAMPLES_PER_CHUNK];
+    int t38_len_b;
+    int t30_len_b;
+    int msg_len;
+    uint8_t msg[1024];
+    int outframes;
+    int i;
+    int seq_no;
+    double tx_when;
+    double rx_when;
+    t30_state_t *t30;
+    t38_core_state_t *t38_core;
+    logging_state_t *logging;
+
+    output_file_name = file_name;
+    when = 0.0;
+    done[0] =
+    done[1] = FALSE;
+    succeeded[0] =
+    succeeded[1] = FALSE;
+    checkpoint_countdown = -1;
+    checkpoints_taken = 0;
+
+    srand48(0x1234567);
+    if ((path_a_to_b = g1050_init(g1050_model_no, g1050_speed_pattern_no, 100, 33)) == NULL)
+    {
+        fprintf(stderr, "Failed to start IP network path model\n");
+        exit(2);
+    }
+    if ((path_b_to_a = g1050_init(g1050_model_no, g1050_speed_pattern_no, 100, 33)) == NULL)
+    {
+        fprintf(stderr, "Failed to start IP network path model\n");
+        exit(2);
+    }
+
+    t38_state_a = start_t38_terminal_a();
+    t38_state_b = start_t38_gateway_b();
+    fax_state_b = start_fax_b();
+
+    memset(t38_amp_b, 0, sizeof(t38_amp_b));
     memset(t30_amp_b, 0, sizeof(t30_amp_b));
 
-#if defined(ENABLE_GUI)
-    if (use_gui)
-        start_media_monitor();
-#endif
     for (;;)
     {
         logging = t38_terminal_get_logging_state(t38_state_a);
@@ -433,7 +561,7 @@ int main(int argc, char *argv[])
             for (i = 0;  i < t30_len_b;  i++)
                 t30_amp_b[i] += t38_amp_b[i] >> 1;
         }
-        if (log_audio)
+        if (wave_handle)
         {
             for (i = 0;  i < t30_len_b;  i++)
                 out_amp[2*i + 1] = t30_amp_b[i];
@@ -450,7 +578,7 @@ int main(int argc, char *argv[])
                 t38_len_b = SAMPLES_PER_CHUNK;
             }
         }
-        if (log_audio)
+        if (wave_handle)
         {
             for (i = 0;  i < t38_len_b;  i++)
                 out_amp[2*i] = t38_amp_b[i];
@@ -478,13 +606,15 @@ int main(int argc, char *argv[])
             t38_core = t38_terminal_get_t38_core_state(t38_state_a);
             t38_core_rx_ifp_packet(t38_core, msg, msg_len, seq_no);
         }
-        if (log_audio)
+        if (wave_handle)
         {
             outframes = sf_writef_short(wave_handle, out_amp, SAMPLES_PER_CHUNK);
             if (outframes != SAMPLES_PER_CHUNK)
                 break;
         }
 
+        if (checkpoint_countdown > 0  &&  --checkpoint_countdown == 0)
+            migrate_call();
         if (done[0]  &&  done[1])
             break;
 #if defined(ENABLE_GUI)
@@ -492,8 +622,113 @@ int main(int argc, char *argv[])
             media_monitor_update_display();
 #endif
     }
-    t38_terminal_release(t38_state_a);
-    fax_release(fax_state_b);
+    t38_terminal_free(t38_state_a);
+    t38_gateway_free(t38_state_b);
+    fax_free(fax_state_b);
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    int log_audio;
+    int opt;
+
+    log_audio = FALSE;
+    t38_version = 1;
+    use_ecm = FALSE;
+    input_file_name = INPUT_FILE_NAME;
+    simulate_incrementing_repeats = FALSE;
+    g1050_model_no = 0;
+    g1050_speed_pattern_no = 1;
+    use_gui = FALSE;
+    use_tep = FALSE;
+    feedback_audio = FALSE;
+    use_transmit_on_idle = TRUE;
+    supported_modems = T30_SUPPORT_V27TER | T30_SUPPORT_V29 | T30_SUPPORT_V17;
+    while ((opt = getopt(argc, argv, "cefgi:Ilm:M:s:tv:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            use_checkpoints = TRUE;
+            break;
+        case 'e':
+            use_ecm = TRUE;
+            break;
+        case 'f':
+            feedback_audio = TRUE;
+            break;
+        case 'g':
+#if defined(ENABLE_GUI)
+            use_gui = TRUE;
+#else
+            fprintf(stderr, "Graphical monitoring not available\n");
+            exit(2);
+#endif
+            break;
+        case 'i':
+            input_file_name = optarg;
+            break;
+        case 'I':
+            simulate_incrementing_repeats = TRUE;
+            break;
+        case 'l':
+            log_audio = TRUE;
+            break;
+        case 'm':
+            supported_modems = atoi(optarg);
+            break;
+        case 'M':
+            g1050_model_no = optarg[0] - 'A' + 1;
+            break;
+        case 's':
+            g1050_speed_pattern_no = atoi(optarg);
+            break;
+        case 't':
+            use_tep = TRUE;
+            break;
+        case 'v':
+            t38_version = atoi(optarg);
+            break;
+        default:
+            //usage();
+            exit(2);
+            break;
+        }
+    }
+
+    printf("Using T.38 version %d\n", t38_version);
+    if (use_ecm)
+        printf("Using ECM\n");
+
+    wave_handle = NULL;
+    if (use_checkpoints)
+    {
+        /* Receive the document from a call which is left alone, as a reference for
+           the one which is moved about */
+        use_checkpoints = FALSE;
+        run_call(REFERENCE_FILE_NAME);
+        if (!succeeded[0]  ||  !succeeded[1])
+        {
+            printf("Tests failed\n");
+            exit(2);
+        }
+        use_checkpoints = TRUE;
+    }
+    if (log_audio)
+    {
+        if ((wave_handle = sf_open_telephony_write(OUTPUT_FILE_NAME_WAVE, 2)) == NULL)
+        {
+            fprintf(stderr, "    Cannot create audio file '%s'\n", OUTPUT_FILE_NAME_WAVE);
+            exit(2);
+        }
+    }
+
+#if defined(ENABLE_GUI)
+    if (use_gui)
+        start_media_monitor();
+#endif
+    run_call(OUTPUT_FILE_NAME);
     if (log_audio)
     {
         if (sf_close(wave_handle) != 0)
@@ -507,6 +742,16 @@ int main(int argc, char *argv[])
         printf("Tests failed\n");
         exit(2);
     }
+    if (use_checkpoints)
+    {
+        if (checkpoints_taken == 0)
+        {
+            printf("No checkpoints were taken\n");
+            printf("Tests failed\n");
+            exit(2);
+        }
+        compare_received_documents(REFERENCE_FILE_NAME, OUTPUT_FILE_NAME);
+    }
     printf("Tests passed\n");
     return  0;
 }
@@ -40,6 +40,7 @@ in ITU specifications T.4 and T.6.
 #include <fcntl.h>
 #include <unistd.h>
 #include <memory.h>
+#include <sys/time.h>
 
 //#if defined(WITH_SPANDSP_INTERNALS)
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
@@ -49,9 +50,13 @@ in ITU specifications T.4 and T.6.
 
 #define IN_FILE_NAME    "../test-data/itu/fax/itutests.tif"
 #define OUT_FILE_NAME   "t4_tests_receive.tif"
+#define SYNC_FILE_NAME  "t4_tests_receive_sync.tif"
+#define BACKGROUND_FILE_NAME "t4_tests_receive_background.tif"
 
 #define XSIZE           1728
 
+#define BENCHMARK_ROWS  20000
+
 t4_state_t send_state;
 t4_state_t receive_state;
 
@@ -99,6 +104,11 @@ static const char t4_test_patterns[][1728 + 1] =
 
 int rows_written = 0;
 int rows_read = 0;
+int benchmark_rows_read = 0;
+
+#define ZERO_RUN_ROWS   8
+
+int zero_run_rows_read = 0;
 
 static void dump_image_as_xxx(t4_state_t *state)
 {
@@ -109,13 +119,13 @@ static void dump_image_as_xxx(t4_state_t *state)
 
     /* Dump the entire image as text 'X's and spaces */
     printf("Image (%d x %d):\n", receive_state.image_width, receive_state.image_length);
-    s = state->image_buffer;
     for (i = 0;  i < state->image_length;  i++)
     {
+        s = t4_page_buffer_row(&state->image, i, state->bytes_per_row);
         for (j = 0;  j < state->bytes_per_row;  j++)
         {
             for (k = 0;  k < 8;  k++)
-                printf((state->image_buffer[i*state->bytes_per_row + j] & (0x80 >> k))  ?  "X"  :  " ");
+                printf((s[j] & (0x80 >> k))  ?  "X"  :  " ");
         }
         printf("\n");
     }
@@ -194,6 +204,514 @@ static int row_write_handler(void *user_data, const uint8_t buf[], size_t len)
 }
 /*- End of function --------------------------------------------------------*/
 
+static int benchmark_row_read_handler(void *user_data, uint8_t buf[], size_t len)
+{
+    int i;
+    int j;
+    const char *s;
+
+    /* Send a long page, which is mostly white, with some rows of the test
+       patterns scattered through it, like a typical page of text. */
+    if (benchmark_rows_read >= BENCHMARK_ROWS)
+        return 0;
+    memset(buf, 0, len);
+    if ((benchmark_rows_read & 3) == 0)
+    {
+        s = t4_test_patterns[(benchmark_rows_read >> 2) & 15];
+        for (i = 0;  i < len;  i++)
+        {
+            for (j = 0;  j < 8;  j++)
+            {
+                if (*s++ != ' ')
+                    buf[i] |= (0x80 >> j);
+            }
+        }
+    }
+    benchmark_rows_read++;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void encode_benchmark(const char *in_file_name, int compression)
+{
+    t4_state_t *s;
+    uint8_t block[1024];
+    struct timeval start;
+    struct timeval end;
+    double elapsed;
+    int len;
+
+    if ((s = t4_tx_init(NULL, in_file_name, -1, -1)) == NULL)
+    {
+        printf("Failed to init T.4 tx\n");
+        exit(2);
+    }
+    t4_tx_set_row_read_handler(s, benchmark_row_read_handler, NULL);
+    t4_tx_set_tx_encoding(s, compression);
+    benchmark_rows_read = 0;
+    gettimeofday(&start, NULL);
+    /* The whole page is encoded as the page starts */
+    if (t4_tx_start_page(s))
+    {
+        printf("Failed to start T.4 tx page\n");
+        exit(2);
+    }
+    gettimeofday(&end, NULL);
+    while ((len = t4_tx_get_chunk(s, block, sizeof(block))) == sizeof(block))
+        ;
+    t4_tx_end_page(s);
+    t4_tx_free(s);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+    if (elapsed <= 0.0)
+        elapsed = 0.000001;
+    printf("%s encoding of %d rows - %.0f rows/s\n", t4_encoding_to_str(compression), BENCHMARK_ROWS, BENCHMARK_ROWS/elapsed);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint8_t *encode_benchmark_page(const char *in_file_name, int compression, int *len, int *y_resolution)
+{
+    t4_state_t *s;
+    uint8_t *buf;
+
+    if ((s = t4_tx_init(NULL, in_file_name, -1, -1)) == NULL)
+    {
+        printf("Failed to init T.4 tx\n");
+        exit(2);
+    }
+    t4_tx_set_row_read_handler(s, benchmark_row_read_handler, NULL);
+    t4_tx_set_tx_encoding(s, compression);
+    benchmark_rows_read = 0;
+    if (t4_tx_start_page(s))
+    {
+        printf("Failed to start T.4 tx page\n");
+        exit(2);
+    }
+    if ((buf = malloc(s->image_size)) == NULL)
+    {
+        printf("Out of memory\n");
+        exit(2);
+    }
+    *len = t4_tx_get_chunk(s, buf, s->image_size);
+    *y_resolution = t4_tx_get_y_resolution(s);
+    t4_tx_end_page(s);
+    t4_tx_free(s);
+    return buf;
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint8_t *transcoded_buf;
+static int transcoded_len;
+static int transcoded_max;
+
+static int transcoder_output_handler(void *user_data, const uint8_t buf[], int len)
+{
+    if (transcoded_len + len > transcoded_max)
+        return -1;
+    memcpy(&transcoded_buf[transcoded_len], buf, len);
+    transcoded_len += len;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void transcode_test(const char *in_file_name, int from, int to)
+{
+    t4_transcoder_state_t *s;
+    uint8_t *in_buf;
+    uint8_t *ref_buf;
+    int in_len;
+    int ref_len;
+    int y_resolution;
+    struct timeval start;
+    struct timeval end;
+    double elapsed;
+
+    /* Transcoding must give exactly what encoding the same image directly would */
+    in_buf = encode_benchmark_page(in_file_name, from, &in_len, &y_resolution);
+    ref_buf = encode_benchmark_page(in_file_name, to, &ref_len, &y_resolution);
+    transcoded_max = ref_len;
+    if ((transcoded_buf = malloc(transcoded_max)) == NULL)
+    {
+        printf("Out of memory\n");
+        exit(2);
+    }
+    transcoded_len = 0;
+    if ((s = t4_transcoder_init(NULL, from, to, transcoder_output_handler, NULL)) == NULL)
+    {
+        printf("Failed to init T.4 transcoder\n");
+        exit(2);
+    }
+    t4_transcoder_set_image_width(s, XSIZE);
+    t4_transcoder_set_y_resolution(s, y_resolution);
+    gettimeofday(&start, NULL);
+    if (t4_transcoder_start_page(s))
+    {
+        printf("Failed to start T.4 transcoder page\n");
+        exit(2);
+    }
+    t4_transcoder_put_chunk(s, in_buf, in_len);
+    t4_transcoder_end_page(s);
+    gettimeofday(&end, NULL);
+    t4_transcoder_free(s);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+    if (elapsed <= 0.0)
+        elapsed = 0.000001;
+    printf("%s to %s transcoding of %d rows - %.0f rows/s\n", t4_encoding_to_str(from), t4_encoding_to_str(to), BENCHMARK_ROWS, BENCHMARK_ROWS/elapsed);
+    if (transcoded_len != ref_len  ||  memcmp(transcoded_buf, ref_buf, ref_len))
+    {
+        printf("Transcoded image does not match - %d bytes, expected %d bytes\n", transcoded_len, ref_len);
+        printf("Tests failed\n");
+        exit(2);
+    }
+    free(transcoded_buf);
+    free(ref_buf);
+    free(in_buf);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int zero_run_row_read_handler(void *user_data, uint8_t buf[], size_t len)
+{
+    /* White 5, black 3, then white to the end of the row */
+    if (zero_run_rows_read >= ZERO_RUN_ROWS)
+        return 0;
+    memset(buf, 0, len);
+    buf[0] = 0x07;
+    zero_run_rows_read++;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int put_code(uint8_t buf[], int bit_pos, const char *code)
+{
+    /* T.4 codes are sent least significant bit of each byte first */
+    for (  ;  *code;  code++, bit_pos++)
+    {
+        if (*code == '1')
+            buf[bit_pos >> 3] |= (1 << (bit_pos & 7));
+    }
+    return bit_pos;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void zero_length_run_transcode_test(const char *in_file_name)
+{
+    /* The same row as zero_run_row_read_handler() produces, coded with some zero length
+       runs - white 5, black 0, white 0, black 0, white 0, black 3, white 1720 */
+    static const char *row_codes[] =
+    {
+        "1100",
+        "0000110111",
+        "00110101",
+        "0000110111",
+        "00110101",
+        "10",
+        "011000",
+        "01011001",
+        NULL
+    };
+    static const char eol[] = "000000000001";
+    t4_transcoder_state_t *s;
+    t4_state_t *t;
+    uint8_t in_buf[1024];
+    uint8_t *ref_buf;
+    int in_len;
+    int ref_len;
+    int bit_pos;
+    int row;
+    int i;
+
+    memset(in_buf, 0, sizeof(in_buf));
+    bit_pos = put_code(in_buf, 0, eol);
+    for (row = 0;  row < ZERO_RUN_ROWS;  row++)
+    {
+        for (i = 0;  row_codes[i];  i++)
+            bit_pos = put_code(in_buf, bit_pos, row_codes[i]);
+        bit_pos = put_code(in_buf, bit_pos, eol);
+    }
+    /* RTC */
+    for (i = 0;  i < 5;  i++)
+        bit_pos = put_code(in_buf, bit_pos, eol);
+    in_len = (bit_pos + 7)/8;
+
+    /* The reference is the same image, with no zero length runs, encoded directly */
+    if ((t = t4_tx_init(NULL, in_file_name, -1, -1)) == NULL)
+    {
+        printf("Failed to init T.4 tx\n");
+        exit(2);
+    }
+    t4_tx_set_row_read_handler(t, zero_run_row_read_handler, NULL);
+    t4_tx_set_tx_encoding(t, T4_COMPRESSION_ITU_T6);
+    zero_run_rows_read = 0;
+    if (t4_tx_start_page(t))
+    {
+        printf("Failed to start T.4 tx page\n");
+        exit(2);
+    }
+    if ((ref_buf = malloc(t->image_size)) == NULL)
+    {
+        printf("Out of memory\n");
+        exit(2);
+    }
+    ref_len = t4_tx_get_chunk(t, ref_buf, t->image_size);
+    t4_tx_end_page(t);
+    t4_tx_free(t);
+
+    transcoded_max = ref_len;
+    if ((transcoded_buf = malloc(transcoded_max)) == NULL)
+    {
+        printf("Out of memory\n");
+        exit(2);
+    }
+    transcoded_len = 0;
+    if ((s = t4_transcoder_init(NULL, T4_COMPRESSION_ITU_T4_1D, T4_COMPRESSION_ITU_T6, transcoder_output_handler, NULL)) == NULL)
+    {
+        printf("Failed to init T.4 transcoder\n");
+        exit(2);
+    }
+    t4_transcoder_set_image_width(s, XSIZE);
+    if (t4_transcoder_start_page(s))
+    {
+        printf("Failed to start T.4 transcoder page\n");
+        exit(2);
+    }
+    t4_transcoder_put_chunk(s, in_buf, in_len);
+    t4_transcoder_end_page(s);
+    t4_transcoder_free(s);
+    printf("Zero length run transcoding - %d bytes, expected %d bytes\n", transcoded_len, ref_len);
+    if (transcoded_len != ref_len  ||  memcmp(transcoded_buf, ref_buf, ref_len))
+    {
+        printf("Transcoded image does not match\n");
+        printf("Tests failed\n");
+        exit(2);
+    }
+    free(transcoded_buf);
+    free(ref_buf);
+}
+/*- End of function --------------------------------------------------------*/
+
+static uint32_t send_document_checksum(const char *in_file_name, int compression)
+{
+    t4_state_t *s;
+    uint8_t block[1024];
+    uint32_t checksum;
+    int len;
+    int i;
+
+    if ((s = t4_tx_init(NULL, in_file_name, -1, -1)) == NULL)
+    {
+        printf("Failed to init T.4 tx\n");
+        exit(2);
+    }
+    t4_tx_set_tx_encoding(s, compression);
+    t4_tx_set_min_bits_per_row(s, 100);
+    checksum = 0;
+    while (t4_tx_start_page(s) == 0)
+    {
+        while ((len = t4_tx_get_chunk(s, block, sizeof(block))) > 0)
+        {
+            for (i = 0;  i < len;  i++)
+                checksum = checksum*31 + block[i];
+        }
+        t4_tx_end_page(s);
+    }
+    t4_tx_free(s);
+    return checksum;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void page_cache_test(const char *in_file_name, int compression)
+{
+    t4_tx_page_cache_stats_t stats;
+    uint32_t uncached;
+    uint32_t first;
+    uint32_t second;
+    int hits;
+    int misses;
+    int pages;
+
+    /* Sending the same document again must take every page from the cache, and must
+       send exactly what encoding the pages afresh sends. */
+    t4_tx_page_cache_set_limit(0);
+    uncached = send_document_checksum(in_file_name, compression);
+    t4_tx_page_cache_set_limit(16*1024*1024);
+    t4_tx_page_cache_get_stats(&stats);
+    hits = stats.hits;
+    misses = stats.misses;
+    first = send_document_checksum(in_file_name, compression);
+    t4_tx_page_cache_get_stats(&stats);
+    pages = stats.misses - misses;
+    second = send_document_checksum(in_file_name, compression);
+    t4_tx_page_cache_get_stats(&stats);
+    hits = stats.hits - hits;
+    misses = stats.misses - misses;
+    printf("%s page cache - %d pages, %d bytes, %d hits, %d misses\n",
+           t4_encoding_to_str(compression),
+           stats.entries,
+           stats.bytes,
+           hits,
+           misses);
+    if (first != uncached  ||  second != uncached  ||  hits != pages  ||  misses != pages  ||  stats.entries != pages)
+    {
+        printf("Page cache test failed\n");
+        printf("Tests failed\n");
+        exit(2);
+    }
+    /* Shrinking the cache drops the pages */
+    t4_tx_page_cache_set_limit(1);
+    t4_tx_page_cache_get_stats(&stats);
+    if (stats.entries != 0  ||  stats.bytes != 0)
+    {
+        printf("Page cache test failed\n");
+        printf("Tests failed\n");
+        exit(2);
+    }
+    t4_tx_page_cache_set_limit(0);
+}
+/*- End of function --------------------------------------------------------*/
+
+static int receive_document(const char *in_file_name, const char *out_file_name, int background)
+{
+    t4_state_t *tx;
+    t4_state_t *rx;
+    uint8_t block[1024];
+    int len;
+    int pages;
+
+    if ((tx = t4_tx_init(NULL, in_file_name, -1, -1)) == NULL)
+    {
+        printf("Failed to init T.4 tx\n");
+        exit(2);
+    }
+    t4_tx_set_tx_encoding(tx, T4_COMPRESSION_ITU_T6);
+    if ((rx = t4_rx_init(NULL, out_file_name, T4_COMPRESSION_ITU_T6)) == NULL)
+    {
+        printf("Failed to init T.4 rx for '%s'\n", out_file_name);
+        exit(2);
+    }
+    if (background  &&  t4_rx_set_background_writing(rx, TRUE))
+    {
+        printf("Failed to start background TIFF writing\n");
+        exit(2);
+    }
+    t4_rx_set_rx_encoding(rx, T4_COMPRESSION_ITU_T6);
+    t4_rx_set_far_ident(rx, "111 2222 3333");
+    for (pages = 0;  t4_tx_start_page(tx) == 0;  pages++)
+    {
+        t4_rx_set_x_resolution(rx, t4_tx_get_x_resolution(tx));
+        t4_rx_set_y_resolution(rx, t4_tx_get_y_resolution(tx));
+        t4_rx_set_image_width(rx, t4_tx_get_image_width(tx));
+        t4_rx_start_page(rx);
+        while ((len = t4_tx_get_chunk(tx, block, sizeof(block))) > 0)
+        {
+            if (t4_rx_put_chunk(rx, block, len))
+                break;
+        }
+        t4_rx_end_page(rx);
+        t4_tx_end_page(tx);
+    }
+    t4_tx_free(tx);
+    t4_rx_free(rx);
+    return pages;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int check_page_number(TIFF *t, int page, int pages)
+{
+    uint16_t page_no;
+    uint16_t total_pages;
+
+    if (!TIFFGetField(t, TIFFTAG_PAGENUMBER, &page_no, &total_pages))
+        return -1;
+    if (page_no != page  ||  total_pages != pages)
+    {
+        printf("Page %d has page number %d of %d\n", page, page_no, total_pages);
+        return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int compare_received_documents(const char *file_a, const char *file_b, int pages)
+{
+    TIFF *a;
+    TIFF *b;
+    uint8_t *row_a;
+    uint8_t *row_b;
+    uint32_t width;
+    uint32_t length;
+    uint32_t row;
+    int page;
+    int failed;
+
+    if ((a = TIFFOpen(file_a, "r")) == NULL  ||  (b = TIFFOpen(file_b, "r")) == NULL)
+        return -1;
+    failed = (TIFFNumberOfDirectories(a) != pages  ||  TIFFNumberOfDirectories(b) != pages);
+    row_a = malloc(TIFFScanlineSize(a) + 1024);
+    row_b = malloc(TIFFScanlineSize(a) + 1024);
+    for (page = 0;  page < pages  &&  !failed;  page++)
+    {
+        if (!TIFFSetDirectory(a, (tdir_t) page)  ||  !TIFFSetDirectory(b, (tdir_t) page))
+        {
+            failed = TRUE;
+            break;
+        }
+        /* Both files must carry the final page count, set when they were closed */
+        if (check_page_number(a, page, pages)  ||  check_page_number(b, page, pages))
+        {
+            failed = TRUE;
+            break;
+        }
+        TIFFGetField(a, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(a, TIFFTAG_IMAGELENGTH, &length);
+        if (!TIFFGetField(b, TIFFTAG_IMAGEWIDTH, &row)  ||  row != width
+            ||
+            !TIFFGetField(b, TIFFTAG_IMAGELENGTH, &row)  ||  row != length)
+        {
+            failed = TRUE;
+            break;
+        }
+        for (row = 0;  row < length;  row++)
+        {
+            if (TIFFReadScanline(a, row_a, row, 0) < 0
+                ||
+                TIFFReadScanline(b, row_b, row, 0) < 0
+                ||
+                memcmp(row_a, row_b, (width + 7)/8))
+            {
+                printf("Page %d differs at row %d\n", page, row);
+                failed = TRUE;
+                break;
+            }
+        }
+    }
+    free(row_a);
+    free(row_b);
+    TIFFClose(a);
+    TIFFClose(b);
+    return (failed)  ?  -1  :  0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void background_writing_test(const char *in_file_name)
+{
+    int sync_pages;
+    int background_pages;
+
+    /* Writing the pages in the background must give the same file as writing them as
+       they end, including the final page counts. */
+    sync_pages = receive_document(in_file_name, SYNC_FILE_NAME, FALSE);
+    background_pages = receive_document(in_file_name, BACKGROUND_FILE_NAME, TRUE);
+    printf("Background TIFF writing - %d pages\n", background_pages);
+    if (sync_pages != background_pages
+        ||
+        compare_received_documents(SYNC_FILE_NAME, BACKGROUND_FILE_NAME, sync_pages))
+    {
+        printf("Background TIFF writing test failed\n");
+        printf("Tests failed\n");
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
 static int detect_page_end(int bit, int page_ended)
 {
     static int consecutive_eols;
@@ -305,6 +823,7 @@ int main(int argc, char *argv[])
     int overlay_page_headers;
     int min_row_bits;
     int restart_pages;
+    int pre_encode;
     int block_size;
     char buf[1024];
     uint8_t block[1024];
@@ -320,6 +839,7 @@ int main(int argc, char *argv[])
     unsigned int pkt_no;
     int page_ended;
     FILE *file;
+    t4_page_buffer_pool_stats_t pool_stats;
 
     tests_failed = 0;
     compression = -1;
@@ -327,6 +847,7 @@ int main(int argc, char *argv[])
     add_page_headers = FALSE;
     overlay_page_headers = FALSE;
     restart_pages = FALSE;
+    pre_encode = FALSE;
     in_file_name = IN_FILE_NAME;
     decode_file_name = NULL;
     page_header_tz = NULL;
@@ -336,7 +857,7 @@ int main(int argc, char *argv[])
     block_size = 1;
     bit_error_rate = 0;
     dump_as_xxx = FALSE;
-    while ((opt = getopt(argc, argv, "1268b:d:ehHri:m:t:x")) != -1)
+    while ((opt = getopt(argc, argv, "1268b:d:ehHpri:m:t:x")) != -1)
     {
         switch (opt)
         {
@@ -377,6 +898,9 @@ int main(int argc, char *argv[])
             add_page_headers = TRUE;
             overlay_page_headers = TRUE;
             break;
+        case 'p':
+            pre_encode = TRUE;
+            break;
         case 'r':
             restart_pages = TRUE;
             break;
@@ -651,6 +1175,11 @@ int main(int argc, char *argv[])
         span_log_set_level(&send_state.logging, SPAN_LOG_SHOW_SEVERITY | SPAN_LOG_SHOW_PROTOCOL | SPAN_LOG_SHOW_TAG | SPAN_LOG_FLOW);
         t4_tx_set_min_bits_per_row(&send_state, min_row_bits);
         t4_tx_set_local_ident(&send_state, "111 2222 3333");
+        if (pre_encode  &&  t4_tx_set_pre_encoding(&send_state, TRUE))
+        {
+            printf("Failed to start background page encoding\n");
+            exit(2);
+        }
 
         /* Receive end puts TIFF to a new file. */
         if (t4_rx_init(&receive_state, OUT_FILE_NAME, T4_COMPRESSION_ITU_T4_2D) == NULL)
@@ -798,6 +1327,36 @@ int main(int argc, char *argv[])
             exit(2);
         }
 #endif
+        printf("Benchmarking the T.4 encoder\n");
+        encode_benchmark(in_file_name, T4_COMPRESSION_ITU_T4_1D);
+        encode_benchmark(in_file_name, T4_COMPRESSION_ITU_T4_2D);
+        encode_benchmark(in_file_name, T4_COMPRESSION_ITU_T6);
+        printf("Testing the T.4 transcoder\n");
+        transcode_test(in_file_name, T4_COMPRESSION_ITU_T6, T4_COMPRESSION_ITU_T4_1D);
+        transcode_test(in_file_name, T4_COMPRESSION_ITU_T4_1D, T4_COMPRESSION_ITU_T6);
+        transcode_test(in_file_name, T4_COMPRESSION_ITU_T4_2D, T4_COMPRESSION_ITU_T4_1D);
+        transcode_test(in_file_name, T4_COMPRESSION_ITU_T6, T4_COMPRESSION_ITU_T4_2D);
+        zero_length_run_transcode_test(in_file_name);
+        printf("Testing the T.4 encoded page cache\n");
+        page_cache_test(in_file_name, T4_COMPRESSION_ITU_T4_1D);
+        page_cache_test(in_file_name, T4_COMPRESSION_ITU_T4_2D);
+        page_cache_test(in_file_name, T4_COMPRESSION_ITU_T6);
+#if defined(HAVE_PTHREAD_H)  &&  defined(HAVE_LIBPTHREAD)
+        printf("Testing background writing of received pages\n");
+        background_writing_test(in_file_name);
+#endif
+        /* Every context has been released, so all the page buffer chunks should be back in the pool */
+        t4_page_buffer_pool_get_stats(&pool_stats);
+        printf("Page buffer pool - %d chunks of %d bytes allocated, %d in use, peak %d in use\n",
+               pool_stats.chunks_allocated,
+               pool_stats.chunk_size,
+               pool_stats.chunks_in_use,
+               pool_stats.peak_chunks_in_use);
+        if (pool_stats.chunks_in_use)
+        {
+            printf("Tests failed\n");
+            exit(2);
+        }
         printf("Tests passed\n");
     }
     return 0;
@@ -0,0 +1,431 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * t85_tests.c - ITU T.85 JBIG for FAX image compression and decompression tests
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page t85_tests_page T.85 tests
+\section t85_tests_page_sec_1 What does it do
+These tests exercise the T.81/T.82 arithmetic coder, using the test sequence
+from T.82, and the T.85 image encoder and decoder. Images are passed through
+the encoder and decoder with a range of options, including images whose length
+is corrected by a NEWLEN marker. Damaged and hostile image headers and coded
+data are checked to be rejected, or limited, rather than decoded blindly.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+#define TEST_IMAGE_WIDTH        1728
+#define TEST_IMAGE_LENGTH       700
+#define TEST_IMAGE_BYTES_PER_ROW (TEST_IMAGE_WIDTH/8)
+
+#define MAX_CODED_LEN           1000000
+
+/* The test sequence from T.82 7.2.1. The 256 decisions are held 16 to a word, most
+   significant bit first. */
+static const uint16_t t82_pix[16] =
+{
+    0x05E0, 0x0000, 0x8B00, 0x01C4, 0x1700, 0x0034, 0x7FFF, 0x1A3F,
+    0x951B, 0x05D8, 0x1D17, 0xE770, 0x0000, 0x0000, 0x0656, 0x0E6A
+};
+
+static const uint16_t t82_cx[16] =
+{
+    0x0FE0, 0x0000, 0x0F00, 0x00F0, 0xFF00, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000
+};
+
+static const uint8_t t82_sde[] =
+{
+    0x69, 0x89, 0x99, 0x5C, 0x32, 0xEA, 0xFA, 0xA0,
+    0xD5, 0xFF, 0x00, 0x52, 0x7F, 0xFF, 0x00, 0xFF,
+    0x00, 0xFF, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x3F,
+    0xFF, 0x00, 0x2D, 0x20, 0x82, 0x91
+};
+
+static uint8_t test_image[TEST_IMAGE_LENGTH][TEST_IMAGE_BYTES_PER_ROW];
+static uint8_t decoded_image[TEST_IMAGE_LENGTH][TEST_IMAGE_BYTES_PER_ROW];
+static int decoded_rows;
+
+static uint8_t coded[MAX_CODED_LEN];
+static int coded_len;
+
+static void coded_output_handler(void *user_data, int byte)
+{
+    if (coded_len >= MAX_CODED_LEN)
+    {
+        printf("Coded data overflow\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+    coded[coded_len++] = (uint8_t) byte;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int row_write_handler(void *user_data, const uint8_t buf[], size_t len)
+{
+    /* Rows beyond the test image are counted, but not kept */
+    if (decoded_rows < TEST_IMAGE_LENGTH)
+        memcpy(decoded_image[decoded_rows], buf, len);
+    decoded_rows++;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void create_test_image(void)
+{
+    int x;
+    int y;
+    int black;
+
+    /* A mix of blocks, a textured disc, a noisy band, and plenty of repeated rows, so
+       typical prediction gets some use. */
+    memset(test_image, 0, sizeof(test_image));
+    for (y = 0;  y < TEST_IMAGE_LENGTH;  y++)
+    {
+        for (x = 0;  x < TEST_IMAGE_WIDTH;  x++)
+        {
+            black = ((x/40 + y/30)%5 == 0);
+            if ((x - 800)*(x - 800) + (y - 350)*(y - 350) < 200*200  &&  ((x ^ y) & 4))
+                black = TRUE;
+            if (y > 600  &&  y < 640)
+                black = ((x*x/7 + y) & 1);
+            if (black)
+                test_image[y][x >> 3] |= (0x80 >> (x & 7));
+        }
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static int decode_coded_data(uint32_t max_xd, uint32_t max_yd, int chunk)
+{
+    t85_decode_state_t *s;
+    int ret;
+    int i;
+    int n;
+
+    decoded_rows = 0;
+    memset(decoded_image, 0, sizeof(decoded_image));
+    if ((s = t85_decode_init(NULL, row_write_handler, NULL)) == NULL)
+    {
+        printf("Failed to init T.85 decoder\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+    t85_decode_set_image_size_constraints(s, max_xd, max_yd);
+    ret = 0;
+    for (i = 0;  i < coded_len  &&  ret == 0;  i += n)
+    {
+        n = (coded_len - i < chunk)  ?  (coded_len - i)  :  chunk;
+        ret = t85_decode_put_chunk(s, &coded[i], n);
+    }
+    if (ret == TRUE  &&  t85_decode_get_image_length(s) != (uint32_t) decoded_rows)
+    {
+        printf("Decoder length %u, but %d rows delivered\n", t85_decode_get_image_length(s), decoded_rows);
+        printf("Test failed\n");
+        exit(2);
+    }
+    t85_decode_free(s);
+    return ret;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void arith_test(void)
+{
+    t81_t82_arith_encode_state_t enc;
+    t81_t82_arith_decode_state_t dec;
+    uint8_t buf[sizeof(t82_sde) + 2];
+    int bit;
+    int cx;
+    int i;
+
+    printf("T.82 arithmetic coder test sequence\n");
+    coded_len = 0;
+    t81_t82_arith_encode_init(&enc, coded_output_handler, NULL);
+    for (i = 0;  i < 256;  i++)
+    {
+        bit = (t82_pix[i >> 4] >> (15 - (i & 15))) & 1;
+        cx = (t82_cx[i >> 4] >> (15 - (i & 15))) & 1;
+        t81_t82_arith_encode(&enc, cx, bit);
+    }
+    t81_t82_arith_encode_flush(&enc);
+    if (coded_len != sizeof(t82_sde)  ||  memcmp(coded, t82_sde, sizeof(t82_sde)))
+    {
+        printf("Encoded sequence does not match T.82\n");
+        for (i = 0;  i < coded_len;  i++)
+            printf("%02X ", coded[i]);
+        printf("\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+
+    /* The coded data is followed by a marker, so the decoder pads it with zeros */
+    memcpy(buf, t82_sde, sizeof(t82_sde));
+    buf[sizeof(t82_sde)] = 0xFF;
+    buf[sizeof(t82_sde) + 1] = 0x02;
+    t81_t82_arith_decode_init(&dec);
+    dec.pscd_ptr = buf;
+    dec.pscd_end = buf + sizeof(buf);
+    for (i = 0;  i < 256;  i++)
+    {
+        cx = (t82_cx[i >> 4] >> (15 - (i & 15))) & 1;
+        bit = t81_t82_arith_decode(&dec, cx);
+        if (bit != ((t82_pix[i >> 4] >> (15 - (i & 15))) & 1))
+        {
+            printf("Decoded decision %d is %d\n", i, bit);
+            printf("Test failed\n");
+            exit(2);
+        }
+    }
+    printf("Test passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+static void encode_test_image(uint32_t l0, int mx, int options, int declared_length, int rows)
+{
+    t85_encode_state_t *s;
+    int y;
+
+    coded_len = 0;
+    if ((s = t85_encode_init(NULL, TEST_IMAGE_WIDTH, declared_length, coded_output_handler, NULL)) == NULL)
+    {
+        printf("Failed to init T.85 encoder\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+    if (t85_encode_set_options(s, l0, mx, options))
+    {
+        printf("Failed to set T.85 options\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+    for (y = 0;  y < rows;  y++)
+    {
+        if (t85_encode_put_row(s, test_image[y]))
+        {
+            printf("Failed to encode row %d\n", y);
+            printf("Test failed\n");
+            exit(2);
+        }
+    }
+    t85_encode_image_complete(s);
+    if (t85_encode_get_image_length(s) != (uint32_t) ((declared_length)  ?  declared_length  :  rows))
+    {
+        printf("Encoder length %u\n", t85_encode_get_image_length(s));
+        printf("Test failed\n");
+        exit(2);
+    }
+    t85_encode_free(s);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void round_trip_test(uint32_t l0, int mx, int options, int declared_length, int rows)
+{
+    static const int chunks[] =
+    {
+        1, 7, 256, MAX_CODED_LEN
+    };
+    static const uint8_t white[TEST_IMAGE_LENGTH][TEST_IMAGE_BYTES_PER_ROW] = {{0}};
+    int expected_rows;
+    int ret;
+    int i;
+
+    printf("Round trip L0=%u, MX=%d, options 0x%02X, declared length %d, %d rows\n",
+           l0,
+           mx,
+           options,
+           declared_length,
+           rows);
+    encode_test_image(l0, mx, options, declared_length, rows);
+    /* A short image with a declared length is padded with white rows */
+    expected_rows = (declared_length)  ?  declared_length  :  rows;
+    /* When the length is not declared up front, the header holds a dummy length, and
+       a NEWLEN marker must bring it down to the true length. */
+    if (declared_length == 0  &&  (coded[19] & T85_VLENGTH) == 0)
+    {
+        printf("VLENGTH not set in the image header\n");
+        printf("Test failed\n");
+        exit(2);
+    }
+    for (i = 0;  i < (int) (sizeof(chunks)/sizeof(chunks[0]));  i++)
+    {
+        ret = decode_coded_data(TEST_IMAGE_WIDTH, 2*TEST_IMAGE_LENGTH, chunks[i]);
+        if (ret != TRUE)
+        {
+            printf("Decode in chunks of %d returned %d\n", chunks[i], ret);
+            printf("Test failed\n");
+            exit(2);
+        }
+        if (decoded_rows != expected_rows
+            ||
+            memcmp(decoded_image, test_image, rows*TEST_IMAGE_BYTES_PER_ROW)
+            ||
+            memcmp(decoded_image[rows], white, (expected_rows - rows)*TEST_IMAGE_BYTES_PER_ROW))
+        {
+            printf("Decode in chunks of %d gave %d rows, which do not match the %d rows expected\n",
+                   chunks[i],
+                   decoded_rows,
+                   expected_rows);
+            printf("Test failed\n");
+            exit(2);
+        }
+    }
+    printf("%d bytes. Test passed\n", coded_len);
+}
+/*- End of function --------------------------------------------------------*/
+
+static void put_uint32(uint8_t buf[], uint32_t value)
+{
+    buf[0] = (uint8_t) (value >> 24);
+    buf[1] = (uint8_t) (value >> 16);
+    buf[2] = (uint8_t) (value >> 8);
+    buf[3] = (uint8_t) value;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void make_header(uint8_t buf[], uint32_t xd, uint32_t yd, uint32_t l0, int options)
+{
+    memset(buf, 0, 20);
+    buf[2] = 1;
+    put_uint32(&buf[4], xd);
+    put_uint32(&buf[8], yd);
+    put_uint32(&buf[12], l0);
+    buf[19] = (uint8_t) options;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void expect_decode(const char *tag, int expected, int max_rows)
+{
+    int ret;
+
+    ret = decode_coded_data(TEST_IMAGE_WIDTH, 2*TEST_IMAGE_LENGTH, MAX_CODED_LEN);
+    printf("%s - returned %d, %d rows\n", tag, ret, decoded_rows);
+    if (ret != expected  ||  decoded_rows > max_rows)
+    {
+        printf("Expected %d, with no more than %d rows\n", expected, max_rows);
+        printf("Test failed\n");
+        exit(2);
+    }
+}
+/*- End of function --------------------------------------------------------*/
+
+static void bad_data_tests(void)
+{
+    int len;
+
+    printf("Damaged and hostile image tests\n");
+
+    /* A header cut short should just wait for more */
+    make_header(coded, TEST_IMAGE_WIDTH, TEST_IMAGE_LENGTH, 128, T85_TPBON);
+    coded_len = 10;
+    expect_decode("Truncated header", 0, 0);
+
+    /* Not a single layer, single plane image */
+    make_header(coded, TEST_IMAGE_WIDTH, TEST_IMAGE_LENGTH, 128, T85_TPBON);
+    coded[2] = 2;
+    coded_len = 20;
+    expect_decode("Two bit planes", -1, 0);
+
+    make_header(coded, 0, TEST_IMAGE_LENGTH, 128, T85_TPBON);
+    expect_decode("Zero width", -1, 0);
+
+    make_header(coded, TEST_IMAGE_WIDTH, TEST_IMAGE_LENGTH, 0, T85_TPBON);
+    expect_decode("Zero stripe length", -1, 0);
+
+    make_header(coded, 2*TEST_IMAGE_WIDTH, TEST_IMAGE_LENGTH, 128, T85_TPBON);
+    expect_decode("Too wide", -1, 0);
+
+    make_header(coded, TEST_IMAGE_WIDTH, TEST_IMAGE_LENGTH, 128, T85_TPBON | T85_DPON);
+    expect_decode("Deterministic prediction", -1, 0);
+
+    /* A huge length must be rejected, unless it might be corrected by NEWLEN. Then it
+       is limited. A few zero bytes can legitimately code a huge number of typical
+       rows, so without the limit this would produce 0x100000 rows. */
+    make_header(coded, TEST_IMAGE_WIDTH, 0x100000, 0x100000, T85_TPBON);
+    memset(&coded[20], 0, 10);
+    coded_len = 30;
+    expect_decode("Huge length", -1, 0);
+
+    make_header(coded, TEST_IMAGE_WIDTH, 0x100000, 0x100000, T85_TPBON | T85_VLENGTH);
+    memset(&coded[20], 0, 10);
+    coded_len = 30;
+    expect_decode("Huge variable length", 0, 2*TEST_IMAGE_LENGTH);
+    coded[coded_len++] = 0xFF;
+    coded[coded_len++] = 0x02;
+    expect_decode("Huge variable length, ended", TRUE, 2*TEST_IMAGE_LENGTH);
+
+    /* Coded data ended by something other than the end of a stripe must not be padded
+       out to fill the stripe. */
+    encode_test_image(TEST_IMAGE_LENGTH, 0, T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    len = coded_len/2;
+    if (coded[len - 1] == 0xFF)
+        len--;
+    coded_len = len;
+    coded[coded_len++] = 0xFF;
+    coded[coded_len++] = 0x04;
+    expect_decode("Aborted image", -1, TEST_IMAGE_LENGTH - 1);
+
+    printf("Test passed\n");
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    arith_test();
+
+    create_test_image();
+    round_trip_test(128, 0, T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(128, 0, 0, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(128, 0, T85_LRLTWO | T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(128, 0, T85_LRLTWO, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(TEST_IMAGE_LENGTH, 0, T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(1, 0, T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    round_trip_test(128, 127, T85_TPBON, TEST_IMAGE_LENGTH, TEST_IMAGE_LENGTH);
+    /* Images padded with white rows to their declared length */
+    round_trip_test(128, 0, T85_TPBON, TEST_IMAGE_LENGTH, 1);
+    /* Images whose length is set by NEWLEN, ending inside a stripe and at the end of one */
+    round_trip_test(128, 0, T85_TPBON, 0, TEST_IMAGE_LENGTH);
+    round_trip_test(128, 0, T85_TPBON, 0, 512);
+    round_trip_test(128, 0, 0, 0, 333);
+    round_trip_test(TEST_IMAGE_LENGTH, 0, T85_TPBON, 0, 457);
+
+    bad_data_tests();
+
+    printf("Tests passed\n");
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
@@ -0,0 +1,309 @@
+/*
+ * SpanDSP - a series of DSP components for telephony
+ *
+ * udptl_tests.c - Tests for the UDPTL module.
+ *
+ * Written by agent <agent@local>
+ *
+ * Copyright (C) 2026 agent
+ *
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*! \file */
+
+/*! \page udptl_tests_page UDPTL tests
+\section udptl_tests_page_sec_1 What does it do?
+These tests pass a long stream of IFP packets through UDPTL packet building and
+parsing, with packets being lost along the way, using each of the error recovery
+schemes. They check every packet delivered is intact, that none is delivered
+twice, and that the lost packets are recovered where the error recovery scheme
+allows it. They also feed corrupted packets to the receiver, to check it rejects
+them cleanly.
+*/
+
+#if defined(HAVE_CONFIG_H)
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//#if defined(WITH_SPANDSP_INTERNALS)
+#define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
+//#endif
+
+#include "spandsp.h"
+
+/* Enough packets to take the sequence numbers through a wrap around */
+#define TEST_PACKETS        70000
+
+uint8_t delivered[TEST_PACKETS];
+int bad_packets;
+int repeated_packets;
+int padded_packets;
+
+static int make_ifp(uint8_t msg[], int index)
+{
+    int len;
+    int i;
+
+    len = 4 + (index*7)%200;
+    msg[0] = (index >> 24) & 0xFF;
+    msg[1] = (index >> 16) & 0xFF;
+    msg[2] = (index >> 8) & 0xFF;
+    msg[3] = index & 0xFF;
+    for (i = 4;  i < len;  i++)
+        msg[i] = (index + i) & 0xFF;
+    return len;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int rx_packet_handler(void *user_data, const uint8_t msg[], int len, int seq_no)
+{
+    uint8_t expected[UDPTL_MAX_IFP_LEN];
+    int expected_len;
+    int index;
+
+    if (len < 4)
+    {
+        bad_packets++;
+        return 0;
+    }
+    index = (msg[0] << 24) | (msg[1] << 16) | (msg[2] << 8) | msg[3];
+    if (index < 0
+        ||
+        index >= TEST_PACKETS
+        ||
+        (index & 0xFFFF) != seq_no
+        ||
+        (expected_len = make_ifp(expected, index)) > len
+        ||
+        memcmp(msg, expected, expected_len))
+    {
+        bad_packets++;
+        return 0;
+    }
+    /* Parity FEC does not protect the length of a packet, so a packet rebuilt from
+       FEC data may be padded out to the length of the longest in its group. */
+    if (len > expected_len)
+        padded_packets++;
+    if (delivered[index])
+        repeated_packets++;
+    delivered[index] = TRUE;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int lost(int index)
+{
+    /* Lose isolated packets, and occasional bursts of three */
+    if ((index%11) == 5)
+        return TRUE;
+    if ((index%1100) >= 500  &&  (index%1100) < 503)
+        return TRUE;
+    return FALSE;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int stream_tests(int ec_scheme, int span, int entries, int max_unrecovered)
+{
+    udptl_state_t *tx;
+    udptl_state_t *rx;
+    uint8_t msg[UDPTL_MAX_IFP_LEN];
+    uint8_t buf[1500];
+    int msg_len;
+    int len;
+    int i;
+    int lost_packets;
+    int missing;
+
+    if ((tx = udptl_init(NULL, ec_scheme, span, entries, rx_packet_handler, NULL)) == NULL
+        ||
+        (rx = udptl_init(NULL, ec_scheme, span, entries, rx_packet_handler, NULL)) == NULL)
+    {
+        printf("Cannot start UDPTL\n");
+        return -1;
+    }
+    udptl_set_far_max_datagram(tx, sizeof(buf));
+    memset(delivered, 0, sizeof(delivered));
+    bad_packets = 0;
+    repeated_packets = 0;
+    padded_packets = 0;
+    lost_packets = 0;
+    for (i = 0;  i < TEST_PACKETS;  i++)
+    {
+        msg_len = make_ifp(msg, i);
+        if ((len = udptl_build_packet(tx, buf, sizeof(buf), msg, msg_len)) < 0)
+        {
+            printf("Failed to build packet %d\n", i);
+            return -1;
+        }
+        if (lost(i))
+        {
+            lost_packets++;
+            continue;
+        }
+        if (udptl_rx_packet(rx, buf, len))
+        {
+            printf("Packet %d rejected\n", i);
+            return -1;
+        }
+    }
+    missing = 0;
+    for (i = 0;  i < TEST_PACKETS;  i++)
+    {
+        if (!delivered[i])
+            missing++;
+    }
+    printf("%d packets lost, %d recovered (%d padded), %d bad, %d repeated\n",
+           lost_packets,
+           lost_packets - missing,
+           padded_packets,
+           bad_packets,
+           repeated_packets);
+    udptl_free(tx);
+    udptl_free(rx);
+    if (bad_packets  ||  repeated_packets)
+        return -1;
+    if (max_unrecovered >= 0  &&  missing > max_unrecovered)
+        return -1;
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int trimming_tests(void)
+{
+    udptl_state_t *tx;
+    uint8_t msg[UDPTL_MAX_IFP_LEN];
+    uint8_t buf[1500];
+    int len;
+    int i;
+
+    /* When redundant entries will not fit, the oldest should be dropped, and the packet
+       should still be sent. */
+    if ((tx = udptl_init(NULL, UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 3, rx_packet_handler, NULL)) == NULL)
+        return -1;
+    memset(msg, 0x55, sizeof(msg));
+    for (i = 0;  i < 4;  i++)
+    {
+        if ((len = udptl_build_packet(tx, buf, 250, msg, 100)) < 0  ||  len > 250)
+        {
+            printf("Redundant packet %d not trimmed to fit - %d\n", i, len);
+            return -1;
+        }
+    }
+    /* A primary packet which cannot fit must be refused, not overrun the buffer */
+    if (udptl_build_packet(tx, buf, 50, msg, 100) >= 0)
+    {
+        printf("Overlength packet accepted\n");
+        return -1;
+    }
+    udptl_free(tx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int attack_tests(void)
+{
+    udptl_state_t *tx;
+    udptl_state_t *rx;
+    uint8_t msg[UDPTL_MAX_IFP_LEN];
+    uint8_t buf[1500];
+    uint8_t bad[1500];
+    int msg_len;
+    int len;
+    int i;
+    int j;
+
+    /* Truncated or corrupted packets must never be delivered as good IFP packets. */
+    if ((tx = udptl_init(NULL, UDPTL_ERROR_CORRECTION_FEC, 3, 3, rx_packet_handler, NULL)) == NULL
+        ||
+        (rx = udptl_init(NULL, UDPTL_ERROR_CORRECTION_FEC, 3, 3, rx_packet_handler, NULL)) == NULL)
+    {
+        return -1;
+    }
+    bad_packets = 0;
+    for (i = 0;  i < 100;  i++)
+    {
+        msg_len = make_ifp(msg, i);
+        len = udptl_build_packet(tx, buf, sizeof(buf), msg, msg_len);
+        for (j = 0;  j < len;  j++)
+        {
+            if (udptl_rx_packet(rx, buf, j) == 0)
+            {
+                printf("Truncated packet %d, len %d accepted\n", i, j);
+                return -1;
+            }
+        }
+        memcpy(bad, buf, len);
+        bad[len] = 0;
+        if (udptl_rx_packet(rx, bad, len + 1) == 0)
+        {
+            printf("Overlength packet %d accepted\n", i);
+            return -1;
+        }
+        for (j = 0;  j < len;  j++)
+            bad[j] = rand();
+        udptl_rx_packet(rx, bad, len);
+    }
+    udptl_free(tx);
+    udptl_free(rx);
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+    printf("No error recovery\n");
+    if (stream_tests(UDPTL_ERROR_CORRECTION_NONE, 0, 0, -1))
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    printf("Redundancy error recovery\n");
+    /* Three redundant packets should recover everything we lose */
+    if (stream_tests(UDPTL_ERROR_CORRECTION_REDUNDANCY, 0, 3, 0))
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    printf("FEC error recovery\n");
+    /* Each packet in a burst of three lies in a different FEC group, so FEC should
+       recover everything we lose */
+    if (stream_tests(UDPTL_ERROR_CORRECTION_FEC, 3, 3, 0))
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    printf("Redundancy trimming\n");
+    if (trimming_tests())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    printf("Corrupt packets\n");
+    if (attack_tests())
+    {
+        printf("Tests failed\n");
+        exit(2);
+    }
+    printf("Tests passed\n");
+    return  0;
+}
+/*- End of function --------------------------------------------------------*/
+/*- End of file ------------------------------------------------------------*/
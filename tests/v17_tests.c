@@ -280,6 +280,90 @@ static void fpe_trap_setup(void)
 /*- End of function --------------------------------------------------------*/
 #endif
 
+static int cache_test_get_bit(void *user_data)
+{
+    uint32_t *seed;
+
+    /* Both transmitters under test must see exactly the same data bits */
+    seed = (uint32_t *) user_data;
+    *seed = *seed*1103515245 + 12345;
+    return (*seed >> 16) & 1;
+}
+/*- End of function --------------------------------------------------------*/
+
+static int compare_cached_training(v17_tx_state_t *live, uint32_t *live_seed, v17_tx_state_t *cached, uint32_t *cached_seed)
+{
+    int16_t live_amp[BLOCK_LEN];
+    int16_t cached_amp[BLOCK_LEN];
+    int live_len;
+    int cached_len;
+    int len;
+    int block_no;
+
+    *live_seed = 0x12345678;
+    *cached_seed = 0x12345678;
+    /* Use irregular block lengths, so the cached segments get split in many different
+       places. Run well past the end of the training, into the data. */
+    for (block_no = 0;  block_no < 400;  block_no++)
+    {
+        len = (block_no*37)%BLOCK_LEN + 1;
+        live_len = v17_tx(live, live_amp, len);
+        cached_len = v17_tx(cached, cached_amp, len);
+        if (live_len != cached_len  ||  memcmp(live_amp, cached_amp, live_len*sizeof(live_amp[0])))
+            return -1;
+    }
+    return 0;
+}
+/*- End of function --------------------------------------------------------*/
+
+static void training_cache_tests(void)
+{
+    static const int bit_rates[] =
+    {
+        14400, 12000, 9600, 7200, 4800, 0
+    };
+    v17_tx_state_t *live;
+    v17_tx_state_t *cached;
+    uint32_t live_seed;
+    uint32_t cached_seed;
+    int i;
+    int tep;
+    int short_train;
+
+    printf("Checking the cached training against live training\n");
+    for (i = 0;  bit_rates[i];  i++)
+    {
+        for (tep = 0;  tep < 2;  tep++)
+        {
+            live = v17_tx_init(NULL, bit_rates[i], tep, cache_test_get_bit, &live_seed);
+            cached = v17_tx_init(NULL, bit_rates[i], tep, cache_test_get_bit, &cached_seed);
+            v17_tx_power(live, -17.0f);
+            v17_tx_power(cached, -17.0f);
+            if (v17_tx_set_training_cache(cached, TRUE))
+            {
+                printf("Cannot enable the training cache\n");
+                exit(2);
+            }
+            for (short_train = 0;  short_train < 2;  short_train++)
+            {
+                /* A short train is only allowed after a long one */
+                v17_tx_restart(live, bit_rates[i], tep, short_train);
+                v17_tx_restart(cached, bit_rates[i], tep, short_train);
+                if (compare_cached_training(live, &live_seed, cached, &cached_seed))
+                {
+                    printf("Cached training differs at %dbps, TEP %d, short train %d\n", bit_rates[i], tep, short_train);
+                    printf("Tests failed.\n");
+                    exit(2);
+                }
+            }
+            v17_tx_free(live);
+            v17_tx_free(cached);
+        }
+    }
+    printf("Cached training matches live training\n");
+}
+/*- End of function --------------------------------------------------------*/
+
 int main(int argc, char *argv[])
 {
     v17_rx_state_t *rx;
@@ -383,6 +467,9 @@ int main(int argc, char *argv[])
     fpe_trap_setup();
 #endif
 
+    if (decode_test_file == NULL)
+        training_cache_tests();
+
     if (log_audio)
     {
         if ((outhandle = sf_open_telephony_write(OUT_FILE_NAME, 1)) == NULL)